@@ -0,0 +1,141 @@
+#include "advertising_scheduler.h"
+
+#include <string.h>
+
+#include "ble_gap.h"
+#include "app_util_platform.h"
+#include "nrf_error.h"
+
+#include "bluetooth_config.h"
+#include "eddystone.h"
+
+#define NRF_LOG_MODULE_NAME "ADV_SCHEDULER"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#define ADV_SCHEDULER_NONE 0xFF
+
+/** Encoded frame is double-buffered: main context writes one buffer while radio interrupt reads the other **/
+typedef struct {
+  uint8_t           data[2][BLE_GAP_ADV_MAX_SIZE];
+  uint16_t          length[2];
+  volatile uint8_t  active;     // Buffer which goes on air
+  uint16_t          period;     // 0: disabled, N: once every N radio events
+  uint16_t          countdown;  // Radio events until frame is due
+  uint32_t          events;     // Radio events frame was selected for
+}adv_frame_t;
+
+static adv_frame_t      m_frames[ADV_SCHEDULER_MAX_FRAMES];
+static volatile uint8_t m_current = ADV_SCHEDULER_NONE; // Frame given to SoftDevice
+static volatile uint32_t m_events = 0;
+
+static bool frame_is_valid(uint8_t frame)
+{
+  return frame < ADV_SCHEDULER_MAX_FRAMES;
+}
+
+static ret_code_t frame_apply(uint8_t frame)
+{
+  adv_frame_t* p_frame = &m_frames[frame];
+  uint8_t buffer = p_frame->active;
+  // NULL scan response keeps the current one
+  return sd_ble_gap_adv_data_set(p_frame->data[buffer], p_frame->length[buffer], NULL, 0);
+}
+
+/** Count down all frames and pick the due frame with the longest period **/
+static uint8_t frame_next(void)
+{
+  uint8_t next = ADV_SCHEDULER_NONE;
+  for(uint8_t ii = 0; ii < ADV_SCHEDULER_MAX_FRAMES; ii++)
+  {
+    adv_frame_t* p_frame = &m_frames[ii];
+    if(!p_frame->period || !p_frame->length[p_frame->active]) { continue; }
+    if(p_frame->countdown) { p_frame->countdown--; }
+    if(p_frame->countdown) { continue; }
+    if(ADV_SCHEDULER_NONE == next || p_frame->period > m_frames[next].period) { next = ii; }
+  }
+  if(ADV_SCHEDULER_NONE != next) { m_frames[next].countdown = m_frames[next].period; }
+  return next;
+}
+
+void adv_scheduler_on_radio_evt(bool active)
+{
+  if(active) { return; }
+  m_events++;
+  uint8_t next = frame_next();
+  if(ADV_SCHEDULER_NONE == next) { return; }
+  m_frames[next].events++;
+  if(next == m_current) { return; }
+  if(NRF_SUCCESS == frame_apply(next)) { m_current = next; }
+}
+
+ret_code_t adv_scheduler_frame_period_set(uint8_t frame, uint16_t period)
+{
+  if(!frame_is_valid(frame)) { return NRF_ERROR_INVALID_PARAM; }
+  CRITICAL_REGION_ENTER();
+  m_frames[frame].period = period;
+  // First rotation sends frame after a full period, frames added together do not all collide on next event
+  m_frames[frame].countdown = period;
+  CRITICAL_REGION_EXIT();
+  return NRF_SUCCESS;
+}
+
+ret_code_t adv_scheduler_frame_encode(uint8_t frame, const ble_advdata_t* advdata)
+{
+  if(!frame_is_valid(frame)) { return NRF_ERROR_INVALID_PARAM; }
+  if(NULL == advdata)        { return NRF_ERROR_NULL; }
+  adv_frame_t* p_frame = &m_frames[frame];
+  uint8_t buffer = !p_frame->active;
+  uint16_t length = BLE_GAP_ADV_MAX_SIZE;
+  ret_code_t err_code = adv_data_encode(advdata, p_frame->data[buffer], &length);
+  if(NRF_SUCCESS != err_code)
+  {
+    NRF_LOG_ERROR("Frame %d encoding failed: %d\r\n", frame, err_code);
+    return err_code;
+  }
+  p_frame->length[buffer] = length;
+
+  // Radio interrupt must not swap frames between the check and the update of SoftDevice data
+  CRITICAL_REGION_ENTER();
+  p_frame->active = buffer;
+  if(frame == m_current || (ADV_SCHEDULER_NONE == m_current && p_frame->period))
+  {
+    err_code = frame_apply(frame);
+    if(NRF_SUCCESS == err_code) { m_current = frame; }
+  }
+  CRITICAL_REGION_EXIT();
+  return err_code;
+}
+
+ret_code_t adv_scheduler_set_manufacturer_data(uint8_t frame, const uint8_t* data, size_t length)
+{
+  //31 bytes - overhead - 2 bytes for manufacturer ID
+  if(24 < length || (length && NULL == data)) { return NRF_ERROR_INVALID_PARAM; }
+  uint8_t data_array[24];
+  memcpy(data_array, data, length);
+  ble_advdata_manuf_data_t manufacturer_data = { .company_identifier = BLE_COMPANY_IDENTIFIER,
+                                                 .data = { .size = length, .p_data = data_array }};
+  ble_advdata_t advdata;
+  memset(&advdata, 0, sizeof(advdata));
+  advdata.flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+  advdata.p_manuf_specific_data = length ? &manufacturer_data : NULL;
+  return adv_scheduler_frame_encode(frame, &advdata);
+}
+
+ret_code_t adv_scheduler_set_eddystone_url(uint8_t frame, char* url, size_t length)
+{
+  ble_advdata_t advdata;
+  ret_code_t err_code = eddystone_prepare_url_advertisement(&advdata, url, length);
+  if(NRF_SUCCESS != err_code) { return err_code; }
+  return adv_scheduler_frame_encode(frame, &advdata);
+}
+
+uint32_t adv_scheduler_frame_events(uint8_t frame)
+{
+  return frame_is_valid(frame) ? m_frames[frame].events : 0;
+}
+
+uint32_t adv_scheduler_events(void)
+{
+  return m_events;
+}
@@ -0,0 +1,74 @@
+#ifndef ADVERTISING_SCHEDULER_H
+#define ADVERTISING_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ble_advdata.h"
+#include "sdk_errors.h"
+
+/**
+ *  Rotates several advertising frames on one advertising timer, i.e. RAWv2 on every event,
+ *  RAWv1 on every 4th and an Eddystone URL on every 16th.
+ *
+ *  Frames are encoded to raw advertisement data when their content changes. After each radio event
+ *  the frame due on the next event is given to the SoftDevice with sd_ble_gap_adv_data_set, so rotating
+ *  costs one SVC call and no encoding. Scan response set by bluetooth_core is left as is.
+ *
+ *  Every frame has a period: 0 disables the frame, N sends it once every N radio events.
+ *  Frame with period 1 fills the events no other frame is due on. If several frames are due,
+ *  the one with the longest period goes first and the others follow on the next events.
+ *  Radio events of a connection advance the rotation too.
+ */
+
+// RAWv2, RAWv1, URL, TLM, relay and motion statistics of ruuvi_firmware
+#ifndef ADV_SCHEDULER_MAX_FRAMES
+  #define ADV_SCHEDULER_MAX_FRAMES 6
+#endif
+
+/**
+ *  Set how often frame is advertised. Takes effect on next radio event.
+ *
+ *  @param frame index of frame, 0 ... ADV_SCHEDULER_MAX_FRAMES - 1
+ *  @param period 0 to disable, N to send once every N radio events
+ *  @return NRF_SUCCESS, NRF_ERROR_INVALID_PARAM on invalid frame
+ */
+ret_code_t adv_scheduler_frame_period_set(uint8_t frame, uint16_t period);
+
+/**
+ *  Encode frame from advertisement data. Frame on air is given to the SoftDevice immediately.
+ *  Call from main context only.
+ *
+ *  @param frame index of frame
+ *  @param advdata content of frame
+ *  @return NRF_SUCCESS, error from encoding or from SoftDevice
+ */
+ret_code_t adv_scheduler_frame_encode(uint8_t frame, const ble_advdata_t* advdata);
+
+/**
+ *  Encode frame with manufacturer specific data, company ID is added. See bluetooth_set_manufacturer_data.
+ *
+ *  @param data manufacturer specific data, maximum length 24 bytes
+ */
+ret_code_t adv_scheduler_set_manufacturer_data(uint8_t frame, const uint8_t* data, size_t length);
+
+/**
+ *  Encode frame with Eddystone URL. See bluetooth_set_eddystone_url.
+ */
+ret_code_t adv_scheduler_set_eddystone_url(uint8_t frame, char* url, size_t length);
+
+/**
+ *  Call from radio notification handler. Selects next frame after radio goes inactive.
+ *
+ *  @param active true if radio is about to be active, false if radio event has ended
+ */
+void adv_scheduler_on_radio_evt(bool active);
+
+/** Number of radio events frame was selected for since boot **/
+uint32_t adv_scheduler_frame_events(uint8_t frame);
+
+/** Number of radio events since boot, i.e. advertisement count of Eddystone TLM **/
+uint32_t adv_scheduler_events(void);
+
+#endif
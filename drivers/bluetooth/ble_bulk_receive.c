@@ -0,0 +1,220 @@
+#include "ble_bulk_receive.h"
+
+#include <string.h>
+
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nrf_error.h"
+
+#include "ruuvi_endpoints.h"
+#include "crc8.h"
+#include "init.h"
+
+#define NRF_LOG_MODULE_NAME "BLE_BULK_RX"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+typedef enum{
+  BULK_RX_IDLE,       // No transfer
+  BULK_RX_RECEIVING,  // Header received, chunks missing
+  BULK_RX_DELIVERING, // All chunks received, CRC check and routing scheduled
+  BULK_RX_COMPLETE,   // Payload was routed, polls are acknowledged
+  BULK_RX_FAILED      // Payload failed CRC check, next poll is answered with ERROR
+}ble_bulk_rx_state_t;
+
+/** State is written in BLE event (interrupt) context and read in scheduler context **/
+static volatile ble_bulk_rx_state_t m_state = BULK_RX_IDLE;
+static ble_bulk_tx_header_t m_header;
+static uint8_t m_received[256 / 8];
+static uint8_t m_received_count = 0;
+static uint8_t m_buffer[BLE_BULK_RX_BUFFER_SIZE];
+static volatile uint8_t m_link = BLE_LINK_INVALID; // Link which writes the transfer
+
+/** Timer to drop transfer if central goes silent, and to forget finished transfer which was not polled **/
+APP_TIMER_DEF(m_rx_timer);
+static bool m_rx_timer_created = false;
+
+static void rx_timeout_handler(void* p_context)
+{
+  if(BULK_RX_DELIVERING == m_state || BULK_RX_IDLE == m_state) { return; }
+  if(BULK_RX_RECEIVING == m_state)
+  {
+    NRF_LOG_WARNING("Bulk write to %x timed out, %d of %d chunks\r\n", m_header.endpoint, m_received_count, m_header.chunks);
+  }
+  m_state = BULK_RX_IDLE;
+}
+
+static void rx_timer_restart(void)
+{
+  if(!m_rx_timer_created)
+  {
+    m_rx_timer_created = (NRF_SUCCESS == app_timer_create(&m_rx_timer, APP_TIMER_MODE_SINGLE_SHOT, rx_timeout_handler));
+  }
+  if(!m_rx_timer_created) { return; }
+  app_timer_stop(m_rx_timer);
+  app_timer_start(m_rx_timer, BLE_BULK_RX_TIMEOUT, NULL);
+}
+
+static void rx_timer_stop(void)
+{
+  if(m_rx_timer_created) { app_timer_stop(m_rx_timer); }
+}
+
+static bool is_received(uint8_t index)
+{
+  return m_received[index / 8] & (1 << (index % 8));
+}
+
+/** Check CRC of whole payload and route it, scheduler context **/
+static void deliver_scheduler_event_handler(void *p_event_data, uint16_t event_size)
+{
+  if(BULK_RX_DELIVERING != m_state) { return; }
+  if(crc8_compute(m_buffer, m_header.length, CRC8_INITIAL_VALUE) != m_header.CRC8)
+  {
+    NRF_LOG_WARNING("Bulk write to %x failed CRC\r\n", m_header.endpoint);
+    // Acknowledged sender is told to start again, otherwise transfer is just dropped
+    m_state = (m_header.flags & BLE_BULK_FLAG_ACK) ? BULK_RX_FAILED : BULK_RX_IDLE;
+    if(BULK_RX_FAILED == m_state) { rx_timer_restart(); }
+    return;
+  }
+  NRF_LOG_INFO("Received %d bytes to %x\r\n", m_header.length, m_header.endpoint);
+  // Replies of endpoint go back to the writer
+  ble_link_set_requester(m_link);
+  route_bulk_message(m_header.endpoint, m_buffer, m_header.length);
+  m_state = BULK_RX_COMPLETE;
+  // Polls are acknowledged until timeout, after that writes to endpoint are standard messages only
+  rx_timer_restart();
+}
+
+/** Answer poll with acknowledgement bitmap, scheduler context **/
+static void poll_scheduler_event_handler(void *p_event_data, uint16_t event_size)
+{
+  ruuvi_standard_message_t ack = { .destination_endpoint = BULK_TRANSFER,
+                                   .source_endpoint      = m_header.endpoint,
+                                   .type                 = ACKNOWLEDGEMENT,
+                                   .payload              = {0}};
+  ack.payload[0] = m_header.endpoint;
+  CRITICAL_REGION_ENTER();
+  switch(m_state)
+  {
+    case BULK_RX_RECEIVING:
+    {
+      uint8_t base = 0;
+      while(base < m_header.chunks && is_received(base)) { base++; }
+      ack.payload[1] = base;
+      for(uint8_t ii = 0; ii < BLE_BULK_MAX_WINDOW && base + ii < m_header.chunks; ii++)
+      {
+        if(is_received(base + ii)) { ack.payload[2 + ii / 8] |= 1 << (ii % 8); }
+      }
+      break;
+    }
+
+    case BULK_RX_COMPLETE:
+      ack.payload[1] = m_header.chunks;
+      break;
+
+    case BULK_RX_FAILED:
+      ack.type = ERROR;
+      m_state = BULK_RX_IDLE;
+      break;
+
+    // Payload is being checked, answer next poll
+    case BULK_RX_DELIVERING:
+    case BULK_RX_IDLE:
+    default:
+      CRITICAL_REGION_EXIT();
+      return;
+  }
+  CRITICAL_REGION_EXIT();
+  ble_std_link_transfer_asynchronous(m_link, ack);
+}
+
+static void receive_header(const uint8_t* data)
+{
+  ble_bulk_tx_header_t header = { .endpoint   = data[0],
+                                  .index      = data[1],
+                                  .chunks     = data[2],
+                                  .CRC8       = data[3],
+                                  .flags      = data[4],
+                                  .window     = data[5],
+                                  .chunk_size = data[6],
+                                  .length     = data[7] | (data[8] << 8) };
+  // Payload which is being routed must not be overwritten, sender retries.
+  if(BULK_RX_DELIVERING == m_state) { return; }
+  m_state = BULK_RX_IDLE;
+  if(!header.chunk_size ||
+     header.chunks > BLE_BULK_MAX_CHUNKS ||
+     header.length > BLE_BULK_RX_BUFFER_SIZE ||
+     header.window > BLE_BULK_MAX_WINDOW ||
+     header.chunks != (header.length + header.chunk_size - 1) / header.chunk_size)
+  {
+    NRF_LOG_WARNING("Rejected bulk write of %d bytes to %x\r\n", header.length, header.endpoint);
+    return;
+  }
+  m_header = header;
+  m_link = ble_link_get_writer();
+  memset(m_received, 0, sizeof(m_received));
+  m_received_count = 0;
+  m_state = header.chunks ? BULK_RX_RECEIVING : BULK_RX_DELIVERING;
+  if(BULK_RX_DELIVERING == m_state) { app_sched_event_put(NULL, 0, deliver_scheduler_event_handler); }
+  else { rx_timer_restart(); }
+  NRF_LOG_DEBUG("Receiving %d bytes in %d chunks\r\n", header.length, header.chunks);
+}
+
+static void receive_chunk(const uint8_t* data, size_t length)
+{
+  uint8_t index = data[1];
+  if(BULK_RX_RECEIVING != m_state || index >= m_header.chunks) { return; }
+  rx_timer_restart();
+  if(is_received(index)) { return; } // Retransmission of a chunk which was received
+
+  size_t offset = (size_t)index * m_header.chunk_size;
+  size_t size = MIN(m_header.chunk_size, m_header.length - offset);
+  if(length != BLE_CHUNK_HEADER_SIZE + size) { return; }
+  uint8_t crc = crc8_compute(data, 2, CRC8_INITIAL_VALUE);
+  if(crc8_compute(&data[BLE_CHUNK_HEADER_SIZE], size, crc) != data[2])
+  {
+    NRF_LOG_DEBUG("Chunk %d failed CRC\r\n", index);
+    return;
+  }
+  memcpy(&m_buffer[offset], &data[BLE_CHUNK_HEADER_SIZE], size);
+  m_received[index / 8] |= 1 << (index % 8);
+  if(++m_received_count == m_header.chunks)
+  {
+    rx_timer_stop();
+    m_state = BULK_RX_DELIVERING;
+    if(NRF_SUCCESS != app_sched_event_put(NULL, 0, deliver_scheduler_event_handler))
+    {
+      // Scheduler is full, sender polls or sends again
+      m_state = BULK_RX_IDLE;
+    }
+  }
+}
+
+bool ble_bulk_receive(const uint8_t* data, size_t length)
+{
+  if(NULL == data || length < BLE_BULK_POLL_SIZE) { return false; }
+  if(BLE_BULK_HEADER_SIZE == length && BLE_BULK_INDEX_HEADER == data[1])
+  {
+    receive_header(data);
+    return true;
+  }
+  if(BULK_RX_IDLE == m_state || data[0] != m_header.endpoint || ble_link_get_writer() != m_link) { return false; }
+  if(BLE_BULK_POLL_SIZE == length && BLE_BULK_INDEX_POLL == data[1])
+  {
+    app_sched_event_put(NULL, 0, poll_scheduler_event_handler);
+    return true;
+  }
+  // Once all chunks are in only polls belong to the transfer, 11-byte writes are standard messages again
+  if(BULK_RX_RECEIVING != m_state || length <= BLE_CHUNK_HEADER_SIZE) { return false; }
+  receive_chunk(data, length);
+  return true;
+}
+
+void ble_bulk_receive_reset(uint8_t link)
+{
+  if(BLE_LINK_INVALID != link && link != m_link) { return; }
+  rx_timer_stop();
+  if(BULK_RX_DELIVERING != m_state) { m_state = BULK_RX_IDLE; }
+}
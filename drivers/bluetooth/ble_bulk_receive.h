@@ -0,0 +1,49 @@
+#ifndef BLE_BULK_RECEIVE_H
+#define BLE_BULK_RECEIVE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ble_bulk_transfer.h"
+
+/**
+ *  Reassembly of bulk writes from central, mirror of ble_bulk_transfer_asynchronous.
+ *  Central writes header, chunks and polls to NUS RX with the protocol in ble_bulk_transfer.h.
+ *  Chunks may arrive in any order and are copied to a static buffer at index * chunk size.
+ *  Polls are answered with acknowledgement bitmap through ble_std_link_transfer_asynchronous.
+ *  Payload with a valid CRC is routed to its endpoint with route_bulk_message in scheduler context.
+ *
+ *  One transfer is received at a time. A new header starts a new transfer, except while
+ *  previous payload is being routed. Transfer belongs to the link which wrote the header,
+ *  chunks and polls of other links are not part of it. Replies to payload go to that link.
+ */
+
+#ifndef BLE_BULK_RX_BUFFER_SIZE
+  #define BLE_BULK_RX_BUFFER_SIZE 2048                                         // Largest accepted payload
+#endif
+
+#ifndef BLE_BULK_RX_TIMEOUT
+  #define BLE_BULK_RX_TIMEOUT APP_TIMER_TICKS(5000, RUUVITAG_APP_TIMER_PRESCALER) // Drop transfer if central goes silent, forget finished one
+#endif
+
+/**
+ *  Feed data written to NUS RX. Call from NUS data handler before parsing standard messages.
+ *  Data is copied, handler may return immediately.
+ *
+ *  Standard messages are 11 bytes like 8-byte chunks, so 11-byte writes are treated as chunks
+ *  only if they start with the endpoint of a transfer which is still missing chunks.
+ *  After the last chunk only polls belong to the transfer until BLE_BULK_RX_TIMEOUT.
+ *
+ *  @param data written by central
+ *  @param length length of data
+ *  @return true if data belonged to bulk transfer
+ */
+bool ble_bulk_receive(const uint8_t* data, size_t length);
+
+/**
+ *  Drop ongoing transfer of link, i.e. on disconnect. Transfers of other links are kept.
+ *  @param link link which was closed, BLE_LINK_INVALID drops transfer of any link
+ */
+void ble_bulk_receive_reset(uint8_t link);
+
+#endif
@@ -1,191 +1,863 @@
 #include "ble_bulk_transfer.h"
 
 #include "ble_nus.h"
-#include "nrf_queue.h"
 #include "nrf_error.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
 
 #include "ruuvi_endpoints.h"
+#include "ruuvi_message_frame.h"
+#include "ruuvi_sample_stream.h"
+#include "bluetooth_core.h"
+#include "ble_diagnostics.h"
+#include "crc8.h"
 
 #define NRF_LOG_MODULE_NAME "BLE_BULK_TX"
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
 
-NRF_QUEUE_DEF(ble_bulk_tx_t, m_ble_tx_queue, BLE_BULK_QUEUE_SIZE, NRF_QUEUE_MODE_OVERFLOW);
-NRF_QUEUE_DEF(ruuvi_standard_message_t, m_std_tx_queue, BLE_STD_QUEUE_SIZE, NRF_QUEUE_MODE_OVERFLOW);
+/** Queues and state of one central. Standard message queue drops its oldest message when full. **/
+typedef struct{
+  uint16_t conn_handle;        // BLE_CONN_HANDLE_INVALID if link is free
+  bool     notifications;      // Central has enabled notifications of NUS RX characteristic
+  uint16_t att_mtu;            // ATT MTU agreed with central
+  uint32_t connected_ticks;    // Time of connection
+
+  ruuvi_standard_message_t std_queue[BLE_STD_QUEUE_SIZE];
+  uint8_t  std_head;
+  uint8_t  std_count;
+
+  /** Standard message framing. Pending frame is kept over calls if softdevice buffers are full **/
+  uint8_t  frame[BLE_RAW_MAX_SIZE];
+  size_t   frame_length;       // 0 if there is no pending frame
+
+  /** Bulk transfers, first element is the active transfer. State is updated in place. **/
+  ble_bulk_tx_t bulk_queue[BLE_BULK_QUEUE_SIZE];
+  uint8_t  bulk_head;
+  uint8_t  bulk_count;
+
+  ble_link_statistics_t statistics;
+}ble_link_t;
 
 /** Pointer to NUS **/
 ble_nus_t* p_nus;
 
+static ble_link_t m_links[BLE_LINK_COUNT];
+static bool       m_links_initialized = false;
+static uint8_t    m_link_next   = 0;                // Link served first on next ble_message_queue_process
+static volatile uint8_t m_writer = BLE_LINK_INVALID; // Link which wrote data handled in BLE event context
+static uint8_t    m_requester   = BLE_LINK_INVALID; // Link which sent latest request
+static uint8_t    m_stream_link = BLE_LINK_INVALID; // Link which configured the source of sample stream
+static uint8_t    m_stream_endpoint = 0;            // Source of sample stream, valid once stream has started
+static bool       m_stream_started  = false;
+
+static bool m_bulk_acknowledged = APPLICATION_BLE_BULK_ACK;
+static bool m_std_packing = APPLICATION_BLE_STD_PACKING;
+
+/** Source of sample stream, refills softdevice buffers after backpressure **/
+static ble_stream_ready_handler_t p_stream_ready_handler = NULL;
+
+/** Throughput counters of all links and state of current transfer burst **/
+static ble_transfer_statistics_t m_statistics = {0};
+static bool     m_transfer_active = false;
+static uint32_t m_transfer_start  = 0;
+static uint32_t m_transfer_bytes  = 0;
+static uint32_t m_transfer_bulks  = 0; // Completed bulk transfers at start of burst
+
+/** Timer to relax connection parameters after transfer **/
+APP_TIMER_DEF(m_idle_timer);
+static bool m_idle_timer_created = false;
+
+static void idle_timeout_handler(void* p_context)
+{
+  NRF_LOG_DEBUG("Transfer idle, relaxing connection parameters\r\n");
+  bluetooth_conn_params_fast(false);
+}
+
+static void links_init(void)
+{
+  if(m_links_initialized) { return; }
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++)
+  {
+    m_links[ii].conn_handle = BLE_CONN_HANDLE_INVALID;
+    m_links[ii].att_mtu     = GATT_MTU_SIZE_DEFAULT;
+  }
+  m_links_initialized = true;
+}
+
+static bool link_is_connected(uint8_t link)
+{
+  links_init();
+  return link < BLE_LINK_COUNT && BLE_CONN_HANDLE_INVALID != m_links[link].conn_handle;
+}
+
+/** Requester, or first connected link if requester has disconnected **/
+static ble_link_t* requester_link(void)
+{
+  if(link_is_connected(m_requester)) { return &m_links[m_requester]; }
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++)
+  {
+    if(link_is_connected(ii)) { return &m_links[ii]; }
+  }
+  return NULL;
+}
+
+/** Link which configured the stream source, requester until stream has started **/
+static ble_link_t* stream_link(void)
+{
+  if(link_is_connected(m_stream_link)) { return &m_links[m_stream_link]; }
+  return requester_link();
+}
+
+/** Timer to poll receiver again if acknowledgement does not arrive. Runs to earliest deadline of all links. **/
+APP_TIMER_DEF(m_ack_timer);
+static bool m_ack_timer_created = false;
+
+static uint32_t ticks_since(uint32_t ticks)
+{
+  uint32_t now, elapsed;
+  app_timer_cnt_get(&now);
+  app_timer_cnt_diff_compute(now, ticks, &elapsed);
+  return elapsed;
+}
+
+/** Active transfer of link if it is waiting for acknowledgement **/
+static ble_bulk_tx_t* waiting_transfer(ble_link_t* p_link)
+{
+  if(BLE_CONN_HANDLE_INVALID == p_link->conn_handle || !p_link->bulk_count) { return NULL; }
+  ble_bulk_tx_t* tx = &p_link->bulk_queue[p_link->bulk_head];
+  return (BULK_TX_WAIT == tx->state) ? tx : NULL;
+}
+
+static void ack_timer_schedule(void)
+{
+  if(!m_ack_timer_created) { return; }
+  app_timer_stop(m_ack_timer);
+  uint32_t timeout = UINT32_MAX;
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++)
+  {
+    ble_bulk_tx_t* tx = waiting_transfer(&m_links[ii]);
+    if(NULL == tx) { continue; }
+    uint32_t elapsed = ticks_since(tx->poll_ticks);
+    uint32_t remaining = (elapsed < BLE_BULK_ACK_TIMEOUT) ? BLE_BULK_ACK_TIMEOUT - elapsed : 0;
+    timeout = MIN(timeout, remaining);
+  }
+  if(UINT32_MAX == timeout) { return; }
+  app_timer_start(m_ack_timer, MAX(timeout, APP_TIMER_MIN_TIMEOUT_TICKS), NULL);
+}
+
+static void ack_timeout_handler(void* p_context)
+{
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++)
+  {
+    ble_bulk_tx_t* tx = waiting_transfer(&m_links[ii]);
+    if(NULL == tx || ticks_since(tx->poll_ticks) < BLE_BULK_ACK_TIMEOUT) { continue; }
+    if(++tx->retries > BLE_BULK_MAX_RETRIES)
+    {
+      NRF_LOG_ERROR("Bulk transfer to %x was not acknowledged\r\n", tx->endpoint);
+      tx->state = BULK_TX_FAILED;
+    }
+    else { tx->state = BULK_TX_POLL; }
+  }
+  // Main loop sends the polls
+  ack_timer_schedule();
+}
+
+/** First notification of a burst: ask for short connection interval and start timing **/
+static void transfer_started(void)
+{
+  if(m_transfer_active) { return; }
+  if(!m_idle_timer_created)
+  {
+    m_idle_timer_created = (NRF_SUCCESS == app_timer_create(&m_idle_timer, APP_TIMER_MODE_SINGLE_SHOT, idle_timeout_handler));
+  }
+  app_timer_stop(m_idle_timer);
+  bluetooth_conn_params_fast(true);
+  app_timer_cnt_get(&m_transfer_start);
+  m_transfer_bytes  = 0;
+  m_transfer_bulks  = m_statistics.transfers;
+  m_transfer_active = true;
+}
+
+/** Queues of all links are empty or unusable: stop timing, relax connection interval after a while **/
+static void transfer_stopped(void)
+{
+  if(!m_transfer_active) { return; }
+  uint32_t ms = (uint32_t)(((uint64_t)ticks_since(m_transfer_start) * 1000 * (RUUVITAG_APP_TIMER_PRESCALER + 1)) / APP_TIMER_CLOCK_FREQ);
+  m_statistics.active_ms += ms;
+  m_transfer_active = false;
+  // Report bursts which carried bulk data, std message bursts are too short to measure
+  if(m_transfer_bulks != m_statistics.transfers && ms)
+  {
+    NRF_LOG_INFO("Sent %d bytes in %d ms, %d B/s, %d links\r\n", m_transfer_bytes, ms, (m_transfer_bytes * 1000) / ms, ble_link_count());
+  }
+  if(m_idle_timer_created) { app_timer_start(m_idle_timer, TRANSFER_IDLE_TIMEOUT, NULL); }
+}
+
+/** Send raw data to link, max ATT MTU - 3 bytes **/
+static ret_code_t link_transfer_raw(ble_link_t* p_link, uint8_t* data, size_t length)
+{
+  NRF_LOG_DEBUG("Transferring %d bytes\r\n", length);
+  if(NULL == p_nus) { return NRF_ERROR_INVALID_STATE; }
+  if(length > (size_t)(p_link->att_mtu - BLE_ATT_HEADER_SIZE)) { return NRF_ERROR_INVALID_LENGTH; }
+  // NUS notifies the connection it holds, copy points to link and keeps NUS state of other links intact
+  ble_nus_t nus = *p_nus;
+  nus.conn_handle = p_link->conn_handle;
+  nus.is_notification_enabled = p_link->notifications;
+  uint32_t err_code = ble_nus_string_send(&nus, data, length);
+  if(NRF_SUCCESS == err_code)
+  {
+    transfer_started();
+    m_transfer_bytes += length;
+    m_statistics.bytes += length;
+    m_statistics.notifications++;
+    p_link->statistics.bytes += length;
+    p_link->statistics.notifications++;
+  }
+  else if(BLE_ERROR_NO_TX_PACKETS == err_code)
+  {
+    m_statistics.busy++;
+    p_link->statistics.busy++;
+  }
+  return err_code;
+}
+
+/** Largest chunk which fits into one notification with MTU of link **/
+static uint8_t chunk_size(const ble_link_t* p_link)
+{
+  return p_link->att_mtu - BLE_ATT_HEADER_SIZE - BLE_CHUNK_HEADER_SIZE;
+}
+
+/** Chunks of window which exist, bit 0 is chunk base **/
+static uint64_t window_mask(const ble_bulk_tx_t* tx)
+{
+  uint8_t count = MIN(tx->header.window, tx->header.chunks - tx->base);
+  return (count >= 64) ? UINT64_MAX : ((1ULL << count) - 1);
+}
+
+/**
+ *  (Re)start transfer from header with chunks of current MTU of link.
+ *  Returns false if data does not fit into BLE_BULK_MAX_CHUNKS chunks.
+ */
+static bool bulk_restart(const ble_link_t* p_link, ble_bulk_tx_t* tx)
+{
+  uint8_t size = chunk_size(p_link);
+  if((size_t)BLE_BULK_MAX_CHUNKS * size < tx->length) { return false; }
+  if(tx->next) { m_statistics.retransmissions += tx->next; }
+  tx->chunk_size     = size;
+  tx->header.chunk_size = size;
+  tx->header.chunks  = tx->length / size + ((tx->length % size) ? 1 : 0);
+  tx->state          = BULK_TX_HEADER;
+  tx->base           = 0;
+  tx->next           = 0;
+  tx->pending        = window_mask(tx);
+  return true;
+}
+
 /** Asynchronous transfer.
  *  This is entry point for bulk transfer library, i.e. data and length can be any values
  *  Driver handles splitting data to chunks
  *
  *  @param endpoint destination endpoint of data transfer. Plese refer to Ruuvi interface specification (TODO), typically 0xE0 - 0xFF
  *  @param data byte array to be transferred. Must be dynamically allocated, will be freed once tx is complete on non-acknowledged tx, after acknowledge on acknowledged packets
- *  @param length number of of bytes to be transferred. Maximum 255*18 = 4590 bytes.
+ *  @param length number of of bytes to be transferred. Maximum 254 chunks, i.e. 254*17 = 4318 bytes with default MTU.
+ *
+ *  Chunks are sized by MTU when transfer starts, transfers are started again if MTU changes.
+ *  Transfer goes to requester link.
  *
  *  Returns TRANSFER_SUCCESS if message was placed to transfer queue, error code if queuing failed.
  **/
 bulk_transfer_ret_t ble_bulk_transfer_asynchronous(const ruuvi_endpoint_t endpoint, uint8_t* data, const size_t length)
 {
-  if(!nrf_queue_available_get(&m_ble_tx_queue)) { return NRF_ERROR_NO_MEM; }
-  if(BLE_BULK_TX_MAX_SIZE < length) { return TX_ERROR_MAX_SIZE_EXCEEDED; }
-  
-  uint8_t num_chunks = (length/BLE_CHUNK_SIZE);
-  if(length%BLE_CHUNK_SIZE) {num_chunks++;}
-  ble_bulk_tx_header_t header = {.endpoint = endpoint,
-                                 .index = 255,
-                                 .chunks = num_chunks,
-                                 .CRC8 = 0};  //XXX
-  uint8_t* index = calloc (1, sizeof(uint8_t));
-  *index=255; //Header has index of 255, start TX with header
-  ble_bulk_tx_t tx = {.data     = data,
-                      .endpoint = endpoint,
-                      .length   = length,
-                      .chunk_index = index,
-                      .header = header
-                     };
-  NRF_LOG_DEBUG("Preparing to send %d bytes in %d chunks\r\n", length, num_chunks);
-  return nrf_queue_push(&m_ble_tx_queue, &tx);
+  ble_link_t* p_link = requester_link();
+  if(NULL == p_link) { return NRF_ERROR_INVALID_STATE; }
+  if(BLE_BULK_QUEUE_SIZE <= p_link->bulk_count)
+  {
+    m_statistics.bulk_overflows++;
+    return NRF_ERROR_NO_MEM;
+  }
+  ble_bulk_tx_t* tx = &p_link->bulk_queue[(p_link->bulk_head + p_link->bulk_count) % BLE_BULK_QUEUE_SIZE];
+  memset(tx, 0, sizeof(ble_bulk_tx_t));
+  tx->data                 = data;
+  tx->endpoint             = endpoint;
+  tx->length               = length;
+  tx->header.endpoint      = endpoint;
+  tx->header.index         = BLE_BULK_INDEX_HEADER;
+  tx->header.CRC8          = crc8_compute(data, length, CRC8_INITIAL_VALUE);
+  tx->header.flags         = m_bulk_acknowledged ? BLE_BULK_FLAG_ACK : 0;
+  tx->header.window        = MIN(BLE_BULK_WINDOW, BLE_BULK_MAX_WINDOW);
+  tx->header.length        = length;
+  if(!bulk_restart(p_link, tx)) { return TX_ERROR_MAX_SIZE_EXCEEDED; }
+  p_link->bulk_count++;
+  NRF_LOG_DEBUG("Preparing to send %d bytes in %d chunks of %d\r\n", length, tx->header.chunks, tx->chunk_size);
+  return TX_SUCCESS;
+}
+
+/** Remove active transfer of link from queue and free its data **/
+static void bulk_queue_pop(ble_link_t* p_link)
+{
+  ble_bulk_tx_t* tx = &p_link->bulk_queue[p_link->bulk_head];
+  if(BULK_TX_DONE == tx->state) { m_statistics.transfers++; }
+  else { m_statistics.failed++; }
+  ble_bulk_message_clean(tx);
+  p_link->bulk_head = (p_link->bulk_head + 1) % BLE_BULK_QUEUE_SIZE;
+  p_link->bulk_count--;
+  NRF_LOG_DEBUG("Processed tx from queue.\r\n");
+}
+
+static ret_code_t bulk_send_header(ble_link_t* p_link, ble_bulk_tx_t* tx)
+{
+  uint8_t data[BLE_BULK_HEADER_SIZE] = {0};
+  data[0] = tx->header.endpoint;
+  data[1] = tx->header.index;
+  data[2] = tx->header.chunks;
+  data[3] = tx->header.CRC8;
+  data[4] = tx->header.flags;
+  data[5] = tx->header.window;
+  data[6] = tx->header.chunk_size;
+  data[7] = tx->header.length & 0xFF;
+  data[8] = tx->header.length >> 8;
+  return link_transfer_raw(p_link, data, BLE_BULK_HEADER_SIZE);
+}
+
+static ret_code_t bulk_send_chunk(ble_link_t* p_link, ble_bulk_tx_t* tx, uint8_t index)
+{
+  uint8_t data[BLE_RAW_MAX_SIZE];
+  size_t offset = (size_t)index * tx->chunk_size;
+  uint8_t size = MIN(tx->chunk_size, tx->length - offset);
+  data[0] = tx->endpoint;
+  data[1] = index;
+  memcpy(&(data[BLE_CHUNK_HEADER_SIZE]), &(tx->data[offset]), size);
+  uint8_t crc = crc8_compute(data, 2, CRC8_INITIAL_VALUE);
+  data[2] = crc8_compute(&(data[BLE_CHUNK_HEADER_SIZE]), size, crc);
+  return link_transfer_raw(p_link, data, BLE_CHUNK_HEADER_SIZE + size);
+}
+
+/** Send pending chunks of window, then poll or move to next window **/
+static ret_code_t bulk_send_window(ble_link_t* p_link, ble_bulk_tx_t* tx)
+{
+  ret_code_t err_code = NRF_SUCCESS;
+  while(tx->pending && NRF_SUCCESS == err_code)
+  {
+    uint8_t offset = __builtin_ctzll(tx->pending);
+    uint8_t index = tx->base + offset;
+    err_code = bulk_send_chunk(p_link, tx, index);
+    if(NRF_SUCCESS == err_code)
+    {
+      tx->pending &= ~(1ULL << offset);
+      if(index < tx->next) { m_statistics.retransmissions++; }
+      else { tx->next = index + 1; }
+    }
+  }
+  if(NRF_SUCCESS != err_code) { return err_code; }
+
+  if(tx->header.flags & BLE_BULK_FLAG_ACK) { tx->state = BULK_TX_POLL; }
+  else
+  {
+    // Without acknowledgements sent chunks are considered done
+    tx->base = tx->next;
+    tx->pending = window_mask(tx);
+    if(tx->base >= tx->header.chunks) { tx->state = BULK_TX_DONE; }
+  }
+  return err_code;
+}
+
+static ret_code_t bulk_send_poll(ble_link_t* p_link, ble_bulk_tx_t* tx)
+{
+  uint8_t data[BLE_BULK_POLL_SIZE] = {tx->endpoint, BLE_BULK_INDEX_POLL};
+  ret_code_t err_code = link_transfer_raw(p_link, data, BLE_BULK_POLL_SIZE);
+  if(NRF_SUCCESS == err_code)
+  {
+    tx->state = BULK_TX_WAIT;
+    app_timer_cnt_get(&tx->poll_ticks);
+    if(!m_ack_timer_created)
+    {
+      m_ack_timer_created = (NRF_SUCCESS == app_timer_create(&m_ack_timer, APP_TIMER_MODE_SINGLE_SHOT, ack_timeout_handler));
+    }
+    ack_timer_schedule();
+  }
+  return err_code;
+}
+
+/** Run state machine of active transfer until softdevice buffers are full or transfer waits for acknowledgement **/
+static ret_code_t bulk_queue_process(ble_link_t* p_link)
+{
+  ret_code_t err_code = NRF_SUCCESS;
+  while(p_link->bulk_count && NRF_SUCCESS == err_code)
+  {
+    ble_bulk_tx_t* tx = &p_link->bulk_queue[p_link->bulk_head];
+    switch(tx->state)
+    {
+      case BULK_TX_HEADER:
+        err_code = bulk_send_header(p_link, tx);
+        if(NRF_SUCCESS == err_code) { tx->state = BULK_TX_SEND; }
+        break;
+
+      case BULK_TX_SEND:
+        err_code = bulk_send_window(p_link, tx);
+        break;
+
+      case BULK_TX_POLL:
+        err_code = bulk_send_poll(p_link, tx);
+        break;
+
+      case BULK_TX_WAIT:
+        return NRF_SUCCESS;
+
+      case BULK_TX_DONE:
+      case BULK_TX_FAILED:
+      default:
+        bulk_queue_pop(p_link);
+        break;
+    }
+  }
+  return err_code;
+}
+
+/** Push to standard message queue of link, oldest message is dropped if queue is full **/
+static void std_queue_push(ble_link_t* p_link, const ruuvi_standard_message_t* message)
+{
+  if(BLE_STD_QUEUE_SIZE <= p_link->std_count)
+  {
+    m_statistics.std_overflows++;
+    p_link->std_head = (p_link->std_head + 1) % BLE_STD_QUEUE_SIZE;
+    p_link->std_count--;
+  }
+  p_link->std_queue[(p_link->std_head + p_link->std_count) % BLE_STD_QUEUE_SIZE] = *message;
+  p_link->std_count++;
+}
+
+static void std_queue_pop(ble_link_t* p_link)
+{
+  p_link->std_head = (p_link->std_head + 1) % BLE_STD_QUEUE_SIZE;
+  p_link->std_count--;
 }
 
 ret_code_t ble_std_transfer_asynchronous(const ruuvi_standard_message_t message)
 {
   NRF_LOG_DEBUG("STD message added to queue\r\n");
-  return nrf_queue_push(&m_std_tx_queue, &message);
+  ret_code_t err_code = NRF_ERROR_INVALID_STATE;
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++)
+  {
+    if(!link_is_connected(ii) || !m_links[ii].notifications) { continue; }
+    std_queue_push(&m_links[ii], &message);
+    err_code = NRF_SUCCESS;
+  }
+  return err_code;
 }
 
-/** Process BLE message queue. This function should be scheduled in main loop and BLE TX READY event.**/
-// TODO: Split to several functions
-ret_code_t ble_message_queue_process(void)
+ret_code_t ble_std_reply_asynchronous(const ruuvi_standard_message_t message)
+{
+  ble_link_t* p_link = requester_link();
+  if(NULL == p_link) { return NRF_ERROR_INVALID_STATE; }
+  std_queue_push(p_link, &message);
+  return NRF_SUCCESS;
+}
+
+ret_code_t ble_std_link_transfer_asynchronous(const uint8_t link, const ruuvi_standard_message_t message)
+{
+  if(!link_is_connected(link)) { return NRF_ERROR_INVALID_STATE; }
+  std_queue_push(&m_links[link], &message);
+  return NRF_SUCCESS;
+}
+
+/** Send standard messages one per notification **/
+static ret_code_t std_queue_process_single(ble_link_t* p_link)
 {
   ret_code_t err_code = NRF_SUCCESS;
-  //Send messages from std queue first
-  while(!nrf_queue_is_empty(&m_std_tx_queue) &&
-        NRF_SUCCESS == err_code)
-  {
-    ruuvi_standard_message_t txs[1];
-    ruuvi_standard_message_t* tx =&(txs[0]);
-    err_code = nrf_queue_peek (&m_std_tx_queue,
-                               tx);
-    err_code |= ble_transfer_raw((void*) tx, sizeof(ruuvi_standard_message_t));
+  while(p_link->std_count && NRF_SUCCESS == err_code)
+  {
+    ruuvi_standard_message_t* tx = &p_link->std_queue[p_link->std_head];
+    err_code = link_transfer_raw(p_link, (void*) tx, sizeof(ruuvi_standard_message_t));
     //Pop tx if transmission was placed in SD queue
-    if(NRF_SUCCESS == err_code) {nrf_queue_pop (&m_std_tx_queue, tx); }
+    if(NRF_SUCCESS == err_code)
+    {
+      std_queue_pop(p_link);
+      m_statistics.std_messages++;
+    }
     NRF_LOG_DEBUG("Sent STD message\r\n");
   }
+  return err_code;
+}
 
-  //return success if bulk queue is empty and there was no error in std queue
-  if(nrf_queue_is_empty(&m_ble_tx_queue) &&
-     NRF_SUCCESS == err_code)
-  {
-    NRF_LOG_DEBUG("Queue is empty\r\n");
-    return NRF_SUCCESS;
-  }
-  //Allocate memory for the first element of the queue
-  ble_bulk_tx_t txs[1];
-  ble_bulk_tx_t* tx =  &(txs[0]);
-
-  //Process while no errors occur
+/** Send standard messages packed into frames which fill a notification **/
+static ret_code_t std_queue_process_packed(ble_link_t* p_link, size_t capacity)
+{
+  ret_code_t err_code = NRF_SUCCESS;
   while(NRF_SUCCESS == err_code)
   {
-    //Read first element
-    err_code = nrf_queue_peek (&m_ble_tx_queue,
-                               tx);
-
-    //No more elements could be read -> queue is processed -> return success
-    if(NRF_SUCCESS != err_code) { return NRF_SUCCESS; }
-    uint8_t* chunk_index = tx->chunk_index;
-    NRF_LOG_DEBUG("Processing tx, next chunk is %d\r\n", *chunk_index);
-    //Send header
-    if(255==*chunk_index)
+    if(!p_link->frame_length)
     {
-      uint8_t data[BLE_BULK_HEADER_SIZE] = {0};
-      data[0] = tx->header.endpoint;
-      data[1] = tx->header.index;
-      data[2] = tx->header.chunks;
-      data[3] = tx->header.CRC8;            
-      err_code = ble_transfer_raw(data, BLE_BULK_HEADER_SIZE);
-      if(NRF_SUCCESS == err_code) {(*chunk_index)++;} //Roll around to element 0
+      if(!p_link->std_count) { break; }
+      p_link->frame_length = message_frame_begin(p_link->frame);
     }
-  
-    //While this element has unsent data and data was queued successfully
-    while((((*chunk_index)+1) * BLE_CHUNK_SIZE) <= tx->length && 
-          NRF_SUCCESS == err_code)
+    // Top up pending frame, messages are popped as the frame owns them now.
+    while(message_frame_count(p_link->frame) < capacity && p_link->std_count)
     {
-      //Create TX package
-      uint8_t data[BLE_RAW_SIZE] = {0};
-      data[0] = tx->endpoint;
-      data[1] = *chunk_index;
-      memcpy(&(data[2]), &(tx->data[*chunk_index * BLE_CHUNK_SIZE]), BLE_CHUNK_SIZE);
-    
-      //Send TX package
-      err_code = ble_transfer_raw(data, BLE_RAW_SIZE);
-      // Move to next chunk on succeess
-      if(NRF_SUCCESS == err_code) {(*chunk_index)++;}
+      p_link->frame_length = message_frame_append(p_link->frame, p_link->frame_length,
+                                                  &p_link->std_queue[p_link->std_head]);
+      std_queue_pop(p_link);
     }
-    //Send last chunk if data was not divisible by CHUNK_SIZE
-    uint8_t remainder_size = tx->length % BLE_CHUNK_SIZE;
-    if(((*chunk_index) * BLE_CHUNK_SIZE) <= tx->length && 
-       NRF_SUCCESS == err_code && 
-       (remainder_size))
+    err_code = link_transfer_raw(p_link, p_link->frame, p_link->frame_length);
+    if(NRF_SUCCESS == err_code)
     {
-      //Create TX package, header has 2 bytes
-      uint8_t data[2 + remainder_size];
-      data[0] = tx->endpoint;
-      data[1] = *chunk_index;
-      NRF_LOG_DEBUG("Last chunk has %d payload bytes\r\n", remainder_size);
-      memcpy(&(data[2]), &(tx->data[*chunk_index * BLE_CHUNK_SIZE]), remainder_size);
-    
-      //Send TX package
-      err_code = ble_transfer_raw(data, 2+remainder_size);
-      if(NRF_SUCCESS == err_code) {(*chunk_index)++;}
+      m_statistics.std_messages += message_frame_count(p_link->frame);
+      NRF_LOG_DEBUG("Sent %d STD messages in a frame\r\n", message_frame_count(p_link->frame));
+      p_link->frame_length = 0;
     }
-    
-    //This element has been processed, pop tx from queue
-    if(NRF_SUCCESS == err_code &&
-       *chunk_index == tx->header.chunks) 
+  }
+  return err_code;
+}
+
+/** Send queued data of one link until its softdevice buffers are full or queues are done **/
+static ret_code_t link_queue_process(ble_link_t* p_link)
+{
+  ret_code_t err_code = NRF_SUCCESS;
+  //Send messages from std queue first. Pending frame is sent even if packing was turned off.
+  size_t capacity = message_frame_capacity(p_link->att_mtu - BLE_ATT_HEADER_SIZE);
+  if(p_link->frame_length || (m_std_packing && capacity > 1)) { err_code = std_queue_process_packed(p_link, capacity); }
+  else { err_code = std_queue_process_single(p_link); }
+
+  //Stream is real-time data, it goes before bulk data
+  if(NRF_SUCCESS == err_code && p_stream_ready_handler && p_link == stream_link())
+  {
+    err_code = p_stream_ready_handler();
+  }
+
+  //Send bulk data if std queue and stream are done
+  if(NRF_SUCCESS == err_code) { err_code = bulk_queue_process(p_link); }
+  return err_code;
+}
+
+/** Process BLE message queues. This function should be scheduled in main loop and BLE TX READY event.**/
+ret_code_t ble_message_queue_process(void)
+{
+  ret_code_t err_code = NRF_SUCCESS;
+  bool busy = false;
+  uint32_t start = 0;
+  app_timer_cnt_get(&start);
+
+  // Links take turns in going first, a link which always has data cannot delay the others
+  uint8_t first = m_link_next;
+  m_link_next = (m_link_next + 1) % BLE_LINK_COUNT;
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++)
+  {
+    uint8_t link = (first + ii) % BLE_LINK_COUNT;
+    if(!link_is_connected(link)) { continue; }
+    ret_code_t link_status = link_queue_process(&m_links[link]);
+    // Full softdevice buffers are expected while sending, other errors mean that link cannot be used now.
+    if(BLE_ERROR_NO_TX_PACKETS == link_status) { busy = true; }
+    else if(NRF_SUCCESS != link_status)
     {
-      //Clear TX out of memory and queue
-      nrf_queue_pop (&m_ble_tx_queue, tx);
-      ble_bulk_message_clean(tx);      
-      NRF_LOG_DEBUG("Processed tx from queue.\r\n");
-      break;
+      NRF_LOG_DEBUG("BLE transfer status of link %d: %d\r\n", link, link_status);
+      err_code = link_status;
     }
   }
-  if(NRF_SUCCESS != err_code){ NRF_LOG_DEBUG("BLE transfer status: %d\r\n", err_code); }
+  if(busy) { err_code = BLE_ERROR_NO_TX_PACKETS; }
+  else
+  {
+    NRF_LOG_DEBUG("Queues are empty\r\n");
+    transfer_stopped();
+  }
+
+  uint32_t ticks = ticks_since(start);
+  ble_diagnostics_on_queue_process(ticks);
   return err_code;
 }
 
-/**
- *  Asynchronous transfer of raw binary data, max 20 bytes per chunk.
- *  This function is meant for driver's own use only. 
- */
 ret_code_t ble_transfer_raw(uint8_t* data, size_t length)
 {
-  NRF_LOG_DEBUG("Transferring %d bytes\r\n", length);
-  uint8_t data_array[BLE_RAW_SIZE] = {0};
-  uint32_t       err_code;
-  memcpy(&data_array, data, length);  
-  err_code = ble_nus_string_send(p_nus, data_array, length);
+  ble_link_t* p_link = requester_link();
+  if(NULL == p_link) { return NRF_ERROR_INVALID_STATE; }
+  return link_transfer_raw(p_link, data, length);
+}
+
+ret_code_t ble_stream_transfer(const uint8_t endpoint, const uint16_t sequence, const uint8_t* samples,
+                               const uint8_t sample_size, const size_t count, size_t* sent)
+{
+  if(NULL == samples || NULL == sent) { return NRF_ERROR_NULL; }
+  *sent = 0;
+  ble_link_t* p_link = stream_link();
+  if(NULL == p_link) { return NRF_ERROR_INVALID_STATE; }
+  m_stream_link     = p_link - m_links;
+  m_stream_endpoint = endpoint;
+  m_stream_started  = true;
+  size_t capacity = sample_stream_capacity(p_link->att_mtu - BLE_ATT_HEADER_SIZE, sample_size);
+  if(!capacity) { return NRF_ERROR_INVALID_LENGTH; }
+  ret_code_t err_code = NRF_SUCCESS;
+  uint8_t block[BLE_RAW_MAX_SIZE];
+  while(*sent < count && NRF_SUCCESS == err_code)
+  {
+    uint8_t block_count = MIN(capacity, count - *sent);
+    size_t length = sample_stream_pack(block, endpoint, sequence + *sent, &samples[*sent * sample_size],
+                                       sample_size, block_count);
+    err_code = link_transfer_raw(p_link, block, length);
+    if(NRF_SUCCESS == err_code)
+    {
+      *sent += block_count;
+      m_statistics.stream_samples += block_count;
+    }
+  }
   return err_code;
 }
 
+void ble_stream_set_ready_handler(ble_stream_ready_handler_t handler)
+{
+  p_stream_ready_handler = handler;
+}
+
+/** Free bulk transfers of link **/
+static void bulk_queue_purge(ble_link_t* p_link)
+{
+  while(p_link->bulk_count)
+  {
+    ble_bulk_message_clean(&p_link->bulk_queue[p_link->bulk_head]);
+    p_link->bulk_head = (p_link->bulk_head + 1) % BLE_BULK_QUEUE_SIZE;
+    p_link->bulk_count--;
+  }
+}
+
+/** Drop queued messages and transfers of link **/
+static void link_purge(ble_link_t* p_link)
+{
+  bulk_queue_purge(p_link);
+  p_link->std_head     = 0;
+  p_link->std_count    = 0;
+  p_link->frame_length = 0;
+}
+
+uint8_t ble_link_connect(uint16_t conn_handle)
+{
+  links_init();
+  uint8_t link = ble_link_find(conn_handle);
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT && BLE_LINK_INVALID == link; ii++)
+  {
+    if(BLE_CONN_HANDLE_INVALID == m_links[ii].conn_handle) { link = ii; }
+  }
+  if(BLE_LINK_INVALID == link)
+  {
+    NRF_LOG_ERROR("No free link for connection %d\r\n", conn_handle);
+    return BLE_LINK_INVALID;
+  }
+  ble_link_t* p_link = &m_links[link];
+  link_purge(p_link);
+  p_link->conn_handle   = conn_handle;
+  p_link->notifications = false;
+  p_link->att_mtu       = GATT_MTU_SIZE_DEFAULT;
+  memset(&p_link->statistics, 0, sizeof(p_link->statistics));
+  app_timer_cnt_get(&p_link->connected_ticks);
+  NRF_LOG_INFO("Link %d connected, %d links\r\n", link, ble_link_count());
+  return link;
+}
+
+void ble_link_disconnect(uint16_t conn_handle)
+{
+  uint8_t link = ble_link_find(conn_handle);
+  if(BLE_LINK_INVALID == link) { return; }
+  ble_link_t* p_link = &m_links[link];
+  link_purge(p_link);
+  p_link->conn_handle   = BLE_CONN_HANDLE_INVALID;
+  p_link->notifications = false;
+  p_link->att_mtu       = GATT_MTU_SIZE_DEFAULT;
+  // Index is reused by next central
+  if(m_writer == link)      { m_writer = BLE_LINK_INVALID; }
+  if(m_requester == link)   { m_requester = BLE_LINK_INVALID; }
+  if(m_stream_link == link) { m_stream_link = BLE_LINK_INVALID; }
+  ack_timer_schedule();
+  NRF_LOG_INFO("Link %d disconnected, %d links\r\n", link, ble_link_count());
+}
+
+uint8_t ble_link_find(uint16_t conn_handle)
+{
+  if(BLE_CONN_HANDLE_INVALID == conn_handle) { return BLE_LINK_INVALID; }
+  links_init();
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++)
+  {
+    if(conn_handle == m_links[ii].conn_handle) { return ii; }
+  }
+  return BLE_LINK_INVALID;
+}
+
+uint8_t ble_link_count(void)
+{
+  uint8_t count = 0;
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++)
+  {
+    if(link_is_connected(ii)) { count++; }
+  }
+  return count;
+}
+
+void ble_link_on_write(uint16_t conn_handle, uint16_t handle, const uint8_t* data, uint16_t length)
+{
+  uint8_t link = ble_link_find(conn_handle);
+  m_writer = link;
+  if(BLE_LINK_INVALID == link || NULL == p_nus || NULL == data) { return; }
+  if(handle == p_nus->rx_handles.cccd_handle && 2 == length)
+  {
+    m_links[link].notifications = data[0] & BLE_GATT_HVX_NOTIFICATION;
+    NRF_LOG_DEBUG("Link %d notifications %d\r\n", link, m_links[link].notifications);
+  }
+}
+
+uint8_t ble_link_get_writer(void)
+{
+  return m_writer;
+}
+
+uint8_t ble_link_get_requester(void)
+{
+  ble_link_t* p_link = requester_link();
+  return p_link ? (uint8_t)(p_link - m_links) : BLE_LINK_INVALID;
+}
+
+void ble_link_set_requester(uint8_t link)
+{
+  if(link_is_connected(link)) { m_requester = link; }
+}
+
+ret_code_t ble_link_message_schedule(const ruuvi_standard_message_t message)
+{
+  ble_link_message_t event = { .message = message, .link = m_writer };
+  //Schedule handling of the message - do not process in interrupt context
+  return app_sched_event_put(&event, sizeof(event), ble_link_scheduler_event_handler);
+}
+
+void ble_link_scheduler_event_handler(void *p_event_data, uint16_t event_size)
+{
+  ble_link_message_t event;
+  memcpy(&event, p_event_data, sizeof(event));
+  ble_link_set_requester(event.link);
+  // Configuration of stream source moves the stream to the configuring central, queries do not
+  if(m_stream_started && m_stream_endpoint == event.message.destination_endpoint &&
+     SENSOR_CONFIGURATION == event.message.type && link_is_connected(event.link))
+  {
+    m_stream_link = event.link;
+  }
+  route_message(event.message);
+}
+
+void ble_link_statistics_get(uint8_t link, ble_link_statistics_t* statistics)
+{
+  if(NULL == statistics || BLE_LINK_COUNT <= link) { return; }
+  ble_link_t* p_link = &m_links[link];
+  if(link_is_connected(link))
+  {
+    p_link->statistics.connected_ms = (uint32_t)(((uint64_t)ticks_since(p_link->connected_ticks) * 1000 *
+                                                  (RUUVITAG_APP_TIMER_PRESCALER + 1)) / APP_TIMER_CLOCK_FREQ);
+  }
+  memcpy(statistics, &p_link->statistics, sizeof(p_link->statistics));
+}
+
+void ble_bulk_set_att_mtu(uint16_t conn_handle, uint16_t att_mtu)
+{
+  uint8_t link = ble_link_find(conn_handle);
+  if(BLE_LINK_INVALID == link) { return; }
+  ble_link_t* p_link = &m_links[link];
+  if(att_mtu < GATT_MTU_SIZE_DEFAULT) { att_mtu = GATT_MTU_SIZE_DEFAULT; }
+  if(att_mtu > NRF_BLE_MAX_MTU_SIZE)  { att_mtu = NRF_BLE_MAX_MTU_SIZE; }
+  p_link->att_mtu = att_mtu;
+  // Pending frame does not fit into smaller MTU, messages in it are lost
+  if(p_link->frame_length > (size_t)(p_link->att_mtu - BLE_ATT_HEADER_SIZE))
+  {
+    NRF_LOG_WARNING("Dropped frame of %d STD messages\r\n", message_frame_count(p_link->frame));
+    p_link->frame_length = 0;
+  }
+  // Peer has changed, start queued transfers again with chunks of new size
+  for(uint8_t ii = 0; ii < p_link->bulk_count; ii++)
+  {
+    ble_bulk_tx_t* tx = &p_link->bulk_queue[(p_link->bulk_head + ii) % BLE_BULK_QUEUE_SIZE];
+    if(BULK_TX_DONE != tx->state && !bulk_restart(p_link, tx)) { tx->state = BULK_TX_FAILED; }
+  }
+  ack_timer_schedule();
+  NRF_LOG_INFO("Link %d ATT MTU %d, chunk size %d\r\n", link, p_link->att_mtu, chunk_size(p_link));
+}
+
+uint16_t ble_bulk_get_att_mtu(uint16_t conn_handle)
+{
+  uint8_t link = ble_link_find(conn_handle);
+  return (BLE_LINK_INVALID == link) ? GATT_MTU_SIZE_DEFAULT : m_links[link].att_mtu;
+}
+
+void ble_std_set_packing(bool packing)
+{
+  m_std_packing = packing;
+}
+
+bool ble_std_get_packing(void)
+{
+  return m_std_packing;
+}
+
+void ble_transfer_statistics_get(ble_transfer_statistics_t* statistics)
+{
+  if(NULL == statistics) { return; }
+  memcpy(statistics, &m_statistics, sizeof(m_statistics));
+}
+
+void ble_transfer_statistics_reset(void)
+{
+  memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+/** Acknowledgement comes from the link which receives the transfer, it is the requester while message is routed **/
+ret_code_t ble_bulk_ack_handler(const ruuvi_standard_message_t message)
+{
+  ble_link_t* p_link = requester_link();
+  if(NULL == p_link || !p_link->bulk_count) { return ENDPOINT_INVALID; }
+  ble_bulk_tx_t* tx = &p_link->bulk_queue[p_link->bulk_head];
+  if(message.payload[0] != tx->endpoint ||
+     BULK_TX_HEADER == tx->state    ||
+     BULK_TX_DONE   <= tx->state) { return ENDPOINT_INVALID; }
+
+  if(ERROR == message.type)
+  {
+    NRF_LOG_WARNING("Bulk transfer to %x failed CRC, sending again\r\n", tx->endpoint);
+    if(++tx->retries > BLE_BULK_MAX_RETRIES || !bulk_restart(p_link, tx)) { tx->state = BULK_TX_FAILED; }
+    ack_timer_schedule();
+    return ENDPOINT_SUCCESS;
+  }
+  if(ACKNOWLEDGEMENT != message.type) { return ENDPOINT_UNKNOWN; }
+
+  uint8_t base = message.payload[1];
+  if(base < tx->base || base > tx->next) { return ENDPOINT_INVALID; } // Stale or bogus acknowledgement
+  if(base > tx->base) { tx->retries = 0; } // Progress
+  if(base >= tx->header.chunks)
+  {
+    tx->state = BULK_TX_DONE;
+    ack_timer_schedule();
+    return ENDPOINT_SUCCESS;
+  }
+  uint64_t received = 0;
+  for(uint8_t ii = 0; ii < BLE_BULK_ACK_BITMAP_SIZE; ii++)
+  {
+    received |= (uint64_t)message.payload[2 + ii] << (8 * ii);
+  }
+  tx->base    = base;
+  tx->pending = window_mask(tx) & ~received;
+  tx->state   = BULK_TX_SEND;
+  ack_timer_schedule();
+  NRF_LOG_DEBUG("Bulk ACK base %d\r\n", base);
+  return ENDPOINT_SUCCESS;
+}
+
+void ble_bulk_set_acknowledged(bool acknowledged)
+{
+  m_bulk_acknowledged = acknowledged;
+}
+
 /** Set pointer to NUS service **/
 void ble_bulk_set_nus(ble_nus_t* nus)
 {
  p_nus = nus;
 }
 
-/** Free whole message queue **/
+/** Free bulk transfer queues of all links **/
 ret_code_t ble_bulk_message_queue_purge()
 {
-  ble_bulk_tx_t txs[1] = {};
-  ble_bulk_tx_t* tx =  &(txs[0]);
-  while(!nrf_queue_is_empty(&m_ble_tx_queue))
-  {
-      nrf_queue_pop (&m_ble_tx_queue, tx);
-      ble_bulk_message_clean(tx);
-  }
+  links_init();
+  for(uint8_t ii = 0; ii < BLE_LINK_COUNT; ii++) { bulk_queue_purge(&m_links[ii]); }
+  ack_timer_schedule();
   return NRF_SUCCESS;
 }
 
@@ -202,7 +874,6 @@ ret_code_t ble_bulk_message_clean(ble_bulk_tx_t* element)
   }
   //Free TX data
   free(element->data);
-  free(element->chunk_index);
+  element->data = NULL;
   return NRF_SUCCESS;
 }
-
@@ -1,5 +1,6 @@
 #ifndef BLE_BULK_TRANSFER_H
 #define BLE_BULK_TRANSFER_H
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -7,32 +8,113 @@
 #include "ble_nus.h"
 
 #include "ruuvi_endpoints.h"
+#include "bluetooth_config.h"
+#include "app_timer.h"
+#include "init.h"
+
+/**
+ *  Bulk transfer protocol. All notifications start with the destination endpoint of the transfer.
+ *
+ *  Header:  0 endpoint, 1 BLE_BULK_INDEX_HEADER, 2 number of chunks, 3 CRC8 of whole payload,
+ *           4 flags, 5 window, i.e. chunks sent between acknowledgements, 6 payload bytes per chunk,
+ *           7-8 payload length, little endian
+ *  Chunk:   0 endpoint, 1 chunk index, 2 CRC8 of bytes 0, 1 and payload, 3... payload
+ *  Poll:    0 endpoint, 1 BLE_BULK_INDEX_POLL. Sent after each window if BLE_BULK_FLAG_ACK is set.
+ *
+ *  Receiver answers a poll with a standard message to BULK_TRANSFER endpoint:
+ *  type ACKNOWLEDGEMENT, payload 0 endpoint, 1 base, i.e. all chunks below base were received,
+ *  2...7 bitmap of received chunks base ... base + 47, LSB of byte 2 is chunk base.
+ *  Sender retransmits only the missing chunks of the window and moves the window to base.
+ *  Type ERROR with payload 0 endpoint means that whole transfer failed CRC check and is sent again.
+ *  CRC8 is crc8_compute() from libraries/crc8.
+ *
+ *  Same protocol is used for writes from central to tag, see ble_bulk_receive.h.
+ *
+ *  Links: up to BLE_LINK_COUNT centrals may be connected at the same time. Every link has its own
+ *  ATT MTU, standard message queue, pending frame, bulk transfer queue and throughput counters,
+ *  so a slow or stalled central does not hold back the others.
+ *  ble_message_queue_process serves the links in turns, starting from a different link on every call.
+ *
+ *  Standard messages written by a central are routed with the link they came from. The link which
+ *  sent the latest message is the requester: replies and bulk transfers go to it.
+ *  If requester has disconnected, first connected link takes its place.
+ *  Sample stream goes to the link which last sent SENSOR_CONFIGURATION to the source endpoint of the stream,
+ *  i.e. the central which configured the accelerometer, so queries of other centrals do not move it.
+ *  ble_std_transfer_asynchronous, i.e. GATT transmission target, sends to every link
+ *  which has enabled notifications.
+ */
 
 // TODO: Move to a separate config file?
 #define BLE_BULK_QUEUE_SIZE 10
-#define BLE_CHUNK_SIZE 18
-#define BLE_BULK_TX_MAX_SIZE (255*BLE_CHUNK_SIZE)
-#define BLE_RAW_SIZE BLE_NUS_MAX_DATA_LEN
-#define BLE_BULK_HEADER_SIZE 4
+#define BLE_ATT_HEADER_SIZE 3                                         // Notification opcode and handle
+#define BLE_CHUNK_HEADER_SIZE 3                                       // Endpoint, chunk index and CRC8
+#define BLE_RAW_MAX_SIZE (NRF_BLE_MAX_MTU_SIZE - BLE_ATT_HEADER_SIZE) // Largest notification with largest allowed MTU
+#define BLE_CHUNK_MAX_SIZE (BLE_RAW_MAX_SIZE - BLE_CHUNK_HEADER_SIZE)
+#define BLE_BULK_MAX_CHUNKS 254                                       // Chunk indices 0xFE and 0xFF are reserved
+#define BLE_BULK_TX_MAX_SIZE (BLE_BULK_MAX_CHUNKS*BLE_CHUNK_MAX_SIZE) // Actual maximum depends on negotiated MTU
+#define BLE_BULK_HEADER_SIZE 9
+#define BLE_BULK_POLL_SIZE 2
+#define BLE_BULK_INDEX_HEADER 0xFF
+#define BLE_BULK_INDEX_POLL   0xFE
+#define BLE_BULK_FLAG_ACK     0x01                                    // Receiver acknowledges every window
+#define BLE_BULK_ACK_BITMAP_SIZE 6                                    // Bytes of bitmap in acknowledgement
+#define BLE_BULK_MAX_WINDOW (8*BLE_BULK_ACK_BITMAP_SIZE)
+
+#ifndef BLE_BULK_WINDOW
+  #define BLE_BULK_WINDOW BLE_BULK_MAX_WINDOW
+#endif
+
+#ifndef BLE_BULK_ACK_TIMEOUT
+  #define BLE_BULK_ACK_TIMEOUT APP_TIMER_TICKS(1000, RUUVITAG_APP_TIMER_PRESCALER) // Poll again if there is no acknowledgement
+#endif
+
+#ifndef BLE_BULK_MAX_RETRIES
+  #define BLE_BULK_MAX_RETRIES 5                                      // Polls and restarts before transfer is dropped
+#endif
 
 //Large enough queue for 32 FiFo samples by default
 #ifndef BLE_STD_QUEUE_SIZE
    #define BLE_STD_QUEUE_SIZE 40
 #endif
 
+#ifndef BLE_LINK_COUNT
+  #define BLE_LINK_COUNT PERIPHERAL_LINK_COUNT                        // Simultaneous peripheral links
+#endif
+#define BLE_LINK_INVALID 0xFF
+
 typedef struct{
-  const ruuvi_endpoint_t endpoint;
-  const uint8_t index;
-  const uint8_t chunks;
-  const uint8_t CRC8; 
+  ruuvi_endpoint_t endpoint;
+  uint8_t index;
+  uint8_t chunks;
+  uint8_t CRC8;
+  uint8_t flags;
+  uint8_t window;
+  uint8_t chunk_size;
+  uint16_t length;
 }ble_bulk_tx_header_t;
 
+/** State of a transfer in queue **/
+typedef enum{
+  BULK_TX_HEADER,   // Header is next
+  BULK_TX_SEND,     // Sending chunks of pending bitmap
+  BULK_TX_POLL,     // Window is sent, poll is next
+  BULK_TX_WAIT,     // Waiting for acknowledgement
+  BULK_TX_DONE,     // All chunks acknowledged or sent
+  BULK_TX_FAILED    // Retries exhausted
+}ble_bulk_tx_state_t;
+
 typedef struct{
   ble_bulk_tx_header_t header;
   uint8_t* data;
-  const ruuvi_endpoint_t endpoint;
-  const size_t length;
-  uint8_t* chunk_index;
+  ruuvi_endpoint_t endpoint;
+  size_t length;
+  uint8_t chunk_size;          // Payload bytes per chunk, fixed when header is sent
+  ble_bulk_tx_state_t state;
+  uint8_t base;                // First chunk of window, all chunks below are acknowledged or sent
+  uint8_t next;                // First chunk which has never been sent
+  uint64_t pending;            // Chunks of window to send, bit 0 is chunk base
+  uint8_t retries;
+  uint32_t poll_ticks;         // Time of last poll, acknowledgement is due BLE_BULK_ACK_TIMEOUT later
 }ble_bulk_tx_t;
 
 typedef enum{
@@ -40,18 +122,178 @@ typedef enum{
   TX_ERROR_MAX_SIZE_EXCEEDED = 1
 }bulk_transfer_ret_t;
 
+/** Throughput counters, accumulated since boot or last reset **/
+typedef struct{
+  uint32_t bytes;          // Bytes placed to softdevice, including chunk headers
+  uint32_t notifications;  // Notifications placed to softdevice
+  uint32_t std_messages;   // Standard messages placed to softdevice, packed or not
+  uint32_t busy;           // Notifications refused because softdevice buffers were full
+  uint32_t transfers;      // Completed bulk transfers
+  uint32_t retransmissions;// Chunks sent again after acknowledgement or restart
+  uint32_t failed;         // Bulk transfers dropped after BLE_BULK_MAX_RETRIES
+  uint32_t stream_samples; // Samples placed to softdevice in sample stream blocks
+  uint32_t active_ms;      // Time spent sending, from first notification until queues are empty
+  uint32_t std_overflows;  // Standard messages overwritten because queue was full
+  uint32_t bulk_overflows; // Bulk transfers refused because queue was full
+}ble_transfer_statistics_t;
+
+/** Throughput counters of a link, reset when central connects **/
+typedef struct{
+  uint32_t bytes;          // Bytes placed to softdevice
+  uint32_t notifications;  // Notifications placed to softdevice
+  uint32_t busy;           // Notifications refused because softdevice buffers were full
+  uint32_t connected_ms;   // Time since central connected, updated on ble_link_statistics_get
+}ble_link_statistics_t;
+
+/** Standard message written by a central, scheduled with the link it came from **/
+typedef struct __attribute__((packed)){
+  ruuvi_standard_message_t message;
+  uint8_t link;
+}ble_link_message_t;
+
+/**
+ *  Queue bulk transfer to requester link.
+ *  @return TX_SUCCESS, NRF_ERROR_NO_MEM if queue is full, NRF_ERROR_INVALID_STATE if no central is connected.
+ *          Caller keeps data if transfer was not queued.
+ */
 bulk_transfer_ret_t ble_bulk_transfer_asynchronous(const ruuvi_endpoint_t endpoint, uint8_t* data, const size_t length);
 
+/**
+ *  Queue standard message to every link which has enabled notifications. Full queue drops its oldest message.
+ *  @return NRF_SUCCESS, NRF_ERROR_INVALID_STATE if no link has enabled notifications.
+ */
 ret_code_t ble_std_transfer_asynchronous(const ruuvi_standard_message_t message);
 
+/** Queue standard message to requester link. Register with set_reply_handler. **/
+ret_code_t ble_std_reply_asynchronous(const ruuvi_standard_message_t message);
+
+/** Queue standard message to given link **/
+ret_code_t ble_std_link_transfer_asynchronous(const uint8_t link, const ruuvi_standard_message_t message);
+
+/**
+ *  Send queued data of all links until softdevice buffers are full or queues are empty.
+ *  Call from main loop and after BLE TX complete.
+ *
+ *  @return NRF_SUCCESS if all queues are done, BLE_ERROR_NO_TX_PACKETS if a link waits for
+ *          softdevice buffers, otherwise error of a link which could not be used.
+ */
 ret_code_t ble_message_queue_process(void);
 
+/** Send raw data to requester link, max ATT MTU - 3 bytes. Driver's own use only. **/
 ret_code_t ble_transfer_raw(uint8_t* data, size_t length);
 
+/**
+ *  Select framing of standard messages. Packed notifications carry as many messages as fit
+ *  into ATT MTU, see ruuvi_message_frame.h. Messages are sent one per notification if packing
+ *  is off or if MTU has room for only one message. Default is APPLICATION_BLE_STD_PACKING.
+ */
+void ble_std_set_packing(bool packing);
+
+/** Return true if standard messages are packed **/
+bool ble_std_get_packing(void);
+
 ret_code_t ble_bulk_message_queue_purge(void);
 
 ret_code_t ble_bulk_message_clean(ble_bulk_tx_t* element);
 
 void ble_bulk_set_nus(ble_nus_t* nus);
 
+/**
+ *  Handle acknowledgement or error from receiver of bulk transfer, i.e. messages to
+ *  BULK_TRANSFER endpoint. Register with set_bulk_transfer_handler.
+ */
+ret_code_t ble_bulk_ack_handler(const ruuvi_standard_message_t message);
+
+/**
+ *  Select acknowledged bulk transfers for transfers queued after this call.
+ *  Default is APPLICATION_BLE_BULK_ACK.
+ */
+void ble_bulk_set_acknowledged(bool acknowledged);
+
+/**
+ *  Set ATT MTU agreed with the peer of connection. Queued transfers of link are started again from
+ *  header with chunks sized to fill one notification, as MTU changes only when peer changes.
+ *  Values are clamped to GATT_MTU_SIZE_DEFAULT ... NRF_BLE_MAX_MTU_SIZE.
+ */
+void ble_bulk_set_att_mtu(uint16_t conn_handle, uint16_t att_mtu);
+
+/** Return ATT MTU of connection, GATT_MTU_SIZE_DEFAULT if connection has no link **/
+uint16_t ble_bulk_get_att_mtu(uint16_t conn_handle);
+
+/**
+ *  Take a free link into use for new connection, call on BLE_GAP_EVT_CONNECTED.
+ *  @return index of link, BLE_LINK_INVALID if all links are in use.
+ */
+uint8_t ble_link_connect(uint16_t conn_handle);
+
+/** Free link of closed connection, its queued messages and transfers are dropped. Call on BLE_GAP_EVT_DISCONNECTED. **/
+void ble_link_disconnect(uint16_t conn_handle);
+
+/** Return index of link of connection, BLE_LINK_INVALID if connection has no link **/
+uint8_t ble_link_find(uint16_t conn_handle);
+
+/** Return number of connected links **/
+uint8_t ble_link_count(void);
+
+/**
+ *  Handle GATT write of a central, call on BLE_GATTS_EVT_WRITE before NUS handles the event.
+ *  Records the link as writer of data which NUS passes to its data handler next, and notification
+ *  state of link from writes to NUS RX CCCD.
+ */
+void ble_link_on_write(uint16_t conn_handle, uint16_t handle, const uint8_t* data, uint16_t length);
+
+/** Return link which wrote the data being handled in BLE event context **/
+uint8_t ble_link_get_writer(void);
+
+/** Return link which receives replies, see above. BLE_LINK_INVALID if no central is connected. **/
+uint8_t ble_link_get_requester(void);
+
+/** Set link which receives replies, i.e. before routing a bulk write of the link **/
+void ble_link_set_requester(uint8_t link);
+
+/**
+ *  Schedule standard message written by writer link to router. Call from NUS data handler.
+ *  Replies to the message go back to the link.
+ */
+ret_code_t ble_link_message_schedule(const ruuvi_standard_message_t message);
+
+/** Scheduler handler of ble_link_message_schedule: sets requester and routes message **/
+void ble_link_scheduler_event_handler(void *p_event_data, uint16_t event_size);
+
+/** Copy throughput counters of link **/
+void ble_link_statistics_get(uint8_t link, ble_link_statistics_t* statistics);
+
+/**
+ *  Called when softdevice has room for stream data again. Returns NRF_SUCCESS when stream
+ *  source has nothing more to send, BLE_ERROR_NO_TX_PACKETS if softdevice buffers filled up.
+ */
+typedef ret_code_t(*ble_stream_ready_handler_t)(void);
+
+/**
+ *  Send samples packed into sample stream blocks, see ruuvi_sample_stream.h, to stream link until all
+ *  samples are sent or softdevice buffers are full. Register with set_ble_stream_handler.
+ *  Each block carries as many samples as fit into ATT MTU.
+ *
+ *  @param endpoint source of samples
+ *  @param sequence sequence number of first sample
+ *  @param samples  count samples of sample_size bytes
+ *  @param sent     number of samples placed to softdevice, caller keeps the rest
+ *  @return NRF_SUCCESS if all samples were sent, BLE_ERROR_NO_TX_PACKETS if softdevice buffers are full,
+ *          other error if link cannot be used.
+ */
+ret_code_t ble_stream_transfer(const uint8_t endpoint, const uint16_t sequence, const uint8_t* samples,
+                               const uint8_t sample_size, const size_t count, size_t* sent);
+
+/**
+ *  Set handler which ble_message_queue_process calls after standard messages of stream link are sent.
+ *  Stream source refills softdevice buffers from it, i.e. with samples it kept after backpressure.
+ */
+void ble_stream_set_ready_handler(ble_stream_ready_handler_t handler);
+
+/** Copy throughput counters to statistics **/
+void ble_transfer_statistics_get(ble_transfer_statistics_t* statistics);
+
+/** Reset throughput counters **/
+void ble_transfer_statistics_reset(void);
+
 #endif
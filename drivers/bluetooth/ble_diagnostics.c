@@ -0,0 +1,135 @@
+#include "ble_diagnostics.h"
+
+#include <string.h>
+
+#include "ble_bulk_transfer.h"
+
+#define NRF_LOG_MODULE_NAME "BLE_DIAGNOSTICS"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#define BLE_DIAGNOSTICS_INTERVAL_UNIT 6 // 7.5 ms in 1.25 ms units, shortest connection interval
+
+static ble_diagnostics_t m_diagnostics = {0};
+
+/** Index of highest set bit plus one, clamped to last bucket **/
+static uint8_t histogram_bucket(uint32_t value)
+{
+  uint8_t bucket = 0;
+  while(value && bucket < BLE_DIAGNOSTICS_BUCKETS - 1)
+  {
+    value >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void conn_params_record(uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+  m_diagnostics.interval = interval;
+  m_diagnostics.latency  = latency;
+  m_diagnostics.timeout  = timeout;
+  uint16_t interval_units = interval ? (interval - 1) / BLE_DIAGNOSTICS_INTERVAL_UNIT : 0;
+  m_diagnostics.interval_histogram[histogram_bucket(interval_units)]++;
+  m_diagnostics.latency_histogram[histogram_bucket(latency)]++;
+}
+
+void ble_diagnostics_on_connected(uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+  m_diagnostics.connections++;
+  conn_params_record(interval, latency, timeout);
+}
+
+void ble_diagnostics_on_conn_params(uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+  conn_params_record(interval, latency, timeout);
+}
+
+void ble_diagnostics_on_disconnected(uint8_t reason)
+{
+  m_diagnostics.disconnections++;
+  m_diagnostics.disconnect_reason = reason;
+  m_diagnostics.interval = 0;
+  m_diagnostics.latency  = 0;
+  m_diagnostics.timeout  = 0;
+}
+
+void ble_diagnostics_on_tx_complete(uint8_t count)
+{
+  m_diagnostics.tx_complete_events++;
+  m_diagnostics.tx_completed += count;
+}
+
+void ble_diagnostics_on_queue_process(uint32_t ticks)
+{
+  m_diagnostics.process_calls++;
+  if(ticks > m_diagnostics.process_max) { m_diagnostics.process_max = ticks; }
+  m_diagnostics.process_histogram[histogram_bucket(ticks)]++;
+}
+
+void ble_diagnostics_get(ble_diagnostics_t* diagnostics)
+{
+  if(NULL == diagnostics) { return; }
+  memcpy(diagnostics, &m_diagnostics, sizeof(m_diagnostics));
+}
+
+/** Send two halves of a histogram as UINT16 messages **/
+static ret_code_t reply_histogram(message_handler p_reply_handler, ruuvi_standard_message_t* reply, const uint16_t* histogram)
+{
+  ret_code_t err_code = ENDPOINT_SUCCESS;
+  reply->type = UINT16;
+  for(uint8_t ii = 0; ii < BLE_DIAGNOSTICS_BUCKETS; ii += 4)
+  {
+    memcpy(reply->payload, &histogram[ii], sizeof(reply->payload));
+    err_code |= p_reply_handler(*reply);
+  }
+  return err_code;
+}
+
+static ret_code_t query_diagnostics(const ruuvi_standard_message_t message)
+{
+  message_handler p_reply_handler = get_reply_handler();
+  if(!p_reply_handler) { return ENDPOINT_HANDLER_ERROR; }
+  ble_diagnostics_t diagnostics;
+  ble_transfer_statistics_t transfer;
+  ble_diagnostics_get(&diagnostics);
+  ble_transfer_statistics_get(&transfer);
+  ruuvi_standard_message_t reply = { .destination_endpoint = message.source_endpoint,
+                                     .source_endpoint      = message.destination_endpoint,
+                                     .type                 = UINT32,
+                                     .payload              = { 0 }};
+  ret_code_t err_code = reply_uint32(p_reply_handler, &reply, diagnostics.connections, diagnostics.disconnections);
+
+  uint16_t parameters[4] = { diagnostics.interval, diagnostics.latency, diagnostics.timeout, diagnostics.disconnect_reason };
+  reply.type = UINT16;
+  memcpy(reply.payload, parameters, sizeof(reply.payload));
+  err_code |= p_reply_handler(reply);
+
+  err_code |= reply_uint32(p_reply_handler, &reply, diagnostics.tx_complete_events, diagnostics.tx_completed);
+  err_code |= reply_uint32(p_reply_handler, &reply, transfer.notifications, transfer.busy);
+  err_code |= reply_uint32(p_reply_handler, &reply, transfer.std_overflows, transfer.bulk_overflows);
+  err_code |= reply_uint32(p_reply_handler, &reply, diagnostics.process_calls, diagnostics.process_max);
+  err_code |= reply_histogram(p_reply_handler, &reply, diagnostics.interval_histogram);
+  err_code |= reply_histogram(p_reply_handler, &reply, diagnostics.latency_histogram);
+  err_code |= reply_histogram(p_reply_handler, &reply, diagnostics.process_histogram);
+  for(uint8_t link = 0; link < BLE_LINK_COUNT; link++)
+  {
+    ble_link_statistics_t statistics;
+    ble_link_statistics_get(link, &statistics);
+    err_code |= reply_uint32(p_reply_handler, &reply, statistics.bytes, statistics.notifications);
+  }
+  return err_code;
+}
+
+ret_code_t ble_diagnostics_handler(const ruuvi_standard_message_t message)
+{
+  switch(message.type)
+  {
+    case STATUS_QUERY:
+      NRF_LOG_DEBUG("Querying BLE diagnostics\r\n");
+      return query_diagnostics(message);
+
+    default:
+      return unknown_handler(message);
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef BLE_DIAGNOSTICS_H
+#define BLE_DIAGNOSTICS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sdk_errors.h"
+#include "ruuvi_endpoints.h"
+
+/**
+ *  Counters and histograms of BLE stack events and of the BLE message queues, read through
+ *  BLE_DIAGNOSTICS endpoint.
+ *
+ *  Stack events are recorded by on_ble_evt in BLE event (interrupt) context, queue processing
+ *  by ble_message_queue_process in main context. Each counter is written from one context only.
+ *  Counters run since boot and wrap around, central compares differences of two queries.
+ *  Connection parameters are those of the latest connection.
+ *
+ *  SoftDevice has no event for a connection event, connection events which acknowledged
+ *  notifications are counted from BLE_EVT_TX_COMPLETE. Connection parameters are recorded
+ *  on connection and on every parameter update.
+ *
+ *  STATUS_QUERY to BLE_DIAGNOSTICS is answered with these messages, in order:
+ *    UINT32  connections, disconnections
+ *    UINT16  connection interval (1.25 ms units), slave latency, supervision timeout (10 ms units),
+ *            HCI reason of last disconnection. Parameters are 0 while not connected.
+ *    UINT32  TX complete events, notifications acknowledged by peer
+ *    UINT32  notifications placed to softdevice, notifications refused with BLE_ERROR_NO_TX_PACKETS
+ *    UINT32  standard messages overwritten in full queue, bulk transfers refused by full queue
+ *    UINT32  ble_message_queue_process calls, longest call in app_timer ticks
+ *    UINT16  connection interval histogram, buckets 0 ... 3, then 4 ... 7
+ *    UINT16  slave latency histogram, buckets 0 ... 3, then 4 ... 7
+ *    UINT16  ble_message_queue_process time histogram, buckets 0 ... 3, then 4 ... 7
+ *    UINT32  bytes, notifications placed to softdevice for link, one message per link 0 ... BLE_LINK_COUNT - 1.
+ *            Counters of a link restart when a central connects to it.
+ *
+ *  Histogram buckets are powers of two: value 0 goes to bucket 0, 1 to bucket 1, 2 ... 3 to bucket 2,
+ *  4 ... 7 to bucket 3 and so on, last bucket takes everything above. Connection interval is
+ *  counted in units of 7.5 ms, the shortest interval, so bucket 0 is 7.5 ms, bucket 1 up to 15 ms
+ *  and bucket 7 above 480 ms. Processing time is counted in app_timer ticks of RUUVITAG_APP_TIMER_PRESCALER,
+ *  bucket 0 is a call shorter than one tick.
+ */
+
+#define BLE_DIAGNOSTICS_BUCKETS 8
+
+typedef struct{
+  uint32_t connections;
+  uint32_t disconnections;
+  uint8_t  disconnect_reason;        // HCI status code of last disconnection
+  uint16_t interval;                 // Current connection interval in 1.25 ms units, 0 if not connected
+  uint16_t latency;                  // Current slave latency
+  uint16_t timeout;                  // Current supervision timeout in 10 ms units
+  uint32_t tx_complete_events;       // Connection events which acknowledged notifications
+  uint32_t tx_completed;             // Notifications acknowledged by peer
+  uint32_t process_calls;            // ble_message_queue_process calls
+  uint32_t process_max;              // Longest ble_message_queue_process call in app_timer ticks
+  uint16_t interval_histogram[BLE_DIAGNOSTICS_BUCKETS];
+  uint16_t latency_histogram[BLE_DIAGNOSTICS_BUCKETS];
+  uint16_t process_histogram[BLE_DIAGNOSTICS_BUCKETS];
+}ble_diagnostics_t;
+
+/** Record new connection and its parameters **/
+void ble_diagnostics_on_connected(uint16_t interval, uint16_t latency, uint16_t timeout);
+
+/** Record updated connection parameters **/
+void ble_diagnostics_on_conn_params(uint16_t interval, uint16_t latency, uint16_t timeout);
+
+/** Record disconnection with HCI reason **/
+void ble_diagnostics_on_disconnected(uint8_t reason);
+
+/** Record BLE_EVT_TX_COMPLETE with number of notifications acknowledged **/
+void ble_diagnostics_on_tx_complete(uint8_t count);
+
+/** Record duration of one ble_message_queue_process call in app_timer ticks **/
+void ble_diagnostics_on_queue_process(uint32_t ticks);
+
+/** Copy counters to diagnostics **/
+void ble_diagnostics_get(ble_diagnostics_t* diagnostics);
+
+/**
+ *  Handler for BLE_DIAGNOSTICS endpoint, register with set_diagnostics_handler.
+ *  Answers STATUS_QUERY through reply handler, see above. Other message types are unknown.
+ */
+ret_code_t ble_diagnostics_handler(const ruuvi_standard_message_t message);
+
+#endif
@@ -11,6 +11,13 @@
 #include "nrf_log_ctrl.h"
 
 #include "bluetooth_config.h"
+#include "ble_bulk_receive.h"
+#include "ble_bulk_transfer.h"
+#include "ble_diagnostics.h"
+#include "bluetooth_core.h"
+#if APPLICATION_BLE_RELAY
+#include "ble_relay.h"
+#endif
 #include "app_scheduler.h"
 
 #if APPLICATION_GATT
@@ -18,13 +25,13 @@
 #endif
 
 
-static uint16_t                          m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Handle of the current connection. */
+static uint16_t                          m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Handle of the latest connection, connection parameters module follows it. */
 nrf_ble_qwr_t                            m_qwr;                                     /**< Queued Writes structure.*/
 
-/** Return true if connected **/
+/** Return true if any central is connected **/
 bool is_ble_connected()
 {
-  return !(BLE_CONN_HANDLE_INVALID == m_conn_handle);
+  return ble_link_count() > 0;
 }
 
 /**@brief Function for dispatching a system event to interested modules.
@@ -109,25 +116,74 @@ void on_ble_evt(ble_evt_t * p_ble_evt)
             err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);//TODO
             APP_ERROR_CHECK(err_code);
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            ble_link_connect(m_conn_handle);
+            {
+              // Connected event has the parameters in use in both min and max interval
+              ble_gap_conn_params_t const * p_params = &p_ble_evt->evt.gap_evt.params.connected.conn_params;
+              ble_diagnostics_on_connected(p_params->max_conn_interval, p_params->slave_latency,
+                                           p_params->conn_sup_timeout);
+            }
             NRF_LOG_INFO("Connection established\r\n");
+            // SoftDevice stops advertising on connection, keep advertising while there are free links
+            if(ble_link_count() < BLE_LINK_COUNT) { bluetooth_advertising_resume(); }
+#if (NRF_SD_BLE_API_VERSION == 3)
+            // Central might not start MTU exchange by itself, i.e. Android unless requested by application.
+            if(NRF_BLE_MAX_MTU_SIZE > GATT_MTU_SIZE_DEFAULT)
+            {
+              err_code = sd_ble_gattc_exchange_mtu_request(m_conn_handle, NRF_BLE_MAX_MTU_SIZE);
+              if(NRF_SUCCESS != err_code) { NRF_LOG_WARNING("MTU exchange request failed: %d\r\n", err_code); }
+            }
+#endif
             break; // BLE_GAP_EVT_CONNECTED
 
         case BLE_GAP_EVT_DISCONNECTED:
             err_code = bsp_indication_set(BSP_INDICATE_IDLE);
             APP_ERROR_CHECK(err_code);
-            m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            if(m_conn_handle == p_ble_evt->evt.gap_evt.conn_handle) { m_conn_handle = BLE_CONN_HANDLE_INVALID; }
+            ble_bulk_receive_reset(ble_link_find(p_ble_evt->evt.gap_evt.conn_handle));
+            ble_link_disconnect(p_ble_evt->evt.gap_evt.conn_handle);
+            if(!is_ble_connected()) { bluetooth_conn_params_fast(false); }
+            // Link was freed, advertising stopped if all links were in use
+            if(BLE_LINK_COUNT > 1) { bluetooth_advertising_resume(); }
+            ble_diagnostics_on_disconnected(p_ble_evt->evt.gap_evt.params.disconnected.reason);
             NRF_LOG_INFO("Disconnected\r\n");
             break; // BLE_GAP_EVT_DISCONNECTED
 
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        {
+            ble_gap_conn_params_t const * p_params = &p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params;
+            ble_diagnostics_on_conn_params(p_params->max_conn_interval, p_params->slave_latency,
+                                           p_params->conn_sup_timeout);
+            NRF_LOG_DEBUG("Connection interval %d, latency %d\r\n", p_params->max_conn_interval, p_params->slave_latency);
+        } break; // BLE_GAP_EVT_CONN_PARAM_UPDATE
+
+        case BLE_EVT_TX_COMPLETE:
+            ble_diagnostics_on_tx_complete(p_ble_evt->evt.common_evt.params.tx_complete.count);
+            break; // BLE_EVT_TX_COMPLETE
+
+#if APPLICATION_BLE_RELAY
+        case BLE_GAP_EVT_ADV_REPORT:
+            ble_relay_on_adv_report(p_ble_evt->evt.gap_evt.params.adv_report.data,
+                                    p_ble_evt->evt.gap_evt.params.adv_report.dlen);
+            break; // BLE_GAP_EVT_ADV_REPORT
+#endif
+
         case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
             // Pairing not supported
-            err_code = sd_ble_gap_sec_params_reply(m_conn_handle, BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP, NULL, NULL);
+            err_code = sd_ble_gap_sec_params_reply(p_ble_evt->evt.gap_evt.conn_handle, BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP, NULL, NULL);
             APP_ERROR_CHECK(err_code);
             break; // BLE_GAP_EVT_SEC_PARAMS_REQUEST
 
+        case BLE_GATTS_EVT_WRITE:
+        {
+            // Before NUS handles the write, data handler needs to know the link it came from
+            ble_gatts_evt_write_t const * p_write = &p_ble_evt->evt.gatts_evt.params.write;
+            ble_link_on_write(p_ble_evt->evt.gatts_evt.conn_handle, p_write->handle, p_write->data, p_write->len);
+        } break; // BLE_GATTS_EVT_WRITE
+
         case BLE_GATTS_EVT_SYS_ATTR_MISSING:
             // No system attributes have been stored.
-            err_code = sd_ble_gatts_sys_attr_set(m_conn_handle, NULL, 0, 0);
+            err_code = sd_ble_gatts_sys_attr_set(p_ble_evt->evt.gatts_evt.conn_handle, NULL, 0, 0);
             APP_ERROR_CHECK(err_code);
             break; // BLE_GATTS_EVT_SYS_ATTR_MISSING
 
@@ -181,10 +237,20 @@ void on_ble_evt(ble_evt_t * p_ble_evt)
 
 #if (NRF_SD_BLE_API_VERSION == 3)
         case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST:
+        {
             err_code = sd_ble_gatts_exchange_mtu_reply(p_ble_evt->evt.gatts_evt.conn_handle,
                                                        NRF_BLE_MAX_MTU_SIZE);
             APP_ERROR_CHECK(err_code);
-            break; // BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST
+            // Agreed MTU is smaller of client and server MTUs
+            uint16_t client_mtu = p_ble_evt->evt.gatts_evt.params.exchange_mtu_request.client_rx_mtu;
+            ble_bulk_set_att_mtu(p_ble_evt->evt.gatts_evt.conn_handle, MIN(client_mtu, NRF_BLE_MAX_MTU_SIZE));
+        } break; // BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST
+
+        case BLE_GATTC_EVT_EXCHANGE_MTU_RSP:
+        {
+            uint16_t server_mtu = p_ble_evt->evt.gattc_evt.params.exchange_mtu_rsp.server_rx_mtu;
+            ble_bulk_set_att_mtu(p_ble_evt->evt.gattc_evt.conn_handle, MIN(server_mtu, NRF_BLE_MAX_MTU_SIZE));
+        } break; // BLE_GATTC_EVT_EXCHANGE_MTU_RSP
 #endif
 
         default:
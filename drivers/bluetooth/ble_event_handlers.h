@@ -17,9 +17,6 @@
 
 //#include "service_if.h"
 
-//TODO: Allow larger MTU
-#define NRF_BLE_MAX_MTU_SIZE GATT_MTU_SIZE_DEFAULT 
-
 //TODO: move to core
 bool is_ble_connected();
 
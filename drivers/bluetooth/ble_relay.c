@@ -0,0 +1,367 @@
+#include "ble_relay.h"
+
+#include <string.h>
+
+#include "ble_gap.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "nordic_common.h"
+#include "nrf_error.h"
+
+#include "advertising_scheduler.h"
+#include "ble_bulk_transfer.h"
+#include "bluetooth_config.h"
+
+#define NRF_LOG_MODULE_NAME "BLE_RELAY"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#define RELAY_FORMAT_RAWv2      0x05
+#define RELAY_SEQUENCE_OFFSET   16
+#define RELAY_MAC_OFFSET        18
+#define RELAY_SEQUENCE_INVALID  0xFFFF
+#define RELAY_SCAN_INTERVAL_MS  100   // Scanner changes channel every interval, window covers whole interval
+#define RELAY_MAX_PERIOD_S      3600  // app_timer counter is 24 bits
+#define RELAY_NONE              0xFF
+
+typedef struct{
+  uint8_t  payload[BLE_RELAY_RAWv2_LENGTH];
+  uint8_t  hops;       // Hop count advertised with payload
+  uint8_t  remaining;  // Advertisements left
+  uint32_t stamp;      // Order of updates, oldest is replaced
+  bool     used;
+}relay_entry_t;
+
+static relay_entry_t          m_table[BLE_RELAY_TABLE_SIZE];
+static ble_relay_config_t     m_config = { .scan_window_ms = 1500, .scan_period_s = 60, .budget_permille = 25,
+                                           .forward_interval_ms = 2560, .frame_period = 2, .max_hops = 2,
+                                           .repeats = 3 };
+static ble_relay_statistics_t m_statistics = {0};
+static uint8_t                m_own_mac[BLE_RELAY_MAC_LENGTH];
+static uint8_t                m_frame     = 0;
+static uint32_t               m_stamp     = 0;
+static uint32_t               m_credit_ms = 0;
+static bool                   m_enabled   = false;
+static volatile bool          m_scanning  = false;
+static bool                   m_forwarding = false;
+static uint8_t                m_on_air    = RELAY_NONE;  // Entry in relay frame
+static uint32_t               m_on_air_events = 0;       // Frame events when entry was encoded
+
+APP_TIMER_DEF(m_period_timer);
+APP_TIMER_DEF(m_window_timer);
+APP_TIMER_DEF(m_forward_timer);
+
+static uint16_t payload_sequence(const uint8_t* payload)
+{
+  return (payload[RELAY_SEQUENCE_OFFSET] << 8) | payload[RELAY_SEQUENCE_OFFSET + 1];
+}
+
+static const uint8_t* payload_mac(const uint8_t* payload)
+{
+  return &payload[RELAY_MAC_OFFSET];
+}
+
+/** Entry of MAC, or the entry to replace: a free one or the oldest **/
+static uint8_t entry_find(const uint8_t* mac, bool* found)
+{
+  uint8_t replace = 0;
+  for(uint8_t ii = 0; ii < BLE_RELAY_TABLE_SIZE; ii++)
+  {
+    relay_entry_t* p_entry = &m_table[ii];
+    if(p_entry->used && !memcmp(payload_mac(p_entry->payload), mac, BLE_RELAY_MAC_LENGTH))
+    {
+      *found = true;
+      return ii;
+    }
+    if(!m_table[replace].used) { continue; }
+    if(!p_entry->used || p_entry->stamp < m_table[replace].stamp) { replace = ii; }
+  }
+  *found = false;
+  return replace;
+}
+
+/** Sequence ahead of stored one in serial number arithmetic. Without a valid sequence any change is new **/
+static bool payload_is_new(const relay_entry_t* p_entry, const uint8_t* payload)
+{
+  uint16_t sequence = payload_sequence(payload);
+  uint16_t stored   = payload_sequence(p_entry->payload);
+  if(RELAY_SEQUENCE_INVALID == sequence || RELAY_SEQUENCE_INVALID == stored)
+  {
+    return 0 != memcmp(p_entry->payload, payload, BLE_RELAY_RAWv2_LENGTH);
+  }
+  return (int16_t)(sequence - stored) > 0;
+}
+
+static void payload_store(const uint8_t* payload, uint8_t hops)
+{
+  if(!memcmp(payload_mac(payload), m_own_mac, BLE_RELAY_MAC_LENGTH)) { return; }
+  m_statistics.reports++;
+  if(hops >= m_config.max_hops)
+  {
+    m_statistics.hop_limited++;
+    return;
+  }
+  bool found;
+  uint8_t index = entry_find(payload_mac(payload), &found);
+  relay_entry_t* p_entry = &m_table[index];
+  if(found && !payload_is_new(p_entry, payload))
+  {
+    m_statistics.duplicates++;
+    return;
+  }
+  if(!found && p_entry->used) { m_statistics.evicted++; }
+  memcpy(p_entry->payload, payload, BLE_RELAY_RAWv2_LENGTH);
+  p_entry->hops      = hops + 1;
+  p_entry->remaining = m_config.repeats;
+  p_entry->stamp     = ++m_stamp;
+  p_entry->used      = true;
+  m_statistics.accepted++;
+}
+
+void ble_relay_on_adv_report(const uint8_t* data, uint8_t length)
+{
+  if(!m_scanning || NULL == data) { return; }
+  // AD structures: length, type, data
+  for(uint8_t offset = 0; offset + 1 < length; offset += data[offset] + 1)
+  {
+    uint8_t ad_length = data[offset];
+    if(!ad_length || offset + ad_length >= length) { return; }
+    if(BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA != data[offset + 1]) { continue; }
+    const uint8_t* p_manufacturer = &data[offset + 2];
+    uint8_t manufacturer_length = ad_length - 1;
+    if(manufacturer_length < 2 + BLE_RELAY_RAWv2_LENGTH) { continue; }
+    if(uint16_decode(p_manufacturer) != BLE_COMPANY_IDENTIFIER) { continue; }
+    const uint8_t* payload = p_manufacturer + 2;
+    if(RELAY_FORMAT_RAWv2 != payload[0]) { continue; }
+    // RAWv2 from its tag, or relay frame with hop count after payload
+    if(2 + BLE_RELAY_RAWv2_LENGTH == manufacturer_length)     { payload_store(payload, 0); }
+    else if(2 + BLE_RELAY_FRAME_LENGTH == manufacturer_length) { payload_store(payload, payload[BLE_RELAY_RAWv2_LENGTH]); }
+  }
+}
+
+static ret_code_t frame_encode(const uint8_t* payload, uint8_t hops)
+{
+  uint8_t data[BLE_RELAY_FRAME_LENGTH];
+  memcpy(data, payload, BLE_RELAY_RAWv2_LENGTH);
+  data[BLE_RELAY_RAWv2_LENGTH] = hops;
+  ble_advdata_manuf_data_t manufacturer_data = { .company_identifier = BLE_COMPANY_IDENTIFIER,
+                                                 .data = { .size = sizeof(data), .p_data = data }};
+  ble_advdata_t advdata;
+  memset(&advdata, 0, sizeof(advdata));
+  // No flags, 24 bytes of RAWv2 and hop count fill the advertisement
+  advdata.p_manuf_specific_data = &manufacturer_data;
+  return adv_scheduler_frame_encode(m_frame, &advdata);
+}
+
+static void forward_stop(void)
+{
+  app_timer_stop(m_forward_timer);
+  adv_scheduler_frame_period_set(m_frame, 0);
+  m_forwarding = false;
+  m_on_air = RELAY_NONE;
+}
+
+/** Put next pending payload to relay frame. Payload on air stays until frame has been advertised **/
+static void forward_timeout_handler(void* p_context)
+{
+  uint8_t payload[BLE_RELAY_RAWv2_LENGTH];
+  uint8_t hops  = 0;
+  uint8_t next  = RELAY_NONE;
+  uint32_t events = adv_scheduler_frame_events(m_frame);
+  CRITICAL_REGION_ENTER();
+  if(RELAY_NONE != m_on_air && events != m_on_air_events && m_table[m_on_air].remaining)
+  {
+    m_table[m_on_air].remaining--;
+  }
+  if(RELAY_NONE == m_on_air || events != m_on_air_events)
+  {
+    uint8_t start = (RELAY_NONE == m_on_air) ? 0 : m_on_air + 1;
+    for(uint8_t ii = 0; ii < BLE_RELAY_TABLE_SIZE && RELAY_NONE == next; ii++)
+    {
+      uint8_t index = (start + ii) % BLE_RELAY_TABLE_SIZE;
+      if(m_table[index].used && m_table[index].remaining) { next = index; }
+    }
+    if(RELAY_NONE != next)
+    {
+      memcpy(payload, m_table[next].payload, sizeof(payload));
+      hops = m_table[next].hops;
+    }
+  }
+  else { next = m_on_air; }
+  CRITICAL_REGION_EXIT();
+
+  if(RELAY_NONE == next)
+  {
+    forward_stop();
+    return;
+  }
+  if(next == m_on_air && events == m_on_air_events) { return; }
+  if(NRF_SUCCESS != frame_encode(payload, hops)) { return; }
+  m_on_air        = next;
+  m_on_air_events = events;
+  m_statistics.forwarded++;
+}
+
+static void forward_start(void)
+{
+  if(m_forwarding) { return; }
+  if(NRF_SUCCESS != app_timer_start(m_forward_timer, APP_TIMER_TICKS(m_config.forward_interval_ms, RUUVITAG_APP_TIMER_PRESCALER), NULL))
+  {
+    return;
+  }
+  m_forwarding = true;
+  forward_timeout_handler(NULL);
+  if(m_forwarding) { adv_scheduler_frame_period_set(m_frame, m_config.frame_period); }
+}
+
+static void scan_stop(void)
+{
+  if(!m_scanning) { return; }
+  sd_ble_gap_scan_stop();
+  m_scanning = false;
+}
+
+static void window_timeout_handler(void* p_context)
+{
+  scan_stop();
+  forward_start();
+}
+
+/** Earn budget of the period, start a window if a full window has been earned and no central is connected **/
+static void period_timeout_handler(void* p_context)
+{
+  uint32_t window_ms = m_config.scan_window_ms;
+  m_credit_ms = MIN(m_credit_ms + (uint32_t)m_config.scan_period_s * m_config.budget_permille, 2 * window_ms);
+  if(m_scanning || ble_link_count() || m_credit_ms < window_ms)
+  {
+    m_statistics.skipped++;
+    return;
+  }
+  uint16_t interval = MSEC_TO_UNITS(MIN(window_ms, RELAY_SCAN_INTERVAL_MS), UNIT_0_625_MS);
+  ble_gap_scan_params_t scan_params = { .active   = 0,
+                                        .interval = interval,
+                                        .window   = interval,
+                                        .timeout  = 0 };
+  ret_code_t err_code = sd_ble_gap_scan_start(&scan_params);
+  if(NRF_SUCCESS != err_code)
+  {
+    NRF_LOG_WARNING("Scan start failed: %d\r\n", err_code);
+    m_statistics.skipped++;
+    return;
+  }
+  m_scanning = true;
+  m_credit_ms -= window_ms;
+  m_statistics.windows++;
+  m_statistics.scan_ms += window_ms;
+  app_timer_start(m_window_timer, APP_TIMER_TICKS(window_ms, RUUVITAG_APP_TIMER_PRESCALER), NULL);
+}
+
+ret_code_t ble_relay_init(uint8_t frame, const uint8_t* own_mac)
+{
+  m_frame = frame;
+  if(own_mac) { memcpy(m_own_mac, own_mac, sizeof(m_own_mac)); }
+  ret_code_t err_code = app_timer_create(&m_period_timer, APP_TIMER_MODE_REPEATED, period_timeout_handler);
+  err_code |= app_timer_create(&m_window_timer, APP_TIMER_MODE_SINGLE_SHOT, window_timeout_handler);
+  err_code |= app_timer_create(&m_forward_timer, APP_TIMER_MODE_REPEATED, forward_timeout_handler);
+  return err_code;
+}
+
+ret_code_t ble_relay_configure(const ble_relay_config_t* config)
+{
+  if(NULL == config) { return NRF_ERROR_NULL; }
+  if(!config->scan_window_ms || !config->scan_period_s || config->scan_period_s > RELAY_MAX_PERIOD_S ||
+     config->scan_window_ms > (uint32_t)config->scan_period_s * 1000 || config->budget_permille > 1000 ||
+     !config->forward_interval_ms || !config->frame_period || !config->repeats)
+  {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  bool period_changed = config->scan_period_s != m_config.scan_period_s;
+  memcpy(&m_config, config, sizeof(m_config));
+  if(m_enabled && period_changed)
+  {
+    app_timer_stop(m_period_timer);
+    return app_timer_start(m_period_timer, APP_TIMER_TICKS(m_config.scan_period_s * 1000u, RUUVITAG_APP_TIMER_PRESCALER), NULL);
+  }
+  return NRF_SUCCESS;
+}
+
+void ble_relay_config_get(ble_relay_config_t* config)
+{
+  if(NULL == config) { return; }
+  memcpy(config, &m_config, sizeof(m_config));
+}
+
+ret_code_t ble_relay_enable(bool enable)
+{
+  if(enable == m_enabled) { return NRF_SUCCESS; }
+  m_enabled = enable;
+  if(!enable)
+  {
+    app_timer_stop(m_period_timer);
+    app_timer_stop(m_window_timer);
+    scan_stop();
+    return NRF_SUCCESS;
+  }
+  m_credit_ms = 0;
+  return app_timer_start(m_period_timer, APP_TIMER_TICKS(m_config.scan_period_s * 1000u, RUUVITAG_APP_TIMER_PRESCALER), NULL);
+}
+
+void ble_relay_statistics_get(ble_relay_statistics_t* statistics)
+{
+  if(NULL == statistics) { return; }
+  memcpy(statistics, &m_statistics, sizeof(m_statistics));
+}
+
+static ret_code_t query_relay(const ruuvi_standard_message_t message)
+{
+  message_handler p_reply_handler = get_reply_handler();
+  if(!p_reply_handler) { return ENDPOINT_HANDLER_ERROR; }
+  ruuvi_standard_message_t reply = { .destination_endpoint = message.source_endpoint,
+                                     .source_endpoint      = message.destination_endpoint,
+                                     .type                 = UINT16,
+                                     .payload              = { 0 }};
+  uint16_t configuration[4] = { m_enabled, m_config.max_hops, m_config.scan_window_ms, m_config.scan_period_s };
+  memcpy(reply.payload, configuration, sizeof(reply.payload));
+  ret_code_t err_code = p_reply_handler(reply);
+  err_code |= reply_uint32(p_reply_handler, &reply, m_statistics.windows, m_statistics.skipped);
+  err_code |= reply_uint32(p_reply_handler, &reply, m_statistics.scan_ms, m_statistics.reports);
+  err_code |= reply_uint32(p_reply_handler, &reply, m_statistics.accepted, m_statistics.duplicates);
+  err_code |= reply_uint32(p_reply_handler, &reply, m_statistics.hop_limited, m_statistics.evicted);
+  err_code |= reply_uint32(p_reply_handler, &reply, m_statistics.forwarded, m_config.budget_permille);
+  return err_code;
+}
+
+/** 0 keeps current value, enable 255 keeps current state **/
+static ret_code_t configure_relay(const ruuvi_standard_message_t message)
+{
+  ble_relay_config_t config = m_config;
+  uint8_t enable = message.payload[0];
+  if(enable > 1 && 255 != enable) { return ENDPOINT_INVALID; }
+  if(message.payload[1]) { config.max_hops = message.payload[1]; }
+  uint16_t window_ms = uint16_decode(&message.payload[2]);
+  uint16_t period_s  = uint16_decode(&message.payload[4]);
+  uint16_t budget    = uint16_decode(&message.payload[6]);
+  if(window_ms) { config.scan_window_ms  = window_ms; }
+  if(period_s)  { config.scan_period_s   = period_s; }
+  if(budget)    { config.budget_permille = budget; }
+  if(NRF_SUCCESS != ble_relay_configure(&config)) { return ENDPOINT_INVALID; }
+  if(255 != enable && NRF_SUCCESS != ble_relay_enable(enable)) { return ENDPOINT_HANDLER_ERROR; }
+  NRF_LOG_INFO("Relay %d, window %d ms every %d s\r\n", m_enabled, m_config.scan_window_ms, m_config.scan_period_s);
+  return query_relay(message);
+}
+
+ret_code_t ble_relay_handler(const ruuvi_standard_message_t message)
+{
+  switch(message.type)
+  {
+    case SENSOR_CONFIGURATION:
+      return configure_relay(message);
+
+    case STATUS_QUERY:
+      return query_relay(message);
+
+    default:
+      return unknown_handler(message);
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef BLE_RELAY_H
+#define BLE_RELAY_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sdk_errors.h"
+#include "ruuvi_endpoints.h"
+
+/**
+ *  Store-and-forward relay of RAWv2 advertisements between tags, for tags out of gateway range.
+ *
+ *  Relay scans in short windows while no central is connected and keeps the latest RAWv2 payload of
+ *  each neighbour in a small table, keyed by the MAC address in the payload. A payload is new if its
+ *  measurement sequence is ahead of the stored one, otherwise it is a duplicate. New payloads are
+ *  advertised in a frame of advertising scheduler, repeats times each, neighbours taking turns.
+ *  While nothing is pending the frame is disabled and own frames get every advertisement.
+ *  Relaying does not add radio events, relay frame takes a share of own advertisements.
+ *
+ *  Relay frame is manufacturer specific data with Ruuvi company ID: the 24-byte RAWv2 payload of
+ *  the neighbour as is, followed by hop count. Frame has no flags to fit in 31 bytes.
+ *  Gateway reads the first 24 bytes as RAWv2, origin tag is identified by MAC in the payload.
+ *  Other relays pick up relay frames too and forward them while hop count is below max_hops,
+ *  a payload heard both directly and relayed is forwarded once.
+ *
+ *  Scan time is limited by a budget: each scan period earns budget_permille of the period as
+ *  scan time, and a window starts only if a full window has been earned. Window longer than the
+ *  budget allows is thus scanned every few periods. Credit is capped to two windows, periods
+ *  skipped for a connection do not accumulate a burst of scanning.
+ *
+ *  Advertising reports are parsed in BLE event (interrupt) context, timers run in main context.
+ *
+ *  BLE_RELAY endpoint:
+ *    SENSOR_CONFIGURATION  payload: enable (0, 1, 255 no change), max hops, scan window ms (uint16),
+ *                          scan period s (uint16), budget permille (uint16). 0 keeps current value.
+ *                          Little endian. Replies like STATUS_QUERY.
+ *    STATUS_QUERY          replies with UINT16 enabled, max hops, scan window ms, scan period s,
+ *                          then UINT32 windows scanned, windows skipped
+ *                               UINT32 ms scanned, Ruuvi reports received
+ *                               UINT32 payloads accepted, duplicates
+ *                               UINT32 dropped at hop limit, neighbours evicted from full table
+ *                               UINT32 relay frames put on air, budget permille
+ */
+
+#define BLE_RELAY_RAWv2_LENGTH   24                          // RAWv2 manufacturer data without company ID
+#define BLE_RELAY_FRAME_LENGTH   (BLE_RELAY_RAWv2_LENGTH + 1) // RAWv2 payload and hop count
+#define BLE_RELAY_MAC_LENGTH     6
+
+#ifndef BLE_RELAY_TABLE_SIZE
+  #define BLE_RELAY_TABLE_SIZE   8  // Neighbours remembered, oldest is replaced when full
+#endif
+
+typedef struct{
+  uint16_t scan_window_ms;      // Length of a scan window
+  uint16_t scan_period_s;       // Time from start of a window to start of next one
+  uint16_t budget_permille;     // Largest share of time spent scanning
+  uint16_t forward_interval_ms; // Time a payload stays in relay frame before next one, about frame_period advertisements
+  uint8_t  frame_period;        // Period of relay frame in advertising scheduler while payloads are pending
+  uint8_t  max_hops;            // Payloads relayed this many times are not relayed again
+  uint8_t  repeats;             // Advertisements of each new payload
+}ble_relay_config_t;
+
+typedef struct{
+  uint32_t windows;       // Scan windows started
+  uint32_t skipped;       // Scan windows skipped for budget or connection
+  uint32_t scan_ms;       // Time spent scanning
+  uint32_t reports;       // Advertising reports with RAWv2 or relay frame
+  uint32_t accepted;      // New payloads of neighbours
+  uint32_t duplicates;    // Payloads already seen
+  uint32_t hop_limited;   // Payloads dropped at max_hops
+  uint32_t evicted;       // Neighbours replaced in full table
+  uint32_t forwarded;     // Payloads put to relay frame
+}ble_relay_statistics_t;
+
+/**
+ *  Create timers. Relay starts disabled.
+ *
+ *  @param frame advertising scheduler frame reserved for relay
+ *  @param own_mac MAC of this tag in RAWv2 byte order, own payloads relayed by others are ignored
+ *  @return NRF_SUCCESS or error from app_timer
+ */
+ret_code_t ble_relay_init(uint8_t frame, const uint8_t* own_mac);
+
+/**
+ *  Apply configuration. Window and budget take effect from next period.
+ *
+ *  @return NRF_SUCCESS, NRF_ERROR_INVALID_PARAM if window or period is 0 or window is longer than period
+ */
+ret_code_t ble_relay_configure(const ble_relay_config_t* config);
+
+/** Current configuration **/
+void ble_relay_config_get(ble_relay_config_t* config);
+
+/**
+ *  Start or stop scanning. Stopping lets pending payloads finish their repeats.
+ *
+ *  @return NRF_SUCCESS or error from app_timer
+ */
+ret_code_t ble_relay_enable(bool enable);
+
+/**
+ *  Call from on_ble_evt on BLE_GAP_EVT_ADV_REPORT with advertisement data.
+ *  Non-Ruuvi advertisements are ignored.
+ */
+void ble_relay_on_adv_report(const uint8_t* data, uint8_t length);
+
+/** Copy counters since boot **/
+void ble_relay_statistics_get(ble_relay_statistics_t* statistics);
+
+/**
+ *  Handler for BLE_RELAY endpoint, register with set_relay_handler. See above.
+ */
+ret_code_t ble_relay_handler(const ruuvi_standard_message_t message);
+
+#endif
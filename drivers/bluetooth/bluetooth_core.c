@@ -137,6 +137,7 @@ ble_advdata_t scanresp =
 };
 
 static bool advertising = false;
+static bool conn_params_fast = false;
 static ble_gap_conn_params_t   gap_conn_params;
 static ble_gap_conn_sec_mode_t sec_mode;
 static ble_advdata_manuf_data_t m_manufacturer_data;
@@ -354,6 +355,15 @@ ret_code_t bluetooth_stack_init(void)
     NRF_LOG_INFO("Softdevice enabled, status: %s\r\n", (uint32_t)ERR_TO_STR(err_code));
     nrf_delay_ms(10);
 
+    #if (NRF_SD_BLE_API_VERSION == 3)
+      // Allow several packets per connection event, required for throughput with long connection intervals
+      ble_opt_t opt;
+      memset(&opt, 0, sizeof(opt));
+      opt.common_opt.conn_evt_ext.enable = 1;
+      err_code |= sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &opt);
+      NRF_LOG_INFO("Connection event extension, status: %d\r\n", err_code);
+    #endif
+
     #if APP_GATT_PROFILE_ENABLED
       //Enable peer manager, erase bonds
       //Init filesystem
@@ -425,6 +435,23 @@ void peer_manager_init(bool erase_bonds)
     APP_ERROR_CHECK(err_code);
 }
 
+ret_code_t bluetooth_conn_params_fast(bool fast)
+{
+  if(fast == conn_params_fast) { return NRF_SUCCESS; }
+  ble_gap_conn_params_t params = gap_conn_params;
+  if(fast)
+  {
+    params.min_conn_interval = FAST_MIN_CONN_INTERVAL;
+    params.max_conn_interval = FAST_MAX_CONN_INTERVAL;
+  }
+  ret_code_t err_code = ble_conn_params_change_conn_params(&params);
+  // Preferred parameters are stored even if there is no connection to update
+  if(!is_ble_connected()) { err_code = NRF_SUCCESS; }
+  if(NRF_SUCCESS == err_code) { conn_params_fast = fast; }
+  NRF_LOG_DEBUG("Connection parameters fast: %d, status %d\r\n", fast, err_code);
+  return err_code;
+}
+
 /**
  * @brief Function to set BLE transmission power
  *  
@@ -482,6 +509,16 @@ ret_code_t bluetooth_advertising_stop(void)
   return err_code;
 }
 
+ret_code_t bluetooth_advertising_resume(void)
+{
+  if(!advertising) { return NRF_SUCCESS; }
+  ret_code_t err_code = sd_ble_gap_adv_start(&m_adv_params);
+  // Advertising has not been stopped, i.e. link was closed while other links were free
+  if(NRF_ERROR_INVALID_STATE == err_code) { err_code = NRF_SUCCESS; }
+  if(NRF_SUCCESS != err_code) { NRF_LOG_INFO("Advertisement fail: %d \r\n", err_code); }
+  return err_code;
+}
+
 /**@brief Function for advertising data. 
  *
  * @details Initializes the BLE advertisement with given data as manufacturer specific data.
@@ -56,6 +56,13 @@ ret_code_t bluetooth_advertising_start(void);
  */
 ret_code_t bluetooth_advertising_stop(void);
 
+/**
+ *  Start advertising again after SoftDevice stopped it for a new connection, so that
+ *  further centrals can connect while there are free links. Does nothing if application
+ *  had stopped advertising. Advertising which is already on is left as is.
+ */
+ret_code_t bluetooth_advertising_resume(void);
+
 /**
  * @brief Function to setsBLE transmission power
  *  
@@ -100,6 +107,16 @@ ret_code_t bluetooth_configure_advertising_interval(uint16_t interval);
 ret_code_t bluetooth_configure_advertisement_type(uint8_t type);
 
 
+/**
+ * Request connection parameters for data transfer or for idle connection.
+ * Fast parameters are FAST_MIN_CONN_INTERVAL ... FAST_MAX_CONN_INTERVAL, idle parameters are
+ * MIN_CONN_INTERVAL ... MAX_CONN_INTERVAL. Central decides the actual interval.
+ *
+ * @param fast true to request short connection interval, false to return to idle parameters
+ * @return error code from connection parameter module, NRF_SUCCESS if request was sent or not needed
+ */
+ret_code_t bluetooth_conn_params_fast(bool fast);
+
 /**
  * Set Eddystone URL advertisement package in advdata.
  * 
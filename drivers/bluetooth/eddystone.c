@@ -26,6 +26,8 @@
 #include "nordic_common.h"
 #include "softdevice_handler.h"
 #include "nrf_error.h"
+#include "nrf_soc.h"
+#include "app_error.h"
 #include "sdk_errors.h"
 #include "app_timer.h"
 #include "bluetooth_config.h"
@@ -37,7 +39,31 @@
 #include "nrf_log_ctrl.h"
 
 #include "bluetooth_core.h"
+#include "eddystone.h"
+#include "aes_eax.h"
 #define EDDYSTONE_UUID 0xFEAA
+
+static uint8_t m_frame[EDDYSTONE_FRAME_MAX_LENGTH];  // Service data of latest prepared frame
+
+/** Point advdata to Eddystone service data in m_frame **/
+static void prepare_service_data(ble_advdata_t* advdata, size_t length)
+{
+    static ble_uuid_t adv_uuids[] = {{EDDYSTONE_UUID, BLE_UUID_TYPE_BLE}};
+    static ble_advdata_service_data_t service_data;                 // Structure to hold Service Data.
+    service_data.service_uuid = EDDYSTONE_UUID;                     // Eddystone UUID to allow discoverability on iOS devices.
+    service_data.data.p_data = m_frame;                             // Pointer to the data to advertise.
+    service_data.data.size = length;                                // Size of the data to advertise.
+
+    // Build and set advertising data.
+    memset(advdata, 0, sizeof(ble_advdata_t));
+
+    advdata->flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    advdata->uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    advdata->uuids_complete.p_uuids  = adv_uuids;
+    advdata->p_service_data_array    = &service_data;  // Pointer to Service Data structure.
+    advdata->service_data_count      = 1;
+}
+
 /**
  *  @brief Helper for advertising Eddystone URLs. 
  *
@@ -45,38 +71,87 @@
  *  @param url url to advertise. May include prefix and suffix bytes, such as 0x03 for https://
  *  @param length length of URL to advertise. 
  *  @return Error code, 0 on success
- *  TODO: Refactor static variables out
  */
 ret_code_t eddystone_prepare_url_advertisement(ble_advdata_t* advdata, char* url, size_t length)
 {
     //Scheme byte is not included in length
     if(length > 18) { return NRF_ERROR_INVALID_PARAM; }
-    static ble_uuid_t    adv_uuids[] = {{EDDYSTONE_UUID, BLE_UUID_TYPE_BLE}};
-
-    static uint8_array_t eddystone_data_array;                             // Array for Service Data structure.
     uint8_t rf_power[] = APP_CONFIG_CALIBRATED_RANGING_DATA;
 
-    static char eddystone_url_data[21] = {0};
-    eddystone_url_data[0] = ES_FRAME_TYPE_URL;                      // Eddystone URL frame type.
-    eddystone_url_data[1] = rf_power[7];                            // RSSI value at 0 m. at 0 dbm transmit. TODO
-    memcpy(eddystone_url_data+2, url, length);                      // URL with a maximum length of 17 bytes.  
+    m_frame[0] = ES_FRAME_TYPE_URL;                                 // Eddystone URL frame type.
+    m_frame[1] = rf_power[7];                                       // RSSI value at 0 m. at 0 dbm transmit. TODO
+    memcpy(m_frame + 2, url, length);                               // URL with a maximum length of 17 bytes.  
+
+    prepare_service_data(advdata, 2 + length);
+    return NRF_SUCCESS;
+}
 
-    eddystone_data_array.p_data = (uint8_t *) eddystone_url_data;   // Pointer to the data to advertise.
-    eddystone_data_array.size = 2 + length;                         // Size of the data to advertise.
+/** Write TLM fields from battery voltage onwards, big-endian **/
+static void tlm_encode(uint8_t* data, const eddystone_tlm_t* tlm)
+{
+    data[0]  = tlm->battery >> 8;
+    data[1]  = tlm->battery & 0xFF;
+    data[2]  = (uint16_t)tlm->temperature >> 8;
+    data[3]  = (uint16_t)tlm->temperature & 0xFF;
+    data[4]  = tlm->adv_count >> 24;
+    data[5]  = (tlm->adv_count >> 16) & 0xFF;
+    data[6]  = (tlm->adv_count >> 8) & 0xFF;
+    data[7]  = tlm->adv_count & 0xFF;
+    data[8]  = tlm->uptime >> 24;
+    data[9]  = (tlm->uptime >> 16) & 0xFF;
+    data[10] = (tlm->uptime >> 8) & 0xFF;
+    data[11] = tlm->uptime & 0xFF;
+}
 
+ret_code_t eddystone_prepare_tlm_advertisement(ble_advdata_t* advdata, const eddystone_tlm_t* tlm)
+{
+    if(NULL == advdata || NULL == tlm) { return NRF_ERROR_NULL; }
+    m_frame[0] = ES_FRAME_TYPE_TLM;
+    m_frame[1] = EDDYSTONE_TLM_VERSION;
+    tlm_encode(&m_frame[2], tlm);
+    prepare_service_data(advdata, EDDYSTONE_TLM_LENGTH);
+    return NRF_SUCCESS;
+}
 
-    static ble_advdata_service_data_t service_data;                        // Structure to hold Service Data.
-    service_data.service_uuid = EDDYSTONE_UUID;                     // Eddystone UUID to allow discoverability on iOS devices.
-    service_data.data = eddystone_data_array;                       // Array for service advertisement data.
+/** AES-128 on SoftDevice ECB, available while SoftDevice is enabled **/
+static ret_code_t ecb_encrypt(const uint8_t* key, const uint8_t* in, uint8_t* out)
+{
+    nrf_ecb_hal_data_t ecb;
+    memcpy(ecb.key, key, SOC_ECB_KEY_LENGTH);
+    memcpy(ecb.cleartext, in, SOC_ECB_CLEARTEXT_LENGTH);
+    ret_code_t err_code = sd_ecb_block_encrypt(&ecb);
+    if(NRF_SUCCESS != err_code) { return err_code; }
+    memcpy(out, ecb.ciphertext, SOC_ECB_CIPHERTEXT_LENGTH);
+    return NRF_SUCCESS;
+}
 
-    // Build and set advertising data.
-    memset(advdata, 0, sizeof(ble_advdata_t));
+ret_code_t eddystone_prepare_etlm_advertisement(ble_advdata_t* advdata, const eddystone_tlm_t* tlm,
+                                                const uint8_t* eik, uint32_t time_counter, uint8_t rotation_exponent)
+{
+    if(NULL == advdata || NULL == tlm || NULL == eik) { return NRF_ERROR_NULL; }
+    if(rotation_exponent > 15) { return NRF_ERROR_INVALID_PARAM; }
 
-    advdata->flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
-    advdata->uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    advdata->uuids_complete.p_uuids  = adv_uuids;
-    advdata->p_service_data_array    = &service_data;  // Pointer to Service Data structure.
-    advdata->service_data_count      = 1;
+    // Nonce: time counter with lowest K bits cleared, big-endian, followed by salt
+    uint8_t salt[2];
+    ret_code_t err_code = sd_rand_application_vector_get(salt, sizeof(salt));
+    if(NRF_SUCCESS != err_code) { return err_code; }
+    time_counter &= ~((1UL << rotation_exponent) - 1);
+    uint8_t nonce[6] = { time_counter >> 24, (time_counter >> 16) & 0xFF, (time_counter >> 8) & 0xFF,
+                         time_counter & 0xFF, salt[0], salt[1] };
 
+    // Frame of previous call stays intact if encryption fails
+    uint8_t data[12];
+    uint8_t tag[AES_EAX_BLOCK_SIZE];
+    tlm_encode(data, tlm);
+    err_code = aes_eax_encrypt(ecb_encrypt, eik, nonce, sizeof(nonce), NULL, 0, data, sizeof(data), tag);
+    if(NRF_SUCCESS != err_code) { return err_code; }
+    m_frame[0] = ES_FRAME_TYPE_TLM;
+    m_frame[1] = EDDYSTONE_ETLM_VERSION;
+    memcpy(&m_frame[2], data, sizeof(data));
+    m_frame[14] = salt[0];
+    m_frame[15] = salt[1];
+    m_frame[16] = tag[0];                                           // Message integrity check is the
+    m_frame[17] = tag[1];                                           // first 2 bytes of the tag.
+    prepare_service_data(advdata, EDDYSTONE_ETLM_LENGTH);
     return NRF_SUCCESS;
 }
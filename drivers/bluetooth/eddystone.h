@@ -5,6 +5,26 @@
 #include "ble_advertising.h"
 #include "sdk_errors.h"
 
+#define EDDYSTONE_TLM_VERSION       0x00
+#define EDDYSTONE_ETLM_VERSION      0x01
+#define EDDYSTONE_TLM_LENGTH        14  // Frame type, version, battery, temperature, advertisement count, uptime
+#define EDDYSTONE_ETLM_LENGTH       18  // Frame type, version, 12 bytes of encrypted TLM, salt, integrity check
+#define EDDYSTONE_FRAME_MAX_LENGTH  20
+#define EDDYSTONE_TLM_TEMPERATURE_INVALID ((int16_t)0x8000)
+
+/** Telemetry of TLM frame **/
+typedef struct {
+  uint16_t battery;     //!< mV, 0 if not measured
+  int16_t  temperature; //!< C in 8.8 fixed point, EDDYSTONE_TLM_TEMPERATURE_INVALID if not measured
+  uint32_t adv_count;   //!< Advertisements sent since boot
+  uint32_t uptime;      //!< 0.1 s since boot
+}eddystone_tlm_t;
+
+/**
+ *  Advertisement data prepared by helpers below points to a static frame buffer,
+ *  encode it before preparing the next frame.
+ */
+
 /**
  *  @brief Helper for advertising Eddystone URLs. 
  *
@@ -15,4 +35,30 @@
  */
  ret_code_t eddystone_prepare_url_advertisement(ble_advdata_t* advdata, char* url, size_t length);
 
+/**
+ *  @brief Helper for advertising unencrypted Eddystone TLM.
+ *
+ *  @param advdata Advertisement data which will be filled with Eddystone TLM
+ *  @param tlm telemetry to advertise
+ *  @return Error code, 0 on success
+ */
+ret_code_t eddystone_prepare_tlm_advertisement(ble_advdata_t* advdata, const eddystone_tlm_t* tlm);
+
+/**
+ *  @brief Helper for advertising encrypted Eddystone TLM (eTLM).
+ *
+ *  TLM fields are encrypted with AES-EAX under the ephemeral identity key (EIK) shared with the resolver,
+ *  nonce is the time counter with lowest rotation_exponent bits cleared and a random salt.
+ *  Requires SoftDevice for AES and random numbers, their errors are returned and advdata is not filled then.
+ *
+ *  @param advdata Advertisement data which will be filled with Eddystone eTLM
+ *  @param tlm telemetry to advertise
+ *  @param eik 16-byte ephemeral identity key
+ *  @param time_counter seconds of beacon time base, as in EID frames
+ *  @param rotation_exponent EID rotation period exponent K, 0 ... 15
+ *  @return Error code, 0 on success
+ */
+ret_code_t eddystone_prepare_etlm_advertisement(ble_advdata_t* advdata, const eddystone_tlm_t* tlm,
+                                                const uint8_t* eik, uint32_t time_counter, uint8_t rotation_exponent);
+
 #endif
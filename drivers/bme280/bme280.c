@@ -59,6 +59,9 @@ void timer_bme280_event_handler(void* p_context);
 /** state variable **/
 static uint8_t current_mode = BME280_MODE_SLEEP;
 static uint8_t current_interval = BME280_STANDBY_0_5_MS;
+static uint8_t oversampling_hum   = BME280_OVERSAMPLING_SKIP;
+static uint8_t oversampling_temp  = BME280_OVERSAMPLING_SKIP;
+static uint8_t oversampling_press = BME280_OVERSAMPLING_SKIP;
 
 BME280_Ret bme280_init()
 {
@@ -121,6 +124,16 @@ BME280_Ret bme280_init()
   bme280.cp.dig_H5 |= bme280_read_reg(0xE6) << 4;		// 11:4
 
   bme280.cp.dig_H6  = bme280_read_reg(0xE7);
+
+  // Terms which depend only on calibration, compensation formulas below use them as-is
+  bme280.ct.T1_x2    = (int32_t)bme280.cp.dig_T1 << 1;
+  bme280.ct.P2_x2_12 = (int64_t)bme280.cp.dig_P2 << 12;
+  bme280.ct.P4_x2_35 = (int64_t)bme280.cp.dig_P4 << 35;
+  bme280.ct.P5_x2_17 = (int64_t)bme280.cp.dig_P5 << 17;
+  bme280.ct.P7_x2_4  = (int64_t)bme280.cp.dig_P7 << 4;
+  bme280.ct.P4_x2_16 = (int32_t)bme280.cp.dig_P4 << 16;
+  bme280.ct.P5_x2    = (int32_t)bme280.cp.dig_P5 << 1;
+  bme280.ct.H_offset = 16384 - ((int32_t)bme280.cp.dig_H4 << 20);
  
   return BME280_RET_OK;
 }
@@ -136,7 +149,7 @@ BME280_Ret bme280_set_mode(enum BME280_MODE mode)
   if(!bme280.sensor_available) { return BME280_RET_ERROR;  }
   uint8_t conf, reg;
   
-  BME280_Ret status = BME280_RET_ERROR;
+  BME280_Ret status = BME280_RET_OK;
   reg = bme280_read_reg(BME280REG_CTRL_HUM);
   conf = bme280_read_reg(BME280REG_CTRL_MEAS);
   NRF_LOG_DEBUG("CONFIG before mode: %x\r\n", conf);
@@ -164,7 +177,8 @@ BME280_Ret bme280_set_mode(enum BME280_MODE mode)
       break;
   }
 
-  if(BME280_RET_OK == status) {current_mode = mode;}
+  // Sensor returns to sleep after forced conversion, configuration is allowed between conversions
+  if(BME280_RET_OK == status) { current_mode = (BME280_MODE_FORCED == mode) ? BME280_MODE_SLEEP : mode; }
   return status;
 }
 
@@ -189,6 +203,11 @@ enum BME280_INTERVAL bme280_get_interval(void)
   return current_interval;
 }
 
+enum BME280_MODE bme280_get_mode(void)
+{
+  return (enum BME280_MODE)current_mode;
+}
+
 
 int bme280_is_measuring(void)
 {
@@ -211,6 +230,7 @@ BME280_Ret bme280_set_oversampling_hum(uint8_t os)
   if(BME280_MODE_SLEEP != current_mode){ return BME280_RET_ILLEGAL; }
   uint8_t meas;
   meas = bme280_read_reg(BME280REG_CTRL_MEAS);
+  oversampling_hum = os;
   bme280_write_reg(BME280REG_CTRL_HUM, os);
   return bme280_write_reg(BME280REG_CTRL_MEAS, meas); //Changes to humi take effect after write to meas
 }
@@ -225,6 +245,7 @@ BME280_Ret bme280_set_oversampling_temp(uint8_t os)
   bme280_write_reg(BME280REG_CTRL_HUM, humi);
   meas &= 0b00011111;
   meas |= (os<<5);
+  oversampling_temp = os;
   return bme280_write_reg(BME280REG_CTRL_MEAS, meas);
 }
 
@@ -238,6 +259,7 @@ BME280_Ret bme280_set_oversampling_press(uint8_t os)
   bme280_write_reg(BME280REG_CTRL_HUM, humi);
   meas &= 0b11100011;
   meas |= (os<<2);
+  oversampling_press = os;
   return bme280_write_reg(BME280REG_CTRL_MEAS, meas);
 }
 	
@@ -251,6 +273,24 @@ BME280_Ret bme280_set_iir(uint8_t iir)
    return bme280_write_reg(BME280REG_CONFIG, conf);
 }
 
+/** Oversampling setting to number of samples, 0 for skipped **/
+static uint32_t oversampling_samples(uint8_t os)
+{
+  return (BME280_OVERSAMPLING_SKIP == os) ? 0 : 1 << (os - 1);
+}
+
+/**
+ * Maximum measurement time of datasheet appendix B:
+ * 1.25 ms + 2.3 ms * T + (2.3 ms * P + 0.575 ms) + (2.3 ms * H + 0.575 ms)
+ */
+uint32_t bme280_measurement_time_us(void)
+{
+  uint32_t time = 1250 + 2300 * oversampling_samples(oversampling_temp);
+  if(BME280_OVERSAMPLING_SKIP != oversampling_press) { time += 2300 * oversampling_samples(oversampling_press) + 575; }
+  if(BME280_OVERSAMPLING_SKIP != oversampling_hum)   { time += 2300 * oversampling_samples(oversampling_hum) + 575; }
+  return time;
+}
+
 /**
  * @brief Read new raw values.
  */
@@ -262,29 +302,30 @@ BME280_Ret bme280_read_measurements()
   
   BME280_Ret err_code = bme280_read_burst(BME280REG_PRESS_MSB, BME280_BURST_READ_LENGTH, data);
 
-  bme280.adc_h = data[8] + ((uint32_t)data[7] << 8);
+  bme280.adc_h = data[7] + ((uint32_t)data[6] << 8);
 
-  bme280.adc_t  = (uint32_t) data[6] >> 4;
-  bme280.adc_t |= (uint32_t) data[5] << 4;
-  bme280.adc_t |= (uint32_t) data[4] << 12;
+  bme280.adc_t  = (uint32_t) data[5] >> 4;
+  bme280.adc_t |= (uint32_t) data[4] << 4;
+  bme280.adc_t |= (uint32_t) data[3] << 12;
 
-  bme280.adc_p  = (uint32_t) data[3] >> 4;
-  bme280.adc_p |= (uint32_t) data[2] << 4;
-  bme280.adc_p |= (uint32_t) data[1] << 12;
+  bme280.adc_p  = (uint32_t) data[2] >> 4;
+  bme280.adc_p |= (uint32_t) data[1] << 4;
+  bme280.adc_p |= (uint32_t) data[0] << 12;
 
   return err_code;
 }
 
 
-static uint32_t compensate_P_int64(int32_t adc_P)
+uint32_t bme280_compensate_pressure_int64(int32_t adc_P)
 {
-	int64_t var1, var2, p;
+	int64_t var1, var2, var1_sq, p;
 
 	var1 = ((int64_t)bme280.t_fine) - 128000;
-	var2 = var1 * var1 * (int64_t)bme280.cp.dig_P6;
-	var2 = var2 + ((var1*(int64_t)bme280.cp.dig_P5) << 17);
-	var2 = var2 + (((int64_t)bme280.cp.dig_P4) << 35);
-	var1 = ((var1 * var1 * (int64_t)bme280.cp.dig_P3) >> 8) + ((var1 * (int64_t)bme280.cp.dig_P2) << 12);
+	var1_sq = var1 * var1;
+	var2 = var1_sq * (int64_t)bme280.cp.dig_P6;
+	var2 = var2 + var1 * bme280.ct.P5_x2_17;
+	var2 = var2 + bme280.ct.P4_x2_35;
+	var1 = ((var1_sq * (int64_t)bme280.cp.dig_P3) >> 8) + var1 * bme280.ct.P2_x2_12;
 	var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)bme280.cp.dig_P1) >> 33;
 	if (var1 == 0) {
 		return 0;
@@ -294,19 +335,55 @@ static uint32_t compensate_P_int64(int32_t adc_P)
 	p = (((p << 31) - var2) * 3125) / var1;
 	var1 = (((int64_t)bme280.cp.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
 	var2 = (((int64_t)bme280.cp.dig_P8) * p) >> 19;
-	p = ((p + var1 + var2) >> 8) + (((int64_t)bme280.cp.dig_P7) << 4);
+	p = ((p + var1 + var2) >> 8) + bme280.ct.P7_x2_4;
 
 	return (uint32_t)p;
 }
 
 
+/**
+ * 32-bit formula of datasheet in Pa, returned in Q24.8. One 32-bit division, which Cortex-M4 has in hardware.
+ */
+uint32_t bme280_compensate_pressure_int32(int32_t adc_P)
+{
+	int32_t var1, var2;
+	uint32_t p;
+
+	var1 = (bme280.t_fine >> 1) - (int32_t)64000;
+	var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)bme280.cp.dig_P6);
+	var2 = var2 + var1 * bme280.ct.P5_x2;
+	var2 = (var2 >> 2) + bme280.ct.P4_x2_16;
+	var1 = (((bme280.cp.dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)bme280.cp.dig_P2) * var1) >> 1)) >> 18;
+	var1 = ((((32768 + var1)) * ((int32_t)bme280.cp.dig_P1)) >> 15);
+	if (var1 == 0) {
+		return 0;
+	}
+
+	p = (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
+	if (p < 0x80000000) {
+		p = (p << 1) / ((uint32_t)var1);
+	}
+	else {
+		p = (p / (uint32_t)var1) * 2;
+	}
+	// Correction terms below overflow far out of operating range, raw values there take the 64-bit formula
+	if (p < 30000 || p > 110000) {
+		return bme280_compensate_pressure_int64(adc_P);
+	}
+	var1 = (((int32_t)bme280.cp.dig_P9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+	var2 = (((int32_t)(p >> 2)) * ((int32_t)bme280.cp.dig_P8)) >> 13;
+	p = (uint32_t)((int32_t)p + ((var1 + var2 + bme280.cp.dig_P7) >> 4));
+
+	return p << 8;
+}
+
+
 static uint32_t compensate_H_int32(int32_t adc_H)
 {
 	int32_t v_x1_u32r;
 
 	v_x1_u32r = (bme280.t_fine - ((int32_t)76800));
-	v_x1_u32r = (((((adc_H << 14) - (((int32_t)bme280.cp.dig_H4) << 20) - (((int32_t)bme280.cp.dig_H5) * v_x1_u32r)) +
-		       ((int32_t)16384)) >> 15) * (((((((v_x1_u32r * ((int32_t)bme280.cp.dig_H6)) >> 10) * (((v_x1_u32r * ((int32_t)bme280.cp.dig_H3)) >> 11) +
+	v_x1_u32r = ((((adc_H << 14) + bme280.ct.H_offset - (((int32_t)bme280.cp.dig_H5) * v_x1_u32r)) >> 15) * (((((((v_x1_u32r * ((int32_t)bme280.cp.dig_H6)) >> 10) * (((v_x1_u32r * ((int32_t)bme280.cp.dig_H3)) >> 11) +
 		       ((int32_t)32768))) >> 10) + ((int32_t)2097152)) * ((int32_t)bme280.cp.dig_H2) + 8192) >> 14));
 
 	v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * ((int32_t)bme280.cp.dig_H1)) >> 4));
@@ -322,7 +399,7 @@ static int32_t compensate_T_int32(int32_t adc_T)
 {
 	int32_t var1, var2, T;
 
-	var1 = ((((adc_T>>3) - ((int32_t)bme280.cp.dig_T1<<1))) * 
+	var1 = ((((adc_T>>3) - bme280.ct.T1_x2)) * 
                ((int32_t)bme280.cp.dig_T2)) >> 11;
 	var2 = (((((adc_T>>4) - ((int32_t)bme280.cp.dig_T1)) *
                ((adc_T>>4) - ((int32_t)bme280.cp.dig_T1))) >> 12) * 
@@ -354,7 +431,11 @@ int32_t bme280_get_temperature(void)
  */
 uint32_t bme280_get_pressure(void)
 {
-	uint32_t press = compensate_P_int64(bme280.adc_p);
+#if BME280_PRESSURE_INT32
+	uint32_t press = bme280_compensate_pressure_int32(bme280.adc_p);
+#else
+	uint32_t press = bme280_compensate_pressure_int64(bme280.adc_p);
+#endif
 	return press;
 }
 
@@ -372,34 +453,22 @@ uint32_t bme280_get_humidity(void)
 
 uint8_t bme280_read_reg(uint8_t reg)
 {
-	uint8_t tx[2];
-	uint8_t rx[2] = {0};
-
-	tx[0] = reg | 0x80;
-	tx[1] = 0x00;
-	spi_transfer_bme280(tx, 2, rx);
+	uint8_t rx = 0;
+	spi_read_bme280(reg | 0x80, &rx, 1);
 
-	return rx[1];
+	return rx;
 }
 
 BME280_Ret bme280_read_burst(uint8_t start, uint8_t length, uint8_t* buffer)
 {
-  uint8_t tx[BME280_MAX_READ_LENGTH] = {0};
-
-  tx[0] = start | 0x80;
-
-  return spi_transfer_bme280(tx, length, buffer);
+  // Registers are received in place, buffer[0] is register start
+  return (SPI_RET_OK == spi_read_bme280(start | 0x80, buffer, length)) ? BME280_RET_OK : BME280_RET_ERROR;
 }
 
 
 BME280_Ret bme280_write_reg(uint8_t reg, uint8_t value)
 {
-	uint8_t tx[2];
-	uint8_t rx[2] = {0};
-
-	tx[0] = reg & 0x7F;
-	tx[1] = value;
-	return (SPI_RET_OK == spi_transfer_bme280(tx, 2, rx)) ? BME280_RET_OK : BME280_RET_ERROR;
+	return (SPI_RET_OK == spi_write_bme280(reg & 0x7F, &value, 1)) ? BME280_RET_OK : BME280_RET_ERROR;
 }
 
 
@@ -76,6 +76,18 @@ struct comp_params {
 	int8_t   dig_H6;
 };
 
+/** Products and shifts of calibration data, computed once in bme280_init **/
+struct comp_terms {
+	int32_t  T1_x2;       ///< dig_T1 << 1
+	int64_t  P2_x2_12;    ///< dig_P2 << 12
+	int64_t  P4_x2_35;    ///< dig_P4 << 35
+	int64_t  P5_x2_17;    ///< dig_P5 << 17
+	int64_t  P7_x2_4;     ///< dig_P7 << 4
+	int32_t  P4_x2_16;    ///< dig_P4 << 16, 32-bit pressure
+	int32_t  P5_x2;       ///< dig_P5 << 1, 32-bit pressure
+	int32_t  H_offset;    ///< 16384 - (dig_H4 << 20)
+};
+
 struct bme280_driver {
 	bool sensor_available;
 	int32_t adc_h;		///< RAW humidity
@@ -83,6 +95,7 @@ struct bme280_driver {
 	int32_t adc_p;		///< RAW pressure
 	int32_t t_fine;		///< calibrated temp
 	struct comp_params cp;	///< calibration data
+	struct comp_terms ct;	///< terms of calibration data
 };
 
 extern struct bme280_driver bme280;
@@ -140,8 +153,14 @@ typedef enum
 
 #define BME280_INTERVAL_MASK     (0xE0)
 
-#define BME280_BURST_READ_LENGTH (9) // 8 bytes + address
-#define BME280_MAX_READ_LENGTH BME280_BURST_READ_LENGTH
+#define BME280_BURST_READ_LENGTH (8) // press_msb ... hum_lsb
+
+// 1 to compensate pressure with 32-bit formula of datasheet, 0 for exact 64-bit formula.
+// 32-bit formula has 1 Pa resolution, see bme280_compensate_pressure_int32. It is not faster on host, measure
+// cycles on target with test_environmental of test_drivers before enabling.
+#ifndef BME280_PRESSURE_INT32
+  #define BME280_PRESSURE_INT32 0
+#endif
 
 enum BME280_INTERVAL {
 	BME280_STANDBY_0_5_MS  = 0x0,
@@ -168,6 +187,7 @@ BME280_Ret bme280_init();
  *  - Sleep  (off)
  *  - Forced (one sample, back to sleep) 
  *  - Normal (continuous)
+ * Driver is in sleep mode after forced mode is set, configuration may change between forced conversions.
  */
 BME280_Ret bme280_set_mode(enum BME280_MODE mode);
 
@@ -181,12 +201,21 @@ BME280_Ret bme280_set_interval(enum BME280_INTERVAL interval);
 /** Return current interval **/
 enum BME280_INTERVAL bme280_get_interval(void);
 
+/** Return current mode, BME280_MODE_SLEEP once a forced conversion is started **/
+enum BME280_MODE bme280_get_mode(void);
+
 /**
  *  Return true if measurement is in progress
  */
  
 int  bme280_is_measuring(void);
 
+/**
+ *  Maximum time of one conversion with current oversampling, in microseconds.
+ *  Forced conversion is complete this long after bme280_set_mode(BME280_MODE_FORCED).
+ */
+uint32_t bme280_measurement_time_us(void);
+
 /**
  *  Read measurements from BME280 to nRF52.
  *  You have to call this manually, in normal mode you get latest stored values.
@@ -228,6 +257,16 @@ int32_t  bme280_get_temperature(void);
  */
 uint32_t bme280_get_pressure(void);
 
+/**
+ * Compensate raw pressure with t_fine of latest bme280_get_temperature, Q24.8 Pa like bme280_get_pressure.
+ * 64-bit formula of datasheet has 1/256 Pa resolution. 32-bit formula has 1 Pa resolution, and is within
+ * 8 Pa of the 64-bit formula over the operating range of 300 ... 1100 hPa and -40 ... 85 C, largest near 1100 hPa.
+ * 32-bit formula overflows far out of operating range, raw values outside 300 ... 1100 hPa are compensated with
+ * the 64-bit formula. Relative accuracy of the sensor is 12 Pa.
+ */
+uint32_t bme280_compensate_pressure_int64(int32_t adc_p);
+uint32_t bme280_compensate_pressure_int32(int32_t adc_p);
+
 /**
  * Returns humidity in %RH as unsigned 32 bit integer in Q22.10 format
  * (22 integer and 10 fractional bits).
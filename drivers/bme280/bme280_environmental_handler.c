@@ -0,0 +1,494 @@
+#include "bme280_environmental_handler.h"
+#include "ruuvi_endpoints.h"
+#include "nrf_error.h"
+#include "bme280.h"
+#include "bme280_scheduler.h"
+#include "derived_metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NRF_LOG_MODULE_NAME "BME280_HANDLER"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+/** Endpoint of each scheduler channel **/
+static const ruuvi_endpoint_t m_endpoints[BME280_ENDPOINT_CHANNELS] = { TEMPERATURE, HUMIDITY, PRESSURE, ENVIRONMENTAL,
+                                                                ENVIRONMENTAL_DERIVED };
+
+static message_handler_state_t  m_states[BME280_ENDPOINT_CHANNELS];
+static bme280_data_t            m_latest[BME280_ENDPOINT_CHANNELS]; // Latest sample of each endpoint
+static message_handler_state_t* p_state   = NULL;          // State of endpoint being handled
+static bme280_channel_t         m_channel = BME280_CHANNEL_TEMPERATURE;
+
+/** Oversampling of the sensors of the endpoint being handled, temperature compensates humidity and pressure at 1x **/
+static void set_oversampling(bme280_request_t* request, uint8_t oversampling)
+{
+  request->oversampling_temp  = BME280_OVERSAMPLING_1;
+  request->oversampling_hum   = BME280_OVERSAMPLING_SKIP;
+  request->oversampling_press = BME280_OVERSAMPLING_SKIP;
+  switch(m_channel)
+  {
+    case BME280_CHANNEL_TEMPERATURE:
+      request->oversampling_temp = oversampling;
+      break;
+
+    case BME280_CHANNEL_HUMIDITY:
+      request->oversampling_hum = oversampling;
+      break;
+
+    case BME280_CHANNEL_PRESSURE:
+      request->oversampling_press = oversampling;
+      break;
+
+    default:
+      request->oversampling_temp  = oversampling;
+      request->oversampling_hum   = oversampling;
+      request->oversampling_press = oversampling;
+      break;
+  }
+}
+
+static ret_code_t set_sample_rate(uint8_t sample_rate, bme280_request_t* request)
+{
+  NRF_LOG_DEBUG("Setting sample_rate %d\r\n", sample_rate);
+  if(SAMPLE_RATE_NO_CHANGE == sample_rate) { return ENDPOINT_SUCCESS; }
+  else if(SAMPLE_RATE_STOP == sample_rate) { request->interval_ms = 0; }
+  else if(SAMPLE_RATE_SINGLE == sample_rate)
+  {
+    request->interval_ms = BME280_SCHEDULER_SINGLE;
+    sample_rate = SAMPLE_RATE_STOP; //Sampling stops after one-shot
+  }
+  else if(sample_rate <= 200) { request->interval_ms = 1000 / sample_rate; }
+  else { return ENDPOINT_NOT_SUPPORTED; }
+  p_state->configuration.sample_rate = sample_rate;
+  return ENDPOINT_SUCCESS;
+}
+
+static ret_code_t set_transmission_rate(uint8_t transmission_rate)
+{
+  NRF_LOG_DEBUG("Setting transmission_rate %d\r\n", transmission_rate);
+  switch(transmission_rate)
+  {
+    case TRANSMISSION_RATE_STOP:
+    case TRANSMISSION_RATE_SAMPLERATE:
+      p_state->configuration.transmission_rate = transmission_rate;
+      return ENDPOINT_SUCCESS;
+
+    case TRANSMISSION_RATE_NO_CHANGE:
+      return ENDPOINT_SUCCESS;
+
+    default:
+      return ENDPOINT_NOT_IMPLEMENTED;
+  }
+}
+
+/** Resolution selects oversampling, each step doubles conversion time of the sensor **/
+static ret_code_t set_resolution(uint8_t resolution, bme280_request_t* request)
+{
+  uint8_t oversampling;
+  NRF_LOG_DEBUG("Setting resolution %d\r\n", resolution);
+  switch(resolution)
+  {
+    case RESOLUTION_NO_CHANGE:
+      return ENDPOINT_SUCCESS;
+
+    case RESOLUTION_MIN:
+    case 1:
+      oversampling = BME280_OVERSAMPLING_1;
+      break;
+
+    case 2:
+      oversampling = BME280_OVERSAMPLING_2;
+      break;
+
+    case 4:
+      oversampling = BME280_OVERSAMPLING_4;
+      break;
+
+    case 8:
+      oversampling = BME280_OVERSAMPLING_8;
+      break;
+
+    case RESOLUTION_MAX:
+    case 16:
+      oversampling = BME280_OVERSAMPLING_16;
+      break;
+
+    default:
+      return ENDPOINT_NOT_SUPPORTED;
+  }
+  set_oversampling(request, oversampling);
+  p_state->configuration.resolution = resolution;
+  return ENDPOINT_SUCCESS;
+}
+
+static ret_code_t set_scale(uint8_t scale)
+{
+  // BME280 has only one scale for each sensor, return success on valid value, mark as MAX
+  p_state->configuration.scale = SCALE_MAX;
+  if(SCALE_MIN       == scale) { return ENDPOINT_SUCCESS; }
+  if(SCALE_MAX       == scale) { return ENDPOINT_SUCCESS; }
+  if(SCALE_NO_CHANGE == scale) { return ENDPOINT_SUCCESS; }
+  return ENDPOINT_NOT_SUPPORTED; //Scale cannot be changed, return error
+}
+
+static ret_code_t set_dsp_function(uint8_t dsp_function)
+{
+  if(DSP_LAST == dsp_function)
+  {
+    p_state->configuration.dsp_function = DSP_LAST;
+    return ENDPOINT_SUCCESS;
+  }
+  return ENDPOINT_NOT_IMPLEMENTED; //TODO
+}
+
+static ret_code_t set_dsp_parameter(uint8_t dsp_parameter)
+{
+  p_state->configuration.dsp_parameter = 1;
+  return ENDPOINT_NOT_IMPLEMENTED; //TODO
+}
+
+/**
+ *  Setup targets to which data will be sent.
+ *  Note: Chaining is done separately.
+ */
+static ret_code_t set_target(uint8_t target)
+{
+  NRF_LOG_DEBUG("Setting targets %d\r\n", target);
+  if(TRANSMISSION_TARGET_NO_CHANGE == target) { return ENDPOINT_SUCCESS; }
+
+  //NULL handlers
+  p_state->p_ble_adv_handler = NULL;
+  p_state->p_ble_gatt_handler = NULL;
+  p_state->p_ble_mesh_handler = NULL;
+  p_state->p_proprietary_handler = NULL;
+  p_state->p_nfc_handler = NULL;
+  p_state->p_ram_handler = NULL;
+  p_state->p_flash_handler = NULL;
+  p_state->configuration.target = target;
+  if(TRANSMISSION_TARGET_STOP == target) { return ENDPOINT_SUCCESS; }
+
+  //Resetup handlers
+  if(TRANSMISSION_TARGET_BLE_GATT & target){ p_state->p_ble_gatt_handler = get_ble_gatt_handler(); }
+  if(TRANSMISSION_TARGET_BLE_ADV & target){ p_state->p_ble_adv_handler = get_ble_adv_handler(); }
+  if(TRANSMISSION_TARGET_BLE_MESH & target){ p_state->p_ble_mesh_handler = get_ble_mesh_handler(); }
+  if(TRANSMISSION_TARGET_PROPRIETARY & target){ p_state->p_proprietary_handler = get_proprietary_handler(); }
+  if(TRANSMISSION_TARGET_NFC & target){ p_state->p_nfc_handler = get_nfc_handler(); }
+  if(TRANSMISSION_TARGET_RAM == target){ p_state->p_ram_handler = get_ram_handler(); }
+  if(TRANSMISSION_TARGET_FLASH == target){ p_state->p_flash_handler = get_flash_handler(); }
+
+  return ENDPOINT_SUCCESS;
+}
+
+/** Send transmission to all data endpoints and downstream chain of endpoint being handled **/
+static ret_code_t transmit(const ruuvi_standard_message_t message)
+{
+  ret_code_t err_code = ENDPOINT_SUCCESS;
+  NRF_LOG_DEBUG("Transmitting to all data points\r\n");
+  if(p_state->p_ble_adv_handler)     { err_code |= p_state->p_ble_adv_handler(message); }
+  if(p_state->p_ble_gatt_handler)    { err_code |= p_state->p_ble_gatt_handler(message); }
+  if(p_state->p_proprietary_handler) { err_code |= p_state->p_proprietary_handler(message); }
+  if(p_state->p_nfc_handler)         { err_code |= p_state->p_nfc_handler(message); }
+  if(p_state->p_ram_handler)         { err_code |= p_state->p_ram_handler(message); }
+  if(p_state->p_flash_handler)       { err_code |= p_state->p_flash_handler(message); }
+  if(p_state->p_chain_handler)
+  {
+    ruuvi_standard_message_t chainmsg;
+    memcpy(&chainmsg, &message, sizeof(ruuvi_standard_message_t));
+    chainmsg.destination_endpoint = p_state->downstream_endpoint;
+    err_code |= p_state->p_chain_handler(chainmsg);
+  }
+  return err_code;
+}
+
+static int16_t saturate_int16(uint32_t value)
+{
+  return (value > INT16_MAX) ? INT16_MAX : value;
+}
+
+/** Encode sample of endpoint being handled, see bme280_environmental_handler.h **/
+static ruuvi_standard_message_t encode_sample(const uint8_t destination, const bme280_data_t* const data)
+{
+  ruuvi_standard_message_t message = {.destination_endpoint = destination,
+                                      .source_endpoint      = m_endpoints[m_channel],
+                                      .type                 = INT32,
+                                      .payload              = { 0 }};
+  switch(m_channel)
+  {
+    case BME280_CHANNEL_TEMPERATURE:
+      memcpy(message.payload, &data->temperature, sizeof(data->temperature));
+      break;
+
+    case BME280_CHANNEL_HUMIDITY:
+      message.type = UINT32;
+      memcpy(message.payload, &data->humidity, sizeof(data->humidity));
+      break;
+
+    case BME280_CHANNEL_PRESSURE:
+      message.type = UINT32;
+      memcpy(message.payload, &data->pressure, sizeof(data->pressure));
+      break;
+
+    case BME280_CHANNEL_DERIVED:
+    {
+      // Absolute humidity and deficit saturate only in hot air, above 83 C and 70 C
+      derived_metrics_t metrics;
+      derived_metrics_compute(data->temperature, data->humidity, data->pressure, &metrics);
+      int16_t values[4] = { metrics.dew_point,
+                            saturate_int16(metrics.absolute_humidity),
+                            saturate_int16(metrics.vapour_deficit),
+                            (metrics.altitude + ((metrics.altitude < 0) ? -50 : 50)) / 100 };
+      message.type = INT16;
+      memcpy(message.payload, values, sizeof(message.payload));
+      break;
+    }
+
+    default:
+    {
+      // 100 %RH is 10000, 1100 hPa is 11000
+      int16_t values[4] = { data->temperature,
+                            ((uint64_t)data->humidity * 100 + 512) >> 10,
+                            (data->pressure + 1280) / 2560,
+                            0 };
+      message.type = INT16;
+      memcpy(message.payload, values, sizeof(message.payload));
+      break;
+    }
+  }
+  return message;
+}
+
+/** ASCII sample of endpoint being handled, up to 8 characters without terminator **/
+static ruuvi_standard_message_t encode_ascii(const uint8_t destination, const bme280_data_t* const data)
+{
+  ruuvi_standard_message_t message = {.destination_endpoint = destination,
+                                      .source_endpoint      = m_endpoints[m_channel],
+                                      .type                 = ASCII,
+                                      .payload              = { 0 }};
+  char ascii[16] = {0};
+  switch(m_channel)
+  {
+    case BME280_CHANNEL_TEMPERATURE:
+    {
+      int32_t temperature = data->temperature;
+      uint32_t magnitude  = (temperature < 0) ? -temperature : temperature;
+      snprintf(ascii, sizeof(ascii), "%s%lu.%02lu C", (temperature < 0) ? "-" : "",
+               (unsigned long)magnitude / 100, (unsigned long)magnitude % 100);
+      break;
+    }
+
+    case BME280_CHANNEL_HUMIDITY:
+    {
+      uint32_t humidity = ((uint64_t)data->humidity * 100 + 512) >> 10;
+      snprintf(ascii, sizeof(ascii), "%lu.%02lu %%", (unsigned long)humidity / 100, (unsigned long)humidity % 100);
+      break;
+    }
+
+    default:
+      snprintf(ascii, sizeof(ascii), "%lu Pa", (unsigned long)((data->pressure + 128) >> 8));
+      break;
+  }
+  memcpy(message.payload, ascii, sizeof(message.payload));
+  return message;
+}
+
+static ret_code_t configure_sensor(const ruuvi_standard_message_t message)
+{
+  NRF_LOG_DEBUG("Configuring sensor:");
+  NRF_LOG_HEXDUMP_DEBUG((uint8_t*)&(message.destination_endpoint), sizeof(message));
+  NRF_LOG_DEBUG("\r\n");
+
+  //Return codes are truncated to 8 bits.
+  ruuvi_sensor_configuration_t result = {0};
+  ruuvi_sensor_configuration_t* payload = (void*)&(message.payload[0]);
+  bme280_request_t request, previous;
+  bme280_scheduler_request_get(m_channel, &previous);
+  request = previous;
+  result.transmission_rate = set_transmission_rate(payload->transmission_rate);
+  result.resolution        = set_resolution(payload->resolution, &request);
+  result.scale             = set_scale(payload->scale);
+  result.dsp_function      = set_dsp_function(payload->dsp_function);
+  result.dsp_parameter     = set_dsp_parameter(payload->dsp_parameter);
+  result.target            = set_target(message.payload[6]);
+  result.sample_rate       = set_sample_rate(payload->sample_rate, &request);
+  // Unchanged request keeps phase of the endpoint
+  if(memcmp(&request, &previous, sizeof(request)) &&
+     BME280_RET_OK != bme280_scheduler_request(m_channel, &request))
+  {
+    result.sample_rate |= ENDPOINT_HANDLER_ERROR;
+  }
+
+  //Store endpoint request came from, even if message will not be processed due to error (TODO?)
+  p_state->destination_endpoint = message.source_endpoint;
+
+  ruuvi_standard_message_t reply = { .destination_endpoint = message.source_endpoint,
+                                     .source_endpoint      = message.destination_endpoint,
+                                     .type                 = ACKNOWLEDGEMENT,
+                                     .payload              = { 0 }};
+  memcpy(reply.payload, &result, sizeof(reply.payload));
+  //Return error if cannot reply
+  ret_code_t err_code = ENDPOINT_HANDLER_ERROR;
+  message_handler p_reply_handler = get_reply_handler();
+  if(p_reply_handler)
+  {
+    NRF_LOG_DEBUG("Sending reply from configuration\r\n");
+    err_code = p_reply_handler(reply);
+  }
+  return err_code; //Error codes from configuration are in payload of reply
+}
+
+/** Transmit latest sample of the endpoint **/
+static ret_code_t read_sensor(const ruuvi_standard_message_t message)
+{
+  const bme280_data_t* data = &m_latest[m_channel];
+  // Plaintext reply if message came from PLAINTEXT endpoint
+  if(PLAINTEXT_MESSAGE == message.source_endpoint && BME280_CHANNEL_PRESSURE >= m_channel)
+  {
+    return transmit(encode_ascii(message.source_endpoint, data));
+  }
+  return transmit(encode_sample(message.source_endpoint, data));
+}
+
+/**
+ *  Reply with current configuration and scheduler counters: conversions, samples of all endpoints
+ */
+static ret_code_t query_sensor(const ruuvi_standard_message_t message)
+{
+  message_handler p_reply_handler = get_reply_handler();
+  if(!p_reply_handler) { return ENDPOINT_HANDLER_ERROR; }
+  ruuvi_standard_message_t reply = { .destination_endpoint = message.source_endpoint,
+                                     .source_endpoint      = message.destination_endpoint,
+                                     .type                 = SENSOR_CONFIGURATION,
+                                     .payload              = { 0 }};
+  memcpy(reply.payload, &p_state->configuration, sizeof(reply.payload));
+  ret_code_t err_code = p_reply_handler(reply);
+
+  bme280_scheduler_statistics_t statistics;
+  bme280_scheduler_statistics_get(&statistics);
+  err_code |= reply_uint32(p_reply_handler, &reply, statistics.conversions, statistics.samples);
+  return err_code;
+}
+
+/**
+ *  Copy function pointer address to which to send the data to be chained
+ */
+static ret_code_t configure_chain_downstream(const ruuvi_standard_message_t message)
+{
+  ret_code_t err_code = ENDPOINT_SUCCESS;
+  ruuvi_chain_configuration_t* config = (void*)&message.payload;
+  // Stop transmitting if transmission rate is 0
+  if(TRANSMISSION_RATE_STOP == config->transmission_rate)
+  {
+    p_state->downstream_endpoint = 0;
+    p_state->p_chain_handler = NULL;
+  }
+  else
+  {
+    p_state->p_chain_handler      = get_chain_handler();
+    p_state->downstream_endpoint  = message.source_endpoint;
+  }
+
+  //Reply via reply handler if applicable
+  message_handler p_reply_handler = get_reply_handler();
+  if(p_reply_handler)
+  {
+    ruuvi_standard_message_t reply = { .destination_endpoint = message.source_endpoint,
+                                       .source_endpoint      = message.destination_endpoint,
+                                       .type                 = ACKNOWLEDGEMENT,
+                                       .payload              = { 0 }};
+    NRF_LOG_DEBUG("Sending reply after configuring Downstream Endpoint %d\r\n", p_state->downstream_endpoint);
+    err_code = p_reply_handler(reply);
+  }
+  return err_code;
+}
+
+/** Store and transmit sample of a scheduler channel **/
+static void sample_handler(const bme280_channel_t channel, const bme280_data_t* const data)
+{
+  m_channel = channel;
+  p_state   = &m_states[channel];
+  m_latest[channel] = *data;
+  if(TRANSMISSION_RATE_SAMPLERATE == p_state->configuration.transmission_rate)
+  {
+    transmit(encode_sample(p_state->destination_endpoint, data));
+  }
+}
+
+/** Handle message to endpoint of given channel **/
+static ret_code_t handle(const ruuvi_standard_message_t message, const bme280_channel_t channel)
+{
+  //Return if message was not meant for this endpoint.
+  NRF_LOG_DEBUG("Message type is %d\r\n", message.type);
+  if(m_endpoints[channel] != message.destination_endpoint){ return ENDPOINT_INVALID; }
+  m_channel = channel;
+  p_state   = &m_states[channel];
+  switch(message.type)
+  {
+    case SENSOR_CONFIGURATION:
+      NRF_LOG_DEBUG("Configuring\r\n");
+      return configure_sensor(message);
+
+    case STATUS_QUERY:
+      return query_sensor(message);
+
+    case DATA_QUERY:
+      NRF_LOG_DEBUG("Querying\r\n");
+      return read_sensor(message);
+
+    case CHAIN_DOWNSTREAM_CONFIGURATION:
+      // Chain channels process INT16 samples
+      if(BME280_CHANNEL_ENVIRONMENTAL != channel && BME280_CHANNEL_DERIVED != channel) { return unknown_handler(message); }
+      NRF_LOG_INFO("Setting up message chain\r\n");
+      return configure_chain_downstream(message);
+
+    case CHAIN_UPSTREAM_CONFIGURATION:
+      NRF_LOG_ERROR("Sensor cannot be upstream target\r\n");
+      return ENDPOINT_INVALID;
+
+    default:
+      return unknown_handler(message);
+  }
+  return ENDPOINT_HANDLER_ERROR; // Should not be reached
+}
+
+ret_code_t bme280_environmental_handler_init(void)
+{
+  memset(m_states, 0, sizeof(m_states));
+  memset(m_latest, 0, sizeof(m_latest));
+  BME280_Ret err_code = bme280_scheduler_init(sample_handler);
+  // Endpoints are stopped at 1x oversampling until configured
+  for(size_t ii = 0; ii < BME280_ENDPOINT_CHANNELS; ii++)
+  {
+    bme280_request_t request = { 0 };
+    m_channel = ii;
+    set_oversampling(&request, BME280_OVERSAMPLING_1);
+    err_code |= bme280_scheduler_request(m_channel, &request);
+  }
+  return (BME280_RET_OK == err_code) ? NRF_SUCCESS : NRF_ERROR_INTERNAL;
+}
+
+ret_code_t bme280_temperature_handler(const ruuvi_standard_message_t message)
+{
+  return handle(message, BME280_CHANNEL_TEMPERATURE);
+}
+
+ret_code_t bme280_humidity_handler(const ruuvi_standard_message_t message)
+{
+  return handle(message, BME280_CHANNEL_HUMIDITY);
+}
+
+ret_code_t bme280_pressure_handler(const ruuvi_standard_message_t message)
+{
+  return handle(message, BME280_CHANNEL_PRESSURE);
+}
+
+ret_code_t bme280_environmental_handler(const ruuvi_standard_message_t message)
+{
+  return handle(message, BME280_CHANNEL_ENVIRONMENTAL);
+}
+
+ret_code_t bme280_environmental_derived_handler(const ruuvi_standard_message_t message)
+{
+  return handle(message, BME280_CHANNEL_DERIVED);
+}
@@ -0,0 +1,54 @@
+#ifndef BME280_ENVIRONMENTAL_HANDLER_H
+#define BME280_ENVIRONMENTAL_HANDLER_H
+
+/**
+ *  TEMPERATURE, HUMIDITY, PRESSURE, ENVIRONMENTAL and ENVIRONMENTAL_DERIVED endpoints of BME280.
+ *
+ *  Every endpoint is configured on its own with SENSOR_CONFIGURATION and samples at its own rate,
+ *  bme280_scheduler merges the rates into shared forced conversions, see bme280_scheduler.h.
+ *    sample_rate:       Hz, 1 ... 200. SAMPLE_RATE_SINGLE samples once, SAMPLE_RATE_STOP stops
+ *    transmission_rate: TRANSMISSION_RATE_SAMPLERATE transmits every sample, TRANSMISSION_RATE_STOP none
+ *    resolution:        oversampling 1, 2, 4, 8 or 16 of the sensors of the endpoint, RESOLUTION_MIN is 1
+ *                       and RESOLUTION_MAX is 16. Humidity and pressure measure temperature at 1x
+ *    scale:             fixed, SCALE_MIN and SCALE_MAX are accepted
+ *    dsp_function:      DSP_LAST
+ *
+ *  Samples are little endian:
+ *    TEMPERATURE    INT32, 0.01 C
+ *    HUMIDITY       UINT32, Q22.10 %RH
+ *    PRESSURE       UINT32, Q24.8 Pa
+ *    ENVIRONMENTAL  INT16, temperature 0.01 C, humidity 0.01 %RH, pressure 0.1 hPa, 0
+ *    ENVIRONMENTAL_DERIVED  INT16, dew point 0.01 C, absolute humidity 0.01 g/m^3, vapour-pressure deficit Pa,
+ *                   pressure altitude m. Computed by derived_metrics.h, values over INT16_MAX saturate
+ *  ENVIRONMENTAL and ENVIRONMENTAL_DERIVED can be upstream of chain channels, which take INT16 samples,
+ *  e.g. a chain channel of ENVIRONMENTAL_DERIVED gives standard deviation of dew point on the tag.
+ *  DATA_QUERY transmits latest sample of the endpoint, as ASCII if the query came from PLAINTEXT_MESSAGE.
+ */
+
+#include "ruuvi_endpoints.h"
+#include "nrf_error.h"
+
+/** Create scheduler, call after bme280_init **/
+ret_code_t bme280_environmental_handler_init(void);
+
+/**
+ *  Handle messages to the endpoint. These should not be called directly, but rather
+ *  through ruuvi_endpoints function route_message.
+ *
+ *  Usage:
+ *  ruuvi_standard_message_t start = {.destination_endpoint = HUMIDITY,
+ *                                    .source_endpoint      = 0x60,
+ *                                    .type                 = SENSOR_CONFIGURATION,
+ *                                    .payload              = {1, TRANSMISSION_RATE_SAMPLERATE, 4, SCALE_NO_CHANGE,
+ *                                                             DSP_LAST, 0, TRANSMISSION_TARGET_BLE_GATT, 0}};
+ *  route_message(start); // Humidity at 1 Hz with 4x oversampling to BLE GATT
+ *
+ *  Returns error code from endpoint, i.e. ENDPOINT_SUCCESS if message was understood.
+ */
+ret_code_t bme280_temperature_handler(const ruuvi_standard_message_t message);
+ret_code_t bme280_humidity_handler(const ruuvi_standard_message_t message);
+ret_code_t bme280_pressure_handler(const ruuvi_standard_message_t message);
+ret_code_t bme280_environmental_handler(const ruuvi_standard_message_t message);
+ret_code_t bme280_environmental_derived_handler(const ruuvi_standard_message_t message);
+
+#endif
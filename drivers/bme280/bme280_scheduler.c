@@ -0,0 +1,278 @@
+#include "bme280_scheduler.h"
+
+#include <string.h>
+
+#include "app_timer.h"
+#include "init.h" // APP_TIMER_PRESCALER
+
+#define NRF_LOG_MODULE_NAME "BME280_SCHEDULER"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+APP_TIMER_DEF(scheduler_timer_id);
+
+typedef struct {
+  bme280_request_t request;
+  bool             active;
+  int32_t          remaining; // Ticks until due, negative if late
+}channel_state_t;
+
+static channel_state_t               m_channels[BME280_CHANNELS];
+static bme280_sample_handler_t       p_sample_handler = NULL;
+static bme280_sample_handler_t       p_application_handler = NULL;
+static bme280_scheduler_statistics_t m_statistics     = {0};
+static uint32_t                      m_last_ticks     = 0;
+static bool                          m_converting     = false;
+static bool                          m_timer_created  = false;
+static uint8_t                       m_joined         = 0; // Bit per channel in running conversion
+
+// Oversampling written to sensor, written again only if it changes. UINT8_MAX is unknown
+static uint8_t m_oversampling_temp  = UINT8_MAX;
+static uint8_t m_oversampling_hum   = UINT8_MAX;
+static uint8_t m_oversampling_press = UINT8_MAX;
+static bool    m_invalidated        = false; // Sensor configured elsewhere, drop the above at next conversion
+
+static int32_t interval_ticks(const channel_state_t* const channel)
+{
+  return APP_TIMER_TICKS(channel->request.interval_ms, APP_TIMER_PRESCALER);
+}
+
+static bool is_single(const channel_state_t* const channel)
+{
+  return BME280_SCHEDULER_SINGLE == channel->request.interval_ms;
+}
+
+/** Move time of channels forward to current RTC tick **/
+static void advance(void)
+{
+  uint32_t now, elapsed;
+  app_timer_cnt_get(&now);
+  app_timer_cnt_diff_compute(now, m_last_ticks, &elapsed);
+  m_last_ticks = now;
+  for(size_t ii = 0; ii < BME280_CHANNELS; ii++)
+  {
+    if(m_channels[ii].active) { m_channels[ii].remaining -= (int32_t)elapsed; }
+  }
+}
+
+/** Earliest due time of active channels, INT32_MAX if none is active **/
+static int32_t next_due(void)
+{
+  int32_t remaining = INT32_MAX;
+  for(size_t ii = 0; ii < BME280_CHANNELS; ii++)
+  {
+    if(m_channels[ii].active && m_channels[ii].remaining < remaining) { remaining = m_channels[ii].remaining; }
+  }
+  return remaining;
+}
+
+/** Start timer towards next conversion. Running conversion reschedules when it completes **/
+static void schedule(void)
+{
+  if(m_converting || !m_timer_created) { return; }
+  app_timer_stop(scheduler_timer_id);
+  advance();
+  int32_t remaining = next_due();
+  if(INT32_MAX == remaining) { return; }
+  if(remaining < APP_TIMER_MIN_TIMEOUT_TICKS) { remaining = APP_TIMER_MIN_TIMEOUT_TICKS; }
+  app_timer_start(scheduler_timer_id, remaining, NULL);
+}
+
+static uint8_t max_oversampling(uint8_t a, uint8_t b)
+{
+  return (a > b) ? a : b;
+}
+
+/** Write oversampling which differs from the previous conversion, sensor is in sleep between conversions **/
+static BME280_Ret configure(uint8_t oversampling_temp, uint8_t oversampling_hum, uint8_t oversampling_press)
+{
+  BME280_Ret err_code = BME280_RET_OK;
+  if(oversampling_hum != m_oversampling_hum)
+  {
+    err_code |= bme280_set_oversampling_hum(oversampling_hum);
+    m_oversampling_hum = oversampling_hum;
+  }
+  if(oversampling_temp != m_oversampling_temp)
+  {
+    err_code |= bme280_set_oversampling_temp(oversampling_temp);
+    m_oversampling_temp = oversampling_temp;
+  }
+  if(oversampling_press != m_oversampling_press)
+  {
+    err_code |= bme280_set_oversampling_press(oversampling_press);
+    m_oversampling_press = oversampling_press;
+  }
+  return err_code;
+}
+
+/** Pass data of a conversion to joined channels, NULL if it failed. Single conversions are done either way **/
+static void deliver(uint8_t joined, const bme280_data_t* const data)
+{
+  for(size_t ii = 0; ii < BME280_CHANNELS; ii++)
+  {
+    if(!(joined & (1 << ii))) { continue; }
+    if(is_single(&m_channels[ii]))
+    {
+      m_channels[ii].active = false;
+      m_channels[ii].request.interval_ms = 0;
+    }
+    if(BME280_CHANNEL_APPLICATION == ii)
+    {
+      if(p_application_handler) { p_application_handler((bme280_channel_t)ii, data); }
+    }
+    else if(data && p_sample_handler) { p_sample_handler((bme280_channel_t)ii, data); }
+    if(data) { m_statistics.samples++; }
+  }
+  schedule();
+}
+
+static void start_conversion(void)
+{
+  advance();
+  // Temperature is needed to compensate the others
+  uint8_t oversampling_temp  = BME280_OVERSAMPLING_1;
+  uint8_t oversampling_hum   = BME280_OVERSAMPLING_SKIP;
+  uint8_t oversampling_press = BME280_OVERSAMPLING_SKIP;
+  m_joined = 0;
+  for(size_t ii = 0; ii < BME280_CHANNELS; ii++)
+  {
+    channel_state_t* channel = &m_channels[ii];
+    if(!channel->active) { continue; }
+    if(!is_single(channel) && channel->remaining > interval_ticks(channel) / 4) { continue; }
+    m_joined |= 1 << ii;
+    oversampling_temp  = max_oversampling(oversampling_temp,  channel->request.oversampling_temp);
+    oversampling_hum   = max_oversampling(oversampling_hum,   channel->request.oversampling_hum);
+    oversampling_press = max_oversampling(oversampling_press, channel->request.oversampling_press);
+    // Keep long-term rate, but do not try to catch up conversions which could not be done in time
+    if(!is_single(channel)) { channel->remaining += interval_ticks(channel); }
+    if(channel->remaining < 0) { channel->remaining = 0; }
+  }
+  if(!m_joined) { schedule(); return; }
+
+  if(m_invalidated)
+  {
+    m_oversampling_temp = m_oversampling_hum = m_oversampling_press = UINT8_MAX;
+    m_invalidated = false;
+  }
+  BME280_Ret err_code = BME280_RET_OK;
+  // Oversampling can be written only in sleep mode, application resumes normal mode when scheduler is idle
+  if(BME280_MODE_NORMAL == bme280_get_mode()) { err_code |= bme280_set_mode(BME280_MODE_SLEEP); }
+  if(BME280_RET_OK == err_code) { err_code |= configure(oversampling_temp, oversampling_hum, oversampling_press); }
+  if(BME280_RET_OK == err_code) { err_code |= bme280_set_mode(BME280_MODE_FORCED); }
+  if(BME280_RET_OK != err_code)
+  {
+    NRF_LOG_ERROR("Conversion not started: %d\r\n", err_code);
+    // Written oversampling is unknown, write all of it next time
+    m_oversampling_temp = m_oversampling_hum = m_oversampling_press = UINT8_MAX;
+    m_statistics.errors++;
+    uint8_t joined = m_joined;
+    m_joined = 0;
+    deliver(joined, NULL);
+    return;
+  }
+  m_statistics.conversions++;
+  m_converting = true;
+  uint32_t timeout = APP_TIMER_TICKS((bme280_measurement_time_us() + 999) / 1000, APP_TIMER_PRESCALER);
+  if(timeout < APP_TIMER_MIN_TIMEOUT_TICKS) { timeout = APP_TIMER_MIN_TIMEOUT_TICKS; }
+  app_timer_start(scheduler_timer_id, timeout, NULL);
+}
+
+/** Read conversion once and pass it to all joined channels **/
+static void complete_conversion(void)
+{
+  m_converting = false;
+  bme280_data_t data = {0};
+  BME280_Ret err_code = bme280_read_measurements();
+  if(BME280_RET_OK == err_code)
+  {
+    // Temperature first, it updates t_fine for the others
+    data.temperature = bme280_get_temperature();
+    if(BME280_OVERSAMPLING_SKIP != m_oversampling_press) { data.pressure = bme280_get_pressure(); }
+    if(BME280_OVERSAMPLING_SKIP != m_oversampling_hum)   { data.humidity = bme280_get_humidity(); }
+  }
+  else { m_statistics.errors++; }
+
+  uint8_t joined = m_joined;
+  m_joined = 0;
+  deliver(joined, (BME280_RET_OK == err_code) ? &data : NULL);
+}
+
+static void scheduler_timeout_handler(void* p_context)
+{
+  if(m_converting) { complete_conversion(); }
+  else { start_conversion(); }
+}
+
+BME280_Ret bme280_scheduler_init(bme280_sample_handler_t handler)
+{
+  memset(m_channels, 0, sizeof(m_channels));
+  memset(&m_statistics, 0, sizeof(m_statistics));
+  p_sample_handler = handler;
+  p_application_handler = NULL;
+  m_converting = false;
+  m_joined     = 0;
+  m_oversampling_temp = m_oversampling_hum = m_oversampling_press = UINT8_MAX;
+  m_invalidated = false;
+  return BME280_RET_OK;
+}
+
+BME280_Ret bme280_scheduler_request(const bme280_channel_t channel, const bme280_request_t* const request)
+{
+  if(NULL == request) { return BME280_RET_NULL; }
+  if(channel >= BME280_CHANNELS) { return BME280_RET_ILLEGAL; }
+  if(request->oversampling_temp  > BME280_OVERSAMPLING_16 ||
+     request->oversampling_hum   > BME280_OVERSAMPLING_16 ||
+     request->oversampling_press > BME280_OVERSAMPLING_16) { return BME280_RET_ILLEGAL; }
+  if(request->interval_ms && !bme280.sensor_available) { return BME280_RET_ERROR; }
+  // Timer is created on first use, sensors are initialized before app timer on some applications
+  if(request->interval_ms && !m_timer_created)
+  {
+    if(NRF_SUCCESS != app_timer_create(&scheduler_timer_id, APP_TIMER_MODE_SINGLE_SHOT, scheduler_timeout_handler))
+    {
+      return BME280_RET_ERROR;
+    }
+    m_timer_created = true;
+  }
+
+  advance();
+  channel_state_t* state = &m_channels[channel];
+  state->active = false;
+  state->request = *request;
+  if(request->interval_ms)
+  {
+    // Align to the next conversion of running channels
+    int32_t remaining = next_due();
+    state->remaining = (INT32_MAX == remaining || remaining < 0) ? 0 : remaining;
+    state->active = true;
+  }
+  NRF_LOG_DEBUG("Channel %d interval %d ms\r\n", channel, request->interval_ms);
+  schedule();
+  return BME280_RET_OK;
+}
+
+void bme280_scheduler_request_get(const bme280_channel_t channel, bme280_request_t* const request)
+{
+  if(NULL == request || channel >= BME280_CHANNELS) { return; }
+  *request = m_channels[channel].request;
+}
+
+void bme280_scheduler_statistics_get(bme280_scheduler_statistics_t* const statistics)
+{
+  if(NULL == statistics) { return; }
+  *statistics = m_statistics;
+}
+
+void bme280_scheduler_set_application_handler(bme280_sample_handler_t handler)
+{
+  p_application_handler = handler;
+}
+
+void bme280_scheduler_invalidate(void)
+{
+  m_invalidated = true;
+}
+
+bool bme280_scheduler_is_idle(void)
+{
+  return !m_converting && INT32_MAX == next_due();
+}
@@ -0,0 +1,103 @@
+#ifndef BME280_SCHEDULER_H
+#define BME280_SCHEDULER_H
+
+/**
+ *  Shared sampling of BME280 for several endpoints.
+ *
+ *  Each channel, i.e. TEMPERATURE, HUMIDITY, PRESSURE, ENVIRONMENTAL and ENVIRONMENTAL_DERIVED endpoint and
+ *  the samples of the application, requests its own interval and oversampling. Scheduler runs the sensor in forced mode and merges the requests
+ *  into as few conversions as possible:
+ *    - A conversion starts when the earliest channel is due. Every channel due within a quarter of its
+ *      interval joins the conversion, so channels at harmonic rates share all conversions of the slower one.
+ *    - Oversampling of a conversion is the largest one requested by the joining channels for each sensor.
+ *      Sensors no joining channel needs are skipped, temperature is always measured for compensation.
+ *    - A new channel is aligned to the next pending conversion of running channels.
+ *  Conversion is read with one burst read after bme280_measurement_time_us and compensated once,
+ *  the same data is passed to the handler of every joining channel.
+ *
+ *  Intervals keep their long-term rate, a channel which joined early is due one interval after its
+ *  previous due time. Conversion which lasts longer than an interval delays the next one, i.e. 16x
+ *  oversampling of all sensors limits sample rate to about 8 Hz.
+ *  IIR filter is left as configured, it is meant for a single stream of conversions and should be off
+ *  while channels of different intervals run.
+ *
+ *  Scheduler keeps the oversampling it wrote and writes only settings which change between conversions.
+ *  Direct bme280_set_mode and bme280_set_oversampling_* calls are not allowed while channels run, application
+ *  samples through BME280_CHANNEL_APPLICATION instead so that its oversampling is merged with the endpoints.
+ *  Application which configures the sensor directly, e.g. IIR at tag mode change, calls
+ *  bme280_scheduler_invalidate afterwards. Sensor left in normal mode is put to sleep before the next conversion,
+ *  application may resume normal mode once bme280_scheduler_is_idle.
+ *
+ *  Timeouts run in scheduler context (APP_TIMER_APPSH_INIT), handler may transmit data.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bme280.h"
+
+typedef enum {
+  BME280_CHANNEL_TEMPERATURE   = 0,
+  BME280_CHANNEL_HUMIDITY      = 1,
+  BME280_CHANNEL_PRESSURE      = 2,
+  BME280_CHANNEL_ENVIRONMENTAL = 3,
+  BME280_CHANNEL_DERIVED       = 4,
+  BME280_ENDPOINT_CHANNELS     = 5, // Channels above belong to bme280_environmental_handler.h
+  BME280_CHANNEL_APPLICATION   = 5, // Samples of the application, i.e. advertisements
+  BME280_CHANNELS              = 6
+}bme280_channel_t;
+
+#define BME280_SCHEDULER_SINGLE UINT32_MAX // Interval of one conversion as soon as possible, channel stops after it
+
+/** Request of a channel. Oversampling is BME280_OVERSAMPLING_SKIP ... BME280_OVERSAMPLING_16 **/
+typedef struct {
+  uint32_t interval_ms;         //!< 0 to stop, BME280_SCHEDULER_SINGLE for one conversion
+  uint8_t  oversampling_temp;
+  uint8_t  oversampling_hum;
+  uint8_t  oversampling_press;
+}bme280_request_t;
+
+/** Counters since bme280_scheduler_init **/
+typedef struct {
+  uint32_t conversions; //!< Forced conversions started
+  uint32_t samples;     //!< Samples passed to channels, samples / conversions is the sharing ratio
+  uint32_t errors;      //!< Conversions which could not be started or read
+}bme280_scheduler_statistics_t;
+
+/**
+ *  Called once per joining channel with compensated data of a conversion.
+ *  Application handler is called with NULL data if the conversion failed, endpoint handler is not called then.
+ */
+typedef void(*bme280_sample_handler_t)(const bme280_channel_t channel, const bme280_data_t* const data);
+
+/**
+ *  Stop all channels. Timer is created by the first request which starts a channel, after app_timer_init.
+ *  Handler gets samples of endpoint channels, application handler is cleared.
+ */
+BME280_Ret bme280_scheduler_init(bme280_sample_handler_t handler);
+
+/** Set handler of BME280_CHANNEL_APPLICATION samples, call after bme280_scheduler_init **/
+void bme280_scheduler_set_application_handler(bme280_sample_handler_t handler);
+
+/**
+ *  Replace request of a channel. Takes effect at next conversion, a running conversion is not disturbed.
+ *
+ *  @return BME280_RET_ILLEGAL on invalid channel or oversampling, BME280_RET_ERROR if sensor is not available
+ */
+BME280_Ret bme280_scheduler_request(const bme280_channel_t channel, const bme280_request_t* const request);
+
+/** Copy current request of a channel **/
+void bme280_scheduler_request_get(const bme280_channel_t channel, bme280_request_t* const request);
+
+/** Copy counters **/
+void bme280_scheduler_statistics_get(bme280_scheduler_statistics_t* const statistics);
+
+/**
+ *  Sensor was configured outside the scheduler, write all oversampling again at next conversion.
+ *  Running conversion is read as it was requested.
+ */
+void bme280_scheduler_invalidate(void);
+
+/** True if no channel is active and no conversion is running, i.e. sensor may be run in normal mode **/
+bool bme280_scheduler_is_idle(void);
+
+#endif
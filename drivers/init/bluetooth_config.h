@@ -20,7 +20,11 @@
 #define IS_SRVC_CHANGED_CHARACT_PRESENT 1                                 /**< Include the service changed characteristic. If not enabled, the server's database cannot be changed for the lifetime of the device. */
 
 #define CENTRAL_LINK_COUNT              0                                 /**< Number of central links used by the application. When changing this number remember to adjust the RAM settings*/
+#ifndef APPLICATION_PERIPHERAL_LINK_COUNT
 #define PERIPHERAL_LINK_COUNT           1                                 /**< Number of peripheral links used by the application. When changing this number remember to adjust the RAM settings*/
+#else
+#define PERIPHERAL_LINK_COUNT           APPLICATION_PERIPHERAL_LINK_COUNT /**< Simultaneous centrals, every link needs RAM for the SoftDevice and for its queues in ble_bulk_transfer */
+#endif
 
 #define APP_CFG_NON_CONN_ADV_TIMEOUT    0                                 /**< Time for which the device must be advertising in non-connectable mode (in seconds). 0 disables the time-out. */
 
@@ -28,8 +32,34 @@
 
 #define BLE_TX_POWER                    APP_TX_POWER                                 /** dBm **/
 
+// Application may allow larger ATT MTU, up to 247. Larger MTU requires more RAM for the softdevice,
+// adjust RAM start in linker script according to softdevice_enable log.
+#ifndef APPLICATION_BLE_MAX_MTU_SIZE
+#define APPLICATION_BLE_MAX_MTU_SIZE    GATT_MTU_SIZE_DEFAULT
+#endif
+
+// Pack several standard messages into each notification when MTU allows, see ruuvi_message_frame.h.
+// Receiver must understand frames, so application enables packing explicitly.
+#ifndef APPLICATION_BLE_STD_PACKING
+#define APPLICATION_BLE_STD_PACKING     0
+#endif
+
+// Receiver acknowledges bulk transfers and sender retransmits missing chunks, see ble_bulk_transfer.h.
+// Receiver must answer polls, so application enables acknowledgements explicitly.
+#ifndef APPLICATION_BLE_BULK_ACK
+#define APPLICATION_BLE_BULK_ACK        0
+#endif
+
+// Scan for RAWv2 advertisements of neighbours and re-advertise them, see ble_relay.h.
+// Application reserves an advertising scheduler frame for relay and enables it explicitly.
+#ifndef APPLICATION_BLE_RELAY
+#define APPLICATION_BLE_RELAY           0
+#endif
+
 #if (NRF_SD_BLE_API_VERSION == 3)
-#define NRF_BLE_MAX_MTU_SIZE            GATT_MTU_SIZE_DEFAULT                       /**< MTU size used in the softdevice enabling and to reply to a BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST event. */
+#define NRF_BLE_MAX_MTU_SIZE            APPLICATION_BLE_MAX_MTU_SIZE                /**< MTU size used in the softdevice enabling and to reply to a BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST event. */
+#else
+#define NRF_BLE_MAX_MTU_SIZE            GATT_MTU_SIZE_DEFAULT
 #endif
 
 #define APP_FEATURE_NOT_SUPPORTED       BLE_GATT_STATUS_ATTERR_APP_BEGIN + 2        /**< Reply when unsupported features are requested. */
@@ -41,6 +71,9 @@
 
 #define MIN_CONN_INTERVAL               MSEC_TO_UNITS(20, UNIT_1_25_MS)             /**< Minimum acceptable connection interval (20 ms), Connection interval uses 1.25 ms units. */
 #define MAX_CONN_INTERVAL               MSEC_TO_UNITS(75, UNIT_1_25_MS)             /**< Maximum acceptable connection interval (75 ms), Connection interval uses 1.25 ms units. */
+#define FAST_MIN_CONN_INTERVAL          MSEC_TO_UNITS(15, UNIT_1_25_MS)             /**< Minimum connection interval while transferring data (15 ms). */
+#define FAST_MAX_CONN_INTERVAL          MSEC_TO_UNITS(30, UNIT_1_25_MS)             /**< Maximum connection interval while transferring data (30 ms). */
+#define TRANSFER_IDLE_TIMEOUT           APP_TIMER_TICKS(2000, RUUVITAG_APP_TIMER_PRESCALER) /**< Time after last transfer before connection interval is relaxed again (2 seconds). */
 #define SLAVE_LATENCY                   0                                           /**< Slave latency. */
 #define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             /**< Connection supervisory timeout (4 seconds), Supervision Timeout uses 10 ms units. */
 #define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000,  RUUVITAG_APP_TIMER_PRESCALER)  /**< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5 seconds). */
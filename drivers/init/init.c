@@ -21,10 +21,12 @@
 #include "bme280.h"
 #include "battery.h"
 #include "ble_bulk_transfer.h"
+#include "ble_diagnostics.h"
 #include "bluetooth_core.h"
-#include "bme280_temperature_handler.h"
+#include "bme280_environmental_handler.h"
 #include "lis2dh12.h"
 #include "lis2dh12_acceleration_handler.h"
+#include "lis2dh12_event_handler.h"
 #include "nfc.h"
 #include "pin_interrupt.h"
 #include "pwm.h"
@@ -32,6 +34,7 @@
 
 //Libraries
 #include "ruuvi_endpoints.h"
+#include "ruuvi_message_frame.h"
 #include "chain_channels.h"
 
 
@@ -83,7 +86,12 @@ init_err_code_t init_ble(void)
     // Application Replies are sent by BLE GATT
     #if APP_GATT_PROFILE_ENABLED
       set_ble_gatt_handler(ble_std_transfer_asynchronous);
-      set_reply_handler(ble_std_transfer_asynchronous);
+      set_reply_handler(ble_std_reply_asynchronous);
+      set_bulk_transfer_handler(ble_bulk_ack_handler);
+      set_bulk_message_handler(STD_MESSAGE_FRAME, message_frame_bulk_handler);
+      set_diagnostics_handler(ble_diagnostics_handler);
+      set_ble_stream_handler(ble_stream_transfer);
+      ble_stream_set_ready_handler(lis2dh12_stream_process);
     #endif
     
     NRF_LOG_DEBUG("BLE Stack init done\r\n");
@@ -186,6 +194,7 @@ init_err_code_t init_lis2dh12(void)
     {
         NRF_LOG_DEBUG("LIS2DH12 init Done\r\n");
         set_acceleration_handler(lis2dh12_acceleration_handler);
+        set_acceleration_event_handler(lis2dh12_event_handler);
     }
     else
     {
@@ -213,7 +222,12 @@ init_err_code_t init_bme280(void)
     if (BME280_RET_OK == (BME280_Ret)err_code)
     {
         NRF_LOG_DEBUG("BME280 init Done, setting up message handlers\r\n");
+        if(NRF_SUCCESS != bme280_environmental_handler_init()) { err_code |= INIT_ERR_UNKNOWN; }
         set_temperature_handler(bme280_temperature_handler);
+        set_humidity_handler(bme280_humidity_handler);
+        set_pressure_handler(bme280_pressure_handler);
+        set_environmental_handler(bme280_environmental_handler);
+        set_environmental_derived_handler(bme280_environmental_derived_handler);
     }
     else
     {
@@ -28,7 +28,8 @@
 #define APP_TIMER_PRESCALER             RUUVITAG_APP_TIMER_PRESCALER      /**< Value of the RTC1 PRESCALER register. */
 #define APP_TIMER_OP_QUEUE_SIZE         RUUVITAG_APP_TIMER_OP_QUEUE_SIZE  /**< Size of timer operation queues. */
 // Scheduler settings                                         
-#define SCHED_MAX_EVENT_DATA_SIZE       MAX(APP_TIMER_SCHED_EVT_SIZE, sizeof(ruuvi_standard_message_t))
+// Standard message written by a central is scheduled with its link index, see ble_link_message_t
+#define SCHED_MAX_EVENT_DATA_SIZE       MAX(APP_TIMER_SCHED_EVT_SIZE, sizeof(ruuvi_standard_message_t) + 1)
 #define SCHED_QUEUE_SIZE                RUUVITAG_APP_TIMER_OP_QUEUE_SIZE
 
 #define ERROR_BLINK_INTERVAL 250u   //toggle interval of error led
@@ -44,18 +44,61 @@ For a detailed description see the detailed description in @ref LIS2DH12.h
 /** Bit Mask to enable auto address incrementation for multi read */
 #define SPI_ADR_INC 0x40U
 
+/** First register of configuration shadow, registers up to ADR_MAX are shadowed */
+#define SHADOW_FIRST LIS2DH12_CTRL_REG0
+
+/** Number of bytes in configuration shadow */
+#define SHADOW_LENGTH (ADR_MAX + 1U - SHADOW_FIRST)
+
 /* MACROS *****************************************************************************************/
 
 
 /* PROTOTYPES *************************************************************************************/
 static lis2dh12_ret_t selftest(void);
 void timer_lis2dh12_event_handler(void* p_context);
-static int16_t rawToMg(int16_t raw_acceleration);
+static void conversion_update(void);
 static uint8_t scale_interrupt_threshold(int16_t threshold_mg);
+static lis2dh12_ret_t configure_event_function_1(uint8_t cfg, uint16_t threshold_mg, uint16_t duration_ms);
+static bool shadowed(uint8_t address);
+static lis2dh12_ret_t shadow_load(void);
+static void shadow_set(uint8_t address, uint8_t clear_mask, uint8_t set_mask);
+static lis2dh12_ret_t shadow_flush(void);
+static lis2dh12_ret_t shadow_write_dirty(void);
 
 /* VARIABLES **************************************************************************************/
 static lis2dh12_scale_t      state_scale = LIS2DH12_SCALE16G;
 static lis2dh12_resolution_t state_resolution = LIS2DH12_RES10BIT;
+/** Raw to mg conversion of state_scale and state_resolution, (raw / 2^shift) * multiplier **/
+static struct{
+  uint8_t shift;
+  int16_t multiplier;  // 0 for invalid configuration
+}conversion = { 6, 48 };
+
+/**
+ * Writable registers in ascending address order. Read-only status, output and source
+ * registers between the runs are never written, and never read from the shadow.
+ */
+static const struct{
+  uint8_t first;
+  uint8_t last;
+}shadow_runs[] = {
+  { LIS2DH12_CTRL_REG0,     LIS2DH12_REFERENCE },
+  { LIS2DH12_FIFO_CTRL_REG, LIS2DH12_FIFO_CTRL_REG },
+  { LIS2DH12_INT1_CFG,      LIS2DH12_INT1_CFG },
+  { LIS2DH12_INT1_THS,      LIS2DH12_INT2_CFG },
+  { LIS2DH12_INT2_THS,      LIS2DH12_CLICK_CFG },
+  { LIS2DH12_CLICK_THS,     LIS2DH12_ACT_DUR }
+};
+/** Copy of writable registers, index is address - SHADOW_FIRST */
+static uint8_t  shadow[SHADOW_LENGTH];
+/** Bit per shadow index, set when shadow differs from sensor */
+static uint64_t shadow_dirty = 0;
+/** Shadow matches sensor after init or reset */
+static bool     shadow_valid = false;
+/** Setters only modify shadow between lis2dh12_begin_configuration and lis2dh12_commit_configuration */
+static bool     shadow_deferred = false;
+/** Power-down was requested during deferred configuration, REFERENCE is read on commit */
+static bool     reference_read_pending = false;
 
 
 
@@ -76,38 +119,31 @@ lis2dh12_ret_t lis2dh12_init(void)
     /* Start Selftest */
     err_code |= selftest();
 
+    /* Configuration is kept as is, setters modify a copy of it */
+    shadow_deferred = false;
+    reference_read_pending = false;
+    if (LIS2DH12_RET_OK == err_code){ err_code |= shadow_load(); }
+
     return err_code;
 }
 
 /** Reboots memory to default settings **/
 lis2dh12_ret_t lis2dh12_reset(void)
 {
-  lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
-  uint8_t ctrl[3] = {0x10, 0x00, 0x07}; //Default values, only first and third are non-zero
-  err_code |= lis2dh12_write_register(0x1E, &ctrl[0], 1);
-  err_code |= lis2dh12_write_register(0x1F, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x20, &ctrl[2], 1);
-  err_code |= lis2dh12_write_register(0x21, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x22, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x23, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x24, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x25, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x26, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x2E, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x30, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x32, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x33, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x34, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x36, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x37, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x38, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x3A, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x3B, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x3C, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x3D, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x3E, &ctrl[1], 1);
-  err_code |= lis2dh12_write_register(0x3F, &ctrl[1], 1);
- return err_code;
+  // Default values, only CTRL_REG0 and CTRL_REG1 are non-zero
+  memset(shadow, 0, sizeof(shadow));
+  shadow[LIS2DH12_CTRL_REG0 - SHADOW_FIRST] = 0x10;
+  shadow[LIS2DH12_CTRL_REG1 - SHADOW_FIRST] = LIS2DH12_XYZ_EN_MASK;
+  for (size_t ii = 0; ii < sizeof(shadow_runs) / sizeof(shadow_runs[0]); ii++)
+  {
+    for (uint8_t address = shadow_runs[ii].first; address <= shadow_runs[ii].last; address++)
+    {
+      shadow_dirty |= 1ULL << (address - SHADOW_FIRST);
+    }
+  }
+  shadow_valid = true;
+  // A burst per run of writable registers, regardless of deferred configuration
+  return shadow_write_dirty();
 }
 
 /**
@@ -115,12 +151,9 @@ lis2dh12_ret_t lis2dh12_reset(void)
  */
 lis2dh12_ret_t lis2dh12_enable(void)
 {
-    lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
     /* Enable XYZ axes */
-    uint8_t ctrl[1] = {0};
-    ctrl[0] = LIS2DH12_XYZ_EN_MASK;
-    err_code |= lis2dh12_write_register(LIS2DH12_CTRL_REG1, ctrl, 1);
-    return err_code;
+    shadow_set(LIS2DH12_CTRL_REG1, 0xFF, LIS2DH12_XYZ_EN_MASK);
+    return shadow_flush();
 }
 
 /**
@@ -129,15 +162,10 @@ lis2dh12_ret_t lis2dh12_enable(void)
 lis2dh12_ret_t lis2dh12_set_scale(lis2dh12_scale_t scale)
 {
     lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
-    //Read current value of CTRL4 Register
-    uint8_t ctrl4[1] = {0};
-    err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG4, ctrl4, 1);
-    //Reset scale bits
-    ctrl4[0] &= ~LIS2DH12_FS_MASK;
-    ctrl4[0] |= scale;
-    //Write register value back to lis2dh12
-    err_code |= lis2dh12_write_register(LIS2DH12_CTRL_REG4, ctrl4, 1);
-    if(LIS2DH12_RET_OK == err_code){ state_scale = scale; }
+    //Replace scale bits, CTRL4 is written only if scale changes
+    shadow_set(LIS2DH12_CTRL_REG4, LIS2DH12_FS_MASK, scale);
+    err_code |= shadow_flush();
+    if(LIS2DH12_RET_OK == err_code){ state_scale = scale; conversion_update(); }
     return err_code;
 }
 
@@ -166,18 +194,13 @@ int lis2dh12_get_full_scale()
 lis2dh12_ret_t lis2dh12_set_resolution(lis2dh12_resolution_t resolution)
 {
     lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
-    uint8_t ctrl1[1] = {0};
-    uint8_t ctrl4[1] = {0};
-    //Read registers 3 & 4
-    err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG1, ctrl1, 1);
-    err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG4, ctrl4, 1);
-    //Reset Low-power, high-resolution masks
-    ctrl1[0] &= ~LIS2DH12_LPEN_MASK;
-    ctrl4[0] &= ~LIS2DH12_HR_MASK;
+    uint8_t ctrl1 = 0;
+    uint8_t ctrl4 = 0;
+    //Low-power, high-resolution bits are replaced
     switch(resolution)
     {
         case LIS2DH12_RES12BIT:
-             ctrl4[0] |= LIS2DH12_HR_MASK;
+             ctrl4 |= LIS2DH12_HR_MASK;
              break;
 
         //No action needed
@@ -185,16 +208,18 @@ lis2dh12_ret_t lis2dh12_set_resolution(lis2dh12_resolution_t resolution)
              break;
 
         case LIS2DH12_RES8BIT:
-             ctrl1[0] |= LIS2DH12_LPEN_MASK;
+             ctrl1 |= LIS2DH12_LPEN_MASK;
              break;
         //Writing normal power to lis2dh12 is safe
         default:
              err_code |= LIS2DH12_RET_INVALID;
              break;
     }
-    err_code |= lis2dh12_write_register(LIS2DH12_CTRL_REG1, ctrl1, 1);
-    err_code |= lis2dh12_write_register(LIS2DH12_CTRL_REG4, ctrl4, 1);
-    if(LIS2DH12_RET_OK == err_code){ state_resolution = resolution; }    
+    //CTRL1 and CTRL4 go in one burst if both change
+    shadow_set(LIS2DH12_CTRL_REG1, LIS2DH12_LPEN_MASK, ctrl1);
+    shadow_set(LIS2DH12_CTRL_REG4, LIS2DH12_HR_MASK, ctrl4);
+    err_code |= shadow_flush();
+    if(LIS2DH12_RET_OK == err_code){ state_resolution = resolution; conversion_update(); }
     return err_code;
 }
 
@@ -209,19 +234,19 @@ lis2dh12_ret_t lis2dh12_set_sample_rate(lis2dh12_sample_rate_t sample_rate)
 {
     lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
     uint8_t ctrl[1] = {0};
-    err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG1, ctrl, 1);
-    NRF_LOG_DEBUG("Read samplerate %x, status %d\r\n", ctrl[0], err_code);
-    // Clear sample rate bits
-    ctrl[0] &= ~LIS2DH12_ODR_MASK;
-    // Setup sample rate
-    ctrl[0] |= sample_rate;
-    err_code |= lis2dh12_write_register(LIS2DH12_CTRL_REG1, ctrl, 1);
-    NRF_LOG_DEBUG("Wrote samplerate %x, status %d\r\n", ctrl[0], err_code);
-
-    //Always read REFERENCE register when powering down to reset filter.
-    if(LIS2DH12_RATE_0 == sample_rate)
+    // Replace sample rate bits
+    shadow_set(LIS2DH12_CTRL_REG1, LIS2DH12_ODR_MASK, sample_rate);
+    err_code |= shadow_flush();
+    NRF_LOG_DEBUG("Samplerate %x, status %d\r\n", sample_rate, err_code);
+
+    //Always read REFERENCE register when powering down to reset filter, after the power-down is written.
+    if(LIS2DH12_RATE_0 == sample_rate && shadow_deferred)
+    {
+        reference_read_pending = true;
+    }
+    else if(LIS2DH12_RATE_0 == sample_rate)
     {
-        err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG6, ctrl, 1);
+        err_code |= lis2dh12_read_register(LIS2DH12_REFERENCE, ctrl, 1);
     }
     return err_code;
 }
@@ -233,8 +258,8 @@ lis2dh12_ret_t lis2dh12_get_sample_rate(lis2dh12_sample_rate_t *sample_rate)
 {
     lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
     uint8_t ctrl[1] = {0};
+    // From shadow after init, includes deferred configuration
     err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG1, ctrl, 1);
-    NRF_LOG_DEBUG("Read samplerate %x, status %d\r\n", ctrl[0], err_code);
     ctrl[0] &= LIS2DH12_ODR_MASK;
     *sample_rate = ctrl[0];
     return err_code;
@@ -270,25 +295,15 @@ int lis2dh12_odr_to_hz(lis2dh12_sample_rate_t sample_rate)
  */
 lis2dh12_ret_t lis2dh12_set_fifo_mode(lis2dh12_fifo_mode_t mode)
 {
-    lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
-    uint8_t ctrl_fifo[1] = {0};
-    uint8_t ctrl5[1] = {0};
-
-    err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG5, ctrl5, 1);
-    err_code |= lis2dh12_read_register(LIS2DH12_FIFO_CTRL_REG, ctrl_fifo, 1);
-
-    // Clear FiFo bits
-    ctrl_fifo[0] &= ~LIS2DH12_FM_MASK;
-    //Clear enable bit
-    ctrl5[0] &= ~LIS2DH12_FIFO_EN_MASK;
-    // Setup FiFo rate
-    ctrl_fifo[0] |= mode;
+    uint8_t ctrl5 = 0;
+
     //Enable FiFo if appropriate
-    if(LIS2DH12_MODE_BYPASS != mode){ ctrl5[0] |= LIS2DH12_FIFO_EN_MASK; }
-    //FIFO must be enabled before setting mode
-    err_code |= lis2dh12_write_register(LIS2DH12_CTRL_REG5, ctrl5, 1);
-    err_code |= lis2dh12_write_register(LIS2DH12_FIFO_CTRL_REG, ctrl_fifo, 1);
-    return err_code;
+    if(LIS2DH12_MODE_BYPASS != mode){ ctrl5 |= LIS2DH12_FIFO_EN_MASK; }
+    shadow_set(LIS2DH12_CTRL_REG5, LIS2DH12_FIFO_EN_MASK, ctrl5);
+    // Setup FiFo mode
+    shadow_set(LIS2DH12_FIFO_CTRL_REG, LIS2DH12_FM_MASK, mode);
+    //FIFO must be enabled before setting mode, registers are written in ascending order
+    return shadow_flush();
 }
 
 lis2dh12_ret_t lis2dh12_read_samples(lis2dh12_sensor_buffer_t* buffer, size_t count)
@@ -297,16 +312,37 @@ lis2dh12_ret_t lis2dh12_read_samples(lis2dh12_sensor_buffer_t* buffer, size_t co
      size_t bytes_to_read = count*sizeof(lis2dh12_sensor_buffer_t);
      NRF_LOG_DEBUG("Reading %d bytes \r\n", bytes_to_read);
      err_code |= lis2dh12_read_register(LIS2DH12_OUT_X_L, (uint8_t*)buffer, count*sizeof(lis2dh12_sensor_buffer_t));
-     // Use constant bitshift, so we don't have to adjust mgpb with resolution
-     for(int ii = 0; ii < count; ii++)
-     {
-        buffer[ii].sensor.x = rawToMg(buffer[ii].sensor.x);
-        buffer[ii].sensor.y = rawToMg(buffer[ii].sensor.y);
-        buffer[ii].sensor.z = rawToMg(buffer[ii].sensor.z);
-     }
+     // Whole burst in one pass, conversion was selected when scale or resolution was set
+     lis2dh12_raw_to_mg((int16_t*)buffer, count * 3);
      return err_code;
 }
 
+/**
+ * Convert raw values to acceleration in mg in place, with the conversion of current scale and resolution.
+ * Division rounds toward zero like the conversion functions of ST: negative values are biased by
+ * 2^shift - 1 before arithmetic shift. No branches in the loop, compiler can unroll and vectorise it.
+ *
+ * @param values raw ADC values from LIS2DH12, X Y Z of consecutive samples
+ * @param count number of values
+ */
+void lis2dh12_raw_to_mg(int16_t* values, size_t count)
+{
+  const int32_t shift      = conversion.shift;
+  const int32_t bias       = (1 << shift) - 1;
+  const int32_t multiplier = conversion.multiplier;
+  if(0 == multiplier)
+  {
+    // Invalid configuration, return "smallest representable value"
+    for(size_t ii = 0; ii < count; ii++) { values[ii] = INT16_MIN; }
+    return;
+  }
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    int32_t raw = values[ii];
+    values[ii] = (int16_t)(((raw + ((raw >> 31) & bias)) >> shift) * multiplier);
+  }
+}
+
 // put number of samples in HW FIFO to count
 lis2dh12_ret_t lis2dh12_get_fifo_sample_number(size_t* count)
 {
@@ -317,19 +353,26 @@ lis2dh12_ret_t lis2dh12_get_fifo_sample_number(size_t* count)
     return err_code;
 }
 
-// Generate watermark interrupt when FIFO reaches certain level
-lis2dh12_ret_t lis2dh12_set_fifo_watermark(size_t count)
+// put number of samples in HW FIFO to count and FIFO overrun flag to overrun
+lis2dh12_ret_t lis2dh12_get_fifo_status(size_t* count, bool* overrun)
 {
-    if(count > 32) return LIS2DH12_RET_INVALID;
     lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
     uint8_t ctrl[1] = {0};
-    err_code |= lis2dh12_read_register(LIS2DH12_FIFO_CTRL_REG, ctrl, 1);
-    ctrl[0] &= ~LIS2DH12_FTH_MASK;
-    ctrl[0] += count;
-    err_code |= lis2dh12_write_register(LIS2DH12_FIFO_CTRL_REG, ctrl, 1);
+    err_code |= lis2dh12_read_register(LIS2DH12_FIFO_SRC_REG, ctrl, 1);
+    *overrun = ctrl[0] & LIS2DH12_OVRN_FIFO_MASK;
+    // FSS has 5 bits, full FIFO is flagged by overrun
+    *count = (*overrun) ? LIS2DH12_FIFO_MAX_LENGTH : (ctrl[0] & LIS2DH12_FSS_MASK);
     return err_code;
 }
 
+// Generate watermark interrupt when FIFO reaches certain level
+lis2dh12_ret_t lis2dh12_set_fifo_watermark(size_t count)
+{
+    if(count > 32) return LIS2DH12_RET_INVALID;
+    shadow_set(LIS2DH12_FIFO_CTRL_REG, LIS2DH12_FTH_MASK, count);
+    return shadow_flush();
+}
+
 /**
  * Enable activity detection interrupt on pin 2. Interrupt is high for samples where high-passed acceleration exceeds mg
  */
@@ -343,9 +386,8 @@ lis2dh12_ret_t lis2dh12_set_activity_interrupt_pin_2(uint16_t mg)
     // //CTRLREG2 = 0x02
     // ctrl[0] = LIS2DH12_HPIS2_MASK;
     // lis2dh12_write_register(LIS2DH12_CTRL_REG2, ctrl, 1);
-    lis2dh12_read_register(LIS2DH12_CTRL_REG2, &cfg, 1);
-    cfg |= LIS2DH12_HPIS2_MASK;
-    lis2dh12_write_register(LIS2DH12_CTRL_REG2, &cfg, 1);
+    shadow_set(LIS2DH12_CTRL_REG2, 0, LIS2DH12_HPIS2_MASK);
+    shadow_flush();
 
     // Enable interrupt 2 on X-Y-Z HI/LO.
     // INT2_CFG = 0x7F
@@ -385,11 +427,10 @@ lis2dh12_ret_t lis2dh12_set_activity_interrupt_pin_2(uint16_t mg)
 lis2dh12_ret_t lis2dh12_set_interrupts(uint8_t interrupts, uint8_t function)
 {
   if(1 != function && 2 != function){ return LIS2DH12_RET_INVALID; }
-  uint8_t ctrl[1]; 
-  ctrl[0] = interrupts;
   uint8_t target_reg = LIS2DH12_CTRL_REG3;
   if( 2 == function ) { target_reg = LIS2DH12_CTRL_REG6; }
-  return lis2dh12_write_register(target_reg, ctrl, 1);
+  shadow_set(target_reg, 0xFF, interrupts);
+  return shadow_flush();
 }
 
 /**
@@ -403,11 +444,10 @@ lis2dh12_ret_t lis2dh12_set_interrupts(uint8_t interrupts, uint8_t function)
 lis2dh12_ret_t lis2dh12_set_interrupt_configuration(uint8_t cfg, uint8_t function)
 {
   if(1 != function && 2 != function){ return LIS2DH12_RET_INVALID; }
-  uint8_t ctrl[1]; 
-  ctrl[0] = cfg;
   uint8_t target_reg = LIS2DH12_INT1_CFG;
   if( 2 == function ) { target_reg = LIS2DH12_INT2_CFG; }
-  return lis2dh12_write_register(target_reg, ctrl, 1);
+  shadow_set(target_reg, 0xFF, cfg);
+  return shadow_flush();
 }
 
 /**
@@ -421,11 +461,10 @@ lis2dh12_ret_t lis2dh12_set_interrupt_configuration(uint8_t cfg, uint8_t functio
 lis2dh12_ret_t lis2dh12_set_threshold(uint8_t bits, uint8_t pin)
 {
   if((1 != pin && 2 != pin) || bits > 0x7F){ return LIS2DH12_RET_INVALID; }
-  uint8_t ctrl[1];
-  ctrl[0] = bits;
   uint8_t target_reg = LIS2DH12_INT1_THS;
   if(2 == pin) { target_reg = LIS2DH12_INT2_THS;} 
-  return lis2dh12_write_register(target_reg, ctrl, 1);
+  shadow_set(target_reg, 0xFF, bits);
+  return shadow_flush();
 }
 
 /**
@@ -460,204 +499,170 @@ lis2dh12_ret_t lis2dh12_set_tap_interrupt(uint8_t click_cfg, int threshold_mg, i
     /* Enable click interrupt on pin */
     err_code |= lis2dh12_set_interrupts(value, pin);
 
-    /* Turn on high pass filter for click detection */
-    err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG2, &value, 1);
-    value |= LIS2DH12_HPCLICK_MASK;
-    value &= ~LIS2DH12_HPCF_MASK; // Largest highpass cutoff frequency
-    err_code |= lis2dh12_write_register(LIS2DH12_CTRL_REG2, &value, 1);
+    /* Turn on high pass filter for click detection, largest highpass cutoff frequency */
+    shadow_set(LIS2DH12_CTRL_REG2, LIS2DH12_HPCF_MASK, LIS2DH12_HPCLICK_MASK);
 
-    value = click_cfg;
-    err_code |= lis2dh12_write_register(LIS2DH12_CLICK_CFG, &value, 1);
+    shadow_set(LIS2DH12_CLICK_CFG, 0xFF, click_cfg);
 
     /* Set threshold */
     reg = (128*threshold_mg) / lis2dh12_get_full_scale();
     value = (uint8_t) (reg > LIS2DH12_CLK_THS_MASK) ? LIS2DH12_CLK_THS_MASK : reg; // clip to max value (7 bits)
     value = (value < 1) ? 1 : value; // at least 1
     // LIR_CLICK bit will be (implicitly) set to 0
-    err_code |= lis2dh12_write_register(LIS2DH12_CLICK_THS, &value, 1);
+    shadow_set(LIS2DH12_CLICK_THS, 0xFF, value);
 
     /* Set time limit */
     err_code |= lis2dh12_get_sample_rate(&sample_rate);
     reg = (timelimit_ms * lis2dh12_odr_to_hz(sample_rate)) / 1e3; // time limit in measurement cycles
     value = (uint8_t) (reg > LIS2DH12_TLI_MASK) ? LIS2DH12_TLI_MASK : reg; // clip to max value (7 bits)
     value = (value < 1) ? 1 : value; // at least 1 cycle
-    err_code |= lis2dh12_write_register(LIS2DH12_TIME_LIMIT, &value, 1);
+    shadow_set(LIS2DH12_TIME_LIMIT, 0xFF, value);
 
     /* Set latency */
     reg = (latency_ms * lis2dh12_odr_to_hz(sample_rate)) / 1e3;
     value = (uint8_t) (reg > 0xFF) ? 0xFF : reg ; // clip to max value (8 bits)
-    err_code |= lis2dh12_write_register(LIS2DH12_TIME_LATENCY, &value, 1);
+    shadow_set(LIS2DH12_TIME_LATENCY, 0xFF, value);
 
     /* Set window */
     reg = (window_ms * lis2dh12_odr_to_hz(sample_rate)) / 1e3;
     value = (uint8_t) (reg > 0xFF) ? 0xFF : reg ; // clip to max value (8 bits)
-    err_code |= lis2dh12_write_register(LIS2DH12_TIME_WINDOW, &value, 1);
+    shadow_set(LIS2DH12_TIME_WINDOW, 0xFF, value);
 
+    // CLICK_THS ... TIME_WINDOW are consecutive, changed ones go in one burst
+    err_code |= shadow_flush();
     return err_code;
 }
 
-/* INTERNAL FUNCTIONS *****************************************************************************/
-
 /**
- * Execute LIS2DH12 Selftest
- * TODO: Run the self-test internal to device
- *
- * @return LIS2DH12_RET_OK Selftest passed
- * @return LIS2DH12_RET_ERROR_SELFTEST Selftest failed
+ * Enable free-fall detection on interrupt function 1. Free-fall is a low event
+ * on all axes at once (AND combination), thresholds from STM App note AN5005
+ * are about 350 mg for 30 ms.
  */
-static lis2dh12_ret_t selftest(void)
+lis2dh12_ret_t lis2dh12_set_free_fall_interrupt(uint16_t threshold_mg, uint16_t duration_ms)
 {
-    uint8_t value[1] = {0};
-    lis2dh12_read_register(LIS2DH12_WHO_AM_I, value, 1);
-    if(LIS2DH12_I_AM_MASK != value[0]) { NRF_LOG_ERROR("WHO_AM_I: %x\r\n", value[0])}
-    return (LIS2DH12_I_AM_MASK == value[0]) ? LIS2DH12_RET_OK : LIS2DH12_RET_ERROR;
+    uint8_t cfg = LIS2DH12_AOI_MASK | LIS2DH12_ZLIE_MASK | LIS2DH12_YLIE_MASK | LIS2DH12_XLIE_MASK;
+    return configure_event_function_1(cfg, threshold_mg, duration_ms);
 }
 
 /**
- * Conversion functions from 
- * https://github.com/STMicroelectronics/STMems_Standard_C_drivers/blob/3e3b7528dfacb223aea250daf4e512e335f17509/lis2dh12_STdC/driver/lis2dh12_reg.c#L104
+ * Enable 6D movement recognition on interrupt function 1. AOI = 0 with 6D set
+ * interrupts on change of orientation, AOI = 1 would interrupt as long as
+ * orientation is stable.
  */
-static inline int16_t lis2dh12_from_fs2_hr_to_mg(int16_t lsb)
+lis2dh12_ret_t lis2dh12_set_orientation_interrupt(uint16_t threshold_mg, uint16_t duration_ms)
 {
-  return (lsb / 16 ) * 1;
+    uint8_t cfg = LIS2DH12_6D_MASK;
+    cfg |= LIS2DH12_ZHIE_MASK | LIS2DH12_ZLIE_MASK;
+    cfg |= LIS2DH12_YHIE_MASK | LIS2DH12_YLIE_MASK;
+    cfg |= LIS2DH12_XHIE_MASK | LIS2DH12_XLIE_MASK;
+    return configure_event_function_1(cfg, threshold_mg, duration_ms);
 }
 
-static inline int16_t lis2dh12_from_fs4_hr_to_mg(int16_t lsb)
+lis2dh12_ret_t lis2dh12_get_event_sources(uint8_t* int1_source, uint8_t* click_source)
 {
-  return (lsb / 16 ) * 2;
+    if(NULL == int1_source || NULL == click_source) { return LIS2DH12_RET_NULL; }
+    lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
+    // Reading source registers clears latched interrupts
+    err_code |= lis2dh12_read_register(LIS2DH12_INT1_SOURCE, int1_source, 1);
+    err_code |= lis2dh12_read_register(LIS2DH12_CLICK_SRC, click_source, 1);
+    return err_code;
 }
 
-static inline int16_t lis2dh12_from_fs8_hr_to_mg(int16_t lsb)
+lis2dh12_ret_t lis2dh12_begin_configuration(void)
 {
-  return (lsb / 16 ) * 4;
+    shadow_deferred = true;
+    return LIS2DH12_RET_OK;
 }
 
-static inline int16_t lis2dh12_from_fs16_hr_to_mg(int16_t lsb)
+lis2dh12_ret_t lis2dh12_commit_configuration(void)
 {
-  return (lsb / 16) * 12;
+    lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
+    uint8_t reference = 0;
+    shadow_deferred = false;
+    err_code |= shadow_write_dirty();
+    if(reference_read_pending)
+    {
+        reference_read_pending = false;
+        err_code |= lis2dh12_read_register(LIS2DH12_REFERENCE, &reference, 1);
+    }
+    return err_code;
 }
 
-static inline int16_t lis2dh12_from_fs2_nm_to_mg(int16_t lsb)
-{
-  return (lsb / 64) * 4;
-}
+/* INTERNAL FUNCTIONS *****************************************************************************/
 
-static inline int16_t lis2dh12_from_fs4_nm_to_mg(int16_t lsb)
+/**
+ * Configure interrupt function 1 for latched event detection: unfiltered data,
+ * threshold at current scale, duration in samples at current sample rate.
+ * Configuration is written last and stale latch is cleared, unless configuration
+ * is deferred, where all registers go in ascending order on commit.
+ */
+static lis2dh12_ret_t configure_event_function_1(uint8_t cfg, uint16_t threshold_mg, uint16_t duration_ms)
 {
-  return (lsb / 64) * 8;
-}
+    lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
+    lis2dh12_sample_rate_t sample_rate;
+    uint8_t value;
+    int reg;
 
-static inline int16_t lis2dh12_from_fs8_nm_to_mg(int16_t lsb)
-{
-  return (lsb / 64) * 16;
-}
+    // Events are on acceleration including gravity, no high-pass
+    shadow_set(LIS2DH12_CTRL_REG2, LIS2DH12_HPIS1_MASK, 0);
 
-static inline int16_t lis2dh12_from_fs16_nm_to_mg(int16_t lsb)
-{
-  return (lsb / 64) * 48;
-}
+    // Latch until source is read, 6D instead of 4D
+    shadow_set(LIS2DH12_CTRL_REG5, LIS2DH12_D4D_INT1_MASK, LIS2DH12_LIR_INT1_MASK);
 
-static inline int16_t lis2dh12_from_fs2_lp_to_mg(int16_t lsb)
-{
-  return (lsb / 256) * 16;
-}
+    shadow_set(LIS2DH12_INT1_THS, 0xFF, scale_interrupt_threshold(threshold_mg));
 
-static inline int16_t lis2dh12_from_fs4_lp_to_mg(int16_t lsb)
-{
-  return (lsb / 256) * 32;
-}
+    err_code |= lis2dh12_get_sample_rate(&sample_rate);
+    reg = ((int)duration_ms * lis2dh12_odr_to_hz(sample_rate)) / 1000;
+    value = (reg > 0x7F) ? 0x7F : reg; // clip to max value (7 bits)
+    shadow_set(LIS2DH12_INT1_DURATION, 0xFF, value);
+    err_code |= shadow_flush();
 
-static inline int16_t lis2dh12_from_fs8_lp_to_mg(int16_t lsb)
-{
-  return (lsb / 256) * 64;
+    err_code |= lis2dh12_set_interrupt_configuration(cfg, 1);
+    err_code |= lis2dh12_read_register(LIS2DH12_INT1_SOURCE, &value, 1);
+    return err_code;
 }
 
-static inline int16_t lis2dh12_from_fs16_lp_to_mg(int16_t lsb)
+/**
+ * Execute LIS2DH12 Selftest
+ * TODO: Run the self-test internal to device
+ *
+ * @return LIS2DH12_RET_OK Selftest passed
+ * @return LIS2DH12_RET_ERROR_SELFTEST Selftest failed
+ */
+static lis2dh12_ret_t selftest(void)
 {
-  return (lsb / 256) * 192;
+    uint8_t value[1] = {0};
+    lis2dh12_read_register(LIS2DH12_WHO_AM_I, value, 1);
+    if(LIS2DH12_I_AM_MASK != value[0]) { NRF_LOG_ERROR("WHO_AM_I: %x\r\n", value[0])}
+    return (LIS2DH12_I_AM_MASK == value[0]) ? LIS2DH12_RET_OK : LIS2DH12_RET_ERROR;
 }
 
-
 /**
- * Convert raw value to acceleration in mg. Reads scale and resolution from state variables.
- *
- * @param raw_acceleration raw ADC value from LIS2DH12
- * @return int16_t representing acceleration in milli-G. 
+ * Select conversion of current scale and resolution.
+ * Conversion functions from
+ * https://github.com/STMicroelectronics/STMems_Standard_C_drivers/blob/3e3b7528dfacb223aea250daf4e512e335f17509/lis2dh12_STdC/driver/lis2dh12_reg.c#L104
+ * are (lsb / 2^shift) * multiplier: shift is 4, 6 and 8 for high resolution, normal and low power mode,
+ * multiplier is 1, 2, 4 and 12 mg per digit at 2, 4, 8 and 16 g in high resolution mode, 4x in normal and 16x in low power mode.
  */
-static int16_t rawToMg(int16_t raw_acceleration)
+static void conversion_update(void)
 {
+  int16_t multiplier = 0;
   switch(state_scale)
   {
-    case LIS2DH12_SCALE2G:
-      switch(state_resolution)
-      {
-        case LIS2DH12_RES8BIT:
-          return lis2dh12_from_fs2_lp_to_mg(raw_acceleration);
-
-        case LIS2DH12_RES10BIT:
-          return  lis2dh12_from_fs2_nm_to_mg(raw_acceleration);
-
-        case LIS2DH12_RES12BIT:
-          return  lis2dh12_from_fs2_hr_to_mg(raw_acceleration);
-
-        default:
-          break;
-      }
-      break;
-
-    case LIS2DH12_SCALE4G:
-      switch(state_resolution)
-      {
-        case LIS2DH12_RES8BIT:
-          return  lis2dh12_from_fs4_lp_to_mg(raw_acceleration);
-
-        case LIS2DH12_RES10BIT:
-          return  lis2dh12_from_fs4_nm_to_mg(raw_acceleration);
-
-        case LIS2DH12_RES12BIT:
-          return  lis2dh12_from_fs4_hr_to_mg(raw_acceleration);
-      }
-      break;
-
-    case LIS2DH12_SCALE8G:
-      switch(state_resolution)
-      {
-        case LIS2DH12_RES8BIT:
-          return  lis2dh12_from_fs8_lp_to_mg(raw_acceleration);
-
-        case LIS2DH12_RES10BIT:
-          return  lis2dh12_from_fs8_nm_to_mg(raw_acceleration);
-
-        case LIS2DH12_RES12BIT:
-          return  lis2dh12_from_fs8_hr_to_mg(raw_acceleration);
-
-        default:
-          break;
-      }
-    break;
-
-    case LIS2DH12_SCALE16G:
-      switch(state_resolution)
-      {
-        case LIS2DH12_RES8BIT:
-          return  lis2dh12_from_fs16_lp_to_mg(raw_acceleration);
-
-        case LIS2DH12_RES10BIT:
-          return  lis2dh12_from_fs16_nm_to_mg(raw_acceleration);
-
-        case LIS2DH12_RES12BIT:
-          return  lis2dh12_from_fs16_hr_to_mg(raw_acceleration);
-
-        default:
-          break;
-      }
-    break;
-
-    default:
-      break;
+    case LIS2DH12_SCALE2G:  multiplier = 1;  break;
+    case LIS2DH12_SCALE4G:  multiplier = 2;  break;
+    case LIS2DH12_SCALE8G:  multiplier = 4;  break;
+    case LIS2DH12_SCALE16G: multiplier = 12; break;
+    default: break;
+  }
+  switch(state_resolution)
+  {
+    case LIS2DH12_RES12BIT: conversion.shift = 4; break;
+    case LIS2DH12_RES10BIT: conversion.shift = 6; multiplier *= 4;  break;
+    case LIS2DH12_RES8BIT:  conversion.shift = 8; multiplier *= 16; break;
+    default: multiplier = 0; break;
   }
-  // reached only in case of an error, return "smallest representable value"
-  return 0x8000;
+  conversion.multiplier = multiplier;
 }
 
 /**
@@ -704,10 +709,98 @@ static uint8_t scale_interrupt_threshold(int16_t threshold_mg)
   return threshold;
 }
 
+/**
+ * Check if register is writable and kept in shadow
+ */
+static bool shadowed(uint8_t address)
+{
+  for(size_t ii = 0; ii < sizeof(shadow_runs) / sizeof(shadow_runs[0]); ii++)
+  {
+    if(address >= shadow_runs[ii].first && address <= shadow_runs[ii].last) { return true; }
+  }
+  return false;
+}
+
+/**
+ * Fill shadow from sensor with a burst per run. Source and output registers are not
+ * read, reading them would clear latched interrupts or pop FIFO.
+ */
+static lis2dh12_ret_t shadow_load(void)
+{
+  lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
+  for(size_t ii = 0; ii < sizeof(shadow_runs) / sizeof(shadow_runs[0]); ii++)
+  {
+    uint8_t first = shadow_runs[ii].first;
+    err_code |= spi_read_lis2dh12(first | SPI_READ | SPI_ADR_INC, &shadow[first - SHADOW_FIRST],
+                                  shadow_runs[ii].last - first + 1);
+  }
+  shadow_dirty = 0;
+  shadow_valid = (LIS2DH12_RET_OK == err_code);
+  return err_code;
+}
+
+/**
+ * Clear and set bits of a writable register in shadow. Register is marked dirty only if value changes.
+ */
+static void shadow_set(uint8_t address, uint8_t clear_mask, uint8_t set_mask)
+{
+  uint8_t index = address - SHADOW_FIRST;
+  uint8_t value = (shadow[index] & ~clear_mask) | set_mask;
+  if(value != shadow[index])
+  {
+    shadow[index] = value;
+    shadow_dirty |= 1ULL << index;
+  }
+}
+
+/**
+ * Write dirty registers, unless configuration is deferred until lis2dh12_commit_configuration
+ */
+static lis2dh12_ret_t shadow_flush(void)
+{
+  if(shadow_deferred) { return LIS2DH12_RET_OK; }
+  return shadow_write_dirty();
+}
+
+/**
+ * Write dirty registers in ascending address order, one burst with address incrementation
+ * per run from first to last dirty register. Clean registers between them are rewritten
+ * with their current value, which costs a byte instead of a transfer.
+ * Registers stay dirty if SPI write fails.
+ */
+static lis2dh12_ret_t shadow_write_dirty(void)
+{
+  lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
+  for(size_t ii = 0; ii < sizeof(shadow_runs) / sizeof(shadow_runs[0]) && shadow_dirty; ii++)
+  {
+    uint8_t first = 0;
+    uint8_t last = 0;
+    bool dirty = false;
+    for(uint8_t address = shadow_runs[ii].first; address <= shadow_runs[ii].last; address++)
+    {
+      if(!(shadow_dirty & (1ULL << (address - SHADOW_FIRST)))) { continue; }
+      if(!dirty) { first = address; }
+      last = address;
+      dirty = true;
+    }
+    if(!dirty) { continue; }
+
+    uint8_t command = (last > first) ? (first | SPI_ADR_INC) : first;
+    lis2dh12_ret_t status = spi_write_lis2dh12(command, &shadow[first - SHADOW_FIRST], last - first + 1);
+    if(LIS2DH12_RET_OK == status)
+    {
+      for(uint8_t address = first; address <= last; address++) { shadow_dirty &= ~(1ULL << (address - SHADOW_FIRST)); }
+    }
+    err_code |= status;
+  }
+  return err_code;
+}
+
 /**
  * Read registers
  *
- * Read one or more registers from the sensor
+ * Read one or more registers from the sensor. Writable registers except REFERENCE
+ * are copied from shadow after init, read of REFERENCE resets the filter on sensor.
  *
  * @param[in] address Start address to read from
  * @param[out] p_toRead Pointer to result buffer
@@ -721,34 +814,33 @@ lis2dh12_ret_t lis2dh12_read_register(const uint8_t address, uint8_t* const p_to
 {
     NRF_LOG_DEBUG("LIS2DH12 Register read started'\r\n");
     lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
-    uint8_t* write_buffer   = calloc(count+1, sizeof(uint8_t));
-    //Separate buffer to read data, includes room for response to address byte. 
-    //This is pretty ineficient, TODO
-    uint8_t* read_buffer    = calloc(count+1, sizeof(uint8_t));
+
+    bool cached = shadow_valid;
+    for (size_t ii = 0; ii < count && cached; ii++)
+    {
+        cached = shadowed(address + ii) && LIS2DH12_REFERENCE != address + ii;
+    }
 
     if (NULL == p_toRead)
     {
         err_code |= LIS2DH12_RET_NULL;
     }
+    else if (cached)
+    {
+        memcpy(p_toRead, &shadow[address - SHADOW_FIRST], count);
+    }
     else
     {
-        write_buffer[0] = address | SPI_READ | SPI_ADR_INC;
-        err_code |= spi_transfer_lis2dh12(write_buffer, (count + 1U), read_buffer);
-
-        if (SPI_RET_OK == (SPI_Ret)err_code)
-        {
-            /* Transfer was ok, copy result */
-            memcpy(p_toRead, &(read_buffer[1]), count);
-        }
+        /* Data is received in place, i.e. a FIFO burst goes directly to sample buffer */
+        err_code |= spi_read_lis2dh12(address | SPI_READ | SPI_ADR_INC, p_toRead, count);
     }
     NRF_LOG_DEBUG("LIS2DH12 Register read complete'\r\n");
-    free(read_buffer);
-    free(write_buffer);
     return err_code;
 }
 
 /**
- * Write a register
+ * Write a register. Written value is kept in shadow, write goes to sensor even
+ * if value is unchanged or configuration is deferred.
  *
  * @param[in] address Register address to write, address is 5bit, so max value is 0x1F
  * @param[in] dataToWrite Data to write to register
@@ -759,19 +851,21 @@ lis2dh12_ret_t lis2dh12_read_register(const uint8_t address, uint8_t* const p_to
 lis2dh12_ret_t lis2dh12_write_register(uint8_t address, uint8_t* const dataToWrite, size_t count)
 {
     lis2dh12_ret_t err_code = LIS2DH12_RET_OK;
-    uint8_t* to_read  = calloc(count+1, sizeof(uint8_t)); /* dummy, not used for writing */
-    uint8_t* to_write = calloc(count+1, sizeof(uint8_t));
 
     /* SPI Addresses are 5bit only */
     if (address <= ADR_MAX)
     {
-        to_write[0] = address;
-        memcpy(&(to_write[1]), dataToWrite, count);
+        /* Consecutive registers are written with address incrementation */
+        uint8_t command = (count > 1) ? (address | SPI_ADR_INC) : address;
+        err_code |= spi_write_lis2dh12(command, dataToWrite, count);
+    }
 
-        err_code |= spi_transfer_lis2dh12(to_write, (count+1), to_read);
+    for (size_t ii = 0; ii < count && LIS2DH12_RET_OK == err_code; ii++)
+    {
+        if (!shadowed(address + ii)) { continue; }
+        shadow[address + ii - SHADOW_FIRST] = dataToWrite[ii];
+        shadow_dirty &= ~(1ULL << (address + ii - SHADOW_FIRST));
     }
-    free(to_read);
-    free(to_write);
 
     return err_code;
 }
@@ -163,12 +163,26 @@ lis2dh12_ret_t lis2dh12_set_fifo_mode(lis2dh12_fifo_mode_t mode);
  */
 lis2dh12_ret_t lis2dh12_read_samples(lis2dh12_sensor_buffer_t* buffer, size_t count);
 
+/**
+ *  Convert raw output register values to mg in place, at current scale and resolution.
+ *  lis2dh12_read_samples calls this for the whole burst, X Y Z of a sample are consecutive values.
+ *  Invalid configuration gives INT16_MIN.
+ */
+void lis2dh12_raw_to_mg(int16_t* values, size_t count);
+
 /**
  *  Get number of samples waiting in buffer into count.
  *  Returns error code from SPI write
  */
 lis2dh12_ret_t lis2dh12_get_fifo_sample_number(size_t* count);
 
+/**
+ *  Get number of samples waiting in buffer and FIFO overrun flag.
+ *  Overrun means FIFO is full, in stream mode next sample overwrites the oldest one.
+ *  Returns error code from SPI write
+ */
+lis2dh12_ret_t lis2dh12_get_fifo_status(size_t* count, bool* overrun);
+
 /**
  *  Sets FIFO watermark level, up to 32. After FIFO has number of samples
  *  defined by watermark interrupt occurs. Remember to set interrupts using lis2dh12_set_inhterrupts
@@ -226,8 +240,53 @@ lis2dh12_ret_t lis2dh12_set_activity_interrupt_pin_2(uint16_t mg);
  */
 lis2dh12_ret_t lis2dh12_set_tap_interrupt(uint8_t click_cfg, int threshold_mg, int timelimit_ms, int latency_ms, int window_ms, uint8_t pin);
 
+/**
+ *  Enable free-fall detection on interrupt function 1: all axes below threshold_mg for duration_ms.
+ *  Interrupt is latched until lis2dh12_get_event_sources is called. Route function 1 to a pin with lis2dh12_set_interrupts.
+ *  Duration is converted to samples at current sample rate.
+ *
+ *  @return error code from SPI stack
+ */
+lis2dh12_ret_t lis2dh12_set_free_fall_interrupt(uint16_t threshold_mg, uint16_t duration_ms);
+
+/**
+ *  Enable 6D orientation change detection on interrupt function 1. Interrupt occurs when the axis
+ *  above threshold_mg changes and new orientation lasts duration_ms. Latched like free-fall.
+ *
+ *  @return error code from SPI stack
+ */
+lis2dh12_ret_t lis2dh12_set_orientation_interrupt(uint16_t threshold_mg, uint16_t duration_ms);
+
+/**
+ *  Read and clear latched event sources, INT1_SRC of interrupt function 1 and CLICK_SRC of tap detection.
+ *  See registers.h for bits.
+ *
+ *  @return error code from SPI stack
+ */
+lis2dh12_ret_t lis2dh12_get_event_sources(uint8_t* int1_source, uint8_t* click_source);
+
+/**
+ *  Defer configuration. Setters modify the register shadow only until lis2dh12_commit_configuration.
+ *  Getters return the deferred configuration. Without deferring each setter writes changed registers at once.
+ *
+ *  @return LIS2DH12_RET_OK
+ */
+lis2dh12_ret_t lis2dh12_begin_configuration(void);
+
+/**
+ *  Write registers changed since lis2dh12_begin_configuration, in ascending address order with a burst per
+ *  run of consecutive writable registers. Unchanged configuration takes no SPI transfers.
+ *  Note: FIFO reset by bypass and back to stream, or interrupt configuration which must be written after
+ *  its threshold, need separate commits.
+ *
+ *  @return error code from SPI stack
+ */
+lis2dh12_ret_t lis2dh12_commit_configuration(void);
+
 /**
  *  Internal functions for reading/writing registers. 
+ *  Writable registers are kept in a shadow which is read from sensor on init and set on reset.
+ *  Reads of writable registers other than REFERENCE come from the shadow without SPI traffic.
  */
 lis2dh12_ret_t lis2dh12_read_register(uint8_t address, uint8_t* const p_toRead, size_t count);
 lis2dh12_ret_t lis2dh12_write_register(uint8_t address, uint8_t* const dataToWrite, size_t count);
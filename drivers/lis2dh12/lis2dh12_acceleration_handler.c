@@ -2,7 +2,8 @@
 #include "ruuvi_endpoints.h"
 #include "nrf_error.h"
 #include "lis2dh12.h"
-#include "math.h"
+#include "lis2dh12_event_handler.h"
+#include "magnitude.h"
 
 #define NRF_LOG_MODULE_NAME "LIS2DH12_HANDLER"
 #include "nrf_log.h"
@@ -11,6 +12,22 @@
 
 static message_handler_state_t m_state = {0};
 
+/** Stream buffer, ring of samples waiting for stream handler **/
+static stream_handler               p_stream_handler = NULL;
+static acceleration_t               m_stream_buffer[LIS2DH12_STREAM_BUFFER_SIZE];
+static size_t                       m_stream_head     = 0;
+static size_t                       m_stream_count    = 0;
+static uint16_t                     m_stream_sequence = 0; // Sequence number of sample at head
+static lis2dh12_stream_statistics_t m_stream_statistics = {0};
+
+static void stream_reset(void)
+{
+  m_stream_head     = 0;
+  m_stream_count    = 0;
+  m_stream_sequence = 0;
+  memset(&m_stream_statistics, 0, sizeof(m_stream_statistics));
+}
+
 static ret_code_t set_sample_rate(uint8_t sample_rate)
 {
   ret_code_t err_code = LIS2DH12_RET_OK;
@@ -65,6 +82,13 @@ static ret_code_t set_transmission_rate(uint8_t transmission_rate)
         err_code |= ENDPOINT_NOT_IMPLEMENTED;
         break;
 
+    case TRANSMISSION_RATE_STREAM:
+        NRF_LOG_DEBUG("Enabling LIS interrupts for streaming\r\n");
+        stream_reset();
+        err_code |= lis2dh12_set_fifo_watermark(LIS2DH12_STREAM_WATERMARK);
+        err_code |= lis2dh12_set_interrupts(LIS2DH12_I1_WTM, 1);
+        break;
+
     case TRANSMISSION_RATE_NO_CHANGE:
         break;
     default :
@@ -187,6 +211,7 @@ static ret_code_t set_target(uint8_t target)
   m_state.p_nfc_handler = NULL;
   m_state.p_ram_handler = NULL;
   m_state.p_flash_handler = NULL;
+  p_stream_handler = NULL;
   m_state.configuration.target = target;  
   
   if(TRANSMISSION_TARGET_STOP == target)
@@ -199,6 +224,7 @@ static ret_code_t set_target(uint8_t target)
   if(TRANSMISSION_TARGET_BLE_GATT & target)
   {
   m_state.p_ble_gatt_handler = get_ble_gatt_handler();
+  p_stream_handler = get_ble_stream_handler();
   NRF_LOG_DEBUG("Setting up GATT handler\r\n");
   }
   if(TRANSMISSION_TARGET_BLE_ADV & target){m_state.p_ble_adv_handler = get_ble_adv_handler();}
@@ -250,6 +276,8 @@ static ret_code_t configure_sensor(const ruuvi_standard_message_t message)
   NRF_LOG_HEXDUMP_DEBUG((uint8_t*)payload, sizeof(ruuvi_sensor_configuration_t));
   NRF_LOG_DEBUG("Transmission rate\r\n");
   result.transmission_rate = set_transmission_rate(payload->transmission_rate);
+  //Sensor registers are written once, changed ones only
+  lis2dh12_begin_configuration();
   NRF_LOG_DEBUG("Resolution\r\n");  
   result.resolution = set_resolution(payload->resolution);
   NRF_LOG_DEBUG("Scale\r\n");  
@@ -263,6 +291,9 @@ static ret_code_t configure_sensor(const ruuvi_standard_message_t message)
   //Call sample rate as last as this may bring sensor out of sleep
   NRF_LOG_DEBUG("Sample rate\r\n");    
   result.sample_rate = set_sample_rate(payload->sample_rate);
+  result.sample_rate |= lis2dh12_commit_configuration();
+  // Event durations are in samples and thresholds in LSBs
+  lis2dh12_event_reconfigure();
 
   NRF_LOG_DEBUG("Configuration result:");
   NRF_LOG_HEXDUMP_DEBUG((uint8_t*)&(result.sample_rate), sizeof(result));
@@ -301,7 +332,7 @@ static ret_code_t read_sensor(const ruuvi_standard_message_t message)
     rvalue[0] = buffer.sensor.x;
     rvalue[1] = buffer.sensor.y;
     rvalue[2] = buffer.sensor.z;
-    rvalue[3] = sqrt(rvalue[0]*rvalue[0] + rvalue[1]*rvalue[1] + rvalue[2]*rvalue[2]);
+    magnitude_block((int16_t*)&buffer, &rvalue[3], 1);
     NRF_LOG_DEBUG("Sending raw reply\r\n");  
     ruuvi_standard_message_t reply = {.destination_endpoint = message.source_endpoint,
                                     .source_endpoint = ACCELERATION,
@@ -312,6 +343,29 @@ static ret_code_t read_sensor(const ruuvi_standard_message_t message)
     return err_code;
 }
 
+/**
+ *  Reply with current configuration and stream counters
+ */
+static ret_code_t query_sensor(const ruuvi_standard_message_t message)
+{
+  message_handler p_reply_handler = get_reply_handler();
+  if(!p_reply_handler) { return ENDPOINT_HANDLER_ERROR; }
+  ruuvi_standard_message_t reply = { .destination_endpoint = message.source_endpoint,
+                                     .source_endpoint      = message.destination_endpoint,
+                                     .type                 = SENSOR_CONFIGURATION,
+                                     .payload              = { 0 }};
+  memcpy(reply.payload, &m_state.configuration, sizeof(reply.payload));
+  ret_code_t err_code = p_reply_handler(reply);
+
+  // Counters wrap around like sequence numbers, receiver compares differences
+  uint16_t counters[4] = { m_stream_statistics.samples, m_stream_statistics.sent,
+                           m_stream_statistics.dropped, m_stream_statistics.overruns };
+  reply.type = UINT16;
+  memcpy(reply.payload, counters, sizeof(reply.payload));
+  err_code |= p_reply_handler(reply);
+  return err_code;
+}
+
 /**
  *  Copy function pointer address to which to send the data to be chained
  *  TODO: Check how this could be deduplicated
@@ -369,8 +423,7 @@ ret_code_t lis2dh12_acceleration_handler(const ruuvi_standard_message_t message)
       break;
       
     case STATUS_QUERY: 
-      return unknown_handler(message);
-      //return query_sensor(message); TODO
+      return query_sensor(message);
       break;
       
     case DATA_QUERY:
@@ -412,15 +465,74 @@ static void process(const ruuvi_standard_message_t message)
   }
 }
 
+/** Move samples from sensor FIFO to stream buffer, oldest samples are dropped if buffer is full **/
+static void stream_read_fifo(void)
+{
+  size_t count = 0;
+  bool overrun = false;
+  lis2dh12_get_fifo_status(&count, &overrun);
+  if(overrun) { m_stream_statistics.overruns++; }
+  lis2dh12_sensor_buffer_t buffer[LIS2DH12_FIFO_MAX_LENGTH];
+  lis2dh12_read_samples(buffer, count);
+  m_stream_statistics.samples += count;
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    if(LIS2DH12_STREAM_BUFFER_SIZE == m_stream_count)
+    {
+      // Sequence number moves past dropped sample, receiver sees a gap
+      m_stream_head = (m_stream_head + 1) % LIS2DH12_STREAM_BUFFER_SIZE;
+      m_stream_count--;
+      m_stream_sequence++;
+      m_stream_statistics.dropped++;
+    }
+    m_stream_buffer[(m_stream_head + m_stream_count) % LIS2DH12_STREAM_BUFFER_SIZE] = buffer[ii].sensor;
+    m_stream_count++;
+  }
+}
+
+ret_code_t lis2dh12_stream_process(void)
+{
+  ret_code_t err_code = ENDPOINT_SUCCESS;
+  if(NULL == p_stream_handler || TRANSMISSION_RATE_STREAM != m_state.configuration.transmission_rate) { return err_code; }
+  while(m_stream_count && ENDPOINT_SUCCESS == err_code)
+  {
+    // Handler takes contiguous samples, ring buffer wraps at most once
+    size_t count = MIN(m_stream_count, LIS2DH12_STREAM_BUFFER_SIZE - m_stream_head);
+    size_t sent = 0;
+    err_code = p_stream_handler(ACCELERATION, m_stream_sequence, (uint8_t*)&m_stream_buffer[m_stream_head],
+                                sizeof(acceleration_t), count, &sent);
+    m_stream_head      = (m_stream_head + sent) % LIS2DH12_STREAM_BUFFER_SIZE;
+    m_stream_count    -= sent;
+    m_stream_sequence += sent;
+    m_stream_statistics.sent += sent;
+  }
+  return err_code;
+}
+
+void lis2dh12_stream_statistics_get(lis2dh12_stream_statistics_t* statistics)
+{
+  *statistics = m_stream_statistics;
+}
+
 /** Scheduler handler to read accelerometer buffer **/
 void lis2dh12_scheduler_event_handler(void *p_event_data, uint16_t event_size)
 {
     NRF_LOG_DEBUG("Accelerometer scheduled function\r\n");
+    // Whole FIFO goes to stream, remaining samples wait for next call or BLE TX complete
+    if(TRANSMISSION_RATE_STREAM == m_state.configuration.transmission_rate)
+    {
+      stream_read_fifo();
+      lis2dh12_stream_process();
+      return;
+    }
     size_t count = 0;
     lis2dh12_get_fifo_sample_number(&count);
     lis2dh12_sensor_buffer_t buffer[32];
     memset(buffer, 0, sizeof(buffer));
     lis2dh12_read_samples(buffer, count);
+    // Magnitude channel of the whole block at once
+    uint16_t magnitudes[32];
+    magnitude_block((int16_t*)buffer, magnitudes, count);
     NRF_LOG_DEBUG("Sending raw UINT16 reply\r\n");
     for(int ii = 0; ii < count; ii++)
     {
@@ -428,7 +540,8 @@ void lis2dh12_scheduler_event_handler(void *p_event_data, uint16_t event_size)
         rvalue[0] = buffer[ii].sensor.x;
         rvalue[1] = buffer[ii].sensor.y;
         rvalue[2] = buffer[ii].sensor.z;
-        rvalue[3] = sqrt(rvalue[0]*rvalue[0] + rvalue[1]*rvalue[1] + rvalue[2]*rvalue[2]);
+        // Magnitude above 32767 mg is possible only at 16 g scale, saturate for INT16 payload
+        rvalue[3] = MIN(magnitudes[ii], INT16_MAX);
         ruuvi_standard_message_t reply = {.destination_endpoint = m_state.destination_endpoint,
                                         .source_endpoint = ACCELERATION,
                                         .type = INT16,
@@ -18,6 +18,29 @@
 #include "ruuvi_endpoints.h"
 #include "nrf_error.h"
 
+/**
+ *  Streaming: configure transmission rate TRANSMISSION_RATE_STREAM with target TRANSMISSION_TARGET_BLE_GATT.
+ *  Every FIFO block is moved to a stream buffer and offered to the stream handler (set_ble_stream_handler),
+ *  which packs samples into sample stream blocks, see ruuvi_sample_stream.h. Samples the handler cannot send
+ *  stay in the stream buffer until lis2dh12_stream_process is called again, i.e. from BLE TX complete.
+ *  If stream buffer fills up, oldest samples are dropped and the sequence number skips them.
+ *  Chained channels do not receive samples while streaming.
+ */
+#ifndef LIS2DH12_STREAM_BUFFER_SIZE
+  #define LIS2DH12_STREAM_BUFFER_SIZE 256 // Samples kept while transport is busy, 640 ms at 400 Hz
+#endif
+#ifndef LIS2DH12_STREAM_WATERMARK
+  #define LIS2DH12_STREAM_WATERMARK   16  // FIFO samples per interrupt while streaming, leaves 40 ms of headroom at 400 Hz
+#endif
+
+/** Stream counters since streaming was configured. STATUS_QUERY returns them as UINT16 in this order **/
+typedef struct{
+  uint32_t samples;   // Samples read from sensor FIFO
+  uint32_t sent;      // Samples accepted by stream handler
+  uint32_t dropped;   // Samples dropped from full stream buffer
+  uint32_t overruns;  // FIFO reads which found sensor FIFO full, sensor may have overwritten samples
+}lis2dh12_stream_statistics_t;
+
 /**
  *  Handle messages with "ACCELERATION" as destination endpoint. This should not be called directly, but rather
  *  through ruuvi_endpoints function route_message. 
@@ -55,4 +78,14 @@ ret_code_t lis2dh12_int1_handler(const ruuvi_standard_message_t message);
  */
 void lis2dh12_scheduler_event_handler(void *p_event_data, uint16_t event_size);
 
+/**
+ *  Offer buffered samples to stream handler. Register with ble_stream_set_ready_handler.
+ *
+ *  @return ENDPOINT_SUCCESS if stream buffer is empty, error from stream handler otherwise
+ */
+ret_code_t lis2dh12_stream_process(void);
+
+/** Copy stream counters to statistics **/
+void lis2dh12_stream_statistics_get(lis2dh12_stream_statistics_t* statistics);
+
 #endif
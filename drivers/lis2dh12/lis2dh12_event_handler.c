@@ -0,0 +1,294 @@
+#include "lis2dh12_event_handler.h"
+#include "ruuvi_endpoints.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "lis2dh12.h"
+
+#define NRF_LOG_MODULE_NAME "LIS2DH12_EVENT"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#define TAP_MODE_OFF    0
+#define TAP_MODE_SINGLE 1
+#define TAP_MODE_DOUBLE 2
+#define TAP_AXIS_X      1
+#define TAP_AXIS_Y      2
+#define TAP_AXIS_Z      4
+#define NO_CHANGE       255
+
+typedef struct{
+  uint8_t  mode;          // TAP_MODE_
+  uint8_t  axes;          // TAP_AXIS_
+  uint16_t threshold_mg;
+  uint8_t  time_limit_ms;
+  uint8_t  latency_ms;
+  uint16_t window_ms;
+  uint16_t events;
+  uint8_t  destination;   // Endpoint which configured tap
+}tap_state_t;
+
+/** Free-fall and orientation on interrupt function 1 **/
+typedef struct{
+  uint8_t  enabled;
+  uint16_t threshold_mg;
+  uint16_t duration_ms;
+  uint16_t events;
+  uint8_t  destination;
+}function_1_state_t;
+
+static tap_state_t        m_tap         = { .mode = TAP_MODE_OFF, .axes = TAP_AXIS_Z,
+                                            .threshold_mg  = LIS2DH12_TAP_THRESHOLD_MG,
+                                            .time_limit_ms = LIS2DH12_TAP_TIME_LIMIT_MS,
+                                            .latency_ms    = LIS2DH12_TAP_LATENCY_MS,
+                                            .window_ms     = LIS2DH12_TAP_WINDOW_MS };
+static function_1_state_t m_free_fall   = { .threshold_mg = LIS2DH12_FREE_FALL_THRESHOLD_MG,
+                                            .duration_ms  = LIS2DH12_FREE_FALL_DURATION_MS };
+static function_1_state_t m_orientation = { .threshold_mg = LIS2DH12_ORIENTATION_THRESHOLD_MG,
+                                            .duration_ms  = LIS2DH12_ORIENTATION_DURATION_MS };
+static lis2dh12_activity_handler_t p_activity_handler = NULL;
+
+static bool events_enabled(void)
+{
+  return TAP_MODE_OFF != m_tap.mode || m_free_fall.enabled || m_orientation.enabled;
+}
+
+/** Set and clear routing bits of pin 2, keeps interrupts of others, i.e. activity **/
+static ret_code_t route_pin_2(uint8_t set, uint8_t clear)
+{
+  uint8_t value = 0;
+  ret_code_t err_code = lis2dh12_read_register(LIS2DH12_CTRL_REG6, &value, 1);
+  value = (value & ~clear) | set;
+  err_code |= lis2dh12_set_interrupts(value, 2);
+  return err_code;
+}
+
+/** CLICK_CFG of tap mode and axes **/
+static uint8_t click_configuration(uint8_t mode, uint8_t axes)
+{
+  uint8_t cfg = 0;
+  if(TAP_MODE_SINGLE == mode)
+  {
+    if(axes & TAP_AXIS_X) { cfg |= LIS2DH12_XS_MASK; }
+    if(axes & TAP_AXIS_Y) { cfg |= LIS2DH12_YS_MASK; }
+    if(axes & TAP_AXIS_Z) { cfg |= LIS2DH12_ZS_MASK; }
+  }
+  else if(TAP_MODE_DOUBLE == mode)
+  {
+    if(axes & TAP_AXIS_X) { cfg |= LIS2DH12_XD_MASK; }
+    if(axes & TAP_AXIS_Y) { cfg |= LIS2DH12_YD_MASK; }
+    if(axes & TAP_AXIS_Z) { cfg |= LIS2DH12_ZD_MASK; }
+  }
+  return cfg;
+}
+
+static ret_code_t tap_apply(void)
+{
+  ret_code_t err_code = LIS2DH12_RET_OK;
+  if(TAP_MODE_OFF == m_tap.mode)
+  {
+    uint8_t value = 0;
+    err_code |= lis2dh12_write_register(LIS2DH12_CLICK_CFG, &value, 1);
+    err_code |= route_pin_2(0, LIS2DH12_I2C_CCK_EN_MASK);
+    return err_code;
+  }
+  // lis2dh12_set_tap_interrupt replaces pin 2 routing, restore others after it
+  uint8_t routing = 0;
+  err_code |= lis2dh12_read_register(LIS2DH12_CTRL_REG6, &routing, 1);
+  err_code |= lis2dh12_set_tap_interrupt(click_configuration(m_tap.mode, m_tap.axes), m_tap.threshold_mg,
+                                         m_tap.time_limit_ms, m_tap.latency_ms, m_tap.window_ms, 2);
+  err_code |= route_pin_2(routing | LIS2DH12_I2C_CCK_EN_MASK, 0);
+
+  // Latch tap until CLICK_SRC is read, short pulse could be gone before scheduled read
+  uint8_t threshold = 0;
+  err_code |= lis2dh12_read_register(LIS2DH12_CLICK_THS, &threshold, 1);
+  threshold |= LIS2DH12_LIR_CLICK_MASK;
+  err_code |= lis2dh12_write_register(LIS2DH12_CLICK_THS, &threshold, 1);
+  return err_code;
+}
+
+/** Apply state of free-fall or orientation to interrupt function 1 **/
+static ret_code_t function_1_apply(void)
+{
+  ret_code_t err_code = LIS2DH12_RET_OK;
+  if(m_free_fall.enabled)
+  {
+    err_code |= lis2dh12_set_free_fall_interrupt(m_free_fall.threshold_mg, m_free_fall.duration_ms);
+  }
+  else if(m_orientation.enabled)
+  {
+    err_code |= lis2dh12_set_orientation_interrupt(m_orientation.threshold_mg, m_orientation.duration_ms);
+  }
+  else
+  {
+    err_code |= lis2dh12_set_interrupt_configuration(0, 1);
+    err_code |= route_pin_2(0, LIS2DH12_I2C_INT1_MASK);
+    return err_code;
+  }
+  err_code |= route_pin_2(LIS2DH12_I2C_INT1_MASK, 0);
+  return err_code;
+}
+
+static ret_code_t reply_status(const ruuvi_standard_message_t message)
+{
+  message_handler p_reply_handler = get_reply_handler();
+  if(!p_reply_handler) { return ENDPOINT_HANDLER_ERROR; }
+  ruuvi_standard_message_t reply = { .destination_endpoint = message.source_endpoint,
+                                     .source_endpoint      = message.destination_endpoint,
+                                     .type                 = UINT16,
+                                     .payload              = { 0 }};
+  uint16_t status[4] = { 0 };
+  if(TAP_DETECTOR == message.destination_endpoint)
+  {
+    status[0] = m_tap.mode;
+    status[1] = m_tap.axes;
+    status[2] = m_tap.threshold_mg;
+    status[3] = m_tap.events;
+  }
+  else
+  {
+    const function_1_state_t* state = (FREE_FALL_DETECTOR == message.destination_endpoint) ? &m_free_fall : &m_orientation;
+    status[0] = state->enabled;
+    status[1] = state->threshold_mg;
+    status[2] = state->duration_ms;
+    status[3] = state->events;
+  }
+  memcpy(reply.payload, status, sizeof(reply.payload));
+  return p_reply_handler(reply);
+}
+
+/** 0 keeps current value, mode 255 keeps current mode **/
+static ret_code_t configure_tap(const ruuvi_standard_message_t message)
+{
+  uint8_t mode = message.payload[0];
+  if(mode > TAP_MODE_DOUBLE && NO_CHANGE != mode) { return ENDPOINT_INVALID; }
+  if(message.payload[1] & ~(TAP_AXIS_X | TAP_AXIS_Y | TAP_AXIS_Z)) { return ENDPOINT_INVALID; }
+  if(NO_CHANGE != mode)
+  {
+    if(TAP_MODE_OFF == m_tap.mode && TAP_MODE_OFF != mode) { m_tap.events = 0; }
+    m_tap.mode = mode;
+  }
+  uint16_t threshold_mg = uint16_decode(&message.payload[2]);
+  uint16_t window_ms    = uint16_decode(&message.payload[6]);
+  if(message.payload[1]) { m_tap.axes = message.payload[1]; }
+  if(threshold_mg)       { m_tap.threshold_mg = threshold_mg; }
+  if(message.payload[4]) { m_tap.time_limit_ms = message.payload[4]; }
+  if(message.payload[5]) { m_tap.latency_ms = message.payload[5]; }
+  if(window_ms)          { m_tap.window_ms = window_ms; }
+  m_tap.destination = message.source_endpoint;
+  if(LIS2DH12_RET_OK != tap_apply()) { return ENDPOINT_HANDLER_ERROR; }
+  NRF_LOG_INFO("Tap mode %d, axes %d, threshold %d mg\r\n", m_tap.mode, m_tap.axes, m_tap.threshold_mg);
+  return reply_status(message);
+}
+
+/** 0 keeps current value, enable 255 keeps current state **/
+static ret_code_t configure_function_1(const ruuvi_standard_message_t message)
+{
+  function_1_state_t* state = (FREE_FALL_DETECTOR == message.destination_endpoint) ? &m_free_fall : &m_orientation;
+  const function_1_state_t* other = (&m_free_fall == state) ? &m_orientation : &m_free_fall;
+  uint8_t enable = message.payload[0];
+  if(enable > 1 && NO_CHANGE != enable) { return ENDPOINT_INVALID; }
+  if(1 == enable && other->enabled) { return ENDPOINT_NOT_SUPPORTED; }
+  if(NO_CHANGE != enable)
+  {
+    if(!state->enabled && enable) { state->events = 0; }
+    state->enabled = enable;
+  }
+  uint16_t threshold_mg = uint16_decode(&message.payload[2]);
+  uint16_t duration_ms  = uint16_decode(&message.payload[4]);
+  if(threshold_mg) { state->threshold_mg = threshold_mg; }
+  if(duration_ms)  { state->duration_ms  = duration_ms; }
+  state->destination = message.source_endpoint;
+  if(LIS2DH12_RET_OK != function_1_apply()) { return ENDPOINT_HANDLER_ERROR; }
+  NRF_LOG_INFO("Event %x %d, threshold %d mg\r\n", message.destination_endpoint, state->enabled, state->threshold_mg);
+  return reply_status(message);
+}
+
+ret_code_t lis2dh12_event_handler(const ruuvi_standard_message_t message)
+{
+  if(TAP_DETECTOR != message.destination_endpoint && FREE_FALL_DETECTOR != message.destination_endpoint
+     && ORIENTATION_DETECTOR != message.destination_endpoint) { return ENDPOINT_INVALID; }
+  switch(message.type)
+  {
+    case SENSOR_CONFIGURATION:
+      if(TAP_DETECTOR == message.destination_endpoint) { return configure_tap(message); }
+      return configure_function_1(message);
+
+    case STATUS_QUERY:
+      return reply_status(message);
+
+    default:
+      return unknown_handler(message);
+  }
+}
+
+static void send_event(uint8_t endpoint, uint8_t destination, uint16_t events, uint8_t source)
+{
+  message_handler p_gatt_handler = get_ble_gatt_handler();
+  if(!p_gatt_handler) { return; }
+  ruuvi_standard_message_t event = { .destination_endpoint = destination,
+                                     .source_endpoint      = endpoint,
+                                     .type                 = UINT16,
+                                     .payload              = { 0 }};
+  uint16_t values[4] = { events, source, 0, 0 };
+  memcpy(event.payload, values, sizeof(event.payload));
+  p_gatt_handler(event);
+}
+
+/** Scheduler handler to read and clear latched event sources **/
+static void event_scheduler_handler(void *p_event_data, uint16_t event_size)
+{
+  uint8_t int1_source = 0, click_source = 0, int2_source = 0;
+  if(LIS2DH12_RET_OK != lis2dh12_get_event_sources(&int1_source, &click_source)) { return; }
+  lis2dh12_read_register(LIS2DH12_INT2_SOURCE, &int2_source, 1);
+  NRF_LOG_DEBUG("Event sources %x %x %x\r\n", int1_source, click_source, int2_source);
+
+  // Activity is not latched and may be over already, interrupt without latched event source was activity
+  bool event = (click_source & LIS2DH12_CLK_IA_MASK) || (int1_source & LIS2DH12_INT_IA_MASK);
+  if(((int2_source & LIS2DH12_INT_IA_MASK) || !event) && p_activity_handler) { p_activity_handler(); }
+
+  bool tap = (TAP_MODE_SINGLE == m_tap.mode && (click_source & LIS2DH12_SCLICK_MASK))
+          || (TAP_MODE_DOUBLE == m_tap.mode && (click_source & LIS2DH12_DCLICK_MASK));
+  if((click_source & LIS2DH12_CLK_IA_MASK) && tap)
+  {
+    send_event(TAP_DETECTOR, m_tap.destination, ++m_tap.events, click_source);
+  }
+  if(int1_source & LIS2DH12_INT_IA_MASK)
+  {
+    if(m_free_fall.enabled)
+    {
+      send_event(FREE_FALL_DETECTOR, m_free_fall.destination, ++m_free_fall.events, int1_source);
+    }
+    else if(m_orientation.enabled)
+    {
+      send_event(ORIENTATION_DETECTOR, m_orientation.destination, ++m_orientation.events, int1_source);
+    }
+  }
+}
+
+ret_code_t lis2dh12_event_int2_handler(const ruuvi_standard_message_t message)
+{
+  if(!events_enabled())
+  {
+    if(p_activity_handler) { p_activity_handler(); }
+    return NRF_SUCCESS;
+  }
+  return app_sched_event_put(NULL, 0, event_scheduler_handler);
+}
+
+void lis2dh12_event_set_activity_handler(lis2dh12_activity_handler_t handler)
+{
+  p_activity_handler = handler;
+}
+
+ret_code_t lis2dh12_event_reconfigure(void)
+{
+  ret_code_t err_code = NRF_SUCCESS;
+  if(TAP_MODE_OFF != m_tap.mode) { err_code |= tap_apply(); }
+  if(m_free_fall.enabled || m_orientation.enabled) { err_code |= function_1_apply(); }
+  return err_code;
+}
+
+bool lis2dh12_event_active_rate_required(void)
+{
+  return TAP_MODE_OFF != m_tap.mode || m_free_fall.enabled;
+}
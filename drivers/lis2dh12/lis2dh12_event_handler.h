@@ -0,0 +1,94 @@
+#ifndef LIS2DH12_EVENT_HANDLER_H
+#define LIS2DH12_EVENT_HANDLER_H
+
+/**
+ *  Handler for event endpoints of LIS2DH12 built-in detection: tap, free-fall and 6D orientation change.
+ *  Application gets a message per physical event without streaming or polling acceleration.
+ *
+ *  Events are routed to interrupt pin 2 next to activity interrupt of the application, tap from click
+ *  detection and free-fall or orientation from interrupt function 1. Free-fall and orientation share
+ *  interrupt function 1, only one of them can be enabled at a time. Tap and function 1 are latched,
+ *  pin 2 stays high until the scheduled read clears the sources, activity edges are not seen meanwhile.
+ *  Durations are converted to samples and thresholds to LSBs at current sample rate and scale, call
+ *  lis2dh12_event_reconfigure after changing them. Tap and free-fall last a few tens of ms and need a
+ *  high sample rate, see lis2dh12_set_tap_interrupt, the application should not go to a low-power rate
+ *  while lis2dh12_event_active_rate_required returns true.
+ *
+ *  TAP_DETECTOR endpoint:
+ *    SENSOR_CONFIGURATION  payload: mode (0 off, 1 single, 2 double, 255 no change), axes (X 1, Y 2, Z 4),
+ *                          threshold mg (uint16), time limit ms, latency ms, window ms (uint16).
+ *                          0 keeps current value. Little endian. Replies like STATUS_QUERY.
+ *    STATUS_QUERY          replies with UINT16 mode, axes, threshold mg, events
+ *  FREE_FALL_DETECTOR and ORIENTATION_DETECTOR endpoints:
+ *    SENSOR_CONFIGURATION  payload: enable (0, 1, 255 no change), reserved, threshold mg (uint16),
+ *                          duration ms (uint16). 0 keeps current value. Replies like STATUS_QUERY.
+ *                          Enabling fails with ENDPOINT_NOT_SUPPORTED while the other one is enabled.
+ *    STATUS_QUERY          replies with UINT16 enabled, threshold mg, duration ms, events
+ *
+ *  Events are sent with BLE GATT to the endpoint which configured the event, type UINT16:
+ *  events since enabled, source register of the event (CLICK_SRC or INT1_SRC, see lis2dh12_registers.h).
+ *
+ *  Activity interrupt of the application shares pin 2. It is unlatched, so pin 2 interrupts which no latched
+ *  source explains, or which have INT2_SRC set, go to the activity handler. While no event is enabled every
+ *  interrupt is activity and the handler is called at once from lis2dh12_event_int2_handler, i.e. in interrupt
+ *  context. Otherwise it is called in scheduler after the sources are read.
+ */
+
+#include "ruuvi_endpoints.h"
+#include "nrf_error.h"
+
+/** Activity interrupt of the application, keep short, may be called in interrupt context **/
+typedef void(*lis2dh12_activity_handler_t)(void);
+
+#ifndef LIS2DH12_TAP_THRESHOLD_MG
+  #define LIS2DH12_TAP_THRESHOLD_MG          1000
+#endif
+#ifndef LIS2DH12_TAP_TIME_LIMIT_MS
+  #define LIS2DH12_TAP_TIME_LIMIT_MS         100
+#endif
+#ifndef LIS2DH12_TAP_LATENCY_MS
+  #define LIS2DH12_TAP_LATENCY_MS            100
+#endif
+#ifndef LIS2DH12_TAP_WINDOW_MS
+  #define LIS2DH12_TAP_WINDOW_MS             400
+#endif
+#ifndef LIS2DH12_FREE_FALL_THRESHOLD_MG
+  #define LIS2DH12_FREE_FALL_THRESHOLD_MG    350
+#endif
+#ifndef LIS2DH12_FREE_FALL_DURATION_MS
+  #define LIS2DH12_FREE_FALL_DURATION_MS     30
+#endif
+#ifndef LIS2DH12_ORIENTATION_THRESHOLD_MG
+  #define LIS2DH12_ORIENTATION_THRESHOLD_MG  600
+#endif
+#ifndef LIS2DH12_ORIENTATION_DURATION_MS
+  #define LIS2DH12_ORIENTATION_DURATION_MS   100
+#endif
+
+/**
+ *  Handle messages to TAP_DETECTOR, FREE_FALL_DETECTOR and ORIENTATION_DETECTOR.
+ *  Register with set_acceleration_event_handler, messages come through route_message.
+ *
+ *  @return ENDPOINT_SUCCESS if message was understood, error code otherwise
+ */
+ret_code_t lis2dh12_event_handler(const ruuvi_standard_message_t message);
+
+/**
+ *  Call from interrupt handler of LIS2DH12 pin 2. Schedules read of event sources if any event is enabled,
+ *  otherwise calls activity handler.
+ */
+ret_code_t lis2dh12_event_int2_handler(const ruuvi_standard_message_t message);
+
+/** Set handler of pin 2 interrupts which are activity, NULL ignores activity **/
+void lis2dh12_event_set_activity_handler(lis2dh12_activity_handler_t handler);
+
+/**
+ *  Reapply thresholds and durations of enabled events at current sample rate and scale.
+ *  Call after lis2dh12_commit_configuration of a sample rate or scale change.
+ */
+ret_code_t lis2dh12_event_reconfigure(void);
+
+/** True while tap or free-fall is enabled, they are not detected at idle sample rate **/
+bool lis2dh12_event_active_rate_required(void);
+
+#endif
@@ -13,6 +13,7 @@
 #define LIS2DH12_OUT_TEMP_L     0x0C
 #define LIS2DH12_OUT_TEMP_H     0x0D
 #define LIS2DH12_WHO_AM_I       0x0F
+#define LIS2DH12_CTRL_REG0      0x1E /*rw */
 #define LIS2DH12_TEMP_CFG_REG   0x1F /*rw */
 #define LIS2DH12_CTRL_REG1      0x20 /*rw */
 #define LIS2DH12_CTRL_REG2      0x21 /*rw */
@@ -191,6 +192,7 @@
 #define LIS2DH12_X_CLICK_MASK      0x01
 
 // CLICK_THS masks
+#define LIS2DH12_LIR_CLICK_MASK 0x80
 #define LIS2DH12_CLK_THS_MASK   0x7F
 
 // TIME_LIMIT masks
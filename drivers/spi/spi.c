@@ -17,6 +17,7 @@ For a detailed description see the detailed description in @ref spi.h
 
 
 /* INCLUDES ***************************************************************************************/
+#include <string.h>
 #include "spi.h"
 #include "nrf_drv_spi.h"
 #include "nrf_delay.h"
@@ -38,10 +39,15 @@ For a detailed description see the detailed description in @ref spi.h
 
 void spi_event_handler(nrf_drv_spi_evt_t const * p_event);
 
+static SPI_Ret spi_read(uint32_t ss_pin, uint8_t command, uint8_t* const p_toRead, uint8_t count);
+static SPI_Ret spi_write(uint32_t ss_pin, uint8_t command, const uint8_t* const p_toWrite, uint8_t count);
+
 /* VARIABLES **************************************************************************************/
 static const nrf_drv_spi_t spi = NRF_DRV_SPI_INSTANCE(SPI_INSTANCE);  /**< SPI instance. */
 volatile bool spi_xfer_done; /**< Semaphore to indicate that SPI instance completed the transfer. */
 static bool initDone = false;       /**< Flag to indicate if this module is already initilized */
+/** Command and data of transfer in RAM for EasyDMA, shared by sensors as one transfer runs at a time */
+static uint8_t scratch[SPI_WRITE_MAX_LENGTH + 1];
 
 /* EXTERNAL FUNCTIONS *****************************************************************************/
 
@@ -146,9 +152,85 @@ extern SPI_Ret spi_transfer_lis2dh12(uint8_t* const p_toWrite, uint8_t count, ui
     return retVal;
 }
 
+extern SPI_Ret spi_read_bme280(uint8_t command, uint8_t* const p_toRead, uint8_t count)
+{
+    return spi_read(SPIM0_SS_HUMI_PIN, command, p_toRead, count);
+}
+
+extern SPI_Ret spi_write_bme280(uint8_t command, const uint8_t* const p_toWrite, uint8_t count)
+{
+    return spi_write(SPIM0_SS_HUMI_PIN, command, p_toWrite, count);
+}
+
+extern SPI_Ret spi_read_lis2dh12(uint8_t command, uint8_t* const p_toRead, uint8_t count)
+{
+    return spi_read(SPIM0_SS_ACC_PIN, command, p_toRead, count);
+}
+
+extern SPI_Ret spi_write_lis2dh12(uint8_t command, const uint8_t* const p_toWrite, uint8_t count)
+{
+    return spi_write(SPIM0_SS_ACC_PIN, command, p_toWrite, count);
+}
+
 
 /* INTERNAL FUNCTIONS *****************************************************************************/
 
+/**
+ * Run one transfer and wait for it to complete. Chip select is handled by caller.
+ * Buffers may be NULL with length 0, missing TX bytes are clocked out as over-read character.
+ */
+static SPI_Ret spi_xfer(const uint8_t* p_toWrite, uint8_t write_count, uint8_t* p_toRead, uint8_t read_count)
+{
+    spi_xfer_done = false;
+    if (NRF_SUCCESS != nrf_drv_spi_transfer(&spi, p_toWrite, write_count, p_toRead, read_count))
+    {
+        spi_xfer_done = true;
+        return SPI_RET_ERROR;
+    }
+    while (!spi_xfer_done)
+    {
+        //Requires initialized softdevice
+        sd_app_evt_wait();
+    }
+    return SPI_RET_OK;
+}
+
+/**
+ * Send command byte from scratch buffer, then clock data directly to p_toRead while chip select is held low.
+ * Response to the command byte is not stored, so no intermediate buffer or copy is needed.
+ */
+static SPI_Ret spi_read(uint32_t ss_pin, uint8_t command, uint8_t* const p_toRead, uint8_t count)
+{
+    if (NULL == p_toRead) { return SPI_RET_ERROR; }
+    /* check if an other SPI transfer is running */
+    if (true != spi_xfer_done) { return SPI_RET_BUSY; }
+
+    scratch[0] = command;
+    nrf_gpio_pin_clear(ss_pin);
+    SPI_Ret retVal = spi_xfer(scratch, 1, NULL, 0);
+    if (SPI_RET_OK == retVal) { retVal = spi_xfer(NULL, 0, p_toRead, count); }
+    nrf_gpio_pin_set(ss_pin);
+    return retVal;
+}
+
+/**
+ * Copy command and data to scratch buffer, which EasyDMA can read even if data is a constant in flash.
+ * Nothing is received.
+ */
+static SPI_Ret spi_write(uint32_t ss_pin, uint8_t command, const uint8_t* const p_toWrite, uint8_t count)
+{
+    if ((NULL == p_toWrite && count) || SPI_WRITE_MAX_LENGTH < count) { return SPI_RET_ERROR; }
+    /* check if an other SPI transfer is running */
+    if (true != spi_xfer_done) { return SPI_RET_BUSY; }
+
+    scratch[0] = command;
+    if (count) { memcpy(&scratch[1], p_toWrite, count); }
+    nrf_gpio_pin_clear(ss_pin);
+    SPI_Ret retVal = spi_xfer(scratch, count + 1, NULL, 0);
+    nrf_gpio_pin_set(ss_pin);
+    return retVal;
+}
+
 
 /**
  * SPI user event handler
@@ -26,6 +26,8 @@ extern "C"
 #include "app_error.h"
 
 /* CONSTANTS **************************************************************************************/
+/** Longest data of spi_write_* after command byte */
+#define SPI_WRITE_MAX_LENGTH 32
 
 /* MACROS *****************************************************************************************/
 
@@ -77,6 +79,47 @@ extern SPI_Ret spi_transfer_bme280(uint8_t* const p_toWrite, uint8_t count, uint
  */
 extern SPI_Ret spi_transfer_lis2dh12(uint8_t* const p_toWrite, uint8_t count, uint8_t* const p_toRead);
 
+/**
+ * Read from bme280 environmental sensor in place
+ *
+ * Command byte is sent, then count bytes are received directly to p_toRead.
+ * Chip select stays low over both, no intermediate buffer is used.
+ *
+ * @param[in] command Command byte, i.e. register address with read bit
+ * @param[out] p_toRead Receive buffer, must be in RAM
+ * @param[in] count Number of bytes to receive
+ *
+ * @return SPI_RET_OK SPI transfer was successful
+ * @return SPI_RET_BUSY SPI is busy with other transfer, please try again
+ * @return SPI_RET_ERROR p_toRead is NULL or transfer could not be started
+ */
+extern SPI_Ret spi_read_bme280(uint8_t command, uint8_t* const p_toRead, uint8_t count);
+
+/**
+ * Write to bme280 environmental sensor
+ *
+ * Command byte and data are copied to a static buffer in RAM for EasyDMA, data may be in flash.
+ *
+ * @param[in] command Command byte, i.e. register address without read bit
+ * @param[in] p_toWrite Data after command byte
+ * @param[in] count Number of data bytes, 0 ... SPI_WRITE_MAX_LENGTH
+ *
+ * @return SPI_RET_OK SPI transfer was successful
+ * @return SPI_RET_BUSY SPI is busy with other transfer, please try again
+ * @return SPI_RET_ERROR count is too large or transfer could not be started
+ */
+extern SPI_Ret spi_write_bme280(uint8_t command, const uint8_t* const p_toWrite, uint8_t count);
+
+/**
+ * Read from lis2dh12 Acceleration Sensor in place, see spi_read_bme280
+ */
+extern SPI_Ret spi_read_lis2dh12(uint8_t command, uint8_t* const p_toRead, uint8_t count);
+
+/**
+ * Write to lis2dh12 Acceleration Sensor, see spi_write_bme280
+ */
+extern SPI_Ret spi_write_lis2dh12(uint8_t command, const uint8_t* const p_toWrite, uint8_t count);
+
 #ifdef __cplusplus
 }
 #endif
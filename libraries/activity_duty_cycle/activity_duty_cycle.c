@@ -0,0 +1,56 @@
+#include "activity_duty_cycle.h"
+
+#include <stdbool.h>
+
+#define NRF_LOG_MODULE_NAME "DUTY_CYCLE"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+static activity_duty_cycle_config_t m_config;
+static activity_state_t m_state               = ACTIVITY_STATE_ACTIVE;
+static uint32_t         m_last_activity       = 0;
+static uint16_t         m_acceleration_events = 0;
+static bool             m_has_events          = false;
+
+void activity_duty_cycle_init(const activity_duty_cycle_config_t* config, uint32_t now_ms)
+{
+  m_config        = *config;
+  m_state         = ACTIVITY_STATE_ACTIVE;
+  m_last_activity = now_ms;
+  m_has_events    = false;
+}
+
+activity_state_t activity_duty_cycle_on_wake(uint32_t now_ms)
+{
+  if(ACTIVITY_STATE_IDLE == m_state) { NRF_LOG_DEBUG("Activity, accelerometer active\r\n"); }
+  m_state         = ACTIVITY_STATE_ACTIVE;
+  m_last_activity = now_ms;
+  return m_state;
+}
+
+activity_state_t activity_duty_cycle_update(uint16_t acceleration_events, uint16_t motion, uint32_t now_ms)
+{
+  // First counter value is the reference, not activity
+  bool events = m_has_events && acceleration_events != m_acceleration_events;
+  m_acceleration_events = acceleration_events;
+  m_has_events          = true;
+
+  // Wake interrupt may have been lost, i.e. in a full scheduler queue
+  if(events) { return activity_duty_cycle_on_wake(now_ms); }
+
+  if(ACTIVITY_STATE_ACTIVE == m_state)
+  {
+    if(motion >= m_config.motion_threshold) { m_last_activity = now_ms; }
+    else if(now_ms - m_last_activity >= m_config.quiet_period_ms)
+    {
+      NRF_LOG_DEBUG("Quiet for %d ms, accelerometer idle\r\n", now_ms - m_last_activity);
+      m_state = ACTIVITY_STATE_IDLE;
+    }
+  }
+  return m_state;
+}
+
+activity_state_t activity_duty_cycle_state_get(void)
+{
+  return m_state;
+}
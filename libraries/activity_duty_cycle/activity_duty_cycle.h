@@ -0,0 +1,51 @@
+#ifndef ACTIVITY_DUTY_CYCLE_H
+#define ACTIVITY_DUTY_CYCLE_H
+
+#include <stdint.h>
+
+/**
+ *  Accelerometer duty cycle which follows activity.
+ *
+ *  Idle state runs the accelerometer slowly with its activity interrupt armed, active state runs it at
+ *  full rate. Activity interrupt wakes up to active state. Active state is kept while activity interrupts
+ *  come or motion between samples is at or over motion_threshold, and falls back to idle after
+ *  quiet_period_ms without either. Motion threshold below the activity interrupt threshold and the quiet
+ *  period give hysteresis, so movement which woke the sensor keeps it awake and short pauses do not
+ *  put it back to sleep.
+ *
+ *  Time is in ms of a free running 32-bit clock, differences are taken modulo 2^32.
+ *  Application reconfigures the sensor when returned state differs from the previous one.
+ */
+typedef enum {
+  ACTIVITY_STATE_IDLE   = 0,
+  ACTIVITY_STATE_ACTIVE = 1
+}activity_state_t;
+
+typedef struct {
+  uint32_t quiet_period_ms;  //!< Time without activity before idle
+  uint16_t motion_threshold; //!< mg, RMS change between accelerometer samples which counts as activity
+}activity_duty_cycle_config_t;
+
+/** Start in active state at now_ms, quiet period starts now **/
+void activity_duty_cycle_init(const activity_duty_cycle_config_t* config, uint32_t now_ms);
+
+/**
+ *  Activity interrupt, call out of interrupt context.
+ *
+ *  @return ACTIVITY_STATE_ACTIVE
+ */
+activity_state_t activity_duty_cycle_on_wake(uint32_t now_ms);
+
+/**
+ *  Feed accelerometer data of a sample period. Motion is ignored in idle state, where samples are sparse.
+ *
+ *  @param acceleration_events counter of activity interrupts, a change is activity
+ *  @param motion mg, RMS change between accelerometer samples since previous update, see motion_aggregate.h
+ *  @return state to use from now on
+ */
+activity_state_t activity_duty_cycle_update(uint16_t acceleration_events, uint16_t motion, uint32_t now_ms);
+
+/** Current state **/
+activity_state_t activity_duty_cycle_state_get(void);
+
+#endif
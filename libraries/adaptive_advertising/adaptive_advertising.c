@@ -0,0 +1,68 @@
+#include "adaptive_advertising.h"
+
+#include <stdlib.h>
+
+#define NRF_LOG_MODULE_NAME "ADAPTIVE_ADV"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+static adaptive_advertising_config_t m_config;
+static ruuvi_sensor_t m_reference;
+static uint16_t m_acceleration_events = 0;
+static bool     m_has_reference       = false;
+static uint8_t  m_steady              = 0;
+static uint16_t m_interval            = 0;
+
+static bool exceeds(int32_t a, int32_t b, int32_t threshold)
+{
+  return abs(a - b) > threshold;
+}
+
+static bool has_changed(const ruuvi_sensor_t* data, uint16_t acceleration_events, uint16_t motion)
+{
+  return !m_has_reference
+      || acceleration_events != m_acceleration_events
+      || (m_config.motion_threshold && motion > m_config.motion_threshold)
+      || exceeds(data->temperature, m_reference.temperature, m_config.temperature_threshold)
+      || exceeds(data->humidity, m_reference.humidity, m_config.humidity_threshold)
+      || exceeds(data->pressure, m_reference.pressure, m_config.pressure_threshold)
+      || exceeds(data->accX, m_reference.accX, m_config.acceleration_threshold)
+      || exceeds(data->accY, m_reference.accY, m_config.acceleration_threshold)
+      || exceeds(data->accZ, m_reference.accZ, m_config.acceleration_threshold);
+}
+
+void adaptive_advertising_init(const adaptive_advertising_config_t* config)
+{
+  m_config = *config;
+  if(m_config.max_interval < m_config.min_interval) { m_config.max_interval = m_config.min_interval; }
+  m_interval      = m_config.min_interval;
+  m_steady        = 0;
+  m_has_reference = false;
+}
+
+uint16_t adaptive_advertising_update(const ruuvi_sensor_t* data, uint16_t acceleration_events, uint16_t motion)
+{
+  if(has_changed(data, acceleration_events, motion))
+  {
+    m_reference           = *data;
+    m_acceleration_events = acceleration_events;
+    m_has_reference       = true;
+    m_steady              = 0;
+    if(m_interval != m_config.min_interval) { NRF_LOG_DEBUG("Data changed, advertising every %d ms\r\n", m_config.min_interval); }
+    m_interval = m_config.min_interval;
+  }
+  else if(++m_steady >= m_config.steady_samples && m_interval < m_config.max_interval)
+  {
+    m_steady   = 0;
+    // Double in 32 bits, max_interval may be over half of UINT16_MAX
+    uint32_t interval = (uint32_t)m_interval * 2;
+    m_interval = (interval > m_config.max_interval) ? m_config.max_interval : interval;
+    NRF_LOG_DEBUG("Data steady, advertising every %d ms\r\n", m_interval);
+  }
+  return m_interval;
+}
+
+uint16_t adaptive_advertising_interval_get(void)
+{
+  return m_interval;
+}
@@ -0,0 +1,48 @@
+#ifndef ADAPTIVE_ADVERTISING_H
+#define ADAPTIVE_ADVERTISING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sensortag.h"
+
+/**
+ *  Advertising interval which follows how fast the advertised data changes.
+ *
+ *  Every sample is compared to the reference sample, i.e. the last one which was considered a change.
+ *  Comparing to the reference rather than to the previous sample catches slow drifts too.
+ *  A change of any field over its threshold, a new acceleration event, or motion between accelerometer
+ *  samples over its threshold drops the interval to min_interval.
+ *  After steady_samples samples without change the interval doubles, up to max_interval.
+ *
+ *  Gateway sees a change at most one sample period + min_interval late, steady data at most max_interval late.
+ *  Invalid values are compared like any other value, so a sensor which fails or recovers counts as change.
+ */
+typedef struct {
+  uint16_t min_interval;           //!< ms, used while data changes
+  uint16_t max_interval;           //!< ms, reached when data is steady. Equal to min_interval disables adaptation.
+  uint8_t  steady_samples;         //!< Samples without change before interval doubles
+  int32_t  temperature_threshold;  //!< 1/100 C
+  uint32_t humidity_threshold;     //!< 1/1024 %
+  uint32_t pressure_threshold;     //!< Pa / 256
+  int16_t  acceleration_threshold; //!< mg, per axis
+  uint16_t motion_threshold;       //!< mg, RMS change between accelerometer samples. 0 ignores motion.
+}adaptive_advertising_config_t;
+
+/** Start from min_interval with given configuration, next sample becomes reference **/
+void adaptive_advertising_init(const adaptive_advertising_config_t* config);
+
+/**
+ *  Feed a new sample.
+ *
+ *  @param data sample as encoded to advertisement
+ *  @param acceleration_events counter of accelerometer activity interrupts
+ *  @param motion mg, RMS change between accelerometer samples since previous update, see motion_aggregate.h
+ *  @return advertising interval in ms to use from now on
+ */
+uint16_t adaptive_advertising_update(const ruuvi_sensor_t* data, uint16_t acceleration_events, uint16_t motion);
+
+/** Current advertising interval in ms **/
+uint16_t adaptive_advertising_interval_get(void);
+
+#endif
@@ -0,0 +1,91 @@
+#include "aes_eax.h"
+
+#include <string.h>
+
+/** Multiply by x in GF(2^128), CMAC subkey generation **/
+static void block_double(uint8_t* block)
+{
+  uint8_t carry = block[0] & 0x80;
+  for(size_t ii = 0; ii < AES_EAX_BLOCK_SIZE - 1; ii++)
+  {
+    block[ii] = (block[ii] << 1) | (block[ii + 1] >> 7);
+  }
+  block[AES_EAX_BLOCK_SIZE - 1] <<= 1;
+  if(carry) { block[AES_EAX_BLOCK_SIZE - 1] ^= 0x87; }
+}
+
+/** OMAC of [domain]_16 || data, i.e. CMAC with domain block prepended **/
+static ret_code_t omac(aes_block_encrypt_t encrypt, const uint8_t* key, uint8_t domain,
+                       const uint8_t* data, size_t length, uint8_t* mac)
+{
+  uint8_t subkey[AES_EAX_BLOCK_SIZE] = {0};
+  ret_code_t err_code = encrypt(key, subkey, subkey);
+  if(NRF_SUCCESS != err_code) { return err_code; }
+  block_double(subkey);
+
+  uint8_t block[AES_EAX_BLOCK_SIZE] = {0};
+  block[AES_EAX_BLOCK_SIZE - 1] = domain;
+  if(0 == length)
+  {
+    // Domain block is the last complete block
+    for(size_t ii = 0; ii < AES_EAX_BLOCK_SIZE; ii++) { block[ii] ^= subkey[ii]; }
+    return encrypt(key, block, mac);
+  }
+  err_code = encrypt(key, block, mac);
+
+  while(NRF_SUCCESS == err_code && length > AES_EAX_BLOCK_SIZE)
+  {
+    for(size_t ii = 0; ii < AES_EAX_BLOCK_SIZE; ii++) { mac[ii] ^= data[ii]; }
+    err_code = encrypt(key, mac, mac);
+    data   += AES_EAX_BLOCK_SIZE;
+    length -= AES_EAX_BLOCK_SIZE;
+  }
+  if(NRF_SUCCESS != err_code) { return err_code; }
+
+  // Last block: complete block uses K1, partial block is padded with 10* and uses K2
+  memset(block, 0, sizeof(block));
+  memcpy(block, data, length);
+  if(length < AES_EAX_BLOCK_SIZE)
+  {
+    block[length] = 0x80;
+    block_double(subkey);
+  }
+  for(size_t ii = 0; ii < AES_EAX_BLOCK_SIZE; ii++) { mac[ii] ^= block[ii] ^ subkey[ii]; }
+  return encrypt(key, mac, mac);
+}
+
+/** CTR mode with 128-bit big-endian counter **/
+static ret_code_t ctr(aes_block_encrypt_t encrypt, const uint8_t* key, const uint8_t* iv,
+                      uint8_t* data, size_t length)
+{
+  uint8_t counter[AES_EAX_BLOCK_SIZE];
+  uint8_t stream[AES_EAX_BLOCK_SIZE];
+  memcpy(counter, iv, sizeof(counter));
+  while(length)
+  {
+    ret_code_t err_code = encrypt(key, counter, stream);
+    if(NRF_SUCCESS != err_code) { return err_code; }
+    size_t count = (length < AES_EAX_BLOCK_SIZE) ? length : AES_EAX_BLOCK_SIZE;
+    for(size_t ii = 0; ii < count; ii++) { data[ii] ^= stream[ii]; }
+    data   += count;
+    length -= count;
+    for(int ii = AES_EAX_BLOCK_SIZE - 1; ii >= 0 && 0 == ++counter[ii]; ii--) { }
+  }
+  return NRF_SUCCESS;
+}
+
+ret_code_t aes_eax_encrypt(aes_block_encrypt_t encrypt, const uint8_t* key,
+                           const uint8_t* nonce, size_t nonce_length,
+                           const uint8_t* header, size_t header_length,
+                           uint8_t* data, size_t length, uint8_t* tag)
+{
+  uint8_t nonce_mac[AES_EAX_BLOCK_SIZE];
+  uint8_t mac[AES_EAX_BLOCK_SIZE];
+  ret_code_t err_code = omac(encrypt, key, 0, nonce, nonce_length, nonce_mac);
+  if(NRF_SUCCESS == err_code) { err_code = omac(encrypt, key, 1, header, header_length, tag); }
+  if(NRF_SUCCESS == err_code) { err_code = ctr(encrypt, key, nonce_mac, data, length); }
+  if(NRF_SUCCESS == err_code) { err_code = omac(encrypt, key, 2, data, length, mac); }
+  if(NRF_SUCCESS != err_code) { return err_code; }
+  for(size_t ii = 0; ii < AES_EAX_BLOCK_SIZE; ii++) { tag[ii] ^= nonce_mac[ii] ^ mac[ii]; }
+  return NRF_SUCCESS;
+}
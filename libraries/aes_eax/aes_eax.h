@@ -0,0 +1,35 @@
+#ifndef AES_EAX_H
+#define AES_EAX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdk_errors.h"
+
+/**
+ *  AES-128 EAX authenticated encryption (Bellare, Rogaway, Wagner), as used by Eddystone eTLM.
+ *  Block cipher is given by caller, i.e. SoftDevice ECB on the tag, so the mode is independent of hardware.
+ *  Error of block cipher stops encryption and is returned, data and tag are not valid then.
+ */
+#define AES_EAX_BLOCK_SIZE 16
+
+/** Encrypt one 16-byte block with AES-128, in and out may be the same block. Returns error code, 0 on success **/
+typedef ret_code_t(*aes_block_encrypt_t)(const uint8_t* key, const uint8_t* in, uint8_t* out);
+
+/**
+ *  Encrypt and authenticate data.
+ *
+ *  @param encrypt AES-128 block encryption
+ *  @param key 16-byte key
+ *  @param nonce nonce, any length
+ *  @param header data which is authenticated but not encrypted, may be NULL if header_length is 0
+ *  @param data plaintext in, ciphertext out
+ *  @param tag 16-byte authentication tag, receivers may check only the first bytes
+ *  @return Error code of block cipher, 0 on success
+ */
+ret_code_t aes_eax_encrypt(aes_block_encrypt_t encrypt, const uint8_t* key,
+                     const uint8_t* nonce, size_t nonce_length,
+                     const uint8_t* header, size_t header_length,
+                     uint8_t* data, size_t length, uint8_t* tag);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef CRC8_H
+#define CRC8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** CRC-8 with polynomial x^8 + x^2 + x + 1 (0x07), no reflection, no final XOR **/
+#define CRC8_INITIAL_VALUE 0x00
+
+/**
+ *  Compute CRC-8 of data. Pass CRC8_INITIAL_VALUE as crc, or result of previous call to
+ *  continue over several buffers.
+ */
+uint8_t crc8_compute(const uint8_t* data, size_t length, uint8_t crc);
+
+#endif
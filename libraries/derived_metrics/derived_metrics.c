@@ -0,0 +1,88 @@
+#include "derived_metrics.h"
+
+#include <stddef.h>
+
+#define TABLE_STEP    250 // 0.01 C
+#define TABLE_LENGTH  ((DERIVED_METRICS_TEMPERATURE_MAX - DERIVED_METRICS_TEMPERATURE_MIN) / TABLE_STEP + 1)
+
+/** Saturation vapour pressure in 0.01 Pa from -40 C in 2.5 C steps **/
+static const uint32_t m_saturation[TABLE_LENGTH] = {
+     1897,    2452,    3149,    4022,    5106,    6448,    8098,   10118,  // -40 C
+    12578,   15562,   19165,   23495,   28677,   34855,   42191,   50868,  // -20 C
+    61094,   73103,   87156,  103547,  122602,  144685,  170198,  199588,  // 0 C
+   233344,  272008,  316174,  366489,  423665,  488474,  561757,  644427,  // 20 C
+   737472,  841960,  959045, 1089966, 1236058, 1398751, 1579579, 1780179,  // 40 C
+  2002300, 2247808, 2518685, 2817040, 3145107, 3505257, 3899995, 4331968,  // 60 C
+  4803971, 5318947, 5879994                                                // 80 C
+};
+
+/**
+ *  Pressure altitude in Q16 m, polynomial of x = (p - 700 hPa) / 400 hPa in Q30.
+ *  Least squares fit at Chebyshev nodes of 300 ... 1100 hPa, largest error 0.55 m.
+ */
+#define ALTITUDE_DEGREE 6
+#define ALTITUDE_CENTER (70000 * 256) // Q24.8 Pa
+#define ALTITUDE_HALF   (40000 * 256) // Q24.8 Pa
+static const int64_t m_altitude[ALTITUDE_DEGREE + 1] = {
+  197399710, -294568936, 68309605, -22222513, 8493058, -6347094, 3191987
+};
+
+uint32_t derived_metrics_saturation_pressure(int32_t temperature)
+{
+  if(temperature <= DERIVED_METRICS_TEMPERATURE_MIN) { return m_saturation[0]; }
+  if(temperature >= DERIVED_METRICS_TEMPERATURE_MAX) { return m_saturation[TABLE_LENGTH - 1]; }
+  uint32_t offset   = temperature - DERIVED_METRICS_TEMPERATURE_MIN;
+  size_t   index    = offset / TABLE_STEP;
+  uint32_t fraction = offset % TABLE_STEP;
+  // Differences are below 2^20, products fit 32 bits
+  return m_saturation[index] + ((m_saturation[index + 1] - m_saturation[index]) * fraction + TABLE_STEP / 2) / TABLE_STEP;
+}
+
+int32_t derived_metrics_dew_point(uint32_t vapour_pressure)
+{
+  if(vapour_pressure <= m_saturation[0]) { return DERIVED_METRICS_TEMPERATURE_MIN; }
+  if(vapour_pressure >= m_saturation[TABLE_LENGTH - 1]) { return DERIVED_METRICS_TEMPERATURE_MAX; }
+  // Last entry at or below vapour pressure
+  size_t low = 0, high = TABLE_LENGTH - 1;
+  while(high - low > 1)
+  {
+    size_t middle = (low + high) / 2;
+    if(m_saturation[middle] <= vapour_pressure) { low = middle; }
+    else { high = middle; }
+  }
+  uint32_t span = m_saturation[high] - m_saturation[low];
+  uint32_t fraction = ((uint64_t)(vapour_pressure - m_saturation[low]) * TABLE_STEP + span / 2) / span;
+  return DERIVED_METRICS_TEMPERATURE_MIN + (int32_t)(low * TABLE_STEP + fraction);
+}
+
+int32_t derived_metrics_altitude(uint32_t pressure)
+{
+  if(pressure < DERIVED_METRICS_PRESSURE_MIN * 256) { pressure = DERIVED_METRICS_PRESSURE_MIN * 256; }
+  if(pressure > DERIVED_METRICS_PRESSURE_MAX * 256) { pressure = DERIVED_METRICS_PRESSURE_MAX * 256; }
+  int64_t x = (((int64_t)pressure - ALTITUDE_CENTER) << 30) / ALTITUDE_HALF;
+  // Horner, |x| <= 2^30 and coefficients below 2^31 keep products within 64 bits
+  int64_t altitude = m_altitude[ALTITUDE_DEGREE];
+  for(int ii = ALTITUDE_DEGREE - 1; ii >= 0; ii--)
+  {
+    altitude = ((altitude * x) >> 30) + m_altitude[ii];
+  }
+  return (int32_t)((altitude * 100 + 32768) >> 16);
+}
+
+void derived_metrics_compute(int32_t temperature, uint32_t humidity, uint32_t pressure, derived_metrics_t* metrics)
+{
+  if(NULL == metrics) { return; }
+  if(humidity > 100 * 1024) { humidity = 100 * 1024; }
+  uint32_t saturation = derived_metrics_saturation_pressure(temperature);
+  uint32_t vapour     = ((uint64_t)saturation * humidity + 51200) / 102400;
+
+  // 1 / Rv = 2.16674 g K / (m^3 Pa), kelvins in 0.01 K
+  int32_t kelvin = temperature + 27315;
+  if(temperature < DERIVED_METRICS_TEMPERATURE_MIN) { kelvin = DERIVED_METRICS_TEMPERATURE_MIN + 27315; }
+  if(temperature > DERIVED_METRICS_TEMPERATURE_MAX) { kelvin = DERIVED_METRICS_TEMPERATURE_MAX + 27315; }
+  metrics->absolute_humidity = ((uint64_t)vapour * 216674 + (uint64_t)kelvin * 500) / ((uint64_t)kelvin * 1000);
+
+  metrics->vapour_deficit = (saturation - vapour + 50) / 100;
+  metrics->dew_point      = derived_metrics_dew_point(vapour);
+  metrics->altitude       = derived_metrics_altitude(pressure);
+}
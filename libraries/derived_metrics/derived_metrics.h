@@ -0,0 +1,62 @@
+#ifndef DERIVED_METRICS_H
+#define DERIVED_METRICS_H
+
+#include <stdint.h>
+
+/**
+ *  Environmental metrics derived from BME280 outputs in fixed point, no floating point or libm.
+ *
+ *  Inputs are those of bme280.h: temperature in 0.01 C, humidity in Q22.10 %RH, pressure in Q24.8 Pa.
+ *    Saturation vapour pressure  es = 610.94 Pa * exp(17.625 T / (T + 243.04 C)), Magnus formula over water
+ *                                (Alduchov & Eskridge 1996), from a 2.5 C table with linear interpolation.
+ *    Vapour pressure             e = es * RH / 100
+ *    Dew point                   temperature at which es = e, table searched and interpolated backwards
+ *    Absolute humidity           e / (Rv * T), Rv = 461.52 J / (kg K)
+ *    Vapour-pressure deficit     es - e
+ *    Pressure altitude           44330.77 m * (1 - (p / 101325 Pa)^0.190263), ISA troposphere,
+ *                                6th degree polynomial of pressure
+ *
+ *  Error bounds against the formulas above in double precision, checked by driver_test of host_simulator:
+ *    es                 0.8 % at -40 C, 0.4 % above 0 C. Interpolation is above the curve
+ *    dew point          0.08 C
+ *    absolute humidity  0.8 % + 0.01 g/m^3
+ *    vapour deficit     0.8 % of es + 1 Pa
+ *    pressure altitude  0.6 m
+ *  Magnus formula itself is within 0.4 % of saturation pressure over water from -40 to 50 C, and sensor
+ *  accuracy of 3 %RH is 0.5 C of dew point, so table error is small against both.
+ *
+ *  Validity: temperature is clamped to -40 ... 85 C and pressure to 300 ... 1100 hPa, i.e. the operating
+ *  range of BME280. Dew points below -40 C, i.e. dry cold air, are reported as -40 C. Below 0 C the
+ *  values are over supercooled water, not over ice.
+ */
+#define DERIVED_METRICS_TEMPERATURE_MIN  -4000   // 0.01 C
+#define DERIVED_METRICS_TEMPERATURE_MAX   8500   // 0.01 C
+#define DERIVED_METRICS_PRESSURE_MIN     30000   // Pa
+#define DERIVED_METRICS_PRESSURE_MAX    110000   // Pa
+
+typedef struct{
+  int32_t  dew_point;         //!< 0.01 C
+  uint32_t absolute_humidity; //!< 0.01 g/m^3
+  uint32_t vapour_deficit;    //!< Pa
+  int32_t  altitude;          //!< cm, pressure altitude of standard atmosphere
+}derived_metrics_t;
+
+/** Saturation vapour pressure in 0.01 Pa at temperature in 0.01 C **/
+uint32_t derived_metrics_saturation_pressure(int32_t temperature);
+
+/** Dew point in 0.01 C of vapour pressure in 0.01 Pa **/
+int32_t derived_metrics_dew_point(uint32_t vapour_pressure);
+
+/** Pressure altitude in cm of pressure in Q24.8 Pa **/
+int32_t derived_metrics_altitude(uint32_t pressure);
+
+/**
+ *  All metrics of one BME280 sample.
+ *
+ *  @param temperature 0.01 C
+ *  @param humidity Q22.10 %RH, values over 100 % are taken as 100 %
+ *  @param pressure Q24.8 Pa
+ */
+void derived_metrics_compute(int32_t temperature, uint32_t humidity, uint32_t pressure, derived_metrics_t* metrics);
+
+#endif
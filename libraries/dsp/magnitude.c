@@ -0,0 +1,60 @@
+#include "magnitude.h"
+
+uint32_t magnitude_isqrt(uint32_t value)
+{
+  uint32_t root = 0;
+  uint32_t remainder = value;
+  // Highest power of 4 not above value, 16 iterations at most
+  uint32_t bit = 1UL << 30;
+  while(bit > remainder) { bit >>= 2; }
+  while(bit)
+  {
+    if(remainder >= root + bit)
+    {
+      remainder -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  // Round up if value > root^2 + root, i.e. value is past (root + 0.5)^2
+  if(remainder > root) { root++; }
+  return root;
+}
+
+void magnitude_block(const int16_t* samples, uint16_t* magnitudes, size_t count)
+{
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    const int32_t x = samples[3 * ii];
+    const int32_t y = samples[3 * ii + 1];
+    const int32_t z = samples[3 * ii + 2];
+    magnitudes[ii] = (uint16_t)magnitude_isqrt((uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z));
+  }
+}
+
+uint32_t magnitude_axis_square(int32_t value)
+{
+  uint32_t magnitude = abs(value);
+  return magnitude * magnitude;
+}
+
+void magnitude_square_block(const int16_t* samples, uint32_t* squares, size_t count)
+{
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    const int16_t* sample = &samples[3 * ii];
+    // Each square is below 2^30 and the sum of three below 2^32
+    squares[ii] = magnitude_axis_square(sample[0]) + magnitude_axis_square(sample[1]) + magnitude_axis_square(sample[2]);
+  }
+}
+
+uint16_t magnitude_root(uint64_t value)
+{
+  if(value > UINT32_MAX) { return UINT16_MAX; }
+  uint32_t result = magnitude_isqrt((uint32_t)value);
+  return (result > UINT16_MAX) ? UINT16_MAX : result;
+}
@@ -0,0 +1,50 @@
+#ifndef MAGNITUDE_H
+#define MAGNITUDE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ *  Integer vector magnitude of accelerometer samples.
+ *
+ *  Squares of int16_t axes are summed in 32 bits, 3 * 2^30 fits without overflow,
+ *  and square root is taken bit by bit without floating point or division.
+ *  Magnitude of any int16_t sample is below 56756, so it fits uint16_t.
+ */
+
+/**
+ *  Square root rounded to nearest integer.
+ *
+ *  @param value 32-bit value
+ *  @return square root of value, 0 ... 65536
+ */
+uint32_t magnitude_isqrt(uint32_t value);
+
+/**
+ *  Magnitudes of a block of samples, i.e. a FIFO drain.
+ *
+ *  @param samples X Y Z of consecutive samples
+ *  @param magnitudes output, one per sample
+ *  @param count number of samples
+ */
+void magnitude_block(const int16_t* samples, uint16_t* magnitudes, size_t count);
+
+/** Square of an axis, or of difference of two axes **/
+uint32_t magnitude_axis_square(int32_t value);
+
+/**
+ *  Squared magnitudes of a block of samples. Aggregates compare magnitudes squared and take
+ *  square root once per window, see magnitude_root.
+ *
+ *  @param samples X Y Z of consecutive samples
+ *  @param squares output, one per sample, below 2^32
+ *  @param count number of samples
+ */
+void magnitude_square_block(const int16_t* samples, uint32_t* squares, size_t count);
+
+/**
+ *  Square root of a sum or mean of squares, saturates at UINT16_MAX.
+ */
+uint16_t magnitude_root(uint64_t value);
+
+#endif
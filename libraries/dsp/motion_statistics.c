@@ -0,0 +1,134 @@
+#include "motion_statistics.h"
+
+#include <string.h>
+
+#include "magnitude.h"
+
+static void window_clear(motion_statistics_t* statistics)
+{
+  motion_aggregate_reset(&statistics->window);
+  statistics->above = 0;
+  memset(statistics->histogram, 0, sizeof(statistics->histogram));
+  statistics->above_us = 0;
+  statistics->untimed  = 0;
+}
+
+void motion_statistics_init(motion_statistics_t* statistics, const motion_statistics_config_t* config)
+{
+  memset(statistics, 0, sizeof(motion_statistics_t));
+  statistics->config = *config;
+  motion_aggregate_init(&statistics->window);
+  statistics->threshold_square = (uint32_t)config->threshold * config->threshold;
+  for(size_t ii = 0; ii < MOTION_STATISTICS_BINS - 1; ii++)
+  {
+    // Edges past 16-bit magnitudes are never reached
+    uint32_t edge = (ii + 1) * (uint32_t)config->bin_width;
+    statistics->edge_square[ii] = (edge > UINT16_MAX) ? UINT32_MAX : edge * edge;
+  }
+}
+
+/** sample_us is time the sample stands for, 0 if not known **/
+static void add_sample(motion_statistics_t* statistics, const int16_t* sample, uint32_t magnitude_square,
+                       uint32_t sample_us)
+{
+  motion_aggregate_add_squares(&statistics->window, sample, &magnitude_square, 1);
+  if(!sample_us) { statistics->untimed = 1; }
+  if(magnitude_square >= statistics->threshold_square)
+  {
+    statistics->above++;
+    statistics->above_us += sample_us;
+  }
+  size_t bin = 0;
+  while(bin < MOTION_STATISTICS_BINS - 1 && magnitude_square >= statistics->edge_square[bin]) { bin++; }
+  statistics->histogram[bin]++;
+
+  if(statistics->config.window && statistics->window.count >= statistics->config.window)
+  {
+    motion_statistics_close(statistics);
+  }
+}
+
+void motion_statistics_add(motion_statistics_t* statistics, const int16_t* samples, size_t count)
+{
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    uint32_t magnitude_square;
+    magnitude_square_block(&samples[3 * ii], &magnitude_square, 1);
+    add_sample(statistics, &samples[3 * ii], magnitude_square, 0);
+  }
+}
+
+void motion_statistics_add_squares(motion_statistics_t* statistics, const int16_t* samples, const uint32_t* squares,
+                                   size_t count, uint32_t duration_ms)
+{
+  if(0 == count) { return; }
+  uint64_t sample_us = (uint64_t)duration_ms * 1000 / count;
+  if(sample_us > UINT32_MAX) { sample_us = UINT32_MAX; }
+  // Sample of a very short block still counts as timed
+  if(duration_ms && !sample_us) { sample_us = 1; }
+  for(size_t ii = 0; ii < count; ii++) { add_sample(statistics, &samples[3 * ii], squares[ii], sample_us); }
+}
+
+void motion_statistics_close(motion_statistics_t* statistics)
+{
+  motion_statistics_result_t* result = &statistics->latest;
+  memset(result, 0, sizeof(motion_statistics_result_t));
+  motion_aggregate_result_t window;
+  motion_aggregate_get(&statistics->window, &window);
+  result->count = window.count;
+  if(window.count)
+  {
+    result->peak  = window.peak;
+    result->rms   = window.rms;
+    result->above = statistics->above;
+    result->timed = !statistics->untimed;
+    if(result->timed)
+    {
+      uint64_t above_ms = statistics->above_us / 1000;
+      result->above_ms  = (above_ms > UINT32_MAX) ? UINT32_MAX : above_ms;
+    }
+    memcpy(result->histogram, statistics->histogram, sizeof(result->histogram));
+  }
+  statistics->windows++;
+  window_clear(statistics);
+}
+
+void motion_statistics_get(const motion_statistics_t* statistics, motion_statistics_result_t* result)
+{
+  memcpy(result, &statistics->latest, sizeof(motion_statistics_result_t));
+}
+
+uint32_t motion_statistics_time_above_ms(const motion_statistics_result_t* result, uint32_t window_ms)
+{
+  if(0 == result->count) { return 0; }
+  if(result->timed) { return result->above_ms; }
+  return (uint64_t)result->above * window_ms / result->count;
+}
+
+uint8_t motion_statistics_share(const motion_statistics_result_t* result, size_t bin, uint8_t scale)
+{
+  if(0 == result->count || bin >= MOTION_STATISTICS_BINS) { return 0; }
+  return ((uint64_t)result->histogram[bin] * scale + result->count / 2) / result->count;
+}
+
+void motion_statistics_encode(uint8_t* data_buffer, const motion_statistics_result_t* result, uint32_t time_above_ms)
+{
+  uint32_t time_above = time_above_ms / 10;
+  if(time_above > UINT16_MAX) { time_above = UINT16_MAX; }
+  uint32_t count = (result->count > UINT16_MAX) ? UINT16_MAX : result->count;
+
+  data_buffer[0] = MOTION_STATISTICS_FORMAT;
+  data_buffer[1] = result->peak >> 8;
+  data_buffer[2] = result->peak & 0xFF;
+  data_buffer[3] = result->rms >> 8;
+  data_buffer[4] = result->rms & 0xFF;
+  data_buffer[5] = time_above >> 8;
+  data_buffer[6] = time_above & 0xFF;
+  for(size_t ii = 0; ii < MOTION_STATISTICS_BINS / 2; ii++)
+  {
+    data_buffer[7 + ii] = (motion_statistics_share(result, 2 * ii, 15) << 4)
+                        | motion_statistics_share(result, 2 * ii + 1, 15);
+  }
+  data_buffer[11] = count >> 8;
+  data_buffer[12] = count & 0xFF;
+}
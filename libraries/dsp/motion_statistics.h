@@ -0,0 +1,112 @@
+#ifndef MOTION_STATISTICS_H
+#define MOTION_STATISTICS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "motion_aggregate.h"
+
+/**
+ *  Statistics of acceleration magnitude over windows of samples.
+ *
+ *  Samples are fed in blocks as they are drained from the LIS2DH12 FIFO. Per window:
+ *    peak       largest magnitude
+ *    rms        root mean square of magnitudes, about 1000 mg at rest
+ *    above      samples with magnitude at or over threshold, i.e. time above threshold in samples
+ *    histogram  samples per magnitude bin of bin_width mg, last bin is open ended
+ *  Count, peak and RMS of the window are a motion_aggregate, which keeps its reference sample over windows.
+ *  Magnitudes are compared squared against precomputed bin edges, square root is taken once per window.
+ *  Memory is constant: one window being filled and the result of the latest complete window.
+ *
+ *  Window closes after window samples, or on motion_statistics_close if window is 0, i.e. at
+ *  a transmission interval. Sample rate does not need to be known, time above threshold is
+ *  the share of samples above threshold scaled to window length, see motion_statistics_time_above_ms.
+ *  Share of samples is wrong if sample rate changes within a window, e.g. 1 Hz idle and 50 Hz active
+ *  accelerometer: blocks given with their duration weight each sample by the time it stands for.
+ */
+#define MOTION_STATISTICS_BINS 8
+
+typedef struct{
+  uint16_t threshold; //!< mg, magnitude counted as above threshold
+  uint16_t bin_width; //!< mg, width of histogram bins
+  uint32_t window;    //!< samples per window, 0 to close windows with motion_statistics_close
+}motion_statistics_config_t;
+
+typedef struct{
+  uint32_t count;                              //!< Samples in window
+  uint16_t peak;                               //!< mg
+  uint16_t rms;                                //!< mg
+  uint32_t above;                              //!< Samples at or over threshold
+  uint32_t histogram[MOTION_STATISTICS_BINS];  //!< Samples per bin
+  uint32_t above_ms;                           //!< Time at or over threshold, valid if timed
+  uint8_t  timed;                              //!< Every block of window was added with its duration
+}motion_statistics_result_t;
+
+typedef struct{
+  motion_statistics_config_t config;
+  uint32_t threshold_square;                       //!< mg^2
+  uint32_t edge_square[MOTION_STATISTICS_BINS - 1]; //!< mg^2, lower edge of bins 1 ...
+  motion_aggregate_t window;                       //!< Count, peak and RMS of current window
+  uint32_t above;
+  uint32_t histogram[MOTION_STATISTICS_BINS];
+  uint64_t above_us;                               //!< Time at or over threshold of timed blocks
+  uint8_t  untimed;                                //!< A block without duration was added
+  motion_statistics_result_t latest;               //!< Latest complete window
+  uint32_t windows;                                //!< Complete windows since init
+}motion_statistics_t;
+
+/** Configure and clear statistics **/
+void motion_statistics_init(motion_statistics_t* statistics, const motion_statistics_config_t* config);
+
+/**
+ *  Add a block of samples. Windows which fill up in the block are closed on the way.
+ *
+ *  @param samples X Y Z triplets in mg, i.e. acceleration_t array as read by lis2dh12_read_samples
+ *  @param count number of triplets
+ */
+void motion_statistics_add(motion_statistics_t* statistics, const int16_t* samples, size_t count);
+
+/**
+ *  Add a block of samples with squared magnitudes computed by magnitude_square_block.
+ *
+ *  @param duration_ms time the block stands for, i.e. since previous block. Each sample weighs duration_ms / count
+ *                     in time above threshold. 0 if not known, window then uses share of samples.
+ */
+void motion_statistics_add_squares(motion_statistics_t* statistics, const int16_t* samples, const uint32_t* squares,
+                                   size_t count, uint32_t duration_ms);
+
+/** Close current window, its result becomes the latest result, and start a new window **/
+void motion_statistics_close(motion_statistics_t* statistics);
+
+/** Result of latest complete window. All fields are 0 before the first window closes **/
+void motion_statistics_get(const motion_statistics_t* statistics, motion_statistics_result_t* result);
+
+/**
+ *  Time above threshold of a window which lasted window_ms.
+ *
+ *  @return above_ms of timed window, otherwise above / count * window_ms. 0 for empty window
+ */
+uint32_t motion_statistics_time_above_ms(const motion_statistics_result_t* result, uint32_t window_ms);
+
+/**
+ *  Share of window samples in histogram bin.
+ *
+ *  @return histogram[bin] / count * scale, rounded. 0 for empty window or invalid bin
+ */
+uint8_t motion_statistics_share(const motion_statistics_result_t* result, size_t bin, uint8_t scale);
+
+/**
+ *  Compact encoding of a window for advertisements, MOTION_STATISTICS_ENCODED_LENGTH bytes, big endian:
+ *    0:     MOTION_STATISTICS_FORMAT
+ *    1-2:   peak, mg
+ *    3-4:   rms, mg
+ *    5-6:   time above threshold, 10 ms, saturates at 0xFFFF
+ *    7-10:  histogram, share of samples in bin in 1/15, 4 bits per bin, bin 0 in high bits of byte 7
+ *    11-12: samples in window, saturates at 0xFFFF
+ *  Proposal, not an official Ruuvi data format.
+ */
+#define MOTION_STATISTICS_FORMAT         0xF0
+#define MOTION_STATISTICS_ENCODED_LENGTH 13
+void motion_statistics_encode(uint8_t* data_buffer, const motion_statistics_result_t* result, uint32_t time_above_ms);
+
+#endif
@@ -0,0 +1,74 @@
+#include "motion_aggregate.h"
+
+#include <string.h>
+
+#include "magnitude.h"
+
+static void add_sample(motion_aggregate_t* aggregate, const int16_t* sample, uint32_t magnitude_square)
+{
+  if(magnitude_square >= aggregate->peak_square)
+  {
+    aggregate->peak_square = magnitude_square;
+    memcpy(aggregate->peak_sample, sample, sizeof(aggregate->peak_sample));
+  }
+  aggregate->sum_square += magnitude_square;
+  aggregate->count++;
+
+  if(aggregate->has_latest)
+  {
+    // Change per axis may reach 2^16, sum in 64 bits
+    aggregate->sum_change += (uint64_t)magnitude_axis_square(sample[0] - aggregate->latest[0])
+                           + magnitude_axis_square(sample[1] - aggregate->latest[1])
+                           + magnitude_axis_square(sample[2] - aggregate->latest[2]);
+    aggregate->changes++;
+  }
+  memcpy(aggregate->latest, sample, sizeof(aggregate->latest));
+  aggregate->has_latest = 1;
+}
+
+void motion_aggregate_init(motion_aggregate_t* aggregate)
+{
+  memset(aggregate, 0, sizeof(motion_aggregate_t));
+}
+
+void motion_aggregate_reset(motion_aggregate_t* aggregate)
+{
+  aggregate->count       = 0;
+  aggregate->changes     = 0;
+  aggregate->peak_square = 0;
+  aggregate->sum_square  = 0;
+  aggregate->sum_change  = 0;
+}
+
+void motion_aggregate_add(motion_aggregate_t* aggregate, const int16_t* samples, size_t count)
+{
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    uint32_t magnitude_square;
+    magnitude_square_block(&samples[3 * ii], &magnitude_square, 1);
+    add_sample(aggregate, &samples[3 * ii], magnitude_square);
+  }
+}
+
+void motion_aggregate_add_squares(motion_aggregate_t* aggregate, const int16_t* samples, const uint32_t* squares,
+                                  size_t count)
+{
+  for(size_t ii = 0; ii < count; ii++) { add_sample(aggregate, &samples[3 * ii], squares[ii]); }
+}
+
+void motion_aggregate_get(const motion_aggregate_t* aggregate, motion_aggregate_result_t* result)
+{
+  memset(result, 0, sizeof(motion_aggregate_result_t));
+  result->count = aggregate->count;
+  if(aggregate->count)
+  {
+    // Magnitudes are compared squared, square root is taken once per window
+    result->peak = magnitude_root(aggregate->peak_square);
+    memcpy(result->peak_sample, aggregate->peak_sample, sizeof(result->peak_sample));
+    result->rms  = magnitude_root(aggregate->sum_square / aggregate->count);
+  }
+  if(aggregate->changes)
+  {
+    result->motion = magnitude_root(aggregate->sum_change / aggregate->changes);
+  }
+}
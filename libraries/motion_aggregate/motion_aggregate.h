@@ -0,0 +1,65 @@
+#ifndef MOTION_AGGREGATE_H
+#define MOTION_AGGREGATE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ *  Aggregates of accelerometer samples between two advertisements.
+ *
+ *  Samples are fed in blocks as they are drained from the LIS2DH12 FIFO, so every sample taken at
+ *  the configured data rate counts, not only the one read at advertisement time.
+ *    peak   largest magnitude of a sample, the sample itself is kept too
+ *    rms    root mean square of magnitudes, about 1000 mg at rest
+ *    motion root mean square of change between consecutive samples. Gravity and a steady orientation
+ *           do not contribute, so this is about the sensor noise at rest and grows with shaking.
+ *           First sample after init has no predecessor and only sets the reference.
+ *  Sums are 64-bit, a block can be any length and any number of blocks can be aggregated.
+ *  Reference sample of motion is kept over motion_aggregate_reset, so no change is lost between windows.
+ */
+typedef struct{
+  uint32_t count;          //!< Samples in window
+  uint32_t changes;        //!< Consecutive sample pairs in window
+  uint32_t peak_square;    //!< mg^2, largest squared magnitude
+  uint64_t sum_square;     //!< mg^2, sum of squared magnitudes
+  uint64_t sum_change;     //!< mg^2, sum of squared change between consecutive samples
+  int16_t  peak_sample[3]; //!< mg, X Y Z of sample with largest magnitude
+  int16_t  latest[3];      //!< mg, X Y Z of latest sample
+  uint8_t  has_latest;     //!< Latest is valid
+}motion_aggregate_t;
+
+typedef struct{
+  uint32_t count;          //!< Samples aggregated
+  uint16_t peak;           //!< mg
+  uint16_t rms;            //!< mg
+  uint16_t motion;         //!< mg
+  int16_t  peak_sample[3]; //!< mg, X Y Z of sample with peak magnitude
+}motion_aggregate_result_t;
+
+/** Clear aggregate and reference sample **/
+void motion_aggregate_init(motion_aggregate_t* aggregate);
+
+/** Start a new window. Latest sample stays as reference of motion **/
+void motion_aggregate_reset(motion_aggregate_t* aggregate);
+
+/**
+ *  Add a block of samples.
+ *
+ *  @param samples X Y Z triplets in mg, i.e. acceleration_t array as read by lis2dh12_read_samples
+ *  @param count number of triplets
+ */
+void motion_aggregate_add(motion_aggregate_t* aggregate, const int16_t* samples, size_t count);
+
+/**
+ *  Add a block of samples with squared magnitudes computed by magnitude_square_block, so that
+ *  several aggregates of the same block square magnitudes once.
+ */
+void motion_aggregate_add_squares(motion_aggregate_t* aggregate, const int16_t* samples, const uint32_t* squares,
+                                  size_t count);
+
+/**
+ *  Results of current window. All fields are 0 if window has no samples.
+ */
+void motion_aggregate_get(const motion_aggregate_t* aggregate, motion_aggregate_result_t* result);
+
+#endif
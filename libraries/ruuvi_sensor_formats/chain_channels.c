@@ -1,6 +1,7 @@
 #include "chain_channels.h"
 #include "ruuvi_endpoints.h"
 #include "dsp.h"
+#include "motion_statistics.h"
 
 
 //TODO: Refactor had dependency to nRF52 scheduler out of library
@@ -36,11 +37,31 @@ static const app_timer_id_t* p_timers[] = {&ch0_timer, &ch1_timer, &ch2_timer, &
 static message_handler_state_t m_states[NUM_CHAIN_CHANNELS];
 static message_handler_state_t* p_state = NULL;
 static uint8_t m_chain_index = 0;
+// Motion statistics and the chain channel using them, -1 if none
+static motion_statistics_t m_statistics;
+static int8_t m_statistics_channel = -1;
+// Transmission interval of each chain channel, window length of statistics
+static uint32_t m_intervals_ms[NUM_CHAIN_CHANNELS];
+
+/**
+ *  Transmission interval of rate in ms, 0 if rate is not an interval
+ */
+static uint32_t transmission_interval_ms(const uint8_t rate)
+{
+  //seconds, TODO: define constants
+  if(rate < 60) { return 1000 * rate; }
+  //Minutes
+  if(rate < 120) { return 60000 * (rate - 59); }
+  //Hours - todo: Check that values are possible with given prescaler
+  if(rate < 250) { return 3600000 * (rate - 119); }
+  return 0;
+}
 
 //TODO: Deduplicate
 static ret_code_t set_dsp(uint8_t dsp_function, uint8_t dsp_parameter)
 {
   ret_code_t status = ENDPOINT_NOT_IMPLEMENTED;
+  if(DSP_MOTION_STATISTICS != dsp_function && m_statistics_channel == m_chain_index) { m_statistics_channel = -1; }
   switch(dsp_function)
   {
     case DSP_LAST:
@@ -62,6 +83,19 @@ static ret_code_t set_dsp(uint8_t dsp_function, uint8_t dsp_parameter)
       }
       break;
 
+    case DSP_MOTION_STATISTICS:
+      if(m_statistics_channel >= 0 && m_statistics_channel != m_chain_index) { return ENDPOINT_NOT_SUPPORTED; }
+      NRF_LOG_INFO("Setting up motion statistics for chain %d, parameter %d\r\n", m_chain_index, dsp_parameter);
+      motion_statistics_config_t config = { .threshold = dsp_parameter ? dsp_parameter * 16 : CHAIN_MOTION_THRESHOLD_MG,
+                                            .bin_width = CHAIN_MOTION_BIN_WIDTH_MG,
+                                            .window    = 0 };
+      motion_statistics_init(&m_statistics, &config);
+      m_statistics_channel = m_chain_index;
+      p_state->configuration.dsp_function  = DSP_MOTION_STATISTICS;
+      p_state->configuration.dsp_parameter = dsp_parameter;
+      status = ENDPOINT_SUCCESS;
+      break;
+
     default: 
       break;
   }
@@ -116,6 +150,7 @@ static ret_code_t set_target(uint8_t target)
 static ret_code_t set_transmission_rate(const uint8_t rate)
 {
   ret_code_t err_code = ENDPOINT_SUCCESS;
+  m_intervals_ms[m_chain_index] = 0;
   if(TRANSMISSION_RATE_STOP == rate)
   {
     p_state->p_chain_handler = NULL;
@@ -126,12 +161,9 @@ static ret_code_t set_transmission_rate(const uint8_t rate)
   {
     //Get chain handler
     p_state->p_chain_handler = get_chain_handler();
-    //seconds, TODO: define constants
-    if(rate < 60) { err_code |=  app_timer_start(*(p_timers[m_chain_index]), APP_TIMER_TICKS(1000 * (rate), APP_TIMER_PRESCALER), p_state); }
-    //Minutes
-    else if(rate < 120) { err_code |=  app_timer_start(*(p_timers[m_chain_index]), APP_TIMER_TICKS(60000 * (rate - 59), APP_TIMER_PRESCALER), p_state); }
-    //Hours - todo: Check that values are possible with given prescaler
-    else if(rate < 250) { err_code |=  app_timer_start(*(p_timers[m_chain_index]), APP_TIMER_TICKS(3600000 * (rate - 119), APP_TIMER_PRESCALER), p_state); }
+    uint32_t interval = transmission_interval_ms(rate);
+    m_intervals_ms[m_chain_index] = interval;
+    if(interval) { err_code |=  app_timer_start(*(p_timers[m_chain_index]), APP_TIMER_TICKS(interval, APP_TIMER_PRESCALER), p_state); }
     NRF_LOG_INFO("Setting up transmission rate %d, status %d\r\n", rate, err_code);
   }
   return err_code;
@@ -239,7 +271,37 @@ static ret_code_t read_value_i16(const ruuvi_standard_message_t message)
   return err_code;
 }
 
+/**
+ *  Close motion statistics window and transmit it, UINT16 summary followed by UINT8 histogram.
+ */
+static ret_code_t read_statistics(const ruuvi_standard_message_t message)
+{
+  ret_code_t err_code = ENDPOINT_SUCCESS;
+  motion_statistics_result_t result;
+  motion_statistics_close(&m_statistics);
+  motion_statistics_get(&m_statistics, &result);
+
+  uint32_t time_above = motion_statistics_time_above_ms(&result, m_intervals_ms[m_chain_index]) / 10;
+  uint16_t summary[4] = { result.peak,
+                          result.rms,
+                          (time_above > UINT16_MAX) ? UINT16_MAX : time_above,
+                          (result.count > UINT16_MAX) ? UINT16_MAX : result.count };
+  ruuvi_standard_message_t reply = {.destination_endpoint = message.destination_endpoint,
+                                    .source_endpoint = (m_chain_index + ENDPOINT_CHAIN_OFFSET),
+                                    .type = UINT16,
+                                    .payload = { 0 }};
+  memcpy(reply.payload, summary, sizeof(reply.payload));
+  NRF_LOG_DEBUG("Motion: peak %d RMS %d above %d samples %d\r\n", summary[0], summary[1], summary[2], summary[3]);
+  err_code |= transmit(reply);
 
+  reply.type = UINT8;
+  for(size_t ii = 0; ii < MOTION_STATISTICS_BINS; ii++)
+  {
+    reply.payload[ii] = motion_statistics_share(&result, ii, 100);
+  }
+  err_code |= transmit(reply);
+  return err_code;
+}
 
 /**
  *  Configure this endpoint as a downstream endpoint, i.e. receiver of data.
@@ -254,6 +316,7 @@ static ret_code_t configure_chain_downstream(const ruuvi_standard_message_t mess
   // Stop transmitting if transmission rate is 0
   if(TRANSMISSION_RATE_STOP == config->transmission_rate)
   {
+    m_intervals_ms[m_chain_index] = 0;
     p_state->p_chain_handler = NULL;
     app_timer_stop(*(p_timers[m_chain_index]));
   }
@@ -262,12 +325,9 @@ static ret_code_t configure_chain_downstream(const ruuvi_standard_message_t mess
   {
     //Get chain handler
     p_state->p_chain_handler = get_chain_handler();
-    //seconds, TODO: define constants
-    if(config->transmission_rate < 60) { app_timer_start(*(p_timers[m_chain_index]), APP_TIMER_TICKS(1000 * (config->transmission_rate), APP_TIMER_PRESCALER), p_state); }
-    //Minutes
-    else if(config->transmission_rate < 120) { app_timer_start(*(p_timers[m_chain_index]), APP_TIMER_TICKS(60000 * (config->transmission_rate - 59), APP_TIMER_PRESCALER), p_state); }
-    //Hours - todo: Check that values are possible with given prescaler
-    else if(config->transmission_rate < 250) { app_timer_start(*(p_timers[m_chain_index]), APP_TIMER_TICKS(3600000 * (config->transmission_rate - 119), APP_TIMER_PRESCALER), p_state); }
+    uint32_t interval = transmission_interval_ms(config->transmission_rate);
+    m_intervals_ms[m_chain_index] = interval;
+    if(interval) { app_timer_start(*(p_timers[m_chain_index]), APP_TIMER_TICKS(interval, APP_TIMER_PRESCALER), p_state); }
     NRF_LOG_INFO("Setting up transmission rate %d \r\n", config->transmission_rate);
   }
   return ENDPOINT_SUCCESS;
@@ -281,6 +341,12 @@ static ret_code_t process_i16(const ruuvi_standard_message_t message)
 {
   int16_t values[4];
   memcpy(values, message.payload, sizeof(message.payload));
+  //Statistics take X, Y, Z of the sample, magnitude is computed exactly
+  if(DSP_MOTION_STATISTICS == p_state->configuration.dsp_function)
+  {
+    motion_statistics_add(&m_statistics, values, 1);
+    return NRF_SUCCESS;
+  }
   for(size_t ii = 0; ii < 4; ii++)
   {
     NRF_LOG_DEBUG("Processing DSP CH %d\r\n", ii);
@@ -373,7 +439,8 @@ static void chain_transmission_handler(void *p_context)
                                       .type = INT16,
                                       .payload = { 0 }};    
   //XXX generalise                                    
-  read_value_i16(message);
+  if(DSP_MOTION_STATISTICS == p_state->configuration.dsp_function) { read_statistics(message); }
+  else { read_value_i16(message); }
 }
 
 /**
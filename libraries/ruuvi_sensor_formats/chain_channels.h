@@ -4,6 +4,22 @@
 #define NUM_CHAIN_CHANNELS 16
 #define ENDPOINT_CHAIN_OFFSET 0x50
 
+/**
+ *  DSP_MOTION_STATISTICS: statistics of acceleration magnitude, see motion_statistics.h.
+ *  Upstream sends X, Y, Z in mg, i.e. ACCELERATION. Window is the transmission interval, which must be
+ *  a time interval, i.e. not TRANSMISSION_RATE_SAMPLERATE.
+ *  dsp_parameter is threshold in 16 mg steps, 0 for default. One chain channel at a time,
+ *  configuring another one fails with ENDPOINT_NOT_SUPPORTED.
+ *  Each window transmits UINT16 peak mg, RMS mg, time above threshold in 10 ms, samples,
+ *  followed by UINT8 share of samples in percent in each of MOTION_STATISTICS_BINS bins.
+ */
+#ifndef CHAIN_MOTION_THRESHOLD_MG
+  #define CHAIN_MOTION_THRESHOLD_MG  1500
+#endif
+#ifndef CHAIN_MOTION_BIN_WIDTH_MG
+  #define CHAIN_MOTION_BIN_WIDTH_MG  250
+#endif
+
 #include "ruuvi_endpoints.h"
 
 ret_code_t chain_handler(const ruuvi_standard_message_t message);
@@ -13,11 +13,21 @@ static message_handler p_temperature_handler       = NULL;
 static message_handler p_humidity_handler          = NULL;
 static message_handler p_pressure_handler          = NULL;
 static message_handler p_air_quality_handler       = NULL;
+static message_handler p_environmental_handler     = NULL;
+static message_handler p_environmental_derived_handler = NULL;
 static message_handler p_acceleration_handler      = NULL;
 static message_handler p_magnetometer_handler      = NULL;
 static message_handler p_gyroscope_handler         = NULL;
 static message_handler p_movement_detector_handler = NULL;
+static message_handler p_acceleration_event_handler = NULL;
 static message_handler p_mam_handler               = NULL;
+static message_handler p_bulk_transfer_handler     = NULL;
+static message_handler p_diagnostics_handler       = NULL;
+static message_handler p_relay_handler             = NULL;
+
+/** Bulk write handlers, pairs of endpoint and handler **/
+static uint8_t              m_bulk_endpoints[MAX_BULK_HANDLERS] = {0};
+static bulk_message_handler p_bulk_handlers[MAX_BULK_HANDLERS]  = {NULL};
 
 /** Chain handler **/
 static message_handler p_chain_handler = NULL;
@@ -31,12 +41,12 @@ static message_handler p_proprietary_handler = NULL;
 static message_handler p_nfc_handler         = NULL;
 static message_handler p_ram_handler         = NULL;
 static message_handler p_flash_handler       = NULL;
+static stream_handler  p_ble_stream_handler  = NULL;
 
 /** Scheduler handler to call message router **/
 // TODO rename as incoming message handler and parse all messages through this function?
 void ble_gatt_scheduler_event_handler(void *p_event_data, uint16_t event_size)
 {
-  //TODO: Handle incoming bulk writes
   ruuvi_standard_message_t message = {};
   memcpy(&message, p_event_data, sizeof(message));
   route_message(message);
@@ -89,6 +99,16 @@ void route_message(const ruuvi_standard_message_t message)
         if(p_air_quality_handler) {p_air_quality_handler(message); } 
         else {unknown_handler(message); }
         break;
+
+      case ENVIRONMENTAL:
+        if(p_environmental_handler) {p_environmental_handler(message); }
+        else {unknown_handler(message); }
+        break;
+
+      case ENVIRONMENTAL_DERIVED:
+        if(p_environmental_derived_handler) {p_environmental_derived_handler(message); }
+        else {unknown_handler(message); }
+        break;
         
       case ACCELERATION:
         if(p_acceleration_handler) {p_acceleration_handler(message); } 
@@ -110,10 +130,32 @@ void route_message(const ruuvi_standard_message_t message)
         else {unknown_handler(message); }
         break;
 
+      case TAP_DETECTOR:
+      case FREE_FALL_DETECTOR:
+      case ORIENTATION_DETECTOR:
+        if(p_acceleration_event_handler) {p_acceleration_event_handler(message); }
+        else {unknown_handler(message); }
+        break;
+
       case MAM:
         if(p_mam_handler) {p_mam_handler(message); } 
         else {unknown_handler(message); }
         break;
+
+      case BULK_TRANSFER:
+        if(p_bulk_transfer_handler) {p_bulk_transfer_handler(message); } 
+        else {unknown_handler(message); }
+        break;
+
+      case BLE_DIAGNOSTICS:
+        if(p_diagnostics_handler) {p_diagnostics_handler(message); }
+        else {unknown_handler(message); }
+        break;
+
+      case BLE_RELAY:
+        if(p_relay_handler) {p_relay_handler(message); }
+        else {unknown_handler(message); }
+        break;
     
       default:
         //Call chain handler if applicable
@@ -136,16 +178,56 @@ void set_temperature_handler(message_handler handler)
   p_temperature_handler = handler;
 }
 
+void set_humidity_handler(message_handler handler)
+{
+  p_humidity_handler = handler;
+}
+
+void set_pressure_handler(message_handler handler)
+{
+  p_pressure_handler = handler;
+}
+
+void set_environmental_handler(message_handler handler)
+{
+  p_environmental_handler = handler;
+}
+
+void set_environmental_derived_handler(message_handler handler)
+{
+  p_environmental_derived_handler = handler;
+}
+
 void set_acceleration_handler(message_handler handler)
 {
   p_acceleration_handler = handler;
 }
 
+void set_acceleration_event_handler(message_handler handler)
+{
+  p_acceleration_event_handler = handler;
+}
+
 void set_mam_handler(message_handler handler)
 {
   p_mam_handler = handler;
 }
 
+void set_bulk_transfer_handler(message_handler handler)
+{
+  p_bulk_transfer_handler = handler;
+}
+
+void set_diagnostics_handler(message_handler handler)
+{
+  p_diagnostics_handler = handler;
+}
+
+void set_relay_handler(message_handler handler)
+{
+  p_relay_handler = handler;
+}
+
 void set_reply_handler(message_handler handler)
 {
   p_reply_handler = handler;
@@ -191,6 +273,11 @@ void set_chain_handler(message_handler handler)
   p_chain_handler = handler;
 }
 
+void set_ble_stream_handler(stream_handler handler)
+{
+  p_ble_stream_handler = handler;
+}
+
 message_handler get_reply_handler(void)
 {
   return p_reply_handler;
@@ -236,6 +323,50 @@ message_handler get_chain_handler(void)
   return p_chain_handler;
 }
 
+stream_handler get_ble_stream_handler(void)
+{
+  return p_ble_stream_handler;
+}
+
+/** Pass reassembled bulk payload to handler of its endpoint **/
+ret_code_t route_bulk_message(const uint8_t endpoint, const uint8_t* data, const size_t length)
+{
+  for(uint8_t ii = 0; ii < MAX_BULK_HANDLERS; ii++)
+  {
+    if(p_bulk_handlers[ii] && endpoint == m_bulk_endpoints[ii]) { return p_bulk_handlers[ii](endpoint, data, length); }
+  }
+  NRF_LOG_INFO("No bulk handler for %x, %d bytes dropped\r\n", endpoint, length);
+  return ENDPOINT_NOT_SUPPORTED;
+}
+
+/** Replace handler of endpoint if it has one, otherwise take first free slot **/
+ret_code_t set_bulk_message_handler(const uint8_t endpoint, bulk_message_handler handler)
+{
+  uint8_t free_slot = MAX_BULK_HANDLERS;
+  for(uint8_t ii = 0; ii < MAX_BULK_HANDLERS; ii++)
+  {
+    if(p_bulk_handlers[ii] && endpoint == m_bulk_endpoints[ii])
+    {
+      p_bulk_handlers[ii] = handler;
+      return ENDPOINT_SUCCESS;
+    }
+    if(!p_bulk_handlers[ii] && MAX_BULK_HANDLERS == free_slot) { free_slot = ii; }
+  }
+  if(!handler) { return ENDPOINT_SUCCESS; }
+  if(MAX_BULK_HANDLERS == free_slot) { return ENDPOINT_HANDLER_ERROR; }
+  m_bulk_endpoints[free_slot] = endpoint;
+  p_bulk_handlers[free_slot]  = handler;
+  return ENDPOINT_SUCCESS;
+}
+
+ret_code_t reply_uint32(message_handler p_reply_handler, ruuvi_standard_message_t* reply, uint32_t first, uint32_t second)
+{
+  uint32_t values[2] = { first, second };
+  reply->type = UINT32;
+  memcpy(reply->payload, values, sizeof(reply->payload));
+  return p_reply_handler(*reply);
+}
+
 // Send payload back to source with type "UNKNOWN"
 ret_code_t unknown_handler(const ruuvi_standard_message_t message)
 {
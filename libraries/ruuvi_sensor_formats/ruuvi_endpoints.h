@@ -19,12 +19,21 @@ typedef enum{
   PRESSURE                = 0x33,
   AIR_QUALITY             = 0x34,
   ENVIRONMENTAL           = 0x3A, // Aggregate of temperature, humidity, pressure,
+  ENVIRONMENTAL_DERIVED   = 0x3B, // Dew point, absolute humidity, vapour-pressure deficit, altitude, see derived_metrics.h
   ACCELERATION            = 0x40,
   MAGNETOMETER            = 0x41,
   GYROSCOPE               = 0x42,
   MOVEMENT_DETECTOR       = 0x43, 
+  TAP_DETECTOR            = 0x44, // Single or double tap events from accelerometer
+  FREE_FALL_DETECTOR      = 0x45, // Free-fall events from accelerometer
+  ORIENTATION_DETECTOR    = 0x46, // 6D orientation change events from accelerometer
   // endpoints 0x50 ... 0x5F are reserved for chain handlers, however they're not enumerated but rather called dynamically
-  MAM                     = 0xE0  // Masked Authenticated Messaging
+  MAM                     = 0xE0, // Masked Authenticated Messaging
+  STD_MESSAGE_FRAME       = 0xF0, // Reserved, first byte of a notification with several standard messages, see ruuvi_message_frame.h
+  BULK_TRANSFER           = 0xF1, // Acknowledgements from receiver of a bulk transfer, see ble_bulk_transfer.h
+  SAMPLE_STREAM           = 0xF2, // Reserved, first byte of a notification with a block of samples, see ruuvi_sample_stream.h
+  BLE_DIAGNOSTICS         = 0xF3, // BLE stack event and message queue counters, see ble_diagnostics.h
+  BLE_RELAY               = 0xF4  // Relay of neighbour advertisements, see ble_relay.h
 }ruuvi_endpoint_t;
 
 typedef enum{
@@ -66,6 +75,7 @@ typedef enum {
   TRANSMISSION_RATE_STOP       = 0,
   TRANSMISSION_RATE_SAMPLERATE = 251,
   TRANSMISSION_RATE_DSPRATE    = 252,
+  TRANSMISSION_RATE_STREAM     = 253, // Every sample, packed into sample stream blocks
   TRANSMISSION_RATE_NO_CHANGE  = 255
 }ruuvi_transmissionrate_t;
 
@@ -90,6 +100,7 @@ typedef enum {
   DSP_IMPULSE   = 6,
   DSP_LOW_PASS  = 7,
   DSP_HIGH_PASS = 8,
+  DSP_MOTION_STATISTICS = 9, // Chain channels only, see chain_channels.h
   DSP_VECTOR    = 128
 }ruuvi_dsp_function_t;
 
@@ -159,6 +170,19 @@ typedef struct __attribute__((packed)){
 // Declare message handler type
 typedef ret_code_t(*message_handler)(const ruuvi_standard_message_t);
 
+// Declare handler type for payloads reassembled from bulk writes
+typedef ret_code_t(*bulk_message_handler)(const uint8_t endpoint, const uint8_t* data, const size_t length);
+#define MAX_BULK_HANDLERS 4
+
+/**
+ *  Declare handler type for streams of samples. Handler sends as many samples as transport accepts now
+ *  and returns the number in sent. Caller keeps the rest and offers them again later.
+ *
+ *  @return ENDPOINT_SUCCESS if all samples were sent, error from transport otherwise
+ */
+typedef ret_code_t(*stream_handler)(const uint8_t endpoint, const uint16_t sequence, const uint8_t* samples,
+                                    const uint8_t sample_size, const size_t count, size_t* sent);
+
 /** Message handler state **/
 typedef struct {
 /** Data target handlers **/
@@ -187,10 +211,37 @@ void route_message(const ruuvi_standard_message_t message);
 
 ret_code_t unknown_handler(const ruuvi_standard_message_t message);
 
+/**
+ *  Send two counters as UINT32 reply, i.e. statistics replies to STATUS_QUERY.
+ *  Endpoints of reply are kept, type and payload are overwritten.
+ *
+ *  @return return value of p_reply_handler
+ */
+ret_code_t reply_uint32(message_handler p_reply_handler, ruuvi_standard_message_t* reply, uint32_t first, uint32_t second);
+
+/**
+ *  Routes payload of a bulk write to handler registered for endpoint.
+ *  Data is valid only for the duration of the call, handler must copy what it keeps.
+ *
+ *  @return ENDPOINT_NOT_SUPPORTED if endpoint has no bulk handler, otherwise return value of handler
+ */
+ret_code_t route_bulk_message(const uint8_t endpoint, const uint8_t* data, const size_t length);
+
+/** Register handler for bulk writes to endpoint, NULL unregisters. Up to MAX_BULK_HANDLERS endpoints **/
+ret_code_t set_bulk_message_handler(const uint8_t endpoint, bulk_message_handler handler);
+
 // Peripheral handlers
 void set_temperature_handler(message_handler handler);
+void set_humidity_handler(message_handler handler);
+void set_pressure_handler(message_handler handler);
+void set_environmental_handler(message_handler handler);
+void set_environmental_derived_handler(message_handler handler);
 void set_acceleration_handler(message_handler handler);
+void set_acceleration_event_handler(message_handler handler);
 void set_mam_handler(message_handler handler);
+void set_bulk_transfer_handler(message_handler handler);
+void set_diagnostics_handler(message_handler handler);
+void set_relay_handler(message_handler handler);
 void set_unknown_handler(message_handler handler);
 
 // Data transmission handlers
@@ -202,6 +253,7 @@ void set_reply_handler(message_handler handler);
 void set_ram_handler(message_handler handler);
 void set_flash_handler(message_handler handler);
 void set_chain_handler(message_handler handler);
+void set_ble_stream_handler(stream_handler handler);
 
 message_handler get_reply_handler(void);
 message_handler get_ble_adv_handler(void);
@@ -212,5 +264,6 @@ message_handler get_nfc_handler(void);
 message_handler get_ram_handler(void);
 message_handler get_flash_handler(void);
 message_handler get_chain_handler(void);
+stream_handler  get_ble_stream_handler(void);
 
 #endif
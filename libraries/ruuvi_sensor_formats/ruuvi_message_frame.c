@@ -0,0 +1,76 @@
+#include "ruuvi_message_frame.h"
+#include "ruuvi_endpoints.h"
+
+#include <string.h>
+
+size_t message_frame_capacity(size_t frame_size)
+{
+  if(frame_size < MESSAGE_FRAME_HEADER_SIZE) { return 0; }
+  size_t capacity = (frame_size - MESSAGE_FRAME_HEADER_SIZE) / MESSAGE_FRAME_ELEMENT_SIZE;
+  return (capacity > UINT8_MAX) ? UINT8_MAX : capacity;
+}
+
+size_t message_frame_begin(uint8_t* frame)
+{
+  frame[0] = STD_MESSAGE_FRAME;
+  frame[1] = 0;
+  return MESSAGE_FRAME_HEADER_SIZE;
+}
+
+uint8_t message_frame_count(const uint8_t* frame)
+{
+  return frame[1];
+}
+
+size_t message_frame_append(uint8_t* frame, size_t length, const ruuvi_standard_message_t* message)
+{
+  frame[length++] = sizeof(ruuvi_standard_message_t);
+  memcpy(&frame[length], message, sizeof(ruuvi_standard_message_t));
+  frame[1]++;
+  return length + sizeof(ruuvi_standard_message_t);
+}
+
+ret_code_t message_frame_unpack(const uint8_t* data, size_t length, message_handler handler)
+{
+  if(NULL == data || NULL == handler) { return ENDPOINT_INVALID; }
+  ruuvi_standard_message_t message;
+
+  // Single message
+  if(STD_MESSAGE_FRAME != data[0])
+  {
+    if(sizeof(message) != length) { return ENDPOINT_INVALID; }
+    memcpy(&message, data, sizeof(message));
+    return handler(message);
+  }
+
+  if(length < MESSAGE_FRAME_HEADER_SIZE) { return ENDPOINT_INVALID; }
+  uint8_t count = data[1];
+  size_t offset = MESSAGE_FRAME_HEADER_SIZE;
+  ret_code_t err_code = ENDPOINT_SUCCESS;
+  for(uint8_t ii = 0; ii < count && ENDPOINT_SUCCESS == err_code; ii++)
+  {
+    if(offset >= length) { return ENDPOINT_INVALID; }
+    uint8_t element_length = data[offset++];
+    if(offset + element_length > length) { return ENDPOINT_INVALID; }
+    if(sizeof(message) == element_length)
+    {
+      memcpy(&message, &data[offset], sizeof(message));
+      err_code = handler(message);
+    }
+    offset += element_length;
+  }
+  return err_code;
+}
+
+static ret_code_t route_frame_message(const ruuvi_standard_message_t message)
+{
+  route_message(message);
+  return ENDPOINT_SUCCESS;
+}
+
+ret_code_t message_frame_bulk_handler(const uint8_t endpoint, const uint8_t* data, const size_t length)
+{
+  // Single messages are written as such, uploaded payload must be a frame
+  if(NULL == data || !length || STD_MESSAGE_FRAME != data[0]) { return ENDPOINT_INVALID; }
+  return message_frame_unpack(data, length, route_frame_message);
+}
@@ -0,0 +1,69 @@
+#ifndef RUUVI_MESSAGE_FRAME_H
+#define RUUVI_MESSAGE_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ruuvi_endpoints.h"
+
+/**
+ *  Packed frame of standard messages, fills one notification with several messages.
+ *
+ *  0:     STD_MESSAGE_FRAME marker
+ *  1:     number of elements
+ *  2...:  elements, each one length byte followed by that many bytes of message
+ *
+ *  Marker is a reserved endpoint, so receiver can tell frames from single 11-byte messages
+ *  and from bulk transfer chunks which start with endpoint. Elements of other length than
+ *  ruuvi_standard_message_t are reserved for future message types and skipped by unpacker.
+ */
+#define MESSAGE_FRAME_HEADER_SIZE   2
+#define MESSAGE_FRAME_ELEMENT_SIZE  (1 + sizeof(ruuvi_standard_message_t))
+
+/** Number of standard messages which fit into frame of frame_size bytes **/
+size_t message_frame_capacity(size_t frame_size);
+
+/**
+ *  Start a new frame.
+ *
+ *  @param frame buffer of at least MESSAGE_FRAME_HEADER_SIZE bytes
+ *  @return length of frame, i.e. MESSAGE_FRAME_HEADER_SIZE
+ */
+size_t message_frame_begin(uint8_t* frame);
+
+/** Number of messages in frame **/
+uint8_t message_frame_count(const uint8_t* frame);
+
+/**
+ *  Append message to frame. Caller checks the space with message_frame_capacity.
+ *
+ *  @param frame buffer started with message_frame_begin
+ *  @param length current length of frame
+ *  @param message to append
+ *  @return new length of frame
+ */
+size_t message_frame_append(uint8_t* frame, size_t length, const ruuvi_standard_message_t* message);
+
+/**
+ *  Unpack a notification and pass each standard message to handler in order.
+ *  Accepts both frames and single 11-byte messages.
+ *
+ *  @param data received notification
+ *  @param length length of notification
+ *  @param handler called once per message
+ *  @return ENDPOINT_SUCCESS, ENDPOINT_INVALID if data is neither a frame nor a message,
+ *          or error from handler. Messages before a truncated element are delivered.
+ */
+ret_code_t message_frame_unpack(const uint8_t* data, size_t length, message_handler handler);
+
+/**
+ *  Bulk message handler of STD_MESSAGE_FRAME endpoint, register with set_bulk_message_handler.
+ *  Central uploads a frame with a bulk write to configure several endpoints at once, i.e. a whole
+ *  configuration which does not fit one write. Each message is routed with route_message in order.
+ *  Frame of 255 messages is 3062 bytes, BLE_BULK_RX_BUFFER_SIZE limits the upload.
+ *
+ *  @return ENDPOINT_INVALID if payload is not a frame, otherwise ENDPOINT_SUCCESS
+ */
+ret_code_t message_frame_bulk_handler(const uint8_t endpoint, const uint8_t* data, const size_t length);
+
+#endif
@@ -0,0 +1,37 @@
+#include "ruuvi_sample_stream.h"
+#include "ruuvi_endpoints.h"
+
+#include <string.h>
+
+size_t sample_stream_capacity(size_t frame_size, size_t sample_size)
+{
+  if(frame_size < SAMPLE_STREAM_HEADER_SIZE || !sample_size) { return 0; }
+  size_t capacity = (frame_size - SAMPLE_STREAM_HEADER_SIZE) / sample_size;
+  return (capacity > UINT8_MAX) ? UINT8_MAX : capacity;
+}
+
+size_t sample_stream_pack(uint8_t* frame, uint8_t endpoint, uint16_t sequence,
+                          const uint8_t* samples, uint8_t sample_size, uint8_t count)
+{
+  frame[0] = SAMPLE_STREAM;
+  frame[1] = endpoint;
+  frame[2] = sequence & 0xFF;
+  frame[3] = sequence >> 8;
+  frame[4] = count;
+  frame[5] = sample_size;
+  memcpy(&frame[SAMPLE_STREAM_HEADER_SIZE], samples, (size_t)count * sample_size);
+  return SAMPLE_STREAM_HEADER_SIZE + (size_t)count * sample_size;
+}
+
+ret_code_t sample_stream_unpack(const uint8_t* data, size_t length, sample_stream_block_t* block)
+{
+  if(NULL == data || NULL == block) { return ENDPOINT_INVALID; }
+  if(length < SAMPLE_STREAM_HEADER_SIZE || SAMPLE_STREAM != data[0]) { return ENDPOINT_INVALID; }
+  block->endpoint    = data[1];
+  block->sequence    = data[2] | (data[3] << 8);
+  block->count       = data[4];
+  block->sample_size = data[5];
+  block->samples     = &data[SAMPLE_STREAM_HEADER_SIZE];
+  if(SAMPLE_STREAM_HEADER_SIZE + (size_t)block->count * block->sample_size != length) { return ENDPOINT_INVALID; }
+  return ENDPOINT_SUCCESS;
+}
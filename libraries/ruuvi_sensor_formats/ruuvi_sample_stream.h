@@ -0,0 +1,50 @@
+#ifndef RUUVI_SAMPLE_STREAM_H
+#define RUUVI_SAMPLE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ruuvi_endpoints.h"
+
+/**
+ *  Block of consecutive samples of one endpoint, fills one notification while streaming.
+ *
+ *  0:     SAMPLE_STREAM marker
+ *  1:     source endpoint, i.e. ACCELERATION
+ *  2-3:   sequence number of first sample, uint16 little-endian, wraps around
+ *  4:     number of samples
+ *  5:     bytes per sample
+ *  6...:  samples, format defined by endpoint. ACCELERATION: int16 x, y, z in mg, little-endian
+ *
+ *  Sequence number counts samples, so receiver detects lost samples as a gap between
+ *  sequence + count of a block and sequence of the next block.
+ */
+#define SAMPLE_STREAM_HEADER_SIZE 6
+
+typedef struct {
+  uint8_t        endpoint;
+  uint16_t       sequence;
+  uint8_t        count;
+  uint8_t        sample_size;
+  const uint8_t* samples;
+}sample_stream_block_t;
+
+/** Number of samples of sample_size bytes which fit into a block of frame_size bytes **/
+size_t sample_stream_capacity(size_t frame_size, size_t sample_size);
+
+/**
+ *  Write block header and samples to frame. Caller checks the space with sample_stream_capacity.
+ *
+ *  @return length of block
+ */
+size_t sample_stream_pack(uint8_t* frame, uint8_t endpoint, uint16_t sequence,
+                          const uint8_t* samples, uint8_t sample_size, uint8_t count);
+
+/**
+ *  Parse block, samples point into data.
+ *
+ *  @return ENDPOINT_SUCCESS, ENDPOINT_INVALID if data is not a complete block
+ */
+ret_code_t sample_stream_unpack(const uint8_t* data, size_t length, sample_stream_block_t* block);
+
+#endif
@@ -65,13 +65,17 @@ void encodeToRawFormat5(uint8_t* data_buffer, const ruuvi_sensor_t* const data,
     data_buffer[16] = packet_counter>>8;
     data_buffer[17] = packet_counter&0xFF;
     packet_counter++;
-    data_buffer[18] = ((NRF_FICR->DEVICEADDR[1]>>8)&0xFF) | 0xC0; //2 MSB must be 11;
-    data_buffer[19] = ((NRF_FICR->DEVICEADDR[1]>>0)&0xFF);
-    data_buffer[20] = ((NRF_FICR->DEVICEADDR[0]>>24)&0xFF);
-    data_buffer[21] = ((NRF_FICR->DEVICEADDR[0]>>16)&0xFF);
-    data_buffer[22] = ((NRF_FICR->DEVICEADDR[0]>>8)&0xFF);
-    data_buffer[23] = ((NRF_FICR->DEVICEADDR[0]>>0)&0xFF);
+    getRawFormat5Mac(&data_buffer[18]);
+}
 
+void getRawFormat5Mac(uint8_t* mac)
+{
+    mac[0] = ((NRF_FICR->DEVICEADDR[1]>>8)&0xFF) | 0xC0; //2 MSB must be 11;
+    mac[1] = ((NRF_FICR->DEVICEADDR[1]>>0)&0xFF);
+    mac[2] = ((NRF_FICR->DEVICEADDR[0]>>24)&0xFF);
+    mac[3] = ((NRF_FICR->DEVICEADDR[0]>>16)&0xFF);
+    mac[4] = ((NRF_FICR->DEVICEADDR[0]>>8)&0xFF);
+    mac[5] = ((NRF_FICR->DEVICEADDR[0]>>0)&0xFF);
 }
 
 /**
@@ -83,6 +83,12 @@ void encodeToRawFormat3(uint8_t* data_buffer, const ruuvi_sensor_t* const data);
  */
 void encodeToRawFormat5(uint8_t* data_buffer,  const ruuvi_sensor_t* const data, uint16_t acceleration_events, int8_t tx_pwr);
 
+/**
+ *  MAC address of the tag as encoded in RAWv2, 2 MSB of first byte are 11 (random static address)
+ *  @param mac uint8_t array with length of 6 bytes
+ */
+void getRawFormat5Mac(uint8_t* mac);
+
 
 /**
  *  Encodes sensor data into given char* url. The base url must have the base of url written by caller.
@@ -0,0 +1,946 @@
+/**
+ *  Host test of the LIS2DH12 and BME280 drivers on a virtual SPI bus, see sim_spi.h.
+ *
+ *  lis2dh12.c and bme280.c are compiled as-is, with malloc, calloc, realloc and free renamed
+ *  to counting wrappers below. Configuration, FIFO drains and measurement reads must not touch the heap,
+ *  and FIFO drain must take one SPI transfer of command byte and samples.
+ *  Block conversion of raw samples to mg is compared to the per-value switch it replaced,
+ *  over every raw value at each scale and resolution, and both are timed on host.
+ *  Integer magnitude kernel is compared to double precision sqrt.
+ *  Free-fall and orientation detection must configure interrupt function 1 without touching FIFO or activity.
+ *  Unchanged LIS2DH12 configuration must not take SPI transfers, deferred configuration is committed in bursts.
+ *  Motion statistics of traces/ are compared to double precision per window, FIFO block size must not matter.
+ *  BME280 forced conversion time follows oversampling, configuration is allowed between forced conversions.
+ *  BME280 compensation with precomputed terms is compared to datasheet formulas over the full ADC range,
+ *  32-bit pressure to 64-bit pressure, and both pressure formulas are timed on host.
+ *  Adaptive advertising interval drops to minimum on change and doubles over steady samples up to maximum.
+ *  AES-EAX of eTLM is checked against the test vectors of the EAX paper on a software AES-128.
+ *  Accelerometer duty cycle wakes on activity interrupts, stays awake on motion and sleeps after the quiet period.
+ *
+ *  Usage: driver_test
+ *  Prints a line per check and exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lis2dh12.h"
+#include "lis2dh12_registers.h"
+#include "bme280.h"
+#include "magnitude.h"
+#include "motion_statistics.h"
+#include "derived_metrics.h"
+#include "adaptive_advertising.h"
+#include "aes_eax.h"
+#include "activity_duty_cycle.h"
+#include <math.h>
+#include "sim_spi.h"
+
+static uint32_t m_allocations = 0;
+static int      m_failures    = 0;
+
+void* sim_malloc(size_t size)                 { m_allocations++; return malloc(size); }
+void* sim_calloc(size_t count, size_t size)   { m_allocations++; return calloc(count, size); }
+void* sim_realloc(void* pointer, size_t size) { m_allocations++; return realloc(pointer, size); }
+void  sim_free(void* pointer)                 { free(pointer); }
+
+static void check(int passed, const char* description)
+{
+  printf("%s %s\n", passed ? "PASS" : "FAIL", description);
+  if(!passed) { m_failures++; }
+}
+
+/** FIFO burst of 32 samples at 2 g, 12 bits, where raw / 16 is mg **/
+static void test_lis2dh12_fifo(void)
+{
+  lis2dh12_sensor_buffer_t buffer[LIS2DH12_FIFO_MAX_LENGTH];
+  int16_t expected[LIS2DH12_FIFO_MAX_LENGTH][3];
+  size_t count = 0;
+  bool overrun = true;
+
+  check(LIS2DH12_RET_OK == lis2dh12_init(), "lis2dh12_init reads WHO_AM_I");
+  lis2dh12_reset();
+  lis2dh12_enable();
+  lis2dh12_set_scale(LIS2DH12_SCALE2G);
+  lis2dh12_set_resolution(LIS2DH12_RES12BIT);
+  lis2dh12_set_sample_rate(LIS2DH12_RATE_100);
+  lis2dh12_set_fifo_watermark(24);
+  lis2dh12_set_fifo_mode(LIS2DH12_MODE_STREAM);
+  check(LIS2DH12_FM_STREAM == (sim_spi_lis2dh12_register(LIS2DH12_FIFO_CTRL_REG) & LIS2DH12_FM_MASK)
+        && 24 == (sim_spi_lis2dh12_register(LIS2DH12_FIFO_CTRL_REG) & LIS2DH12_FTH_MASK),
+        "FIFO stream mode and watermark written");
+
+  for(int ii = 0; ii < LIS2DH12_FIFO_MAX_LENGTH; ii++)
+  {
+    int16_t raw[3] = { (int16_t)(ii * 16 * 31), (int16_t)(-ii * 16 * 17), (int16_t)(1000 * 16 - ii * 16) };
+    for(int axis = 0; axis < 3; axis++) { expected[ii][axis] = raw[axis] / 16; }
+    sim_spi_lis2dh12_push(raw);
+  }
+  lis2dh12_get_fifo_status(&count, &overrun);
+  check(LIS2DH12_FIFO_MAX_LENGTH == count && overrun, "FIFO status reports full FIFO");
+
+  sim_spi_statistics_t before, after;
+  sim_spi_statistics_get(&before);
+  memset(buffer, 0, sizeof(buffer));
+  lis2dh12_read_samples(buffer, count);
+  sim_spi_statistics_get(&after);
+  check(0 == memcmp(buffer, expected, sizeof(expected)), "32 samples read in place in one burst");
+  printf("     FIFO drain of %d samples: %u SPI transfers, %u bytes\n", (int)count,
+         after.transfers - before.transfers, after.bytes - before.bytes);
+  check(1 == after.transfers - before.transfers, "FIFO drain takes one SPI transfer");
+  lis2dh12_get_fifo_status(&count, &overrun);
+  check(0 == count && !overrun, "FIFO is empty after drain");
+
+  // Consecutive registers in one write need address incrementation
+  uint8_t thresholds[2] = { 0x12, 0x34 };
+  lis2dh12_write_register(LIS2DH12_INT1_THS, thresholds, sizeof(thresholds));
+  check(0x12 == sim_spi_lis2dh12_register(LIS2DH12_INT1_THS)
+        && 0x34 == sim_spi_lis2dh12_register(LIS2DH12_INT1_DURATION), "multi-register write increments address");
+}
+
+/** Free-fall and 6D orientation on interrupt function 1 at 2 g, 100 Hz, after FIFO test **/
+static void test_lis2dh12_events(void)
+{
+  lis2dh12_set_activity_interrupt_pin_2(64);
+  uint8_t routing = sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG6);
+
+  check(LIS2DH12_RET_OK == lis2dh12_set_free_fall_interrupt(350, 30), "lis2dh12_set_free_fall_interrupt");
+  check((LIS2DH12_AOI_MASK | LIS2DH12_ZLIE_MASK | LIS2DH12_YLIE_MASK | LIS2DH12_XLIE_MASK)
+        == sim_spi_lis2dh12_register(LIS2DH12_INT1_CFG), "free-fall is AND of low events");
+  check(22 == sim_spi_lis2dh12_register(LIS2DH12_INT1_THS) && 3 == sim_spi_lis2dh12_register(LIS2DH12_INT1_DURATION),
+        "free-fall threshold and duration at scale and sample rate");
+  uint8_t ctrl5 = sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG5);
+  check((ctrl5 & LIS2DH12_LIR_INT1_MASK) && (ctrl5 & LIS2DH12_FIFO_EN_MASK), "function 1 latched, FIFO still enabled");
+  check(routing == sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG6)
+        && LIS2DH12_HPIS2_MASK == (sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG2) & (LIS2DH12_HPIS1_MASK | LIS2DH12_HPIS2_MASK)),
+        "activity routing and high-pass kept");
+
+  check(LIS2DH12_RET_OK == lis2dh12_set_orientation_interrupt(600, 100), "lis2dh12_set_orientation_interrupt");
+  check((LIS2DH12_6D_MASK | 0x3F) == sim_spi_lis2dh12_register(LIS2DH12_INT1_CFG)
+        && 10 == sim_spi_lis2dh12_register(LIS2DH12_INT1_DURATION), "orientation is 6D movement");
+
+  uint8_t int1_source = 0, click_source = 0;
+  check(LIS2DH12_RET_OK == lis2dh12_get_event_sources(&int1_source, &click_source), "lis2dh12_get_event_sources");
+  lis2dh12_set_interrupt_configuration(0, 1);
+}
+
+/** Register shadow at 2 g, 12 bits, 100 Hz stream, after event test **/
+static void test_lis2dh12_shadow(void)
+{
+  sim_spi_statistics_t before, after;
+  uint8_t value = 0;
+
+  sim_spi_statistics_get(&before);
+  lis2dh12_set_scale(LIS2DH12_SCALE2G);
+  lis2dh12_set_resolution(LIS2DH12_RES12BIT);
+  lis2dh12_set_sample_rate(LIS2DH12_RATE_100);
+  lis2dh12_set_fifo_watermark(24);
+  lis2dh12_set_fifo_mode(LIS2DH12_MODE_STREAM);
+  lis2dh12_read_register(LIS2DH12_CTRL_REG1, &value, 1);
+  sim_spi_statistics_get(&after);
+  check(0 == after.transfers - before.transfers && value == sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG1),
+        "unchanged configuration and register read take no SPI transfers");
+
+  sim_spi_statistics_get(&before);
+  lis2dh12_begin_configuration();
+  lis2dh12_set_interrupts(LIS2DH12_I1_WTM, 1);
+  lis2dh12_set_fifo_mode(LIS2DH12_MODE_BYPASS);
+  lis2dh12_set_resolution(LIS2DH12_RES8BIT);
+  lis2dh12_set_sample_rate(LIS2DH12_RATE_1);
+  check(0 == sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG3), "deferred configuration is not written");
+  lis2dh12_commit_configuration();
+  sim_spi_statistics_get(&after);
+  printf("     deferred reconfiguration of 5 registers: %u SPI transfers, %u bytes\n",
+         after.transfers - before.transfers, after.bytes - before.bytes);
+  check(2 == after.transfers - before.transfers, "commit takes a burst per run of changed registers");
+  check((LIS2DH12_ODR_MASK_1HZ | LIS2DH12_LPEN_MASK | LIS2DH12_XYZ_EN_MASK) == sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG1)
+        && LIS2DH12_I1_WTM == sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG3)
+        && !(sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG4) & LIS2DH12_HR_MASK)
+        && !(sim_spi_lis2dh12_register(LIS2DH12_CTRL_REG5) & LIS2DH12_FIFO_EN_MASK)
+        && 24 == sim_spi_lis2dh12_register(LIS2DH12_FIFO_CTRL_REG), "committed registers match setters");
+}
+
+/** Conversion of raw value by switch on scale and resolution, as lis2dh12.c did before block conversion **/
+static int16_t reference_raw_to_mg(lis2dh12_scale_t scale, lis2dh12_resolution_t resolution, int16_t lsb)
+{
+  switch(scale)
+  {
+    case LIS2DH12_SCALE2G:
+      switch(resolution)
+      {
+        case LIS2DH12_RES8BIT:  return (lsb / 256) * 16;
+        case LIS2DH12_RES10BIT: return (lsb / 64) * 4;
+        case LIS2DH12_RES12BIT: return (lsb / 16) * 1;
+        default: break;
+      }
+      break;
+    case LIS2DH12_SCALE4G:
+      switch(resolution)
+      {
+        case LIS2DH12_RES8BIT:  return (lsb / 256) * 32;
+        case LIS2DH12_RES10BIT: return (lsb / 64) * 8;
+        case LIS2DH12_RES12BIT: return (lsb / 16) * 2;
+        default: break;
+      }
+      break;
+    case LIS2DH12_SCALE8G:
+      switch(resolution)
+      {
+        case LIS2DH12_RES8BIT:  return (lsb / 256) * 64;
+        case LIS2DH12_RES10BIT: return (lsb / 64) * 16;
+        case LIS2DH12_RES12BIT: return (lsb / 16) * 4;
+        default: break;
+      }
+      break;
+    case LIS2DH12_SCALE16G:
+      switch(resolution)
+      {
+        case LIS2DH12_RES8BIT:  return (lsb / 256) * 192;
+        case LIS2DH12_RES10BIT: return (lsb / 64) * 48;
+        case LIS2DH12_RES12BIT: return (lsb / 16) * 12;
+        default: break;
+      }
+      break;
+    default:
+      break;
+  }
+  return 0x8000;
+}
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** Every raw value at 4 scales x 3 resolutions, and host time per sample of 3 values **/
+static void test_lis2dh12_conversion(void)
+{
+  static const lis2dh12_scale_t scales[] = { LIS2DH12_SCALE2G, LIS2DH12_SCALE4G, LIS2DH12_SCALE8G, LIS2DH12_SCALE16G };
+  static const lis2dh12_resolution_t resolutions[] = { LIS2DH12_RES8BIT, LIS2DH12_RES10BIT, LIS2DH12_RES12BIT };
+  static int16_t values[65536];
+  static int16_t expected[65536];
+  const int rounds = 64;
+  volatile int16_t sink = 0;
+  double reference_ns = 0, block_ns = 0;
+  int mismatches = 0;
+
+  for(size_t ss = 0; ss < sizeof(scales) / sizeof(scales[0]); ss++)
+  {
+    for(size_t rr = 0; rr < sizeof(resolutions) / sizeof(resolutions[0]); rr++)
+    {
+      lis2dh12_set_scale(scales[ss]);
+      lis2dh12_set_resolution(resolutions[rr]);
+      for(int ii = 0; ii < 65536; ii++) { values[ii] = (int16_t)(ii - 32768); }
+      lis2dh12_raw_to_mg(values, 65536);
+      for(int ii = 0; ii < 65536; ii++)
+      {
+        expected[ii] = reference_raw_to_mg(scales[ss], resolutions[rr], (int16_t)(ii - 32768));
+        if(expected[ii] != values[ii]) { mismatches++; }
+      }
+
+      double start = now_ns();
+      for(int round = 0; round < rounds; round++)
+      {
+        for(int ii = 0; ii < 65536; ii++) { expected[ii] = reference_raw_to_mg(scales[ss], resolutions[rr], values[ii]); }
+        sink ^= expected[round];
+      }
+      reference_ns += now_ns() - start;
+      start = now_ns();
+      for(int round = 0; round < rounds; round++)
+      {
+        lis2dh12_raw_to_mg(values, 65536);
+        sink ^= values[round];
+      }
+      block_ns += now_ns() - start;
+    }
+  }
+  check(0 == mismatches, "block conversion equals switch at all 12 scales and resolutions");
+  // Sample is 3 values
+  double samples = 12.0 * rounds * 65536 / 3;
+  printf("     host time per sample: switch %.2f ns, block %.2f ns\n", reference_ns / samples, block_ns / samples);
+  (void)sink;
+}
+
+/** Integer square root against rounded double sqrt, and magnitudes past the old 16-bit products **/
+static void test_magnitude(void)
+{
+  int mismatches = 0;
+  for(uint32_t value = 0; value < (1UL << 20); value++)
+  {
+    if(magnitude_isqrt(value) != (uint32_t)(sqrt(value) + 0.5)) { mismatches++; }
+  }
+  // Around squares and half-way points up to 2^32 - 1
+  for(uint64_t root = 1024; root < 65536; root++)
+  {
+    const uint64_t points[] = { root * root - 1, root * root, root * root + root, root * root + root + 1 };
+    for(size_t ii = 0; ii < sizeof(points) / sizeof(points[0]); ii++)
+    {
+      if(magnitude_isqrt(points[ii]) != (uint32_t)(sqrt((double)points[ii]) + 0.5)) { mismatches++; }
+    }
+  }
+  if(magnitude_isqrt(UINT32_MAX) != 65536) { mismatches++; }
+  check(0 == mismatches, "integer square root equals rounded sqrt");
+
+  const int16_t samples[] = { 0, 0, 1000,   200, -300, 1000,   -32768, -32768, -32768,   24564, 24564, 24564 };
+  uint16_t magnitudes[4];
+  magnitude_block(samples, magnitudes, 4);
+  check(1000 == magnitudes[0] && 1063 == magnitudes[1] && 56756 == magnitudes[2] && 42546 == magnitudes[3],
+        "magnitudes of block, full scale without overflow");
+}
+
+#define TRACE_SAMPLES 1000 // 20 s at 50 Hz
+#define TRACE_WINDOW  250  // 5 s at 50 Hz
+#define TRACE_PI      3.14159265358979
+
+typedef enum{
+  TRACE_REST, //!< Tag lying still on a table
+  TRACE_WALK, //!< Tag in a pocket while walking, steps at 1.8 Hz
+  TRACE_DROP  //!< Tag dropped on the floor from about 80 cm at 8 s, lands upside down
+}trace_t;
+
+/** Uniform noise of +- amplitude mg, fixed seed per trace so that every run sees the same trace **/
+static double trace_noise(uint32_t* seed, int32_t amplitude)
+{
+  *seed = *seed * 1103515245u + 12345u;
+  return (int32_t)((*seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+/** Synthetic 50 Hz trace in mg, X Y Z as drained from LIS2DH12 FIFO, 12 mg steps of 16 G scale **/
+static void trace_generate(trace_t trace, int16_t* samples, size_t count)
+{
+  uint32_t seed = trace + 1;
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    double x = 0, y = 0, z = 1000;
+    if(TRACE_WALK == trace)
+    {
+      double phase = 2 * TRACE_PI * 1.8 * ii / 50;
+      x = 90 + 60 * sin(phase / 2);
+      y = 40 * cos(phase);
+      z = 1000 + 500 * sin(phase) + 150 * sin(2 * phase);
+    }
+    else if(TRACE_DROP == trace && ii >= 400)
+    {
+      // 0.4 s free fall, impact ringing down in about 0.2 s
+      size_t impact = ii - 420;
+      double ring = (ii < 420) ? 0 : exp(-(double)impact / 3) * cos(1.3 * impact);
+      x = 2500 * ring;
+      y = -1800 * ring;
+      z = (ii < 420) ? 0 : -1000 + 10000 * ring;
+    }
+    double axes[3] = { x + trace_noise(&seed, 24), y + trace_noise(&seed, 24), z + trace_noise(&seed, 24) };
+    for(size_t aa = 0; aa < 3; aa++) { samples[3 * ii + aa] = (int16_t)(12 * lround(axes[aa] / 12)); }
+  }
+}
+
+/**
+ *  Feed trace in blocks, store result of every window. Squared feeds magnitudes squared once per block
+ *  like FIFO drain of ruuvi_firmware. @return windows
+ */
+static size_t trace_windows(const int16_t* samples, size_t count, size_t block, int squared,
+                            motion_statistics_result_t* results)
+{
+  uint32_t squares[LIS2DH12_FIFO_MAX_LENGTH];
+  motion_statistics_t statistics;
+  motion_statistics_config_t config = { .threshold = 1500, .bin_width = 250, .window = TRACE_WINDOW };
+  motion_statistics_init(&statistics, &config);
+  for(size_t ii = 0; ii < count; ii += block)
+  {
+    uint32_t windows = statistics.windows;
+    size_t length = (count - ii < block) ? count - ii : block;
+    if(squared)
+    {
+      magnitude_square_block(&samples[3 * ii], squares, length);
+      motion_statistics_add_squares(&statistics, &samples[3 * ii], squares, length, 0);
+    }
+    else { motion_statistics_add(&statistics, &samples[3 * ii], length); }
+    if(statistics.windows != windows) { motion_statistics_get(&statistics, &results[windows]); }
+  }
+  return statistics.windows;
+}
+
+/** Reference of a window in double precision **/
+static int trace_window_matches(const int16_t* samples, const motion_statistics_result_t* result)
+{
+  double peak = 0, sum_square = 0;
+  uint32_t above = 0, histogram[MOTION_STATISTICS_BINS] = { 0 };
+  for(size_t ii = 0; ii < TRACE_WINDOW; ii++)
+  {
+    const int16_t* sample = &samples[3 * ii];
+    double magnitude = sqrt((double)sample[0] * sample[0] + (double)sample[1] * sample[1] + (double)sample[2] * sample[2]);
+    if(magnitude > peak) { peak = magnitude; }
+    sum_square += magnitude * magnitude;
+    if(magnitude >= 1500) { above++; }
+    size_t bin = magnitude / 250;
+    histogram[(bin < MOTION_STATISTICS_BINS) ? bin : MOTION_STATISTICS_BINS - 1]++;
+  }
+  double rms = sqrt(sum_square / TRACE_WINDOW);
+  return TRACE_WINDOW == result->count && fabs(result->peak - peak) <= 0.5 && fabs(result->rms - rms) <= 1
+         && above == result->above && 0 == memcmp(histogram, result->histogram, sizeof(histogram));
+}
+
+static void test_motion_statistics(void)
+{
+  static int16_t samples[3 * TRACE_SAMPLES];
+  motion_statistics_result_t block_results[TRACE_SAMPLES / TRACE_WINDOW];
+  motion_statistics_result_t single_results[TRACE_SAMPLES / TRACE_WINDOW];
+  const char* traces[] = { "rest", "walk", "drop" };
+  uint32_t above[3] = { 0 };
+  char description[96];
+
+  for(size_t tt = 0; tt < sizeof(traces) / sizeof(traces[0]); tt++)
+  {
+    size_t count = TRACE_SAMPLES;
+    trace_generate((trace_t)tt, samples, count);
+    size_t windows = trace_windows(samples, count, LIS2DH12_FIFO_MAX_LENGTH, 0, block_results);
+    int matches = (windows == count / TRACE_WINDOW);
+    for(size_t ww = 0; matches && ww < windows; ww++)
+    {
+      matches = trace_window_matches(&samples[3 * ww * TRACE_WINDOW], &block_results[ww]);
+      above[tt] += block_results[ww].above;
+    }
+    snprintf(description, sizeof(description), "motion statistics of %s equal double precision", traces[tt]);
+    check(matches, description);
+
+    trace_windows(samples, count, 1, 0, single_results);
+    snprintf(description, sizeof(description), "motion statistics of %s do not depend on block size", traces[tt]);
+    check(0 == memcmp(block_results, single_results, windows * sizeof(motion_statistics_result_t)), description);
+
+    trace_windows(samples, count, LIS2DH12_FIFO_MAX_LENGTH, 1, single_results);
+    snprintf(description, sizeof(description), "motion statistics of %s from shared squared magnitudes", traces[tt]);
+    check(0 == memcmp(block_results, single_results, windows * sizeof(motion_statistics_result_t)), description);
+  }
+  check(0 == above[0] && 0 < above[2], "drop is above threshold, rest is not");
+
+  uint8_t encoded[MOTION_STATISTICS_ENCODED_LENGTH];
+  motion_statistics_result_t result = { .count = 250, .peak = 9703, .rms = 1100, .above = 25,
+                                        .histogram = { 0, 0, 0, 125, 100, 0, 0, 25 } };
+  motion_statistics_encode(encoded, &result, motion_statistics_time_above_ms(&result, 5000));
+  const uint8_t expected[] = { MOTION_STATISTICS_FORMAT, 0x25, 0xE7, 0x04, 0x4C, 0x00, 0x32,
+                               0x00, 0x08, 0x60, 0x02, 0x00, 0xFA };
+  check(0 == memcmp(encoded, expected, sizeof(expected)), "motion statistics encoding");
+
+  // Duty cycled accelerometer in a 10 s window: 2 s active at 50 Hz in 25-sample FIFO drains, 0.8 s of it above
+  // threshold, then 8 s idle at 1 Hz with one sample per 1 s drain, 2 of them above. Share of samples would
+  // give 42 / 108 * 10 s = 3.9 s.
+  motion_statistics_t statistics;
+  motion_statistics_config_t config = { .threshold = 1500, .bin_width = 250, .window = 0 };
+  motion_statistics_init(&statistics, &config);
+  int16_t block[3 * 25] = { 0 };
+  uint32_t squares[25];
+  for(size_t drain = 0; drain < 4; drain++)
+  {
+    for(size_t ii = 0; ii < 25; ii++) { block[3 * ii + 2] = (25 * drain + ii < 40) ? 2000 : 1000; }
+    magnitude_square_block(block, squares, 25);
+    motion_statistics_add_squares(&statistics, block, squares, 25, 500);
+  }
+  for(size_t ii = 0; ii < 8; ii++)
+  {
+    block[2] = (ii < 2) ? 2000 : 1000;
+    magnitude_square_block(block, squares, 1);
+    motion_statistics_add_squares(&statistics, block, squares, 1, 1000);
+  }
+  motion_statistics_close(&statistics);
+  motion_statistics_get(&statistics, &result);
+  check(108 == result.count && 42 == result.above && 2800 == motion_statistics_time_above_ms(&result, 10000),
+        "time above threshold weighted by sample period through rate change");
+  block[2] = 2000;
+  motion_statistics_add(&statistics, block, 1);
+  block[2] = 1000;
+  magnitude_square_block(block, squares, 1);
+  motion_statistics_add_squares(&statistics, block, squares, 1, 1000);
+  motion_statistics_close(&statistics);
+  motion_statistics_get(&statistics, &result);
+  check(!result.timed && 500 == motion_statistics_time_above_ms(&result, 1000),
+        "window with untimed samples falls back to share of samples");
+}
+
+/** Compensation example of BME280 datasheet: 25.08 C, and 100653.25 Pa with 64-bit integer formula **/
+static void test_bme280(void)
+{
+  check(BME280_RET_OK == bme280_init(), "bme280_init reads ID and calibration");
+  bme280_set_oversampling_hum(BME280_OVERSAMPLING_1);
+  bme280_set_oversampling_temp(BME280_OVERSAMPLING_1);
+  bme280_set_oversampling_press(BME280_OVERSAMPLING_1);
+  bme280_set_iir(BME280_IIR_16);
+  check(BME280_IIR_16 == (sim_spi_bme280_register(BME280REG_CONFIG) & BME280_IIR_MASK), "IIR written");
+  bme280_set_mode(BME280_MODE_NORMAL);
+
+  sim_spi_statistics_t before, after;
+  sim_spi_statistics_get(&before);
+  check(BME280_RET_OK == bme280_read_measurements(), "bme280_read_measurements");
+  sim_spi_statistics_get(&after);
+  check(1 == after.transfers - before.transfers, "measurement burst takes one SPI transfer");
+  int32_t temperature = bme280_get_temperature();
+  uint32_t pressure = bme280_get_pressure();
+  printf("     temperature %d.%02d C, pressure %u.%02u Pa\n", (int)(temperature / 100), (int)(temperature % 100),
+         pressure / 256, (pressure % 256) * 100 / 256);
+  check(2508 == temperature, "temperature of datasheet example");
+  check(25767233 == pressure, "pressure of datasheet example");
+
+  // Forced conversions, 9.3 ms at 1x and 43.8 ms with 16x pressure
+  check(BME280_RET_ILLEGAL == bme280_set_oversampling_press(BME280_OVERSAMPLING_16), "no configuration in normal mode");
+  check(9300 == bme280_measurement_time_us(), "measurement time of 1x oversampling");
+  bme280_set_mode(BME280_MODE_SLEEP);
+  bme280_set_oversampling_press(BME280_OVERSAMPLING_16);
+  check(43800 == bme280_measurement_time_us(), "measurement time of 16x pressure oversampling");
+  check(BME280_RET_OK == bme280_set_mode(BME280_MODE_FORCED)
+        && BME280_MODE_FORCED == (sim_spi_bme280_register(BME280REG_CTRL_MEAS) & 0x03), "forced conversion started");
+  check(BME280_RET_OK == bme280_set_oversampling_press(BME280_OVERSAMPLING_1), "configuration between forced conversions");
+}
+
+/** 64-bit pressure formula of datasheet as printed, Q24.8 Pa **/
+static uint32_t reference_pressure(int32_t adc_P)
+{
+  int64_t var1, var2, p;
+  var1 = ((int64_t)bme280.t_fine) - 128000;
+  var2 = var1 * var1 * (int64_t)bme280.cp.dig_P6;
+  var2 = var2 + ((var1*(int64_t)bme280.cp.dig_P5) << 17);
+  var2 = var2 + (((int64_t)bme280.cp.dig_P4) << 35);
+  var1 = ((var1 * var1 * (int64_t)bme280.cp.dig_P3) >> 8) + ((var1 * (int64_t)bme280.cp.dig_P2) << 12);
+  var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)bme280.cp.dig_P1) >> 33;
+  if (var1 == 0) { return 0; }
+  p = 1048576 - adc_P;
+  p = (((p << 31) - var2) * 3125) / var1;
+  var1 = (((int64_t)bme280.cp.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+  var2 = (((int64_t)bme280.cp.dig_P8) * p) >> 19;
+  p = ((p + var1 + var2) >> 8) + (((int64_t)bme280.cp.dig_P7) << 4);
+  return (uint32_t)p;
+}
+
+/** Humidity formula of datasheet as printed, Q22.10 %RH, capped to 100 % like the driver **/
+static uint32_t reference_humidity(int32_t adc_H)
+{
+  int32_t v_x1_u32r;
+  v_x1_u32r = (bme280.t_fine - ((int32_t)76800));
+  v_x1_u32r = (((((adc_H << 14) - (((int32_t)bme280.cp.dig_H4) << 20) - (((int32_t)bme280.cp.dig_H5) * v_x1_u32r)) +
+               ((int32_t)16384)) >> 15) * (((((((v_x1_u32r * ((int32_t)bme280.cp.dig_H6)) >> 10) * (((v_x1_u32r *
+               ((int32_t)bme280.cp.dig_H3)) >> 11) + ((int32_t)32768))) >> 10) + ((int32_t)2097152)) *
+               ((int32_t)bme280.cp.dig_H2) + 8192) >> 14));
+  v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * ((int32_t)bme280.cp.dig_H1)) >> 4));
+  v_x1_u32r = (v_x1_u32r < 0 ? 0 : v_x1_u32r);
+  v_x1_u32r = (v_x1_u32r > (100<<22) ? (100<<22) : v_x1_u32r);
+  return (uint32_t)(v_x1_u32r >> 12);
+}
+
+/**
+ *  Every raw pressure and humidity at temperatures from -40 to 85 C in 5 C steps, calibration of bme280_init.
+ *  32-bit pressure is bounded over every raw pressure, outside 300 ... 1100 hPa it falls back to 64-bit formula.
+ */
+static void test_bme280_compensation(void)
+{
+  int pressure_mismatches = 0, humidity_mismatches = 0;
+  uint32_t error_max = 0, error_max_outside = 0;
+  volatile uint32_t sink = 0;
+  double int64_ns = 0, int32_ns = 0, calls = 0;
+  int temperatures = 0;
+
+  for(int32_t adc_t = 0; adc_t < (1 << 20); adc_t += 16)
+  {
+    bme280.adc_t = adc_t;
+    int32_t temperature = bme280_get_temperature();
+    // First raw value at or over each 5 C step
+    if(temperature < -4000 + 500 * temperatures || temperature > 8500) { continue; }
+    temperatures++;
+
+    for(int32_t adc_p = 0; adc_p < (1 << 20); adc_p++)
+    {
+      uint32_t exact = bme280_compensate_pressure_int64(adc_p);
+      if(exact != reference_pressure(adc_p)) { pressure_mismatches++; }
+      uint32_t fast = bme280_compensate_pressure_int32(adc_p);
+      uint32_t error = (fast > exact) ? fast - exact : exact - fast;
+      if(exact >= 30000u * 256 && exact <= 110000u * 256) { if(error > error_max) { error_max = error; } }
+      else if(error > error_max_outside) { error_max_outside = error; }
+    }
+    for(int32_t adc_h = 0; adc_h < (1 << 16); adc_h++)
+    {
+      bme280.adc_h = adc_h;
+      if(bme280_get_humidity() != reference_humidity(adc_h)) { humidity_mismatches++; }
+    }
+
+    double start = now_ns();
+    for(int32_t adc_p = 0; adc_p < (1 << 20); adc_p++) { sink ^= bme280_compensate_pressure_int64(adc_p); }
+    int64_ns += now_ns() - start;
+    start = now_ns();
+    for(int32_t adc_p = 0; adc_p < (1 << 20); adc_p++) { sink ^= bme280_compensate_pressure_int32(adc_p); }
+    int32_ns += now_ns() - start;
+    calls += 1 << 20;
+  }
+  check(26 == temperatures, "compensation at 26 temperatures from -40 to 85 C");
+  check(0 == pressure_mismatches, "precomputed 64-bit pressure equals datasheet formula");
+  check(0 == humidity_mismatches, "precomputed humidity equals datasheet formula");
+  printf("     32-bit pressure error: %u.%02u Pa in operating range, %u.%02u Pa outside\n",
+         error_max / 256, (error_max % 256) * 100 / 256, error_max_outside / 256, (error_max_outside % 256) * 100 / 256);
+  check(error_max <= 8 * 256, "32-bit pressure within 8 Pa of 64-bit pressure in operating range");
+  check(error_max_outside <= 8 * 256, "32-bit pressure within 8 Pa of 64-bit pressure over every raw pressure");
+  printf("     host time per pressure: 64-bit %.2f ns, 32-bit %.2f ns\n", int64_ns / calls, int32_ns / calls);
+  (void)sink;
+}
+
+/** Formulas of derived_metrics.h in double precision **/
+static double reference_saturation(double celcius)
+{
+  return 610.94 * exp(17.625 * celcius / (celcius + 243.04));
+}
+
+static double reference_dew_point(double vapour)
+{
+  double gamma = log(vapour / 610.94);
+  return 243.04 * gamma / (17.625 - gamma);
+}
+
+static double reference_altitude(double pascal)
+{
+  return 44330.77 * (1 - pow(pascal / 101325, 0.190263));
+}
+
+/**
+ *  Derived metrics at every 0.01 C from -40 to 85 C and every 1 %RH, and at every pressure of 300 ... 1100 hPa
+ *  in 1/256 Pa steps of 997, against error bounds of derived_metrics.h.
+ */
+static void test_derived_metrics(void)
+{
+  double es_error = 0, es_error_warm = 0, dew_error = 0, humidity_error = 0, deficit_error = 0, altitude_error = 0;
+  int clamped = 1;
+  volatile int32_t sink = 0;
+  double compute_ns = 0, calls = 0;
+
+  for(int32_t temperature = -4000; temperature <= 8500; temperature++)
+  {
+    double celcius = temperature / 100.0;
+    double saturation = reference_saturation(celcius);
+    double error = fabs(derived_metrics_saturation_pressure(temperature) / 100.0 / saturation - 1);
+    if(error > es_error) { es_error = error; }
+    if(temperature >= 0 && error > es_error_warm) { es_error_warm = error; }
+    if(temperature % 10) { continue; }
+
+    for(uint32_t percent = 1; percent <= 100; percent++)
+    {
+      derived_metrics_t metrics;
+      derived_metrics_compute(temperature, percent * 1024, 101325 * 256, &metrics);
+      double vapour = saturation * percent / 100;
+      // Dew points below -40 C are expected as -40 C, within the same error near the limit
+      double dew_point = fmax(reference_dew_point(vapour), -40);
+      clamped &= (metrics.dew_point >= -4000);
+      if(fabs(metrics.dew_point / 100.0 - dew_point) > dew_error) { dew_error = fabs(metrics.dew_point / 100.0 - dew_point); }
+      // Absolute error over relative bound of saturation pressure
+      double humidity = vapour * 2.16674 / (celcius + 273.15);
+      error = (fabs(metrics.absolute_humidity / 100.0 - humidity) - 0.01) / humidity;
+      if(error > humidity_error) { humidity_error = error; }
+      error = (fabs(metrics.vapour_deficit - (saturation - vapour)) - 1) / saturation;
+      if(error > deficit_error) { deficit_error = error; }
+    }
+  }
+  for(uint32_t pressure = 30000 * 256; pressure <= 110000 * 256; pressure += 997)
+  {
+    double error = fabs(derived_metrics_altitude(pressure) / 100.0 - reference_altitude(pressure / 256.0));
+    if(error > altitude_error) { altitude_error = error; }
+  }
+  for(int32_t temperature = -4000; temperature <= 8500; temperature += 10)
+  {
+    derived_metrics_t metrics;
+    double start = now_ns();
+    for(uint32_t humidity = 0; humidity <= 100 * 1024; humidity += 64)
+    {
+      derived_metrics_compute(temperature, humidity, 30000 * 256 + humidity * 64, &metrics);
+      sink ^= metrics.dew_point;
+    }
+    compute_ns += now_ns() - start;
+    calls += 100 * 1024 / 64 + 1;
+  }
+
+  printf("     saturation pressure %.3f %% (%.3f %% above 0 C), dew point %.3f C, absolute humidity %.3f %%,\n"
+         "     vapour deficit %.3f %% of saturation, altitude %.2f m\n", es_error * 100, es_error_warm * 100, dew_error,
+         humidity_error * 100, deficit_error * 100, altitude_error);
+  check(es_error <= 0.008 && es_error_warm <= 0.004, "saturation pressure within 0.8 %, 0.4 % above 0 C");
+  check(dew_error <= 0.08, "dew point within 0.08 C");
+  check(clamped, "dew point below -40 C is reported as -40 C");
+  check(humidity_error <= 0.008, "absolute humidity within 0.8 % + 0.01 g/m^3");
+  check(deficit_error <= 0.008, "vapour-pressure deficit within 0.8 % of saturation + 1 Pa");
+  check(altitude_error <= 0.6, "pressure altitude within 0.6 m from 300 to 1100 hPa");
+  printf("     host time per sample of derived metrics: %.2f ns\n", compute_ns / calls);
+  (void)sink;
+}
+
+/** Feed steady samples until interval changes, return number of samples fed or 0 if it did not change **/
+static uint32_t adaptive_advertising_steady(const ruuvi_sensor_t* data, uint16_t events, uint32_t limit)
+{
+  uint16_t interval = adaptive_advertising_interval_get();
+  for(uint32_t ii = 1; ii <= limit; ii++)
+  {
+    if(adaptive_advertising_update(data, events, 0) != interval) { return ii; }
+  }
+  return 0;
+}
+
+/**
+ *  Adaptive advertising interval over steady and changing samples, with maximum interval over 32767 ms
+ *  where doubling would wrap in 16 bits, and with maximum below minimum.
+ */
+static void test_adaptive_advertising(void)
+{
+  adaptive_advertising_config_t config = { .min_interval = 1000, .max_interval = 65000, .steady_samples = 3,
+                                           .temperature_threshold = 50, .humidity_threshold = 2048,
+                                           .pressure_threshold = 25600, .acceleration_threshold = 100,
+                                           .motion_threshold = 50 };
+  ruuvi_sensor_t data = { .temperature = 2000, .humidity = 50 * 1024, .pressure = 101325 * 256, .accZ = 1000 };
+  adaptive_advertising_init(&config);
+
+  int first = (1000 == adaptive_advertising_update(&data, 0, 0));
+  check(first, "adaptive advertising starts at minimum interval");
+
+  // 1000, 2000, ... 64000 ms, each after 3 steady samples, then 65000 ms instead of wrapping 128000 ms
+  int doubling = 1;
+  uint16_t expected = 1000;
+  while(expected < 64000)
+  {
+    doubling &= (3 == adaptive_advertising_steady(&data, 0, 10));
+    expected *= 2;
+    doubling &= (expected == adaptive_advertising_interval_get());
+  }
+  check(doubling, "adaptive advertising interval doubles after 3 steady samples");
+  int clamped = (3 == adaptive_advertising_steady(&data, 0, 10)) && (65000 == adaptive_advertising_interval_get());
+  clamped &= (0 == adaptive_advertising_steady(&data, 0, 100)) && (65000 == adaptive_advertising_interval_get());
+  check(clamped, "adaptive advertising interval is clamped to maximum of 65000 ms");
+
+  // Drift of 0.2 C per sample is under threshold from previous sample, but over it from reference
+  int changes = 1;
+  data.temperature += 20;
+  changes &= (65000 == adaptive_advertising_update(&data, 0, 0));
+  data.temperature += 20;
+  changes &= (65000 == adaptive_advertising_update(&data, 0, 0));
+  data.temperature += 20;
+  changes &= (1000 == adaptive_advertising_update(&data, 0, 0));
+  adaptive_advertising_steady(&data, 0, 10);
+  changes &= (1000 == adaptive_advertising_update(&data, 1, 0));
+  adaptive_advertising_steady(&data, 1, 10);
+  changes &= (1000 == adaptive_advertising_update(&data, 1, 51));
+  adaptive_advertising_steady(&data, 1, 10);
+  changes &= (2000 == adaptive_advertising_update(&data, 1, 50));
+  data.accX = 101;
+  changes &= (1000 == adaptive_advertising_update(&data, 1, 0));
+  check(changes, "adaptive advertising drops to minimum on drift, acceleration event, motion and acceleration");
+
+  // Maximum below minimum is raised to minimum, interval does not move
+  config.min_interval = 2000;
+  config.max_interval = 1000;
+  adaptive_advertising_init(&config);
+  int inverted = (2000 == adaptive_advertising_update(&data, 0, 0));
+  inverted &= (0 == adaptive_advertising_steady(&data, 0, 100)) && (2000 == adaptive_advertising_interval_get());
+  check(inverted, "adaptive advertising stays at minimum if maximum is below it");
+}
+
+/** Multiply in GF(2^8) of AES **/
+static uint8_t aes_multiply(uint8_t a, uint8_t b)
+{
+  uint8_t product = 0;
+  for(; b; b >>= 1)
+  {
+    if(b & 1) { product ^= a; }
+    a = (a << 1) ^ ((a & 0x80) ? 0x1B : 0);
+  }
+  return product;
+}
+
+/** S-box of FIPS-197 from multiplicative inverse and affine transform **/
+static uint8_t aes_sbox(uint8_t value)
+{
+  uint8_t inverse = 0;
+  for(int candidate = 1; value && candidate < 256; candidate++)
+  {
+    if(1 == aes_multiply(value, candidate)) { inverse = candidate; }
+  }
+  uint8_t result = 0x63;
+  for(int ii = 0; ii < 5; ii++) { result ^= (inverse << ii) | (inverse >> (8 - ii)); }
+  return result;
+}
+
+static uint32_t m_aes_blocks  = 0;
+static uint32_t m_aes_fail_at = UINT32_MAX;
+
+/** Plain software AES-128 in place of SoftDevice ECB, block number m_aes_fail_at fails like a busy ECB **/
+static ret_code_t software_aes_encrypt(const uint8_t* key, const uint8_t* in, uint8_t* out)
+{
+  static uint8_t sbox[256];
+  if(!sbox[0]) { for(int ii = 0; ii < 256; ii++) { sbox[ii] = aes_sbox(ii); } }
+  if(m_aes_blocks++ == m_aes_fail_at) { return NRF_ERROR_BUSY; }
+
+  uint8_t round_key[16], state[16], rcon = 1;
+  memcpy(round_key, key, 16);
+  for(int ii = 0; ii < 16; ii++) { state[ii] = in[ii] ^ round_key[ii]; }
+  for(int round = 1; round <= 10; round++)
+  {
+    // SubBytes and ShiftRows, state is column by column
+    uint8_t shifted[16];
+    for(int ii = 0; ii < 16; ii++) { shifted[ii] = sbox[state[(ii + 4 * (ii % 4)) % 16]]; }
+    // MixColumns, except in last round
+    for(int column = 0; column < 4; column++)
+    {
+      uint8_t* c = &shifted[4 * column];
+      uint8_t a0 = c[0], a1 = c[1], a2 = c[2], a3 = c[3];
+      if(10 == round) { break; }
+      c[0] = aes_multiply(a0, 2) ^ aes_multiply(a1, 3) ^ a2 ^ a3;
+      c[1] = a0 ^ aes_multiply(a1, 2) ^ aes_multiply(a2, 3) ^ a3;
+      c[2] = a0 ^ a1 ^ aes_multiply(a2, 2) ^ aes_multiply(a3, 3);
+      c[3] = aes_multiply(a0, 3) ^ a1 ^ a2 ^ aes_multiply(a3, 2);
+    }
+    // Next round key
+    uint8_t temp[4] = { sbox[round_key[13]] ^ rcon, sbox[round_key[14]], sbox[round_key[15]], sbox[round_key[12]] };
+    for(int ii = 0; ii < 16; ii++) { round_key[ii] ^= (ii < 4) ? temp[ii] : round_key[ii - 4]; }
+    rcon = aes_multiply(rcon, 2);
+    for(int ii = 0; ii < 16; ii++) { state[ii] = shifted[ii] ^ round_key[ii]; }
+  }
+  memcpy(out, state, 16);
+  return NRF_SUCCESS;
+}
+
+static size_t hex_decode(const char* hex, uint8_t* data)
+{
+  size_t length = 0;
+  for(; hex[0] && hex[1]; hex += 2)
+  {
+    unsigned int value;
+    sscanf(hex, "%2x", &value);
+    data[length++] = value;
+  }
+  return length;
+}
+
+/** Test vectors of The EAX Mode of Operation, Bellare, Rogaway and Wagner. Cipher is ciphertext || tag. **/
+static const char* const m_eax_vectors[][5] = {
+  // message, key, nonce, header, cipher
+  { "", "233952DEE4D5ED5F9B9C6D6FF80FF478", "62EC67F9C3A4A407FCB2A8C49031A8B3", "6BFB914FD07EAE6B",
+    "E037830E8389F27B025A2D6527E79D01" },
+  { "F7FB", "91945D3F4DCBEE0BF45EF52255F095A4", "BECAF043B0A23D843194BA972C66DEBD", "FA3BFD4806EB53FA",
+    "19DD5C4C9331049D0BDAB0277408F67967E5" },
+  { "1A47CB4933", "01F74AD64077F2E704C0F60ADA3DD523", "70C3DB4F0D26368400A10ED05D2BFF5E", "234A3463C1264AC6",
+    "D851D5BAE03A59F238A23E39199DC9266626C40F80" },
+  { "481C9E39B1", "D07CF6CBB7F313BDDE66B727AFD3C5E8", "8408DFFF3C1A2B1292DC199E46B7D617", "33CCE2EABFF5A79D",
+    "632A9D131AD4C168A4225D8E1FF755939974A7BEDE" },
+  { "40D0C07DA5E4", "35B6D0580005BBC12B0587124557D2C2", "FDB6B06676EEDC5C61D74276E1F8E816", "AEB96EAEBE2970E9",
+    "071DFE16C675CB0677E536F73AFE6A14B74EE49844DD" },
+  { "4DE3B35C3FC039245BD1FB7D", "BD8E6E11475E60B268784C38C62FEB22", "6EAC5C93072D8E8513F750935E46DA1B",
+    "D4482D1CA78DCE0F", "835BB4F15D743E350E728414ABB8644FD6CCB86947C5E10590210A4F" },
+  { "8B0A79306C9CE7ED99DAE4F87F8DD61636", "7C77D6E813BED5AC98BAA417477A2E7D", "1A8C98DCD73D38393B2BF1569DEEFC19",
+    "65D2017990D62528", "02083E3979DA014812F59F11D52630DA30137327D10649B0AA6E1C181DB617D7F2" },
+  { "1BDA122BCE8A8DBAF1877D962B8592DD2D56", "5FFF20CAFAB119CA2FC73549E20F5B0D", "DDE59B97D722156D4D9AFF2BC7559826",
+    "54B9F04E6A09189A", "2EC47B2C4954A489AFC7BA4897EDCDAE8CC33B60450599BD02C96382902AEF7F832A" },
+  { "6CF36720872B8513F6EAB1A8A44438D5EF11", "A4A4782BCFFD3EC5E7EF6D8C34A56123", "B781FCF2F75FA5A8DE97A9CA48E522EC",
+    "899A175897561D7E", "0DE18FD0FDD91E7AF19F1D8EE8733938B1E8E7F6D2231618102FDB7FE55FF1991700" },
+  { "CA40D7446E545FFAED3BD12A740A659FFBBB3CEAB7", "8395FCF1E95BEBD697BD010BC766AAC3",
+    "22E7ADD93CFC6393C57EC0B3C17D6B44", "126735FCC320D25A",
+    "CB8920F87A6C75CFF39627B56E3ED197C552D295A7CFC46AFC253B4652B1AF3795B124AB6E" },
+};
+
+/** AES-128 of FIPS-197 appendix C.1, then every EAX paper vector, then a block cipher which fails **/
+static void test_aes_eax(void)
+{
+  uint8_t key[16], block[16], expected[64];
+  hex_decode("000102030405060708090A0B0C0D0E0F", key);
+  hex_decode("00112233445566778899AABBCCDDEEFF", block);
+  hex_decode("69C4E0D86A7B0430D8CDB78070B4C55A", expected);
+  software_aes_encrypt(key, block, block);
+  check(0 == memcmp(block, expected, 16), "software AES-128 matches FIPS-197 example");
+
+  int vectors = 1;
+  for(size_t ii = 0; ii < sizeof(m_eax_vectors) / sizeof(m_eax_vectors[0]); ii++)
+  {
+    uint8_t data[32], nonce[16], header[16], tag[16];
+    size_t length = hex_decode(m_eax_vectors[ii][0], data);
+    hex_decode(m_eax_vectors[ii][1], key);
+    size_t nonce_length  = hex_decode(m_eax_vectors[ii][2], nonce);
+    size_t header_length = hex_decode(m_eax_vectors[ii][3], header);
+    hex_decode(m_eax_vectors[ii][4], expected);
+    ret_code_t err_code = aes_eax_encrypt(software_aes_encrypt, key, nonce, nonce_length, header, header_length,
+                                          data, length, tag);
+    int passed = (NRF_SUCCESS == err_code) && !memcmp(data, expected, length) && !memcmp(tag, &expected[length], 16);
+    if(!passed) { printf("     EAX vector %u differs\n", (unsigned)ii + 1); }
+    vectors &= passed;
+  }
+  check(vectors, "AES-EAX matches the 10 test vectors of the EAX paper");
+
+  // Error of any block encryption is returned, as by eTLM of 12 bytes with 6-byte nonce and no header
+  uint8_t data[12] = {0}, nonce[6] = {0}, tag[16];
+  m_aes_blocks = 0;
+  int failures = (NRF_SUCCESS == aes_eax_encrypt(software_aes_encrypt, key, nonce, sizeof(nonce), NULL, 0,
+                                                 data, sizeof(data), tag));
+  uint32_t blocks = m_aes_blocks;
+  for(m_aes_fail_at = 0; m_aes_fail_at < blocks; m_aes_fail_at++)
+  {
+    m_aes_blocks = 0;
+    failures &= (NRF_ERROR_BUSY == aes_eax_encrypt(software_aes_encrypt, key, nonce, sizeof(nonce), NULL, 0,
+                                                   data, sizeof(data), tag));
+    // Nothing is encrypted after the failing block
+    failures &= (m_aes_blocks == m_aes_fail_at + 1);
+  }
+  m_aes_fail_at = UINT32_MAX;
+  check(failures && blocks, "AES-EAX returns error of any block encryption of eTLM and stops there");
+}
+
+/**
+ *  Accelerometer duty cycle with the configuration of ruuvi_firmware: 30 s quiet period, 16 mg motion threshold
+ *  below the 64 mg activity interrupt threshold.
+ */
+static void test_activity_duty_cycle(void)
+{
+  const activity_duty_cycle_config_t config = { .quiet_period_ms = 30000, .motion_threshold = 16 };
+  const activity_state_t IDLE = ACTIVITY_STATE_IDLE, ACTIVE = ACTIVITY_STATE_ACTIVE;
+
+  // Counter of activity interrupts was 7 before boot, first value must not restart the quiet period
+  activity_duty_cycle_init(&config, 1000);
+  int first = (ACTIVE == activity_duty_cycle_update(7, 0, 20000));
+  first &= (IDLE == activity_duty_cycle_update(7, 0, 31000));
+  check(first, "duty cycle ignores first activity counter value");
+
+  // Lost wake interrupt is caught by counter, quiet period starts from the update which saw it
+  int wake = (ACTIVE == activity_duty_cycle_update(8, 0, 40000));
+  wake &= (ACTIVE == activity_duty_cycle_update(8, 0, 69999));
+  wake &= (IDLE == activity_duty_cycle_update(8, 0, 70000));
+  wake &= (ACTIVE == activity_duty_cycle_on_wake(80000)) && (ACTIVE == activity_duty_cycle_state_get());
+  wake &= (IDLE == activity_duty_cycle_update(8, 0, 110000));
+  check(wake, "duty cycle wakes on activity interrupt and on activity counter change");
+
+  // Motion at or over 16 mg, too small for the 64 mg interrupt, keeps the tag awake but does not wake it
+  int hysteresis = 1;
+  activity_duty_cycle_on_wake(200000);
+  for(uint32_t now = 210000; now <= 600000; now += 10000)
+  {
+    hysteresis &= (ACTIVE == activity_duty_cycle_update(8, (now % 20000) ? 40 : 16, now));
+  }
+  hysteresis &= (ACTIVE == activity_duty_cycle_update(8, 15, 629999));
+  hysteresis &= (IDLE == activity_duty_cycle_update(8, 15, 630000));
+  hysteresis &= (IDLE == activity_duty_cycle_update(8, 40, 640000));
+  hysteresis &= (IDLE == activity_duty_cycle_update(8, 63, 700000));
+  check(hysteresis, "duty cycle stays awake on motion between motion and activity thresholds, sleeps below it");
+
+  // millis() wraps from UINT32_MAX to 0 within the quiet period
+  int wraparound = (ACTIVE == activity_duty_cycle_on_wake(UINT32_MAX - 9999));
+  wraparound &= (ACTIVE == activity_duty_cycle_update(8, 0, 0));
+  wraparound &= (ACTIVE == activity_duty_cycle_update(8, 0, 19999));
+  wraparound &= (IDLE == activity_duty_cycle_update(8, 0, 20000));
+  check(wraparound, "duty cycle quiet period spans millis() wraparound");
+}
+
+int main(int argc, char** argv)
+{
+  sim_spi_init();
+  test_lis2dh12_fifo();
+  test_lis2dh12_events();
+  test_lis2dh12_shadow();
+  test_lis2dh12_conversion();
+  test_magnitude();
+  test_motion_statistics();
+  test_bme280();
+  test_bme280_compensation();
+  test_derived_metrics();
+  test_adaptive_advertising();
+  test_aes_eax();
+  test_activity_duty_cycle();
+  printf("%s heap allocations by drivers: %u\n", (0 == m_allocations) ? "PASS" : "FAIL", m_allocations);
+  if(m_allocations) { m_failures++; }
+  return m_failures ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+#ifndef APP_ERROR_H
+#define APP_ERROR_H
+
+/** Host stand-in for Nordic SDK app_error.h, aborts simulation on error **/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sdk_errors.h"
+
+#define APP_ERROR_HANDLER(ERR_CODE)                                          \
+    do                                                                       \
+    {                                                                        \
+        fprintf(stderr, "Fatal error %u at %s:%d\n", (unsigned)(ERR_CODE),   \
+                __FILE__, __LINE__);                                         \
+        exit(1);                                                             \
+    } while (0)
+
+#define APP_ERROR_CHECK(ERR_CODE)                                            \
+    do                                                                       \
+    {                                                                        \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE);                          \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS)                                   \
+        {                                                                    \
+            APP_ERROR_HANDLER(LOCAL_ERR_CODE);                               \
+        }                                                                    \
+    } while (0)
+
+#endif
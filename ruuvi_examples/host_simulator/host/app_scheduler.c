@@ -0,0 +1,113 @@
+#include "app_scheduler.h"
+#include "nrf_error.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  app_sched_event_handler_t handler;
+  uint16_t                  event_size;
+}event_header_t;
+
+static event_header_t*          p_headers      = NULL;
+static uint8_t*                 p_data         = NULL;
+static uint16_t                 m_max_size     = 0;
+static uint16_t                 m_queue_size   = 0;
+static uint16_t                 m_start        = 0;
+static uint16_t                 m_count        = 0;
+static app_sched_sim_stats_t    m_stats        = {0};
+static app_sched_sim_observer_t p_observer     = NULL;
+static void                   (*p_idle)(void)  = NULL;
+static bool                     m_in_idle      = false;
+
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void * p_evt_buffer)
+{
+  (void)p_evt_buffer;
+  free(p_headers);
+  free(p_data);
+  p_headers = calloc(queue_size, sizeof(event_header_t));
+  p_data    = calloc(queue_size, max_event_size);
+  if(NULL == p_headers || NULL == p_data) { return NRF_ERROR_NO_MEM; }
+  m_max_size   = max_event_size;
+  m_queue_size = queue_size;
+  m_start      = 0;
+  m_count      = 0;
+  memset(&m_stats, 0, sizeof(m_stats));
+  m_stats.queue_size = queue_size;
+  return NRF_SUCCESS;
+}
+
+uint32_t app_sched_event_put(void const * p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+  if(event_size > m_max_size) { m_stats.drops++; return NRF_ERROR_INVALID_LENGTH; }
+  if(m_count >= m_queue_size) { m_stats.drops++; return NRF_ERROR_NO_MEM; }
+
+  uint16_t index = (m_start + m_count) % m_queue_size;
+  p_headers[index].handler    = handler;
+  p_headers[index].event_size = event_size;
+  if(p_event_data && event_size) { memcpy(&p_data[index * m_max_size], p_event_data, event_size); }
+  m_count++;
+
+  m_stats.puts++;
+  m_stats.depth_sum += m_count;
+  if(m_count > m_stats.depth_max) { m_stats.depth_max = m_count; }
+  return NRF_SUCCESS;
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void app_sched_execute(void)
+{
+  uint8_t event[m_max_size ? m_max_size : 1];
+  while(m_count)
+  {
+    // Copy event out before executing, handler may put new events to queue
+    event_header_t header = p_headers[m_start];
+    memcpy(event, &p_data[m_start * m_max_size], header.event_size);
+    m_start = (m_start + 1) % m_queue_size;
+    m_count--;
+
+    uint64_t start = now_ns();
+    header.handler(event, header.event_size);
+    uint64_t elapsed = now_ns() - start;
+    m_stats.executed++;
+    if(p_observer) { p_observer(header.handler, elapsed); }
+  }
+  if(p_idle && !m_in_idle)
+  {
+    m_in_idle = true;
+    p_idle();
+    m_in_idle = false;
+  }
+}
+
+uint16_t app_sched_queue_space_get(void)
+{
+  return m_queue_size - m_count;
+}
+
+uint16_t app_sched_queue_utilization_get(void)
+{
+  return m_stats.depth_max;
+}
+
+void app_sched_sim_stats_get(app_sched_sim_stats_t* stats)
+{
+  *stats = m_stats;
+}
+
+void app_sched_sim_observer_set(app_sched_sim_observer_t observer)
+{
+  p_observer = observer;
+}
+
+void app_sched_sim_idle_set(void(*idle)(void))
+{
+  p_idle = idle;
+}
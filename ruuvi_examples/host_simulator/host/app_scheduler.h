@@ -0,0 +1,50 @@
+#ifndef APP_SCHEDULER_H
+#define APP_SCHEDULER_H
+
+/**
+ *  Host stand-in for Nordic SDK app_scheduler.h.
+ *  Same FIFO semantics and error codes as the SDK scheduler, plus counters used by the
+ *  simulator report.
+ */
+
+#include <stdint.h>
+#include "sdk_errors.h"
+#include "app_error.h"
+
+typedef void (*app_sched_event_handler_t)(void * p_event_data, uint16_t event_size);
+
+#define APP_SCHED_INIT(EVENT_SIZE, QUEUE_SIZE) \
+    APP_ERROR_CHECK(app_sched_init((EVENT_SIZE), (QUEUE_SIZE), NULL))
+
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void * p_evt_buffer);
+uint32_t app_sched_event_put(void const * p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+void     app_sched_execute(void);
+uint16_t app_sched_queue_space_get(void);
+uint16_t app_sched_queue_utilization_get(void);
+
+/** Simulator statistics, not part of the SDK API **/
+typedef struct {
+  uint64_t puts;          /**< Events placed to queue */
+  uint64_t drops;         /**< Events rejected, queue full or event too large */
+  uint64_t executed;      /**< Events executed */
+  uint64_t depth_sum;     /**< Sum of queue depth after each put, for average */
+  uint16_t depth_max;     /**< Maximum queue depth seen */
+  uint16_t queue_size;
+}app_sched_sim_stats_t;
+
+/**
+ *  Callback invoked around every executed event.
+ *  Simulator uses this to measure per-handler latency.
+ */
+typedef void(*app_sched_sim_observer_t)(app_sched_event_handler_t handler, uint64_t elapsed_ns);
+
+void app_sched_sim_stats_get(app_sched_sim_stats_t* stats);
+void app_sched_sim_observer_set(app_sched_sim_observer_t observer);
+
+/**
+ *  Function called after queue is drained, i.e. the rest of the main loop of the tag
+ *  before it goes to sleep. Not called recursively if it puts new events.
+ */
+void app_sched_sim_idle_set(void(*idle)(void));
+
+#endif
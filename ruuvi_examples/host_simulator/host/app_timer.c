@@ -0,0 +1,147 @@
+#include "app_timer.h"
+#include "app_timer_appsh.h"
+#include "app_scheduler.h"
+#include "nrf_error.h"
+
+/**
+ *  Virtual RTC1. Time is kept as 64-bit tick count so that long simulations do not
+ *  wrap around, app_timer_cnt_get returns 24 lowest bits like the hardware counter.
+ */
+static uint64_t     m_now          = 0;
+static uint64_t     m_expiries     = 0;
+static uint32_t     m_prescaler    = 0;
+static app_timer_t* p_timer_list   = NULL;
+
+uint32_t app_timer_init(uint32_t prescaler, uint8_t op_queue_size, void * p_buffer, void* evt_schedule_func)
+{
+  UNUSED_PARAMETER(op_queue_size);
+  UNUSED_PARAMETER(p_buffer);
+  UNUSED_PARAMETER(evt_schedule_func);
+  m_prescaler = prescaler;
+  m_now       = 0;
+  m_expiries  = 0;
+  return NRF_SUCCESS;
+}
+
+uint32_t app_timer_create(app_timer_id_t const * p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler)
+{
+  if(NULL == p_timer_id || NULL == timeout_handler) { return NRF_ERROR_INVALID_PARAM; }
+  app_timer_t* p_timer = *p_timer_id;
+  if(p_timer->running) { return NRF_ERROR_INVALID_STATE; }
+  p_timer->handler = timeout_handler;
+  p_timer->mode    = mode;
+  if(!p_timer->created)
+  {
+    p_timer->created = true;
+    p_timer->p_next  = p_timer_list;
+    p_timer_list     = p_timer;
+  }
+  return NRF_SUCCESS;
+}
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context)
+{
+  if(timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS) { return NRF_ERROR_INVALID_PARAM; }
+  if(NULL == timer_id || !timer_id->created)      { return NRF_ERROR_INVALID_STATE; }
+  // SDK ignores start of a running timer
+  if(timer_id->running) { return NRF_SUCCESS; }
+  timer_id->p_context       = p_context;
+  timer_id->period          = timeout_ticks;
+  timer_id->ticks_to_expire = m_now + timeout_ticks;
+  timer_id->running         = true;
+  return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+  if(NULL == timer_id) { return NRF_ERROR_INVALID_PARAM; }
+  timer_id->running = false;
+  return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop_all(void)
+{
+  for(app_timer_t* p_timer = p_timer_list; p_timer; p_timer = p_timer->p_next)
+  {
+    p_timer->running = false;
+  }
+  return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(uint32_t * p_ticks)
+{
+  *p_ticks = (uint32_t)(m_now & 0x00FFFFFF);
+  return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff)
+{
+  *p_ticks_diff = (ticks_to - ticks_from) & 0x00FFFFFF;
+  return NRF_SUCCESS;
+}
+
+/** Same as app_timer_appsh.c: unpack event and call timeout handler from scheduler context **/
+static void app_timer_evt_get(void * p_event_data, uint16_t event_size)
+{
+  app_timer_event_t * p_timer_event = (app_timer_event_t *)p_event_data;
+  UNUSED_VARIABLE(event_size);
+  p_timer_event->timeout_handler(p_timer_event->p_context);
+}
+
+static app_timer_t* next_expiring(uint64_t until)
+{
+  app_timer_t* p_next = NULL;
+  for(app_timer_t* p_timer = p_timer_list; p_timer; p_timer = p_timer->p_next)
+  {
+    if(!p_timer->running || p_timer->ticks_to_expire > until) { continue; }
+    if(NULL == p_next || p_timer->ticks_to_expire < p_next->ticks_to_expire) { p_next = p_timer; }
+  }
+  return p_next;
+}
+
+void app_timer_sim_advance(uint64_t ticks)
+{
+  uint64_t target = m_now + ticks;
+  app_timer_t* p_timer;
+  while(NULL != (p_timer = next_expiring(target)))
+  {
+    m_now = p_timer->ticks_to_expire;
+    if(APP_TIMER_MODE_REPEATED == p_timer->mode) { p_timer->ticks_to_expire += p_timer->period; }
+    else { p_timer->running = false; }
+    m_expiries++;
+
+    if(p_timer->irq)
+    {
+      p_timer->handler(p_timer->p_context);
+      app_sched_execute();
+      continue;
+    }
+    app_timer_event_t timer_event = { .timeout_handler = p_timer->handler,
+                                      .p_context       = p_timer->p_context };
+    // Error is counted by the scheduler as a drop, RTC interrupt cannot do anything about it.
+    (void)app_sched_event_put(&timer_event, sizeof(timer_event), app_timer_evt_get);
+    app_sched_execute();
+  }
+  m_now = target;
+  app_sched_execute();
+}
+
+void app_timer_sim_irq_set(app_timer_id_t timer_id, bool irq)
+{
+  timer_id->irq = irq;
+}
+
+uint64_t app_timer_sim_now(void)
+{
+  return m_now;
+}
+
+uint64_t app_timer_sim_expiries(void)
+{
+  return m_expiries;
+}
+
+uint32_t app_timer_sim_tick_rate(void)
+{
+  return APP_TIMER_CLOCK_FREQ / (m_prescaler + 1);
+}
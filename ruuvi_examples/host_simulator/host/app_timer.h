@@ -0,0 +1,86 @@
+#ifndef APP_TIMER_H
+#define APP_TIMER_H
+
+/**
+ *  Host stand-in for Nordic SDK app_timer.h.
+ *
+ *  Timers run on a virtual RTC1 clock instead of hardware. The clock only moves when
+ *  the simulator calls app_timer_sim_advance(), so runs are deterministic and can
+ *  cover hours of tag time in a fraction of a second.
+ *  Expired timers are dispatched through app_scheduler, like APP_TIMER_APPSH_INIT(..., true)
+ *  does on the tag.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "nordic_common.h"
+#include "sdk_errors.h"
+
+#define APP_TIMER_CLOCK_FREQ 32768 /**< Clock frequency of the RTC timer used to implement the app timer module. */
+#define APP_TIMER_MIN_TIMEOUT_TICKS 5
+
+/**@brief Convert milliseconds to timer ticks, same rounding as the SDK. */
+#define APP_TIMER_TICKS(MS, PRESCALER) \
+            ((uint32_t)ROUNDED_DIV((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ, ((PRESCALER) + 1) * 1000))
+
+typedef void (*app_timer_timeout_handler_t)(void * p_context);
+
+typedef enum
+{
+  APP_TIMER_MODE_SINGLE_SHOT,
+  APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef struct app_timer_t
+{
+  app_timer_timeout_handler_t handler;
+  app_timer_mode_t            mode;
+  void*                       p_context;
+  uint64_t                    ticks_to_expire; /**< Absolute expiry time in virtual ticks */
+  uint32_t                    period;
+  bool                        created;
+  bool                        running;
+  bool                        irq;             /**< Simulator: call handler at expiry instead of scheduling it */
+  struct app_timer_t*         p_next;          /**< Linked list of created timers */
+} app_timer_t;
+
+typedef app_timer_t* app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id)                                  \
+    static app_timer_t timer_id##_data = { 0 };                  \
+    static const app_timer_id_t timer_id = &timer_id##_data
+
+uint32_t app_timer_init(uint32_t prescaler, uint8_t op_queue_size, void * p_buffer, void* evt_schedule_func);
+uint32_t app_timer_create(app_timer_id_t const * p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_stop_all(void);
+uint32_t app_timer_cnt_get(uint32_t * p_ticks);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff);
+
+/** Simulator hooks, not part of the SDK API **/
+
+/**
+ *  Advance virtual clock by given number of ticks. Every timer that expires on the way
+ *  is scheduled and the scheduler queue is drained at the expiry time, so handlers observe
+ *  the virtual time at which they would run on the tag.
+ */
+void app_timer_sim_advance(uint64_t ticks);
+
+/**
+ *  Run timer handler directly at expiry, i.e. in interrupt context. Used by simulated
+ *  peripherals to model GPIOTE interrupts which bypass the scheduler on the tag.
+ */
+void app_timer_sim_irq_set(app_timer_id_t timer_id, bool irq);
+
+/** Current virtual time in ticks since start of simulation **/
+uint64_t app_timer_sim_now(void);
+
+/** Number of timer expiries since start of simulation **/
+uint64_t app_timer_sim_expiries(void);
+
+/** Ticks per second with the prescaler given to app_timer_init **/
+uint32_t app_timer_sim_tick_rate(void);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef APP_TIMER_APPSH_H
+#define APP_TIMER_APPSH_H
+
+/** Host stand-in for Nordic SDK app_timer_appsh.h **/
+
+#include "app_timer.h"
+#include "app_scheduler.h"
+
+typedef struct
+{
+  app_timer_timeout_handler_t timeout_handler;
+  void *                      p_context;
+} app_timer_event_t;
+
+#define APP_TIMER_SCHED_EVT_SIZE sizeof(app_timer_event_t)
+
+#define APP_TIMER_APPSH_INIT(PRESCALER, OP_QUEUE_SIZE, USE_SCHEDULER) \
+    APP_ERROR_CHECK(app_timer_init((PRESCALER), (OP_QUEUE_SIZE), NULL, NULL))
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef APP_UTIL_H
+#define APP_UTIL_H
+
+/** Host stand-in for Nordic SDK app_util.h, unit conversions used by BLE configuration **/
+
+#include <stdint.h>
+#include "nordic_common.h"
+
+enum
+{
+  UNIT_0_625_MS = 625,    /**< Number of microseconds in 0.625 milliseconds. */
+  UNIT_1_25_MS  = 1250,   /**< Number of microseconds in 1.25 milliseconds. */
+  UNIT_10_MS    = 10000   /**< Number of microseconds in 10 milliseconds. */
+};
+
+#define MSEC_TO_UNITS(TIME, RESOLUTION) (((TIME) * 1000) / (RESOLUTION))
+
+/**@brief Function for decoding a uint16 value, little endian. */
+static inline uint16_t uint16_decode(const uint8_t * p_encoded_data)
+{
+  return ( (((uint16_t)((uint8_t *)p_encoded_data)[0])) |
+           (((uint16_t)((uint8_t *)p_encoded_data)[1]) << 8 ));
+}
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef APP_UTIL_PLATFORM_H
+#define APP_UTIL_PLATFORM_H
+
+/** Host stand-in for Nordic SDK app_util_platform.h, simulator has a single thread **/
+
+#include "app_util.h"
+
+#define CRITICAL_REGION_ENTER()
+#define CRITICAL_REGION_EXIT()
+
+#endif
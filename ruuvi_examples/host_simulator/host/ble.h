@@ -0,0 +1,25 @@
+#ifndef BLE_H
+#define BLE_H
+
+/** Host stand-in for SoftDevice ble.h, only values used by Ruuvi BLE drivers **/
+
+#include <stdint.h>
+#include "nrf_error.h"
+
+#define NRF_ERROR_STK_BASE_NUM  (0x3000)
+#define BLE_ERROR_NO_TX_PACKETS (NRF_ERROR_STK_BASE_NUM + 0x004) /**< Not enough application packets available on this connection. */
+
+#define BLE_CONN_HANDLE_INVALID 0xFFFF  /**< Invalid Connection Handle. */
+#define GATT_MTU_SIZE_DEFAULT   23      /**< Default MTU size, in bytes. */
+#define BLE_GATT_HVX_NOTIFICATION 0x01  /**< Handle Value Notification, bit of CCCD value. */
+
+/**< GATT characteristic definition handles, from ble_gatts.h. */
+typedef struct
+{
+  uint16_t value_handle;     /**< Handle to the characteristic value. */
+  uint16_t user_desc_handle; /**< Handle to the User Description descriptor, or BLE_GATT_HANDLE_INVALID if not present. */
+  uint16_t cccd_handle;      /**< Handle to the Client Characteristic Configuration Descriptor, or BLE_GATT_HANDLE_INVALID if not present. */
+  uint16_t sccd_handle;      /**< Handle to the Server Characteristic Configuration Descriptor, or BLE_GATT_HANDLE_INVALID if not present. */
+} ble_gatts_char_handles_t;
+
+#endif
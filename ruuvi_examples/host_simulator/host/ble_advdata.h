@@ -0,0 +1,40 @@
+#ifndef BLE_ADVDATA_H
+#define BLE_ADVDATA_H
+
+/** Host stand-in for Nordic SDK ble_advdata.h, types of advertisement data given to advertising scheduler **/
+
+#include "sdk_common.h"
+#include "ble.h"
+#include "ble_gap.h"
+
+/**@brief Byte array type. */
+typedef struct
+{
+  uint16_t  size;   /**< Number of array entries. */
+  uint8_t * p_data; /**< Pointer to array entries. */
+} uint8_array_t;
+
+/**@brief Advertising data name type. */
+typedef enum
+{
+  BLE_ADVDATA_NO_NAME,    /**< Include no device name in advertising data. */
+  BLE_ADVDATA_SHORT_NAME, /**< Include short device name in advertising data. */
+  BLE_ADVDATA_FULL_NAME   /**< Include full device name in advertising data. */
+} ble_advdata_name_type_t;
+
+/**@brief Manufacturer specific data. */
+typedef struct
+{
+  uint16_t      company_identifier; /**< Company identifier code. */
+  uint8_array_t data;               /**< Additional manufacturer specific data. */
+} ble_advdata_manuf_data_t;
+
+/**@brief Advertising data, fields used by Ruuvi drivers. */
+typedef struct
+{
+  ble_advdata_name_type_t    name_type;             /**< Type of device name. */
+  uint8_t                    flags;                 /**< Advertising data Flags field, 0 leaves it out. */
+  ble_advdata_manuf_data_t * p_manuf_specific_data; /**< Manufacturer specific data. */
+} ble_advdata_t;
+
+#endif
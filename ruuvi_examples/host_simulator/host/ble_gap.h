@@ -0,0 +1,26 @@
+#ifndef BLE_GAP_H
+#define BLE_GAP_H
+
+/** Host stand-in for SoftDevice ble_gap.h, scanner API used by ble_relay. Scanner is in sim_relay.c **/
+
+#include <stdint.h>
+#include "nrf_error.h"
+
+#define BLE_GAP_ADV_MAX_SIZE                         31   /**< Maximum size of advertising data in octets. */
+#define BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA   0xFF /**< Manufacturer Specific Data. */
+
+/**@brief GAP scanning parameters. */
+typedef struct
+{
+  uint8_t  active         : 1; /**< If 1, perform active scanning (scan requests). */
+  uint8_t  use_whitelist  : 1; /**< If 1, filter advertisers using current active whitelist. */
+  uint8_t  adv_dir_report : 1; /**< If 1, also report directed advertisements. */
+  uint16_t interval;           /**< Scan interval between 0x0004 and 0x4000 in 0.625 ms units. */
+  uint16_t window;             /**< Scan window between 0x0004 and 0x4000 in 0.625 ms units. */
+  uint16_t timeout;            /**< Scan timeout between 0x0001 and 0xFFFF in seconds, 0x0000 disables timeout. */
+} ble_gap_scan_params_t;
+
+uint32_t sd_ble_gap_scan_start(ble_gap_scan_params_t const *p_scan_params);
+uint32_t sd_ble_gap_scan_stop(void);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef BLE_NUS_H
+#define BLE_NUS_H
+
+/**
+ *  Host stand-in for Nordic UART Service.
+ *  ble_nus_string_send is implemented by the virtual link of the simulator, see sim_link.h.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdk_common.h"
+#include "ble.h"
+
+typedef struct
+{
+  ble_gatts_char_handles_t rx_handles; /**< Handles related to the RX characteristic, notified to the central. */
+  uint16_t conn_handle;             /**< Handle of the current connection. BLE_CONN_HANDLE_INVALID if not in a connection. */
+  bool     is_notification_enabled; /**< Variable to indicate if the peer has enabled notification of the RX characteristic.*/
+} ble_nus_t;
+
+uint32_t ble_nus_string_send(ble_nus_t * p_nus, uint8_t * p_string, uint16_t length);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef BOARDS_H
+#define BOARDS_H
+
+/** Host stand-in for Nordic SDK boards.h, drivers use no board pins on host **/
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef BSP_H
+#define BSP_H
+
+/** Host stand-in for Nordic SDK bsp.h, included by bluetooth_core.h only for its types **/
+
+#include "sdk_common.h"
+#include "ble.h"
+
+#endif
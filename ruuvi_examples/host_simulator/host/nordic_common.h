@@ -0,0 +1,20 @@
+#ifndef NORDIC_COMMON_H
+#define NORDIC_COMMON_H
+
+/** Host stand-in for Nordic SDK nordic_common.h **/
+
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#define ROUNDED_DIV(A, B) (((A) + ((B) / 2)) / (B))
+#define CEIL_DIV(A, B)    (((A) + (B) - 1) / (B))
+
+#define UNUSED_PARAMETER(X) (void)(X)
+#define UNUSED_VARIABLE(X)  (void)(X)
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef NRF_H
+#define NRF_H
+
+/** Host stand-in for Nordic SDK nrf.h, drivers include it for register definitions they do not use **/
+
+#include <stdint.h>
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef NRF_DELAY_H
+#define NRF_DELAY_H
+
+/** Host stand-in for Nordic SDK nrf_delay.h, virtual sensors respond without delay **/
+
+#include <stdint.h>
+
+#define nrf_delay_ms(ms) ((void)(ms))
+#define nrf_delay_us(us) ((void)(us))
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef NRF_DRV_GPIOTE_H
+#define NRF_DRV_GPIOTE_H
+
+/** Host stand-in for Nordic SDK nrf_drv_gpiote.h, included by sensor drivers only for its types **/
+
+#include <stdint.h>
+
+typedef uint32_t nrf_drv_gpiote_pin_t;
+
+#endif
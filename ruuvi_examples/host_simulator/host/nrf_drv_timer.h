@@ -0,0 +1,8 @@
+#ifndef NRF_DRV_TIMER_H
+#define NRF_DRV_TIMER_H
+
+/** Host stand-in for Nordic SDK nrf_drv_timer.h, included by bme280.h but not used **/
+
+#include <stdint.h>
+
+#endif
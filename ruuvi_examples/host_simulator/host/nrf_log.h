@@ -0,0 +1,22 @@
+#ifndef NRF_LOG_H
+#define NRF_LOG_H
+
+/**
+ *  Host stand-in for Nordic SDK nrf_log.h.
+ *  Firmware log calls cast pointers to uint32_t, which is not safe to print
+ *  on a 64-bit host, so all logging compiles out. The simulator prints its own trace.
+ */
+
+#define NRF_LOG_ERROR(...)
+#define NRF_LOG_WARNING(...)
+#define NRF_LOG_INFO(...)
+#define NRF_LOG_DEBUG(...)
+#define NRF_LOG_HEXDUMP_ERROR(...)
+#define NRF_LOG_HEXDUMP_WARNING(...)
+#define NRF_LOG_HEXDUMP_INFO(...)
+#define NRF_LOG_HEXDUMP_DEBUG(...)
+#define NRF_LOG_FLUSH()
+#define NRF_LOG_PROCESS() false
+#define ERR_TO_STR(err_code) ""
+
+#endif
@@ -0,0 +1,66 @@
+#include "nrf_queue.h"
+#include "nrf_error.h"
+#include <string.h>
+
+static size_t next_index(nrf_queue_t const * p_queue, size_t index)
+{
+  return (index < p_queue->size) ? (index + 1) : 0;
+}
+
+size_t nrf_queue_utilization_get(nrf_queue_t const * p_queue)
+{
+  size_t front = p_queue->p_cb->front;
+  size_t back  = p_queue->p_cb->back;
+  return (back >= front) ? (back - front) : (p_queue->size + 1 - front + back);
+}
+
+bool nrf_queue_is_empty(nrf_queue_t const * p_queue)
+{
+  return p_queue->p_cb->front == p_queue->p_cb->back;
+}
+
+bool nrf_queue_is_full(nrf_queue_t const * p_queue)
+{
+  return next_index(p_queue, p_queue->p_cb->back) == p_queue->p_cb->front;
+}
+
+size_t nrf_queue_available_get(nrf_queue_t const * p_queue)
+{
+  return p_queue->size - nrf_queue_utilization_get(p_queue);
+}
+
+size_t nrf_queue_max_utilization_get(nrf_queue_t const * p_queue)
+{
+  return p_queue->p_cb->max_utilization;
+}
+
+void nrf_queue_reset(nrf_queue_t const * p_queue)
+{
+  memset(p_queue->p_cb, 0, sizeof(nrf_queue_cb_t));
+}
+
+ret_code_t nrf_queue_push(nrf_queue_t const * p_queue, void const * p_element)
+{
+  if(nrf_queue_is_full(p_queue))
+  {
+    if(NRF_QUEUE_MODE_NO_OVERFLOW == p_queue->mode) { return NRF_ERROR_NO_MEM; }
+    // Overwrite oldest element
+    p_queue->p_cb->front = next_index(p_queue, p_queue->p_cb->front);
+  }
+  size_t back = p_queue->p_cb->back;
+  memcpy((uint8_t*)p_queue->p_buffer + back * p_queue->element_size, p_element, p_queue->element_size);
+  p_queue->p_cb->back = next_index(p_queue, back);
+
+  size_t utilization = nrf_queue_utilization_get(p_queue);
+  if(utilization > p_queue->p_cb->max_utilization) { p_queue->p_cb->max_utilization = utilization; }
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_queue_generic_pop(nrf_queue_t const * p_queue, void * p_element, bool just_peek)
+{
+  if(nrf_queue_is_empty(p_queue)) { return NRF_ERROR_NOT_FOUND; }
+  size_t front = p_queue->p_cb->front;
+  memcpy(p_element, (uint8_t*)p_queue->p_buffer + front * p_queue->element_size, p_queue->element_size);
+  if(!just_peek) { p_queue->p_cb->front = next_index(p_queue, front); }
+  return NRF_SUCCESS;
+}
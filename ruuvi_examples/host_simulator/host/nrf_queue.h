@@ -0,0 +1,62 @@
+#ifndef NRF_QUEUE_H
+#define NRF_QUEUE_H
+
+/**
+ *  Host stand-in for Nordic SDK nrf_queue.h.
+ *  Same API and overflow semantics, without critical sections.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdk_errors.h"
+
+typedef enum
+{
+  NRF_QUEUE_MODE_OVERFLOW,    /**< If the queue is full, new element will overwrite the oldest. */
+  NRF_QUEUE_MODE_NO_OVERFLOW, /**< If the queue is full, new element will not be accepted. */
+} nrf_queue_mode_t;
+
+typedef struct
+{
+  volatile size_t front;      /**< Queue front index. */
+  volatile size_t back;       /**< Queue back index. */
+  size_t max_utilization;     /**< Maximum utilization of the queue. */
+} nrf_queue_cb_t;
+
+typedef struct
+{
+  nrf_queue_cb_t * p_cb;      /**< Pointer to the instance control block. */
+  void           * p_buffer;  /**< Pointer to the memory that is used as storage. */
+  size_t           size;      /**< Size of a queue. */
+  size_t           element_size; /**< Size of one element. */
+  nrf_queue_mode_t mode;      /**< Mode of the queue. */
+} nrf_queue_t;
+
+/** One element is left unused to tell full queue from empty, like the SDK **/
+#define NRF_QUEUE_DEF(_type, _name, _size, _mode)                             \
+    static _type             _name##_nrf_queue_buffer[(_size) + 1];           \
+    static nrf_queue_cb_t    _name##_nrf_queue_cb;                            \
+    static const nrf_queue_t _name =                                          \
+        {                                                                     \
+            .p_cb           = &_name##_nrf_queue_cb,                          \
+            .p_buffer       = _name##_nrf_queue_buffer,                       \
+            .size           = (_size),                                        \
+            .element_size   = sizeof(_type),                                  \
+            .mode           = _mode,                                          \
+        }
+
+ret_code_t nrf_queue_push(nrf_queue_t const * p_queue, void const * p_element);
+ret_code_t nrf_queue_generic_pop(nrf_queue_t const * p_queue, void * p_element, bool just_peek);
+
+#define nrf_queue_pop(_p_queue, _p_element)  nrf_queue_generic_pop((_p_queue), (_p_element), false)
+#define nrf_queue_peek(_p_queue, _p_element) nrf_queue_generic_pop((_p_queue), (_p_element), true)
+
+void   nrf_queue_reset(nrf_queue_t const * p_queue);
+bool   nrf_queue_is_empty(nrf_queue_t const * p_queue);
+bool   nrf_queue_is_full(nrf_queue_t const * p_queue);
+size_t nrf_queue_utilization_get(nrf_queue_t const * p_queue);
+size_t nrf_queue_available_get(nrf_queue_t const * p_queue);
+size_t nrf_queue_max_utilization_get(nrf_queue_t const * p_queue);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SDK_COMMON_H
+#define SDK_COMMON_H
+
+/**
+ *  Host stand-in for Nordic SDK sdk_common.h.
+ *  Provides only the types and helpers used by Ruuvi libraries.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nordic_common.h"
+#include "sdk_errors.h"
+#include "nrf_error.h"
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef SDK_ERRORS_H
+#define SDK_ERRORS_H
+
+/** Host stand-in for Nordic SDK sdk_errors.h **/
+
+#include <stdint.h>
+#include "nrf_error.h"
+
+typedef uint32_t ret_code_t;
+
+#endif
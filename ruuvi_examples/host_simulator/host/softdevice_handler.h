@@ -0,0 +1,9 @@
+#ifndef SOFTDEVICE_HANDLER_H
+#define SOFTDEVICE_HANDLER_H
+
+/** Host stand-in for Nordic SDK softdevice_handler.h, included by bluetooth_core.h only for its types **/
+
+#include "sdk_common.h"
+#include "ble.h"
+
+#endif
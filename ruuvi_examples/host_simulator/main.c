@@ -0,0 +1,197 @@
+/**
+ *  Host simulator for Ruuvi endpoint and chain channel message system.
+ *
+ *  Runs ruuvi_endpoints, chain_channels, dsp, lis2dh12 acceleration and event handlers, BME280 endpoints and
+ *  ble_bulk_transfer from the firmware tree on Linux. BME280 driver runs on the virtual SPI bus of
+ *  driver_test, see sim_spi.h. Nordic SDK timer, scheduler, queue and
+ *  log are replaced by stand-ins under host/, accelerometer is replaced by a virtual sensor
+ *  with synthetic waveform and SoftDevice by a virtual link to a central, see sim_link.h.
+ *  ble_relay scans virtual neighbour tags and advertises to a virtual gateway, see sim_relay.h.
+ *  Scenario is read from a script, see sim_script.h and scripts/.
+ *
+ *  Usage: host_simulator [-v] <script>
+ *    -v  print every message received by the central
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "init.h"
+#include "ruuvi_endpoints.h"
+#include "ruuvi_message_frame.h"
+#include "chain_channels.h"
+#include "lis2dh12_acceleration_handler.h"
+#include "lis2dh12_event_handler.h"
+#include "bme280_environmental_handler.h"
+#include "bme280_scheduler.h"
+#include "ble_bulk_transfer.h"
+#include "ble_diagnostics.h"
+#include "sim_link.h"
+#include "sim_bulk.h"
+#include "sim_relay.h"
+#include "ble_relay.h"
+#include "sim_lis2dh12.h"
+#include "sim_script.h"
+#include "sim_stats.h"
+#include "sim_spi.h"
+
+static bool        m_verbose         = false;
+static sim_stat_t* p_acceleration_stat = NULL;
+static sim_stat_t* p_chain_stat        = NULL;
+static sim_stat_t* p_gatt_stat         = NULL;
+static sim_stat_t* p_reply_stat        = NULL;
+
+static void print_message(const char* sink, const ruuvi_standard_message_t message)
+{
+  uint64_t ms = app_timer_sim_now() * 1000 / app_timer_sim_tick_rate();
+  printf("%10llu ms %-6s", (unsigned long long)ms, sink);
+  const uint8_t* p_raw = (const uint8_t*)&message;
+  for(size_t ii = 0; ii < sizeof(message); ii++) { printf(" %02X", p_raw[ii]); }
+  printf("\n");
+}
+
+/** Endpoint wrappers measure inclusive latency of firmware handlers **/
+static ret_code_t measured_acceleration_handler(const ruuvi_standard_message_t message)
+{
+  uint64_t start = sim_stats_now_ns();
+  ret_code_t err_code = lis2dh12_acceleration_handler(message);
+  sim_stats_record(p_acceleration_stat, sim_stats_now_ns() - start);
+  return err_code;
+}
+
+static ret_code_t measured_chain_handler(const ruuvi_standard_message_t message)
+{
+  uint64_t start = sim_stats_now_ns();
+  ret_code_t err_code = chain_handler(message);
+  sim_stats_record(p_chain_stat, sim_stats_now_ns() - start);
+  return err_code;
+}
+
+/** GATT and reply handlers queue messages to BLE like init_ble() does **/
+static ret_code_t gatt_sink(const ruuvi_standard_message_t message)
+{
+  sim_stats_record(p_gatt_stat, 0);
+  return ble_std_transfer_asynchronous(message);
+}
+
+static ret_code_t reply_sink(const ruuvi_standard_message_t message)
+{
+  sim_stats_record(p_reply_stat, 0);
+  print_message("REPLY", message);
+  return ble_std_reply_asynchronous(message);
+}
+
+static ret_code_t central_sink(const ruuvi_standard_message_t message)
+{
+  if(m_verbose) { print_message("RX", message); }
+  return ENDPOINT_SUCCESS;
+}
+
+/** Rest of the main loop of test_drivers after app_sched_execute **/
+static void main_loop_idle(void)
+{
+  ble_message_queue_process();
+}
+
+int main(int argc, char** argv)
+{
+  const char* path = NULL;
+  for(int ii = 1; ii < argc; ii++)
+  {
+    if(0 == strcmp(argv[ii], "-v")) { m_verbose = true; }
+    else { path = argv[ii]; }
+  }
+  if(NULL == path)
+  {
+    fprintf(stderr, "Usage: %s [-v] <script>\n", argv[0]);
+    return 2;
+  }
+  FILE* script = fopen(path, "r");
+  if(NULL == script)
+  {
+    perror(path);
+    return 2;
+  }
+
+  // Same scheduler and timer configuration as init_ble()
+  APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
+  APP_TIMER_APPSH_INIT(RUUVITAG_APP_TIMER_PRESCALER, SCHED_QUEUE_SIZE, true);
+
+  p_acceleration_stat = sim_stats_register("endpoint: ACCELERATION");
+  p_chain_stat        = sim_stats_register("endpoint: chain");
+  p_gatt_stat         = sim_stats_register("sink: GATT");
+  p_reply_stat        = sim_stats_register("sink: reply");
+  sim_stats_register_scheduler_handler(ble_link_scheduler_event_handler, "sched: incoming message");
+  sim_stats_register_scheduler_handler(lis2dh12_scheduler_event_handler, "sched: accelerometer FIFO");
+
+  sim_link_init(central_sink);
+  app_sched_sim_idle_set(main_loop_idle);
+  set_ble_gatt_handler(gatt_sink);
+  set_reply_handler(reply_sink);
+  set_acceleration_handler(measured_acceleration_handler);
+  set_acceleration_event_handler(lis2dh12_event_handler);
+  set_chain_handler(measured_chain_handler);
+  set_bulk_transfer_handler(ble_bulk_ack_handler);
+  set_bulk_message_handler(STD_MESSAGE_FRAME, message_frame_bulk_handler);
+  set_diagnostics_handler(ble_diagnostics_handler);
+  set_relay_handler(ble_relay_handler);
+  set_ble_stream_handler(ble_stream_transfer);
+  ble_stream_set_ready_handler(lis2dh12_stream_process);
+  chain_handler_init();
+  sim_lis2dh12_init();
+  // Same as ruuvi_firmware main.c, LIS2DH12_ACTIVITY_THRESHOLD mg
+  lis2dh12_set_activity_interrupt_pin_2(64);
+  sim_relay_init();
+  // Same as init_bme280()
+  sim_spi_init();
+  bme280_init();
+  bme280_set_mode(BME280_MODE_SLEEP);
+  bme280_environmental_handler_init();
+  set_temperature_handler(bme280_temperature_handler);
+  set_humidity_handler(bme280_humidity_handler);
+  set_pressure_handler(bme280_pressure_handler);
+  set_environmental_handler(bme280_environmental_handler);
+  set_environmental_derived_handler(bme280_environmental_derived_handler);
+
+  uint64_t start = sim_stats_now_ns();
+  int status = sim_script_run(script);
+  uint64_t elapsed = sim_stats_now_ns() - start;
+  fclose(script);
+  if(status)
+  {
+    fprintf(stderr, "%s:%d: invalid command\n", path, status);
+    return 1;
+  }
+
+  double virtual_seconds = (double)app_timer_sim_now() / app_timer_sim_tick_rate();
+  printf("\nSimulated %.3f s in %.3f s host time, %llu timer expiries\n", virtual_seconds,
+         elapsed / 1e9, (unsigned long long)app_timer_sim_expiries());
+  printf("Accelerometer: %llu samples, %llu FIFO interrupts, %llu overrun\n",
+         (unsigned long long)sim_lis2dh12_samples(),
+         (unsigned long long)sim_lis2dh12_interrupts(),
+         (unsigned long long)sim_lis2dh12_overruns());
+  if(sim_lis2dh12_taps() || sim_lis2dh12_activity_events())
+  {
+    printf("Accelerometer events: %llu taps, %llu activity\n", (unsigned long long)sim_lis2dh12_taps(),
+           (unsigned long long)sim_lis2dh12_activity_events());
+  }
+  bme280_scheduler_statistics_t environmental;
+  bme280_scheduler_statistics_get(&environmental);
+  if(environmental.conversions)
+  {
+    printf("BME280: %u forced conversions, %u channel samples, %u errors\n", (unsigned)environmental.conversions,
+           (unsigned)environmental.samples, (unsigned)environmental.errors);
+  }
+  lis2dh12_stream_statistics_t stream;
+  lis2dh12_stream_statistics_get(&stream);
+  if(stream.samples)
+  {
+    printf("Stream: %u samples read, %u sent, %u dropped from stream buffer, %u FIFO overruns\n",
+           (unsigned)stream.samples, (unsigned)stream.sent, (unsigned)stream.dropped, (unsigned)stream.overruns);
+  }
+  sim_stats_report(stdout, virtual_seconds);
+  sim_link_report(stdout);
+  sim_bulk_report(stdout);
+  sim_relay_report(stdout);
+  return 0;
+}
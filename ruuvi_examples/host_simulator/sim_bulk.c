@@ -0,0 +1,397 @@
+#include "sim_bulk.h"
+#include "sim_link.h"
+#include "ruuvi_message_frame.h"
+#include "ble_bulk_receive.h"
+#include "ble_bulk_transfer.h"
+#include "ruuvi_endpoints.h"
+#include "crc8.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Source endpoint of acknowledgements, any endpoint of the central **/
+#define CENTRAL_ENDPOINT 0x60
+/** Central which receives bulk transfers and writes uploads, its connection handle **/
+#define SIM_BULK_CENTRAL 0
+
+typedef struct {
+  bool     active;
+  uint8_t  endpoint;
+  uint8_t  chunks;
+  uint8_t  crc;
+  uint8_t  flags;
+  uint8_t  window;
+  uint16_t length;
+  uint8_t  received[256 / 8];
+  uint8_t  lengths[BLE_BULK_MAX_CHUNKS];
+  uint8_t  data[BLE_BULK_MAX_CHUNKS][BLE_CHUNK_MAX_SIZE];
+  uint64_t start_ticks;
+}receiver_t;
+
+/** Central writing to the tag, ble_bulk_receive on the other end **/
+typedef struct {
+  bool     active;
+  uint8_t  endpoint;
+  uint8_t  chunks;
+  uint8_t  chunk_size;
+  uint16_t length;
+  uint8_t  acked[256 / 8];
+  uint8_t  base;            /**< First chunk not acknowledged */
+  uint8_t  next;            /**< Next chunk to write in current window */
+  bool     frame;           /**< Payload is m_frame instead of pattern */
+  bool     header_sent;
+  bool     polled;
+  uint64_t poll_ticks;
+  uint64_t start_ticks;
+}sender_t;
+
+static receiver_t m_rx;
+static sender_t   m_tx;
+static uint8_t    m_loss      = 0;
+static uint32_t   m_seed      = 1;
+static uint64_t   m_completed = 0;
+static uint64_t   m_corrupted = 0;
+static uint64_t   m_dropped   = 0;
+static uint64_t   m_crc_errors = 0;
+static uint64_t   m_acks      = 0;
+static uint64_t   m_uploaded  = 0;
+static uint64_t   m_upload_writes = 0;
+static uint64_t   m_upload_retransmissions = 0;
+static uint64_t   m_upload_errors = 0;
+static uint8_t    m_frame[BLE_BULK_RX_BUFFER_SIZE]; // Frame of standard messages to upload
+static size_t     m_frame_length = 0;
+
+static uint8_t pattern(size_t index)
+{
+  return 'A' + (index * 7) % 26;
+}
+
+/** Byte of payload being uploaded **/
+static uint8_t upload_byte(size_t index)
+{
+  return m_tx.frame ? m_frame[index] : pattern(index);
+}
+
+static bool lost(void)
+{
+  if(!m_loss) { return false; }
+  m_seed = m_seed * 1103515245 + 12345;
+  return ((m_seed >> 16) % 100) < m_loss;
+}
+
+static bool is_received(uint8_t index)
+{
+  return m_rx.received[index / 8] & (1 << (index % 8));
+}
+
+static uint8_t first_missing(void)
+{
+  uint8_t index = 0;
+  while(index < m_rx.chunks && is_received(index)) { index++; }
+  return index;
+}
+
+/** Write message to NUS RX of the tag **/
+static void write_to_tag(ruuvi_standard_message_t* message)
+{
+  sim_link_write(SIM_BULK_CENTRAL, (const uint8_t*)message, sizeof(*message));
+}
+
+/** Assemble and verify payload once every chunk is received **/
+static bool complete(void)
+{
+  size_t length = 0;
+  uint8_t crc = CRC8_INITIAL_VALUE;
+  bool pattern_ok = true;
+  for(uint8_t ii = 0; ii < m_rx.chunks; ii++)
+  {
+    crc = crc8_compute(m_rx.data[ii], m_rx.lengths[ii], crc);
+    for(size_t jj = 0; jj < m_rx.lengths[ii]; jj++)
+    {
+      if(m_rx.data[ii][jj] != pattern(length + jj)) { pattern_ok = false; }
+    }
+    length += m_rx.lengths[ii];
+  }
+  if(crc != m_rx.crc || length != m_rx.length) { return false; }
+
+  uint64_t ms = (app_timer_sim_now() - m_rx.start_ticks) * 1000 / app_timer_sim_tick_rate();
+  printf("%10llu ms BULK   %02X: %zu bytes in %d chunks, %llu ms, %llu B/s, payload %s\n",
+         (unsigned long long)(app_timer_sim_now() * 1000 / app_timer_sim_tick_rate()),
+         m_rx.endpoint, length, m_rx.chunks, (unsigned long long)ms,
+         ms ? (unsigned long long)(length * 1000 / ms) : 0ULL, pattern_ok ? "OK" : "CORRUPTED");
+  if(pattern_ok) { m_completed++; }
+  else { m_corrupted++; }
+  m_rx.active = false;
+  return true;
+}
+
+static void answer_poll(void)
+{
+  uint8_t base = first_missing();
+  ruuvi_standard_message_t ack = { .destination_endpoint = BULK_TRANSFER,
+                                   .source_endpoint      = CENTRAL_ENDPOINT,
+                                   .type                 = ACKNOWLEDGEMENT,
+                                   .payload              = {0} };
+  ack.payload[0] = m_rx.endpoint;
+  ack.payload[1] = base;
+  for(uint8_t ii = 0; ii < BLE_BULK_MAX_WINDOW && base + ii < m_rx.chunks; ii++)
+  {
+    if(is_received(base + ii)) { ack.payload[2 + ii / 8] |= 1 << (ii % 8); }
+  }
+  bool done = (base == m_rx.chunks);
+  if(done && !complete())
+  {
+    // Transfer CRC does not match, ask for the whole transfer again
+    ack.type = ERROR;
+    memset(m_rx.received, 0, sizeof(m_rx.received));
+    m_crc_errors++;
+  }
+  m_acks++;
+  write_to_tag(&ack);
+}
+
+static void receive_header(const uint8_t* data)
+{
+  memset(&m_rx, 0, sizeof(m_rx));
+  m_rx.active      = true;
+  m_rx.endpoint    = data[0];
+  m_rx.chunks      = data[2];
+  m_rx.crc         = data[3];
+  m_rx.flags       = data[4];
+  m_rx.window      = data[5];
+  m_rx.length      = data[7] | (data[8] << 8);
+  m_rx.start_ticks = app_timer_sim_now();
+}
+
+static void receive_chunk(const uint8_t* data, size_t length)
+{
+  uint8_t index = data[1];
+  if(index >= m_rx.chunks || length < BLE_CHUNK_HEADER_SIZE) { return; }
+  uint8_t crc = crc8_compute(data, 2, CRC8_INITIAL_VALUE);
+  crc = crc8_compute(&data[BLE_CHUNK_HEADER_SIZE], length - BLE_CHUNK_HEADER_SIZE, crc);
+  if(crc != data[2]) { m_crc_errors++; return; }
+  m_rx.lengths[index] = length - BLE_CHUNK_HEADER_SIZE;
+  memcpy(m_rx.data[index], &data[BLE_CHUNK_HEADER_SIZE], m_rx.lengths[index]);
+  m_rx.received[index / 8] |= 1 << (index % 8);
+  // Unacknowledged transfer ends when last chunk arrives
+  if(!(m_rx.flags & BLE_BULK_FLAG_ACK) && first_missing() == m_rx.chunks) { complete(); }
+}
+
+bool sim_bulk_receive(const uint8_t* data, size_t length)
+{
+  if(length < BLE_BULK_POLL_SIZE) { return false; }
+  if(BLE_BULK_HEADER_SIZE == length && BLE_BULK_INDEX_HEADER == data[1] && STD_MESSAGE_FRAME != data[0])
+  {
+    receive_header(data);
+    return true;
+  }
+  if(!m_rx.active || data[0] != m_rx.endpoint) { return false; }
+  if(lost())
+  {
+    m_dropped++;
+    return true;
+  }
+  if(BLE_BULK_INDEX_POLL == data[1] && BLE_BULK_POLL_SIZE == length) { answer_poll(); }
+  else { receive_chunk(data, length); }
+  return true;
+}
+
+/** Tag application stand-in, checks the reassembled payload **/
+static ret_code_t tag_bulk_handler(const uint8_t endpoint, const uint8_t* data, const size_t length)
+{
+  bool pattern_ok = true;
+  for(size_t ii = 0; ii < length; ii++)
+  {
+    if(data[ii] != pattern(ii)) { pattern_ok = false; }
+  }
+  printf("%10llu ms ROUTED %02X: %zu bytes, payload %s\n",
+         (unsigned long long)(app_timer_sim_now() * 1000 / app_timer_sim_tick_rate()),
+         endpoint, length, pattern_ok ? "OK" : "CORRUPTED");
+  return ENDPOINT_SUCCESS;
+}
+
+static bool is_acked(uint8_t index)
+{
+  return m_tx.acked[index / 8] & (1 << (index % 8));
+}
+
+/** Write to NUS RX of the tag, tag handles writes in BLE event context **/
+static void write_to_nus(const uint8_t* data, size_t length)
+{
+  m_upload_writes++;
+  sim_link_write(SIM_BULK_CENTRAL, data, length);
+}
+
+static void upload_write_header(void)
+{
+  uint8_t header[BLE_BULK_HEADER_SIZE];
+  uint8_t crc = CRC8_INITIAL_VALUE;
+  for(size_t ii = 0; ii < m_tx.length; ii++)
+  {
+    uint8_t byte = upload_byte(ii);
+    crc = crc8_compute(&byte, 1, crc);
+  }
+  header[0] = m_tx.endpoint;
+  header[1] = BLE_BULK_INDEX_HEADER;
+  header[2] = m_tx.chunks;
+  header[3] = crc;
+  header[4] = BLE_BULK_FLAG_ACK;
+  header[5] = BLE_BULK_MAX_WINDOW;
+  header[6] = m_tx.chunk_size;
+  header[7] = m_tx.length & 0xFF;
+  header[8] = m_tx.length >> 8;
+  write_to_nus(header, sizeof(header));
+  m_tx.header_sent = true;
+}
+
+static void upload_write_chunk(uint8_t index)
+{
+  uint8_t chunk[BLE_CHUNK_HEADER_SIZE + UINT8_MAX];
+  size_t offset = (size_t)index * m_tx.chunk_size;
+  size_t size = MIN(m_tx.chunk_size, m_tx.length - offset);
+  chunk[0] = m_tx.endpoint;
+  chunk[1] = index;
+  for(size_t ii = 0; ii < size; ii++) { chunk[BLE_CHUNK_HEADER_SIZE + ii] = upload_byte(offset + ii); }
+  chunk[2] = crc8_compute(&chunk[BLE_CHUNK_HEADER_SIZE], size, crc8_compute(chunk, 2, CRC8_INITIAL_VALUE));
+  // Chunks are write commands without response and may be lost, header and polls are write requests
+  if(lost()) { m_dropped++; return; }
+  write_to_nus(chunk, BLE_CHUNK_HEADER_SIZE + size);
+}
+
+static void upload_write_poll(void)
+{
+  uint8_t poll[BLE_BULK_POLL_SIZE] = { m_tx.endpoint, BLE_BULK_INDEX_POLL };
+  write_to_nus(poll, sizeof(poll));
+  m_tx.polled     = true;
+  m_tx.poll_ticks = app_timer_sim_now();
+}
+
+void sim_bulk_connection_event(uint8_t packets)
+{
+  if(!m_tx.active) { return; }
+  if(!m_tx.header_sent)
+  {
+    upload_write_header();
+    packets--;
+  }
+  uint16_t window_end = MIN(m_tx.chunks, m_tx.base + BLE_BULK_MAX_WINDOW);
+  while(packets && m_tx.next < window_end)
+  {
+    if(!is_acked(m_tx.next))
+    {
+      upload_write_chunk(m_tx.next);
+      packets--;
+    }
+    m_tx.next++;
+  }
+  if(!packets || m_tx.next < window_end) { return; }
+  // Poll again if acknowledgement does not arrive, i.e. while payload is being routed
+  if(!m_tx.polled || app_timer_sim_now() - m_tx.poll_ticks > app_timer_sim_tick_rate())
+  {
+    upload_write_poll();
+  }
+}
+
+bool sim_bulk_upload_ack(const ruuvi_standard_message_t message)
+{
+  if(!m_tx.active || message.payload[0] != m_tx.endpoint) { return false; }
+  m_tx.polled = false;
+  if(ERROR == message.type)
+  {
+    m_upload_errors++;
+    memset(m_tx.acked, 0, sizeof(m_tx.acked));
+    m_tx.base = m_tx.next = 0;
+    m_tx.header_sent = false;
+    return true;
+  }
+  uint8_t base = message.payload[1];
+  if(base >= m_tx.chunks)
+  {
+    uint64_t ms = (app_timer_sim_now() - m_tx.start_ticks) * 1000 / app_timer_sim_tick_rate();
+    printf("%10llu ms UPLOAD %02X: %u bytes in %d chunks, %llu ms, %llu B/s\n",
+           (unsigned long long)(app_timer_sim_now() * 1000 / app_timer_sim_tick_rate()),
+           m_tx.endpoint, m_tx.length, m_tx.chunks, (unsigned long long)ms,
+           ms ? (unsigned long long)(m_tx.length * 1000ULL / ms) : 0ULL);
+    m_uploaded++;
+    m_tx.active = false;
+    if(m_tx.frame) { m_frame_length = 0; }
+    return true;
+  }
+  for(uint8_t ii = 0; ii < base; ii++) { m_tx.acked[ii / 8] |= 1 << (ii % 8); }
+  for(uint8_t ii = 0; ii < BLE_BULK_MAX_WINDOW && base + ii < m_tx.chunks; ii++)
+  {
+    if(message.payload[2 + ii / 8] & (1 << (ii % 8))) { m_tx.acked[(base + ii) / 8] |= 1 << ((base + ii) % 8); }
+  }
+  // Chunks of previous window which were not acknowledged are written again
+  for(uint8_t ii = base; ii < m_tx.next; ii++) { if(!is_acked(ii)) { m_upload_retransmissions++; } }
+  m_tx.base = base;
+  m_tx.next = base;
+  return true;
+}
+
+static int upload_start(uint8_t endpoint, size_t length, bool frame)
+{
+  size_t chunk_size = MIN(UINT8_MAX, ble_bulk_get_att_mtu(SIM_BULK_CENTRAL) - BLE_ATT_HEADER_SIZE - BLE_CHUNK_HEADER_SIZE);
+  size_t chunks = (length + chunk_size - 1) / chunk_size;
+  if(m_tx.active || length > BLE_BULK_RX_BUFFER_SIZE || chunks > BLE_BULK_MAX_CHUNKS) { return -1; }
+  memset(&m_tx, 0, sizeof(m_tx));
+  m_tx.active      = true;
+  m_tx.endpoint    = endpoint;
+  m_tx.chunks      = chunks;
+  m_tx.chunk_size  = chunk_size;
+  m_tx.length      = length;
+  m_tx.frame       = frame;
+  m_tx.start_ticks = app_timer_sim_now();
+  return 0;
+}
+
+int sim_bulk_upload(uint8_t endpoint, size_t length)
+{
+  if(upload_start(endpoint, length, false)) { return -1; }
+  return set_bulk_message_handler(endpoint, tag_bulk_handler);
+}
+
+int sim_bulk_frame_append(const ruuvi_standard_message_t* message)
+{
+  // Frame being uploaded is kept until the upload completes
+  if(m_tx.active && m_tx.frame) { return -1; }
+  if(!m_frame_length) { m_frame_length = message_frame_begin(m_frame); }
+  if(message_frame_count(m_frame) >= message_frame_capacity(sizeof(m_frame))) { return -1; }
+  m_frame_length = message_frame_append(m_frame, m_frame_length, message);
+  return 0;
+}
+
+int sim_bulk_upload_frame(void)
+{
+  // Tag routes the frame with message_frame_bulk_handler registered at init
+  if(!m_frame_length) { return -1; }
+  return upload_start(STD_MESSAGE_FRAME, m_frame_length, true);
+}
+
+void sim_bulk_set_loss(uint8_t percent)
+{
+  m_loss = percent;
+}
+
+int sim_bulk_send(uint8_t endpoint, size_t length)
+{
+  // NUL terminated, MAM cleanup tokenizes the payload as a string
+  uint8_t* data = malloc(length + 1);
+  if(NULL == data) { return NRF_ERROR_NO_MEM; }
+  for(size_t ii = 0; ii < length; ii++) { data[ii] = pattern(ii); }
+  data[length] = 0;
+  int status = ble_bulk_transfer_asynchronous(endpoint, data, length);
+  if(status) { free(data); }
+  return status;
+}
+
+void sim_bulk_report(FILE* out)
+{
+  fprintf(out, "Bulk: %llu received OK, %llu corrupted, %llu notifications dropped, %llu CRC errors, %llu acknowledgements\n",
+          (unsigned long long)m_completed, (unsigned long long)m_corrupted, (unsigned long long)m_dropped,
+          (unsigned long long)m_crc_errors, (unsigned long long)m_acks);
+  fprintf(out, "Upload: %llu completed, %llu writes, %llu retransmissions, %llu restarts\n",
+          (unsigned long long)m_uploaded, (unsigned long long)m_upload_writes,
+          (unsigned long long)m_upload_retransmissions, (unsigned long long)m_upload_errors);
+}
@@ -0,0 +1,61 @@
+#ifndef SIM_BULK_H
+#define SIM_BULK_H
+
+/**
+ *  Central side of bulk transfer for host simulator.
+ *
+ *  Receives header, chunks and polls from the virtual link, checks chunk and transfer CRCs
+ *  and answers polls with a bitmap acknowledgement written back to the tag, as described in
+ *  ble_bulk_transfer.h. Chunks can be dropped at random to exercise retransmission.
+ *  Transfers are started on the tag with a known pattern, so the central verifies the payload.
+ *
+ *  Uploads go the other way: central writes header, chunks and polls to ble_bulk_receive on
+ *  the tag during connection events and handles acknowledgements the tag notifies back.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ruuvi_endpoints.h"
+
+/** Returns true if notification belongs to bulk transfer and was consumed **/
+bool sim_bulk_receive(const uint8_t* data, size_t length);
+
+/** Drop given percentage of chunks and polls at the central, deterministic pseudo-random **/
+void sim_bulk_set_loss(uint8_t percent);
+
+/**
+ *  Queue a bulk transfer of length bytes of pattern to endpoint on the tag.
+ *  Returns status of ble_bulk_transfer_asynchronous.
+ */
+int sim_bulk_send(uint8_t endpoint, size_t length);
+
+/**
+ *  Start writing length bytes of pattern from central to endpoint on the tag.
+ *  Registers a bulk handler for endpoint on the tag which verifies the routed payload.
+ *  Returns 0 on success.
+ */
+int sim_bulk_upload(uint8_t endpoint, size_t length);
+
+/** Append standard message to the frame written by sim_bulk_upload_frame. Returns 0 on success **/
+int sim_bulk_frame_append(const ruuvi_standard_message_t* message);
+
+/**
+ *  Start writing appended messages as a frame to STD_MESSAGE_FRAME on the tag, i.e. configuration
+ *  upload routed by message_frame_bulk_handler. Messages are appended to a new frame after the upload completes.
+ *  Returns 0 on success.
+ */
+int sim_bulk_upload_frame(void);
+
+/** Write pending upload data to the tag, up to packets writes in this connection event **/
+void sim_bulk_connection_event(uint8_t packets);
+
+/** Returns true if message was an acknowledgement to the ongoing upload **/
+bool sim_bulk_upload_ack(const ruuvi_standard_message_t message);
+
+/** Print summary of received transfers **/
+void sim_bulk_report(FILE* out);
+
+#endif
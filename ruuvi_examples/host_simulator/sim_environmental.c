@@ -0,0 +1,116 @@
+#include "sim_environmental.h"
+#include "bme280.h"
+#include "bme280_scheduler.h"
+#include "app_timer.h"
+#include "init.h"
+#include <string.h>
+
+static bme280_request_t          m_request = { .interval_ms        = BME280_SCHEDULER_SINGLE,
+                                               .oversampling_temp  = BME280_OVERSAMPLING_1,
+                                               .oversampling_hum   = BME280_OVERSAMPLING_1,
+                                               .oversampling_press = BME280_OVERSAMPLING_1 };
+static bme280_data_t             m_data;
+static bool                      m_valid         = false;
+static bool                      m_forced        = true;
+static bool                      m_timer_created = false;
+static sim_environmental_stats_t m_stats;
+
+APP_TIMER_DEF(m_sample_timer);
+
+/** environmental_scheduled() of ruuvi_firmware **/
+static bool scheduled(void)
+{
+  return m_forced || !bme280_scheduler_is_idle();
+}
+
+/** environmental_configure() of ruuvi_firmware, IIR is left off **/
+static void configure(void)
+{
+  if(m_forced || !bme280_scheduler_is_idle()) { return; }
+  bme280_set_mode(BME280_MODE_SLEEP);
+  bme280_set_oversampling_hum  (m_request.oversampling_hum);
+  bme280_set_oversampling_temp (m_request.oversampling_temp);
+  bme280_set_oversampling_press(m_request.oversampling_press);
+  bme280_set_interval(BME280_STANDBY_1000_MS);
+  bme280_set_mode(BME280_MODE_NORMAL);
+  bme280_scheduler_invalidate();
+}
+
+/** environmental_read() of ruuvi_firmware **/
+static void read_latest(void)
+{
+  if(BME280_RET_OK != bme280_read_measurements()) { return; }
+  m_data.temperature = bme280_get_temperature();
+  m_data.pressure    = bme280_get_pressure();
+  m_data.humidity    = bme280_get_humidity();
+  m_valid = true;
+}
+
+/** BME280 part of main_sensor_task() of ruuvi_firmware, and the advertised values **/
+static void sample(void)
+{
+  if(!scheduled())
+  {
+    if(BME280_MODE_NORMAL != bme280_get_mode()) { configure(); }
+    else { read_latest(); }
+  }
+  uint32_t pressure = m_valid ? m_data.pressure / 256  : 0;
+  uint32_t humidity = m_valid ? m_data.humidity / 1024 : 0;
+  if(!m_stats.samples || pressure < m_stats.pressure_min) { m_stats.pressure_min = pressure; }
+  if(!m_stats.samples || pressure > m_stats.pressure_max) { m_stats.pressure_max = pressure; }
+  if(!m_stats.samples || humidity < m_stats.humidity_min) { m_stats.humidity_min = humidity; }
+  if(!m_stats.samples || humidity > m_stats.humidity_max) { m_stats.humidity_max = humidity; }
+  m_stats.samples++;
+}
+
+/** environmental_handler() of ruuvi_firmware **/
+static void sample_handler(const bme280_channel_t channel, const bme280_data_t* const data)
+{
+  if(NULL != data)
+  {
+    m_data  = *data;
+    m_valid = true;
+  }
+  sample();
+}
+
+/** sample_start() of ruuvi_firmware, timeout runs in scheduler context **/
+static void sample_start(void* p_context)
+{
+  if(scheduled() && BME280_RET_OK == bme280_scheduler_request(BME280_CHANNEL_APPLICATION, &m_request)) { return; }
+  sample();
+}
+
+void sim_environmental_start(uint32_t interval_ms, bool forced)
+{
+  if(!m_timer_created)
+  {
+    app_timer_create(&m_sample_timer, APP_TIMER_MODE_REPEATED, sample_start);
+    m_timer_created = true;
+  }
+  app_timer_stop(m_sample_timer);
+  memset(&m_stats, 0, sizeof(m_stats));
+  m_valid = false;
+  if(!interval_ms) { return; }
+
+  m_forced = forced;
+  bme280_scheduler_set_application_handler(sample_handler);
+  configure();
+  // Conversion of boot, sensor converts at once
+  if(m_forced)
+  {
+    bme280_set_oversampling_hum  (m_request.oversampling_hum);
+    bme280_set_oversampling_temp (m_request.oversampling_temp);
+    bme280_set_oversampling_press(m_request.oversampling_press);
+    bme280_scheduler_invalidate();
+    bme280_set_mode(BME280_MODE_FORCED);
+  }
+  read_latest();
+  app_timer_start(m_sample_timer, APP_TIMER_TICKS(interval_ms, RUUVITAG_APP_TIMER_PRESCALER), NULL);
+}
+
+void sim_environmental_stats_get(sim_environmental_stats_t* const stats)
+{
+  *stats = m_stats;
+  memset(&m_stats, 0, sizeof(m_stats));
+}
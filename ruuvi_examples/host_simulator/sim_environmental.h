@@ -0,0 +1,38 @@
+#ifndef SIM_ENVIRONMENTAL_H
+#define SIM_ENVIRONMENTAL_H
+
+/**
+ *  BME280 samples of ruuvi_firmware advertisements for host simulator.
+ *
+ *  Same as environmental_configure, sample_start, environmental_handler and the BME280 part of
+ *  main_sensor_task in ruuvi_firmware main.c, with main loop timer and without radio synchronised sampling.
+ *  Oversampling is 1x. Forced mode converts on BME280_CHANNEL_APPLICATION of the scheduler for every sample.
+ *  Normal mode reads the latest result of the sensor, and converts through the scheduler while endpoints run.
+ *  Advertised pressure and humidity are kept in whole Pa and %RH, before the first sample they are 0.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Samples since previous sim_environmental_stats_get and range of their values **/
+typedef struct {
+  uint32_t samples;
+  uint32_t pressure_min;  //!< Pa
+  uint32_t pressure_max;
+  uint32_t humidity_min;  //!< %RH
+  uint32_t humidity_max;
+}sim_environmental_stats_t;
+
+/**
+ *  Start samples at given interval, replaces previous sampling. Configures the sensor and reads a first
+ *  conversion like boot of ruuvi_firmware does, call before endpoints start BME280 channels.
+ *
+ *  @param interval_ms main loop interval, 0 stops
+ *  @param forced true for APPLICATION_ENVIRONMENTAL_FORCED_MODE 1, false for normal mode
+ */
+void sim_environmental_start(uint32_t interval_ms, bool forced);
+
+/** Copy samples since previous call and start counting again **/
+void sim_environmental_stats_get(sim_environmental_stats_t* const stats);
+
+#endif
@@ -0,0 +1,340 @@
+#include "sim_link.h"
+#include "sim_bulk.h"
+#include "ble_nus.h"
+#include "ble_bulk_receive.h"
+#include "ble_bulk_transfer.h"
+#include "ble_diagnostics.h"
+#include "ruuvi_message_frame.h"
+#include "ruuvi_sample_stream.h"
+#include "bluetooth_core.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "init.h"
+#include <string.h>
+
+#define SIM_LINK_SUPERVISION_TIMEOUT 400  // 10 ms units
+#define SIM_LINK_DISCONNECT_REASON   0x13 // BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION
+#define SIM_LINK_RX_VALUE_HANDLE     0x0E // Attribute handles of NUS RX characteristic
+#define SIM_LINK_RX_CCCD_HANDLE      0x0F
+
+typedef struct {
+  uint8_t  data[BLE_RAW_MAX_SIZE];
+  uint16_t length;
+}tx_buffer_t;
+
+/** Central and the SoftDevice side of its connection **/
+typedef struct {
+  uint16_t         conn_handle;       // Index of central, BLE_CONN_HANDLE_INVALID if not connected
+  tx_buffer_t      buffers[SIM_LINK_MAX_BUFFERS];
+  uint8_t          buffer_count;
+  uint8_t          buffer_start;
+  uint8_t          buffers_max;
+  uint8_t          packets_per_event;
+  uint16_t         att_mtu;
+  uint32_t         interval_ms;
+  uint32_t         current_ms;
+  sim_link_stats_t stats;
+  sim_link_stats_t reported;
+  bool             stream_started;
+  uint16_t         stream_next;       // Sequence number expected in next block
+  app_timer_t      event_timer_data;
+  app_timer_id_t   event_timer;
+}central_t;
+
+static ble_nus_t        m_nus = { .conn_handle = BLE_CONN_HANDLE_INVALID,
+                                  .rx_handles  = { .value_handle = SIM_LINK_RX_VALUE_HANDLE,
+                                                   .cccd_handle  = SIM_LINK_RX_CCCD_HANDLE }};
+static message_handler  p_central         = NULL;
+static central_t        m_centrals[SIM_LINK_CENTRALS];
+static bool             m_fast            = false;
+static uint64_t         m_reported_ticks  = 0;
+
+static bool central_is_connected(const central_t* p_central_link)
+{
+  return BLE_CONN_HANDLE_INVALID != p_central_link->conn_handle;
+}
+
+/** Central accepts fast parameters only if they are faster than current ones **/
+static uint32_t negotiated_interval_ms(const central_t* p_central_link)
+{
+  uint32_t fast_ms = FAST_MAX_CONN_INTERVAL * UNIT_1_25_MS / 1000;
+  return (m_fast && fast_ms < p_central_link->interval_ms) ? fast_ms : p_central_link->interval_ms;
+}
+
+static void event_timer_update(central_t* p_central_link)
+{
+  if(!central_is_connected(p_central_link)) { return; }
+  uint32_t ms = negotiated_interval_ms(p_central_link);
+  if(ms == p_central_link->current_ms) { return; }
+  app_timer_stop(p_central_link->event_timer);
+  APP_ERROR_CHECK(app_timer_start(p_central_link->event_timer, APP_TIMER_TICKS(ms, RUUVITAG_APP_TIMER_PRESCALER), p_central_link));
+  // Same as BLE_GAP_EVT_CONNECTED and BLE_GAP_EVT_CONN_PARAM_UPDATE handlers, no latency, 4 s supervision timeout
+  if(p_central_link->current_ms) { ble_diagnostics_on_conn_params(ms * 1000 / UNIT_1_25_MS, 0, SIM_LINK_SUPERVISION_TIMEOUT); }
+  else { ble_diagnostics_on_connected(ms * 1000 / UNIT_1_25_MS, 0, SIM_LINK_SUPERVISION_TIMEOUT); }
+  p_central_link->current_ms = ms;
+}
+
+/** Count messages before they are given to central, central 0 runs the uploads **/
+static central_t* p_receiving = NULL;
+
+static ret_code_t central_receive(const ruuvi_standard_message_t message)
+{
+  p_receiving->stats.messages++;
+  if(p_receiving == &m_centrals[0] && BULK_TRANSFER == message.destination_endpoint && sim_bulk_upload_ack(message))
+  {
+    return ENDPOINT_SUCCESS;
+  }
+  return p_central ? p_central(message) : ENDPOINT_SUCCESS;
+}
+
+/** Central follows sequence numbers of sample stream, a gap is counted as lost samples **/
+static bool central_stream_receive(central_t* p_central_link, const uint8_t* data, size_t length)
+{
+  sample_stream_block_t block;
+  if(SAMPLE_STREAM != data[0]) { return false; }
+  if(ENDPOINT_SUCCESS != sample_stream_unpack(data, length, &block))
+  {
+    p_central_link->stats.invalid++;
+    return true;
+  }
+  if(p_central_link->stream_started) { p_central_link->stats.stream_lost += (uint16_t)(block.sequence - p_central_link->stream_next); }
+  p_central_link->stream_started = true;
+  p_central_link->stream_next = block.sequence + block.count;
+  p_central_link->stats.stream_samples += block.count;
+  return true;
+}
+
+/** Connection event in radio interrupt, TX complete wakes up main loop **/
+static void connection_event(void* p_context)
+{
+  central_t* p_central_link = p_context;
+  bool bulk = (p_central_link == &m_centrals[0]);
+  p_central_link->stats.connection_events++;
+  uint8_t delivered = 0;
+  for(uint8_t ii = 0; ii < p_central_link->packets_per_event && p_central_link->buffer_count; ii++)
+  {
+    delivered++;
+    tx_buffer_t* p_buffer = &p_central_link->buffers[p_central_link->buffer_start];
+    p_central_link->buffer_start = (p_central_link->buffer_start + 1) % SIM_LINK_MAX_BUFFERS;
+    p_central_link->buffer_count--;
+    p_central_link->stats.notifications++;
+    p_central_link->stats.bytes += p_buffer->length;
+    if(bulk && sim_bulk_receive(p_buffer->data, p_buffer->length)) { continue; }
+    if(central_stream_receive(p_central_link, p_buffer->data, p_buffer->length)) { continue; }
+    p_receiving = p_central_link;
+    if(ENDPOINT_SUCCESS != message_frame_unpack(p_buffer->data, p_buffer->length, central_receive)) { p_central_link->stats.invalid++; }
+  }
+  if(delivered) { ble_diagnostics_on_tx_complete(delivered); }
+  if(bulk) { sim_bulk_connection_event(p_central_link->packets_per_event); }
+}
+
+uint32_t ble_nus_string_send(ble_nus_t * p_nus, uint8_t * p_string, uint16_t length)
+{
+  if(NULL == p_nus || NULL == p_string)             { return NRF_ERROR_NULL; }
+  if(p_nus->conn_handle >= SIM_LINK_CENTRALS ||
+     !central_is_connected(&m_centrals[p_nus->conn_handle])) { return NRF_ERROR_INVALID_STATE; }
+  if(!p_nus->is_notification_enabled)               { return NRF_ERROR_INVALID_STATE; }
+  central_t* p_central_link = &m_centrals[p_nus->conn_handle];
+  if(length > p_central_link->att_mtu - BLE_ATT_HEADER_SIZE) { return NRF_ERROR_INVALID_PARAM; }
+  if(p_central_link->buffer_count >= p_central_link->buffers_max)
+  {
+    p_central_link->stats.refused++;
+    return BLE_ERROR_NO_TX_PACKETS;
+  }
+  tx_buffer_t* p_buffer = &p_central_link->buffers[(p_central_link->buffer_start + p_central_link->buffer_count) % SIM_LINK_MAX_BUFFERS];
+  memcpy(p_buffer->data, p_string, length);
+  p_buffer->length = length;
+  p_central_link->buffer_count++;
+  if(p_central_link->buffer_count > p_central_link->stats.buffers_max) { p_central_link->stats.buffers_max = p_central_link->buffer_count; }
+  return NRF_SUCCESS;
+}
+
+/** Connection parameters module follows one connection, every central accepts the same parameters **/
+ret_code_t bluetooth_conn_params_fast(bool fast)
+{
+  m_fast = fast;
+  for(uint8_t ii = 0; ii < SIM_LINK_CENTRALS; ii++) { event_timer_update(&m_centrals[ii]); }
+  return NRF_SUCCESS;
+}
+
+void sim_link_init(message_handler central)
+{
+  p_central = central;
+  ble_bulk_set_nus(&m_nus);
+  for(uint8_t ii = 0; ii < SIM_LINK_CENTRALS; ii++)
+  {
+    central_t* p_central_link = &m_centrals[ii];
+    p_central_link->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_central_link->buffers_max = 1;
+    p_central_link->packets_per_event = 1;
+    p_central_link->att_mtu     = GATT_MTU_SIZE_DEFAULT;
+    p_central_link->event_timer = &p_central_link->event_timer_data;
+    APP_ERROR_CHECK(app_timer_create(&p_central_link->event_timer, APP_TIMER_MODE_REPEATED, connection_event));
+    app_timer_sim_irq_set(p_central_link->event_timer, true);
+  }
+}
+
+void sim_link_connect(uint8_t central, uint16_t att_mtu, uint32_t interval_ms, uint8_t buffers, uint8_t packets_per_event)
+{
+  if(central >= SIM_LINK_CENTRALS) { return; }
+  sim_link_disconnect(central);
+  central_t* p_central_link = &m_centrals[central];
+  p_central_link->buffers_max       = MAX(1, MIN(buffers, SIM_LINK_MAX_BUFFERS));
+  p_central_link->packets_per_event = MAX(1, packets_per_event);
+  p_central_link->interval_ms       = interval_ms;
+  p_central_link->conn_handle       = central;
+  // Same as BLE_GAP_EVT_CONNECTED and MTU exchange handlers
+  ble_link_connect(central);
+  ble_bulk_set_att_mtu(central, att_mtu);
+  p_central_link->att_mtu = ble_bulk_get_att_mtu(central);
+  event_timer_update(p_central_link);
+  // Central enables notifications of NUS RX characteristic
+  uint8_t cccd[2] = { BLE_GATT_HVX_NOTIFICATION, 0 };
+  ble_link_on_write(central, m_nus.rx_handles.cccd_handle, cccd, sizeof(cccd));
+}
+
+void sim_link_disconnect(uint8_t central)
+{
+  if(central >= SIM_LINK_CENTRALS) { return; }
+  central_t* p_central_link = &m_centrals[central];
+  if(!central_is_connected(p_central_link)) { return; }
+  ble_diagnostics_on_disconnected(SIM_LINK_DISCONNECT_REASON);
+  app_timer_stop(p_central_link->event_timer);
+  p_central_link->current_ms     = 0;
+  p_central_link->buffer_count   = 0;
+  p_central_link->stream_started = false;
+  p_central_link->att_mtu        = GATT_MTU_SIZE_DEFAULT;
+  p_central_link->conn_handle    = BLE_CONN_HANDLE_INVALID;
+  // Same as BLE_GAP_EVT_DISCONNECTED handler
+  ble_bulk_receive_reset(ble_link_find(central));
+  ble_link_disconnect(central);
+  if(!ble_link_count()) { m_fast = false; }
+}
+
+int sim_link_write(uint8_t central, const uint8_t* data, size_t length)
+{
+  if(central >= SIM_LINK_CENTRALS || !central_is_connected(&m_centrals[central])) { return -1; }
+  // BLE_GATTS_EVT_WRITE in on_ble_evt, then NUS data handler of test_drivers
+  ble_link_on_write(central, m_nus.rx_handles.value_handle, data, length);
+  if(ble_bulk_receive(data, length)) { return 0; }
+  if(sizeof(ruuvi_standard_message_t) == length)
+  {
+    ruuvi_standard_message_t message;
+    memcpy(&message, data, sizeof(message));
+    ble_link_message_schedule(message);
+  }
+  return 0;
+}
+
+void sim_link_stats_get(uint8_t central, sim_link_stats_t* stats)
+{
+  if(central < SIM_LINK_CENTRALS) { *stats = m_centrals[central].stats; }
+}
+
+/** Sum of all centrals, buffers_max is the largest of them **/
+static void stats_total(sim_link_stats_t* total, sim_link_stats_t* reported)
+{
+  memset(total, 0, sizeof(*total));
+  memset(reported, 0, sizeof(*reported));
+  for(uint8_t ii = 0; ii < SIM_LINK_CENTRALS; ii++)
+  {
+    const sim_link_stats_t* p_stats = &m_centrals[ii].stats;
+    const sim_link_stats_t* p_reported = &m_centrals[ii].reported;
+    total->connection_events += p_stats->connection_events;
+    total->notifications     += p_stats->notifications;
+    total->bytes             += p_stats->bytes;
+    total->messages          += p_stats->messages;
+    total->invalid           += p_stats->invalid;
+    total->refused           += p_stats->refused;
+    total->stream_samples    += p_stats->stream_samples;
+    total->stream_lost       += p_stats->stream_lost;
+    total->buffers_max        = MAX(total->buffers_max, p_stats->buffers_max);
+    reported->connection_events += p_reported->connection_events;
+    reported->notifications     += p_reported->notifications;
+    reported->bytes             += p_reported->bytes;
+    reported->messages          += p_reported->messages;
+    reported->invalid           += p_reported->invalid;
+    reported->refused           += p_reported->refused;
+    reported->stream_samples    += p_reported->stream_samples;
+    reported->stream_lost       += p_reported->stream_lost;
+  }
+}
+
+/** One line per central once a central other than 0 has connected **/
+static void report_centrals(FILE* out, double seconds)
+{
+  bool several = false;
+  for(uint8_t ii = 1; ii < SIM_LINK_CENTRALS; ii++) { several |= (0 != m_centrals[ii].stats.connection_events); }
+  if(!several) { return; }
+  for(uint8_t ii = 0; ii < SIM_LINK_CENTRALS; ii++)
+  {
+    const sim_link_stats_t* p_stats = &m_centrals[ii].stats;
+    const sim_link_stats_t* p_reported = &m_centrals[ii].reported;
+    ble_link_statistics_t link = {0};
+    uint8_t index = ble_link_find(ii);
+    if(BLE_LINK_INVALID != index) { ble_link_statistics_get(index, &link); }
+    uint64_t bytes = p_stats->bytes - p_reported->bytes;
+    fprintf(out, "     Central %u%s: MTU %u, %llu notifications, %llu bytes, %.0f B/s, %llu messages, %llu stream samples, "
+                 "%llu refused. Tag link %u: %u bytes, %u busy, %u ms connected\n",
+            ii, central_is_connected(&m_centrals[ii]) ? "" : " (disconnected)", m_centrals[ii].att_mtu,
+            (unsigned long long)(p_stats->notifications - p_reported->notifications),
+            (unsigned long long)bytes, seconds > 0 ? bytes / seconds : 0.0,
+            (unsigned long long)(p_stats->messages - p_reported->messages),
+            (unsigned long long)(p_stats->stream_samples - p_reported->stream_samples),
+            (unsigned long long)(p_stats->refused - p_reported->refused),
+            index, (unsigned)link.bytes, (unsigned)link.busy, (unsigned)link.connected_ms);
+  }
+}
+
+void sim_link_report(FILE* out)
+{
+  ble_transfer_statistics_t transfer;
+  ble_transfer_statistics_get(&transfer);
+  ble_transfer_statistics_reset();
+  sim_link_stats_t stats, reported;
+  stats_total(&stats, &reported);
+  uint64_t now = app_timer_sim_now();
+  double seconds = (double)(now - m_reported_ticks) / app_timer_sim_tick_rate();
+  uint64_t notifications = stats.notifications - reported.notifications;
+  uint64_t messages      = stats.messages - reported.messages;
+
+  fprintf(out, "Link %.3f s, MTU %u, packing %s: %llu events, %llu notifications, %llu bytes, "
+               "%llu messages, %.2f messages per notification, %.1f messages/s\n",
+          seconds, m_centrals[0].att_mtu, ble_std_get_packing() ? "on" : "off",
+          (unsigned long long)(stats.connection_events - reported.connection_events),
+          (unsigned long long)notifications,
+          (unsigned long long)(stats.bytes - reported.bytes),
+          (unsigned long long)messages,
+          notifications ? (double)messages / notifications : 0.0,
+          seconds > 0 ? messages / seconds : 0.0);
+  fprintf(out, "     TX buffers: %llu refused, %u of %u in use at most, %llu invalid notifications. "
+               "Driver: %u std messages, %u busy, %u ms active, %u bulk transfers, %u chunks retransmitted, %u failed\n",
+          (unsigned long long)(stats.refused - reported.refused),
+          stats.buffers_max, m_centrals[0].buffers_max,
+          (unsigned long long)(stats.invalid - reported.invalid),
+          (unsigned)transfer.std_messages, (unsigned)transfer.busy, (unsigned)transfer.active_ms,
+          (unsigned)transfer.transfers, (unsigned)transfer.retransmissions, (unsigned)transfer.failed);
+  ble_diagnostics_t diagnostics;
+  ble_diagnostics_get(&diagnostics);
+  fprintf(out, "     Diagnostics since boot: %u connections, %u disconnections, %u TX complete events, %u acknowledged, "
+               "%u STD overflows, %u bulk overflows, %u queue process calls\n",
+          (unsigned)diagnostics.connections, (unsigned)diagnostics.disconnections,
+          (unsigned)diagnostics.tx_complete_events, (unsigned)diagnostics.tx_completed,
+          (unsigned)transfer.std_overflows, (unsigned)transfer.bulk_overflows,
+          (unsigned)diagnostics.process_calls);
+  if(stats.stream_samples != reported.stream_samples || transfer.stream_samples)
+  {
+    fprintf(out, "     Stream: %u samples sent, %llu received, %llu lost in sequence gaps, %.1f samples/s\n",
+            (unsigned)transfer.stream_samples,
+            (unsigned long long)(stats.stream_samples - reported.stream_samples),
+            (unsigned long long)(stats.stream_lost - reported.stream_lost),
+            seconds > 0 ? (stats.stream_samples - reported.stream_samples) / seconds : 0.0);
+  }
+  report_centrals(out, seconds);
+  for(uint8_t ii = 0; ii < SIM_LINK_CENTRALS; ii++)
+  {
+    m_centrals[ii].reported = m_centrals[ii].stats;
+    m_centrals[ii].stats.buffers_max = 0;
+  }
+  m_reported_ticks = now;
+}
@@ -0,0 +1,73 @@
+#ifndef SIM_LINK_H
+#define SIM_LINK_H
+
+/**
+ *  Virtual BLE connection for host simulator.
+ *
+ *  Stands in for the SoftDevice below ble_bulk_transfer: ble_nus_string_send places
+ *  notifications into a limited number of TX buffers, and at every connection event
+ *  up to packets_per_event of them are delivered to the central. Central unpacks each
+ *  notification with message_frame_unpack and passes the messages to its handler.
+ *  Sample stream blocks are checked for sequence gaps instead.
+ *  Connection interval follows bluetooth_conn_params_fast(), like a central which
+ *  accepts every parameter update request.
+ *
+ *  Up to SIM_LINK_CENTRALS centrals connect at the same time, each with its own TX buffers,
+ *  connection events and statistics. Connection handle of a central is its index.
+ *  Central 0 runs the bulk transfers and uploads of sim_bulk.h.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "ruuvi_endpoints.h"
+#include "ble_bulk_transfer.h"
+
+#define SIM_LINK_MAX_BUFFERS 32
+#define SIM_LINK_CENTRALS    BLE_LINK_COUNT
+
+typedef struct {
+  uint64_t connection_events;
+  uint64_t notifications;     /**< Notifications delivered to central */
+  uint64_t bytes;             /**< Bytes delivered to central, without ATT header */
+  uint64_t messages;          /**< Standard messages unpacked by central */
+  uint64_t invalid;           /**< Notifications central could not unpack */
+  uint64_t refused;           /**< ble_nus_string_send calls refused for full TX buffers */
+  uint64_t stream_samples;    /**< Samples received in sample stream blocks */
+  uint64_t stream_lost;       /**< Samples missing between sequence numbers of consecutive blocks */
+  uint16_t buffers_max;       /**< Largest number of TX buffers in use */
+}sim_link_stats_t;
+
+/** Set handler for messages received by central and create connection event timer **/
+void sim_link_init(message_handler central);
+
+/**
+ *  Connect central, exchange MTU, enable notifications and start connection events.
+ *  Central which is connected is disconnected first.
+ *
+ *  @param central index of central, 0 ... SIM_LINK_CENTRALS - 1
+ *  @param att_mtu ATT MTU agreed, clamped by ble_bulk_set_att_mtu
+ *  @param interval_ms connection interval while not transferring
+ *  @param buffers SoftDevice TX buffers, 1 ... SIM_LINK_MAX_BUFFERS
+ *  @param packets_per_event packets the central accepts per connection event
+ */
+void sim_link_connect(uint8_t central, uint16_t att_mtu, uint32_t interval_ms, uint8_t buffers, uint8_t packets_per_event);
+
+/** Disconnect central, buffered notifications are lost **/
+void sim_link_disconnect(uint8_t central);
+
+/**
+ *  Write data to NUS RX of the tag from central, in BLE event context like on the tag:
+ *  on_ble_evt records the link, then NUS data handler passes data to ble_bulk_receive
+ *  or schedules an 11-byte standard message to the router.
+ *
+ *  @return 0 on success, -1 if central is not connected
+ */
+int sim_link_write(uint8_t central, const uint8_t* data, size_t length);
+
+/** Statistics of central since start of simulation **/
+void sim_link_stats_get(uint8_t central, sim_link_stats_t* stats);
+
+/** Print link and ble_bulk_transfer statistics accumulated since previous report **/
+void sim_link_report(FILE* out);
+
+#endif
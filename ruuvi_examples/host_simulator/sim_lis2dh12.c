@@ -0,0 +1,416 @@
+#include "sim_lis2dh12.h"
+#include "lis2dh12_acceleration_handler.h"
+#include "lis2dh12_event_handler.h"
+#include "ruuvi_endpoints.h"
+#include "app_timer.h"
+#include "init.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+APP_TIMER_DEF(sample_timer);
+
+static acceleration_t         m_fifo[LIS2DH12_FIFO_MAX_LENGTH];
+static size_t                 m_fifo_start   = 0;
+static size_t                 m_fifo_count   = 0;
+static acceleration_t         m_latest       = {0};
+static lis2dh12_fifo_mode_t   m_mode         = LIS2DH12_MODE_BYPASS;
+static bool                   m_overrun_flag = false; // OVRN_FIFO, cleared by reading FIFO
+static lis2dh12_sample_rate_t m_rate         = LIS2DH12_RATE_0;
+static lis2dh12_scale_t       m_scale        = LIS2DH12_SCALE2G;
+static lis2dh12_resolution_t  m_resolution   = LIS2DH12_RES10BIT;
+static size_t                 m_watermark    = 0;
+static uint8_t                m_int1         = LIS2DH12_NO_INTERRUPTS;
+static bool                   m_wtm_asserted = false;
+
+static uint64_t m_rate_start   = 0; // Virtual time at which sampling started
+static uint64_t m_produced     = 0; // Samples produced since sampling started
+static uint64_t m_samples      = 0;
+static uint64_t m_overruns     = 0;
+static uint64_t m_interrupts   = 0;
+
+// Event configuration and sources, FIFO and outputs are modelled above
+static uint8_t  m_registers[LIS2DH12_ACT_DUR + 1];
+static bool     m_pin_2        = false;
+static uint64_t m_taps         = 0;
+static uint64_t m_activity     = 0;
+
+static int32_t  m_amplitude    = 0;
+static uint32_t m_period_ms    = 0;
+static int32_t  m_noise        = 0;
+static uint32_t m_lcg          = 1;
+
+/** Deterministic noise so that runs are repeatable **/
+static int32_t noise(void)
+{
+  m_lcg = m_lcg * 1664525u + 1013904223u;
+  if(0 == m_noise) { return 0; }
+  return (int32_t)((m_lcg >> 8) % (2 * m_noise + 1)) - m_noise;
+}
+
+/** Clamp to full scale and truncate to LSB of selected resolution, like the ADC **/
+static int16_t quantize(int32_t mg)
+{
+  int32_t full_scale = lis2dh12_get_full_scale();
+  int32_t bits       = 16 - m_resolution;
+  int32_t lsb        = (2 * full_scale) >> bits;
+  if(0 == lsb) { lsb = 1; }
+  if(mg >= full_scale) { mg = full_scale - lsb; }
+  if(mg < -full_scale) { mg = -full_scale; }
+  return (int16_t)((mg / lsb) * lsb);
+}
+
+static acceleration_t waveform(uint64_t sample_index, int hz)
+{
+  double t     = (double)sample_index / hz;
+  double phase = m_period_ms ? 2 * M_PI * t * 1000.0 / m_period_ms : 0;
+  acceleration_t sample;
+  sample.x = quantize((int32_t)(m_amplitude * sin(phase)) + noise());
+  sample.y = quantize((int32_t)(m_amplitude * cos(phase)) + noise());
+  sample.z = quantize(1000 + (int32_t)(m_amplitude / 2 * sin(2 * phase)) + noise());
+  return sample;
+}
+
+static void fifo_push(acceleration_t sample)
+{
+  m_latest = sample;
+  m_samples++;
+  if(LIS2DH12_MODE_BYPASS == m_mode) { return; }
+  if(LIS2DH12_FIFO_MAX_LENGTH == m_fifo_count)
+  {
+    // Stream mode discards oldest sample
+    m_fifo_start = (m_fifo_start + 1) % LIS2DH12_FIFO_MAX_LENGTH;
+    m_fifo_count--;
+    m_overruns++;
+    m_overrun_flag = true;
+  }
+  m_fifo[(m_fifo_start + m_fifo_count) % LIS2DH12_FIFO_MAX_LENGTH] = sample;
+  m_fifo_count++;
+}
+
+/** Check watermark, INT1 is edge-triggered on the tag (LOTOHI) **/
+static void update_interrupt(void)
+{
+  bool level = m_watermark && m_fifo_count >= m_watermark;
+  if(level && !m_wtm_asserted && (m_int1 & LIS2DH12_I1_WTM))
+  {
+    m_interrupts++;
+    ruuvi_standard_message_t message = { .destination_endpoint = ACCELERATION,
+                                         .source_endpoint      = ACCELERATION,
+                                         .type                 = INT16,
+                                         .payload              = {0}};
+    m_wtm_asserted = true;
+    lis2dh12_int1_handler(message);
+  }
+  if(!level) { m_wtm_asserted = false; }
+}
+
+/** INT2 is edge-triggered on the tag (LOTOHI), latched sources keep it high until read **/
+static void update_pin_2(void)
+{
+  uint8_t routing = m_registers[LIS2DH12_CTRL_REG6];
+  bool level = ((routing & LIS2DH12_I2C_CCK_EN_MASK) && (m_registers[LIS2DH12_CLICK_SRC] & LIS2DH12_CLK_IA_MASK))
+            || ((routing & LIS2DH12_I2C_INT1_MASK) && (m_registers[LIS2DH12_INT1_SOURCE] & LIS2DH12_INT_IA_MASK))
+            || ((routing & LIS2DH12_I2C_INT2_MASK) && (m_registers[LIS2DH12_INT2_SOURCE] & LIS2DH12_INT_IA_MASK));
+  bool edge = level && !m_pin_2;
+  m_pin_2 = level;
+  if(edge)
+  {
+    ruuvi_standard_message_t message = { .destination_endpoint = ACCELERATION,
+                                         .source_endpoint      = ACCELERATION,
+                                         .type                 = INT16,
+                                         .payload              = {0}};
+    lis2dh12_event_int2_handler(message);
+  }
+}
+
+/** accelerometer_activity of ruuvi_firmware **/
+static void activity_handler(void)
+{
+  m_activity++;
+}
+
+/** Produce all samples that are due at current virtual time **/
+static void sample_timeout_handler(void* p_context)
+{
+  (void)p_context;
+  int hz = lis2dh12_odr_to_hz(m_rate);
+  if(0 == hz) { return; }
+  uint64_t elapsed = app_timer_sim_now() - m_rate_start;
+  uint64_t due     = elapsed * hz / app_timer_sim_tick_rate();
+  while(m_produced < due)
+  {
+    fifo_push(waveform(m_produced, hz));
+    m_produced++;
+    // Activity is not latched, it lasts one sample
+    m_registers[LIS2DH12_INT2_SOURCE] = 0;
+  }
+  update_interrupt();
+  update_pin_2();
+}
+
+void sim_lis2dh12_init(void)
+{
+  memset(m_fifo, 0, sizeof(m_fifo));
+  m_fifo_start = m_fifo_count = 0;
+  m_overrun_flag = false;
+  m_rate = LIS2DH12_RATE_0;
+  m_mode = LIS2DH12_MODE_BYPASS;
+  m_samples = m_overruns = m_interrupts = 0;
+  memset(m_registers, 0, sizeof(m_registers));
+  m_pin_2 = false;
+  m_taps = m_activity = 0;
+  lis2dh12_event_set_activity_handler(activity_handler);
+  app_timer_create(&sample_timer, APP_TIMER_MODE_REPEATED, sample_timeout_handler);
+  app_timer_sim_irq_set(sample_timer, true);
+}
+
+void sim_lis2dh12_set_waveform(int32_t amplitude_mg, uint32_t period_ms, int32_t noise_mg)
+{
+  m_amplitude = amplitude_mg;
+  m_period_ms = period_ms;
+  m_noise     = noise_mg;
+}
+
+uint64_t sim_lis2dh12_samples(void)    { return m_samples; }
+uint64_t sim_lis2dh12_overruns(void)   { return m_overruns; }
+uint64_t sim_lis2dh12_interrupts(void) { return m_interrupts; }
+uint64_t sim_lis2dh12_taps(void)       { return m_taps; }
+uint64_t sim_lis2dh12_activity_events(void) { return m_activity; }
+
+uint8_t sim_lis2dh12_register(uint8_t address)
+{
+  return (address < sizeof(m_registers)) ? m_registers[address] : 0;
+}
+
+void sim_lis2dh12_tap(uint32_t duration_ms)
+{
+  uint32_t samples = duration_ms * lis2dh12_odr_to_hz(m_rate) / 1000;
+  if(!(m_registers[LIS2DH12_CLICK_CFG] & LIS2DH12_ZS_MASK) || !samples) { return; }
+  if(samples > (m_registers[LIS2DH12_TIME_LIMIT] & LIS2DH12_TLI_MASK)) { return; }
+  m_registers[LIS2DH12_CLICK_SRC] = LIS2DH12_CLK_IA_MASK | LIS2DH12_SCLICK_MASK | LIS2DH12_Z_CLICK_MASK;
+  update_pin_2();
+}
+
+void sim_lis2dh12_activity(void)
+{
+  if(!lis2dh12_odr_to_hz(m_rate)) { return; }
+  m_registers[LIS2DH12_INT2_SOURCE] = LIS2DH12_INT_IA_MASK | LIS2DH12_ZH_MASK;
+  update_pin_2();
+}
+
+/** lis2dh12.h API **/
+
+int lis2dh12_get_full_scale()
+{
+  switch(m_scale)
+  {
+    case LIS2DH12_SCALE2G:  return 2000;
+    case LIS2DH12_SCALE4G:  return 4000;
+    case LIS2DH12_SCALE8G:  return 8000;
+    case LIS2DH12_SCALE16G: return 16000;
+    default:                return 0;
+  }
+}
+
+lis2dh12_ret_t lis2dh12_set_scale(lis2dh12_scale_t scale)
+{
+  m_scale = scale;
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_set_resolution(lis2dh12_resolution_t resolution)
+{
+  m_resolution = resolution;
+  return LIS2DH12_RET_OK;
+}
+
+int lis2dh12_odr_to_hz(lis2dh12_sample_rate_t sample_rate)
+{
+  switch(sample_rate)
+  {
+    case LIS2DH12_RATE_1:   return 1;
+    case LIS2DH12_RATE_10:  return 10;
+    case LIS2DH12_RATE_25:  return 25;
+    case LIS2DH12_RATE_50:  return 50;
+    case LIS2DH12_RATE_100: return 100;
+    case LIS2DH12_RATE_200: return 200;
+    case LIS2DH12_RATE_400: return 400;
+    default:                return 0;
+  }
+}
+
+lis2dh12_ret_t lis2dh12_set_sample_rate(lis2dh12_sample_rate_t sample_rate)
+{
+  app_timer_stop(sample_timer);
+  m_rate       = sample_rate;
+  m_rate_start = app_timer_sim_now();
+  m_produced   = 0;
+  int hz = lis2dh12_odr_to_hz(sample_rate);
+  if(0 == hz) { return LIS2DH12_RET_OK; }
+  uint32_t ticks = app_timer_sim_tick_rate() / hz;
+  if(ticks < APP_TIMER_MIN_TIMEOUT_TICKS) { ticks = APP_TIMER_MIN_TIMEOUT_TICKS; }
+  app_timer_start(sample_timer, ticks, NULL);
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_get_sample_rate(lis2dh12_sample_rate_t* sample_rate)
+{
+  *sample_rate = m_rate;
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_set_fifo_mode(lis2dh12_fifo_mode_t mode)
+{
+  m_mode = mode;
+  // Switching through bypass resets FIFO
+  if(LIS2DH12_MODE_BYPASS == mode) { m_fifo_start = m_fifo_count = 0; }
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_set_fifo_watermark(size_t count)
+{
+  if(count > LIS2DH12_FIFO_MAX_LENGTH) { return LIS2DH12_RET_INVALID; }
+  m_watermark = count;
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_set_interrupts(uint8_t interrupts, uint8_t pin)
+{
+  if(1 != pin && 2 != pin) { return LIS2DH12_RET_INVALID; }
+  if(1 == pin) { m_int1 = interrupts; }
+  else { m_registers[LIS2DH12_CTRL_REG6] = interrupts; }
+  update_pin_2();
+  return LIS2DH12_RET_OK;
+}
+
+/** Samples of duration at current sample rate, as the driver converts event durations **/
+static uint8_t duration_samples(int duration_ms, uint8_t max)
+{
+  int samples = duration_ms * lis2dh12_odr_to_hz(m_rate) / 1000;
+  return (samples > max) ? max : samples;
+}
+
+static uint8_t threshold_lsb(int threshold_mg, int lsb_per_full_scale, uint8_t max)
+{
+  int value = (lsb_per_full_scale * threshold_mg) / lis2dh12_get_full_scale();
+  if(value > max) { value = max; }
+  return (value < 1) ? 1 : value;
+}
+
+lis2dh12_ret_t lis2dh12_set_activity_interrupt_pin_2(uint16_t mg)
+{
+  m_registers[LIS2DH12_INT2_CFG] = LIS2DH12_6D_MASK | 0x3F;
+  m_registers[LIS2DH12_INT2_THS] = threshold_lsb(mg, 128, LIS2DH12_THS_MASK);
+  return lis2dh12_set_interrupts(LIS2DH12_I2C_INT2_MASK, 2);
+}
+
+lis2dh12_ret_t lis2dh12_set_tap_interrupt(uint8_t click_cfg, int threshold_mg, int timelimit_ms, int latency_ms, int window_ms, uint8_t pin)
+{
+  if(2 != pin) { return LIS2DH12_RET_INVALID; }
+  m_registers[LIS2DH12_CLICK_CFG]    = click_cfg;
+  m_registers[LIS2DH12_CLICK_THS]    = threshold_lsb(threshold_mg, 128, LIS2DH12_CLK_THS_MASK);
+  m_registers[LIS2DH12_TIME_LIMIT]   = duration_samples(timelimit_ms, LIS2DH12_TLI_MASK);
+  if(!m_registers[LIS2DH12_TIME_LIMIT]) { m_registers[LIS2DH12_TIME_LIMIT] = 1; }
+  m_registers[LIS2DH12_TIME_LATENCY] = duration_samples(latency_ms, 0xFF);
+  m_registers[LIS2DH12_TIME_WINDOW]  = duration_samples(window_ms, 0xFF);
+  return lis2dh12_set_interrupts(LIS2DH12_I2C_CCK_EN_MASK, 2);
+}
+
+static lis2dh12_ret_t configure_event_function_1(uint8_t cfg, uint16_t threshold_mg, uint16_t duration_ms)
+{
+  m_registers[LIS2DH12_INT1_THS]      = threshold_lsb(threshold_mg, 128, LIS2DH12_THS_MASK);
+  m_registers[LIS2DH12_INT1_DURATION] = duration_samples(duration_ms, 0x7F);
+  return lis2dh12_set_interrupt_configuration(cfg, 1);
+}
+
+lis2dh12_ret_t lis2dh12_set_free_fall_interrupt(uint16_t threshold_mg, uint16_t duration_ms)
+{
+  return configure_event_function_1(LIS2DH12_AOI_MASK | LIS2DH12_ZLIE_MASK | LIS2DH12_YLIE_MASK | LIS2DH12_XLIE_MASK,
+                                    threshold_mg, duration_ms);
+}
+
+lis2dh12_ret_t lis2dh12_set_orientation_interrupt(uint16_t threshold_mg, uint16_t duration_ms)
+{
+  return configure_event_function_1(LIS2DH12_6D_MASK | 0x3F, threshold_mg, duration_ms);
+}
+
+lis2dh12_ret_t lis2dh12_set_interrupt_configuration(uint8_t cfg, uint8_t function)
+{
+  if(1 != function && 2 != function) { return LIS2DH12_RET_INVALID; }
+  m_registers[(1 == function) ? LIS2DH12_INT1_CFG : LIS2DH12_INT2_CFG] = cfg;
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_read_register(uint8_t address, uint8_t* const p_toRead, size_t count)
+{
+  if(NULL == p_toRead) { return LIS2DH12_RET_NULL; }
+  if(address + count > sizeof(m_registers)) { return LIS2DH12_RET_INVALID; }
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    uint8_t register_address = address + ii;
+    p_toRead[ii] = m_registers[register_address];
+    // Reading latched source clears it
+    if(LIS2DH12_CLICK_SRC == register_address)
+    {
+      if(p_toRead[ii] & LIS2DH12_CLK_IA_MASK) { m_taps++; }
+      m_registers[register_address] = 0;
+    }
+    if(LIS2DH12_INT1_SOURCE == register_address) { m_registers[register_address] = 0; }
+  }
+  update_pin_2();
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_write_register(uint8_t address, uint8_t* const dataToWrite, size_t count)
+{
+  if(NULL == dataToWrite) { return LIS2DH12_RET_NULL; }
+  if(address + count > sizeof(m_registers)) { return LIS2DH12_RET_INVALID; }
+  memcpy(&m_registers[address], dataToWrite, count);
+  update_pin_2();
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_get_event_sources(uint8_t* int1_source, uint8_t* click_source)
+{
+  if(NULL == int1_source || NULL == click_source) { return LIS2DH12_RET_NULL; }
+  lis2dh12_read_register(LIS2DH12_INT1_SOURCE, int1_source, 1);
+  return lis2dh12_read_register(LIS2DH12_CLICK_SRC, click_source, 1);
+}
+
+// Model has no registers, setters take effect at once
+lis2dh12_ret_t lis2dh12_begin_configuration(void)  { return LIS2DH12_RET_OK; }
+lis2dh12_ret_t lis2dh12_commit_configuration(void) { return LIS2DH12_RET_OK; }
+
+lis2dh12_ret_t lis2dh12_get_fifo_sample_number(size_t* count)
+{
+  *count = m_fifo_count;
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_get_fifo_status(size_t* count, bool* overrun)
+{
+  if(NULL == count || NULL == overrun) { return LIS2DH12_RET_NULL; }
+  *overrun = m_overrun_flag;
+  *count   = m_fifo_count;
+  return LIS2DH12_RET_OK;
+}
+
+lis2dh12_ret_t lis2dh12_read_samples(lis2dh12_sensor_buffer_t* buffer, size_t count)
+{
+  if(NULL == buffer) { return LIS2DH12_RET_NULL; }
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    // Empty FIFO returns latest sample, as output registers do in bypass mode
+    if(0 == m_fifo_count) { buffer[ii].sensor = m_latest; continue; }
+    buffer[ii].sensor = m_fifo[m_fifo_start];
+    m_fifo_start = (m_fifo_start + 1) % LIS2DH12_FIFO_MAX_LENGTH;
+    m_fifo_count--;
+  }
+  if(count) { m_overrun_flag = false; }
+  update_interrupt();
+  return LIS2DH12_RET_OK;
+}
@@ -0,0 +1,61 @@
+#ifndef SIM_LIS2DH12_H
+#define SIM_LIS2DH12_H
+
+/**
+ *  Simulated LIS2DH12 for host simulator.
+ *
+ *  Implements the parts of lis2dh12.h used by lis2dh12_acceleration_handler.c on top of a
+ *  32-sample FIFO that is filled from a synthetic waveform at the configured data rate.
+ *  FIFO watermark interrupt on INT1 calls lis2dh12_int1_handler from "interrupt context",
+ *  just like the GPIOTE pin handler on the tag.
+ *
+ *  Event registers of tap, free-fall, orientation and activity are kept as written by
+ *  lis2dh12_event_handler.c. Rising edge of INT2 calls lis2dh12_event_int2_handler like
+ *  lis2dh12_int2_handler of ruuvi_firmware, activity is counted like the firmware counts it.
+ *  Tap and interrupt function 1 sources are latched until read, activity lasts until next sample.
+ */
+
+#include <stdint.h>
+#include "lis2dh12.h"
+
+/** Initialise virtual sensor, sensor is powered down until configured **/
+void sim_lis2dh12_init(void);
+
+/**
+ *  Set synthetic waveform. X and Y axes run sine and cosine at given amplitude and period,
+ *  Z axis has 1 g offset and half amplitude at double frequency. Uniform noise is added to all axes.
+ *
+ *  @param amplitude_mg peak amplitude of the waveform, mg
+ *  @param period_ms period of the waveform, ms. 0 for constant
+ *  @param noise_mg maximum amplitude of uniform noise, mg
+ */
+void sim_lis2dh12_set_waveform(int32_t amplitude_mg, uint32_t period_ms, int32_t noise_mg);
+
+/** Number of samples produced by virtual sensor **/
+uint64_t sim_lis2dh12_samples(void);
+
+/** Number of samples lost to FIFO overrun **/
+uint64_t sim_lis2dh12_overruns(void);
+
+/** Number of INT1 watermark interrupts **/
+uint64_t sim_lis2dh12_interrupts(void);
+
+/**
+ *  Tap on Z axis lasting duration_ms. Sensor latches a single click if a sample falls on the tap,
+ *  single click on Z is enabled and the tap is over within TIME_LIMIT samples.
+ */
+void sim_lis2dh12_tap(uint32_t duration_ms);
+
+/** Movement over activity threshold, INT2 of activity function for one sample **/
+void sim_lis2dh12_activity(void);
+
+/** Taps read from CLICK_SRC by the tag **/
+uint64_t sim_lis2dh12_taps(void);
+
+/** Pin 2 interrupts the tag took as activity, i.e. RAWv2 movement counter **/
+uint64_t sim_lis2dh12_activity_events(void);
+
+/** Register of event model, 0 for registers which are not modelled **/
+uint8_t sim_lis2dh12_register(uint8_t address);
+
+#endif
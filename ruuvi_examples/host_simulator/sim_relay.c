@@ -0,0 +1,299 @@
+#include "sim_relay.h"
+#include "ble_relay.h"
+#include "ble_gap.h"
+#include "advertising_scheduler.h"
+#include "app_timer.h"
+#include "bluetooth_config.h"
+#include "init.h"
+#include <string.h>
+
+#define SIM_RELAY_ADV_DELAY_MS  10   // Random delay added to every advertising interval
+#define SIM_RELAY_FLAGS_LENGTH  3    // Flags AD structure before manufacturer data
+#define SIM_RELAY_SLOT_S        300  // Gateway resolution, a slot is delivered if it has a fresh measurement
+
+typedef struct {
+  uint16_t       sequence;        // Measurement sequence of next advertisement
+  uint64_t       sent;            // Advertisements, one measurement each
+  uint16_t       delivered_sequence;
+  bool           delivered_once;
+  uint64_t       delivered;       // Distinct measurements received by gateway
+  uint64_t       fresh_ticks;     // Time gateway last received a new measurement
+  uint64_t       max_gap_ticks;   // Longest time without a new measurement at gateway
+  uint64_t       slot;            // Last slot with a fresh measurement
+  uint64_t       slots;           // Slots with a fresh measurement
+  app_timer_t    timer_data;
+  app_timer_id_t timer;
+}neighbour_t;
+
+typedef struct {
+  uint64_t sent;
+  uint64_t delivered;
+  uint64_t slots;
+  uint64_t frames;
+  uint64_t frames_lost;
+  ble_relay_statistics_t relay;
+}relay_counters_t;
+
+static neighbour_t      m_neighbours[SIM_RELAY_MAX_NEIGHBOURS];
+static uint8_t          m_neighbour_count = 0;
+static uint32_t         m_neighbour_interval_ms = 0;
+static uint8_t          m_neighbour_loss  = 0;
+static uint8_t          m_neighbour_hops  = 0;
+static uint8_t          m_gateway_loss    = 0;
+static bool             m_scanning        = false;
+static bool             m_used            = false;
+static uint32_t         m_seed            = 7;
+
+// Relay frame as advertising scheduler of the relay tag would have it
+static uint8_t          m_frame_data[BLE_GAP_ADV_MAX_SIZE];
+static uint8_t          m_frame_length    = 0;
+static uint16_t         m_frame_period    = 0;
+static uint16_t         m_frame_countdown = 0;
+static uint32_t         m_frame_events    = 0;
+static uint64_t         m_frames          = 0;
+static uint64_t         m_frames_lost     = 0;
+
+static relay_counters_t m_reported;
+static uint64_t         m_reported_ticks  = 0;
+
+APP_TIMER_DEF(m_gateway_timer);
+
+static uint32_t random_next(void)
+{
+  m_seed = m_seed * 1103515245 + 12345;
+  return m_seed >> 16;
+}
+
+static bool lost(uint8_t loss)
+{
+  return loss && (random_next() % 100) < loss;
+}
+
+static uint32_t neighbour_delay_ticks(void)
+{
+  uint32_t ms = m_neighbour_interval_ms + random_next() % (SIM_RELAY_ADV_DELAY_MS + 1);
+  return APP_TIMER_TICKS(ms, RUUVITAG_APP_TIMER_PRESCALER);
+}
+
+/** MAC of neighbour in RAWv2 byte order, random static address **/
+static void neighbour_mac(uint8_t index, uint8_t* mac)
+{
+  static const uint8_t base[BLE_RELAY_MAC_LENGTH] = { 0xC5, 0x1A, 0x00, 0x00, 0x00, 0x00 };
+  memcpy(mac, base, sizeof(base));
+  mac[BLE_RELAY_MAC_LENGTH - 1] = index + 1;
+}
+
+/**
+ *  RAWv2 advertisement with flags, same layout as adv_scheduler_set_manufacturer_data on the tag.
+ *  With hops, relay frame of a relay further away from gateway instead.
+ */
+static uint8_t neighbour_advertisement(uint8_t index, uint8_t* data)
+{
+  neighbour_t* p_neighbour = &m_neighbours[index];
+  uint8_t offset = m_neighbour_hops ? 0 : SIM_RELAY_FLAGS_LENGTH;
+  uint8_t payload_length = m_neighbour_hops ? BLE_RELAY_FRAME_LENGTH : BLE_RELAY_RAWv2_LENGTH;
+  uint8_t* p_payload = &data[offset + 4];
+  data[0] = 2;
+  data[1] = 0x01; // Flags
+  data[2] = 0x06; // LE general discoverable, BR/EDR not supported
+  data[offset]     = 3 + payload_length;
+  data[offset + 1] = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+  data[offset + 2] = BLE_COMPANY_IDENTIFIER & 0xFF;
+  data[offset + 3] = BLE_COMPANY_IDENTIFIER >> 8;
+  memset(p_payload, 0, payload_length);
+  p_payload[0]  = 0x05;
+  p_payload[1]  = index;               // Temperature
+  p_payload[16] = p_neighbour->sequence >> 8;
+  p_payload[17] = p_neighbour->sequence & 0xFF;
+  neighbour_mac(index, &p_payload[18]);
+  if(m_neighbour_hops) { p_payload[BLE_RELAY_RAWv2_LENGTH] = m_neighbour_hops; }
+  return offset + 4 + payload_length;
+}
+
+static void neighbour_advertise(void* p_context)
+{
+  uint8_t index = (neighbour_t*)p_context - m_neighbours;
+  neighbour_t* p_neighbour = &m_neighbours[index];
+  uint8_t data[BLE_GAP_ADV_MAX_SIZE];
+  uint8_t length = neighbour_advertisement(index, data);
+  p_neighbour->sequence++;
+  p_neighbour->sent++;
+  if(m_scanning && !lost(m_neighbour_loss)) { ble_relay_on_adv_report(data, length); }
+  APP_ERROR_CHECK(app_timer_start(p_neighbour->timer, neighbour_delay_ticks(), p_neighbour));
+}
+
+/** Gateway reads RAWv2 from relay frame, hop count after it **/
+static void gateway_receive(void)
+{
+  if(m_frame_length != 4 + BLE_RELAY_FRAME_LENGTH) { return; }
+  const uint8_t* p_payload = &m_frame_data[4];
+  uint8_t mac[BLE_RELAY_MAC_LENGTH];
+  neighbour_mac(0, mac);
+  if(memcmp(&p_payload[18], mac, BLE_RELAY_MAC_LENGTH - 1)) { return; }
+  uint8_t index = p_payload[23] - 1;
+  if(index >= m_neighbour_count) { return; }
+  neighbour_t* p_neighbour = &m_neighbours[index];
+  uint16_t sequence = (p_payload[16] << 8) | p_payload[17];
+  if(p_neighbour->delivered_once && sequence == p_neighbour->delivered_sequence) { return; }
+  uint64_t now = app_timer_sim_now();
+  if(now - p_neighbour->fresh_ticks > p_neighbour->max_gap_ticks) { p_neighbour->max_gap_ticks = now - p_neighbour->fresh_ticks; }
+  p_neighbour->fresh_ticks        = now;
+  p_neighbour->delivered_sequence = sequence;
+  p_neighbour->delivered_once     = true;
+  p_neighbour->delivered++;
+  uint64_t slot = now / ((uint64_t)SIM_RELAY_SLOT_S * app_timer_sim_tick_rate()) + 1;
+  if(slot != p_neighbour->slot) { p_neighbour->slots++; }
+  p_neighbour->slot = slot;
+}
+
+/** Radio event of relay tag, rotation of advertising_scheduler for the relay frame **/
+static void gateway_event(void* p_context)
+{
+  if(!m_frame_period || !m_frame_length) { return; }
+  if(m_frame_countdown) { m_frame_countdown--; }
+  if(m_frame_countdown) { return; }
+  m_frame_countdown = m_frame_period;
+  m_frame_events++;
+  m_frames++;
+  if(lost(m_gateway_loss)) { m_frames_lost++; }
+  else { gateway_receive(); }
+}
+
+/** SoftDevice scanner, reports come from neighbour advertisements **/
+uint32_t sd_ble_gap_scan_start(ble_gap_scan_params_t const *p_scan_params)
+{
+  if(NULL == p_scan_params) { return NRF_ERROR_NULL; }
+  if(m_scanning) { return NRF_ERROR_INVALID_STATE; }
+  m_scanning = true;
+  return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_scan_stop(void)
+{
+  if(!m_scanning) { return NRF_ERROR_INVALID_STATE; }
+  m_scanning = false;
+  return NRF_SUCCESS;
+}
+
+/** Advertising scheduler of relay tag, only the relay frame is modelled **/
+ret_code_t adv_scheduler_frame_period_set(uint8_t frame, uint16_t period)
+{
+  if(SIM_RELAY_FRAME != frame) { return NRF_ERROR_INVALID_PARAM; }
+  m_frame_period    = period;
+  m_frame_countdown = period;
+  return NRF_SUCCESS;
+}
+
+/** Manufacturer data AD structure like adv_data_encode, relay frame has no flags **/
+ret_code_t adv_scheduler_frame_encode(uint8_t frame, const ble_advdata_t* advdata)
+{
+  if(SIM_RELAY_FRAME != frame) { return NRF_ERROR_INVALID_PARAM; }
+  if(NULL == advdata || NULL == advdata->p_manuf_specific_data) { return NRF_ERROR_NULL; }
+  const ble_advdata_manuf_data_t* p_manufacturer = advdata->p_manuf_specific_data;
+  uint8_t length = advdata->flags ? SIM_RELAY_FLAGS_LENGTH : 0;
+  if(length + 4 + p_manufacturer->data.size > BLE_GAP_ADV_MAX_SIZE) { return NRF_ERROR_DATA_SIZE; }
+  if(length) { return NRF_ERROR_NOT_SUPPORTED; }
+  m_frame_data[0] = 3 + p_manufacturer->data.size;
+  m_frame_data[1] = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+  m_frame_data[2] = p_manufacturer->company_identifier & 0xFF;
+  m_frame_data[3] = p_manufacturer->company_identifier >> 8;
+  memcpy(&m_frame_data[4], p_manufacturer->data.p_data, p_manufacturer->data.size);
+  m_frame_length = 4 + p_manufacturer->data.size;
+  return NRF_SUCCESS;
+}
+
+uint32_t adv_scheduler_frame_events(uint8_t frame)
+{
+  return (SIM_RELAY_FRAME == frame) ? m_frame_events : 0;
+}
+
+void sim_relay_init(void)
+{
+  uint8_t own_mac[BLE_RELAY_MAC_LENGTH] = { 0xC5, 0x1A, 0xFF, 0xFF, 0xFF, 0xFF };
+  for(uint8_t ii = 0; ii < SIM_RELAY_MAX_NEIGHBOURS; ii++)
+  {
+    neighbour_t* p_neighbour = &m_neighbours[ii];
+    p_neighbour->timer = &p_neighbour->timer_data;
+    APP_ERROR_CHECK(app_timer_create(&p_neighbour->timer, APP_TIMER_MODE_SINGLE_SHOT, neighbour_advertise));
+    app_timer_sim_irq_set(p_neighbour->timer, true);
+  }
+  APP_ERROR_CHECK(app_timer_create(&m_gateway_timer, APP_TIMER_MODE_REPEATED, gateway_event));
+  app_timer_sim_irq_set(m_gateway_timer, true);
+  APP_ERROR_CHECK(ble_relay_init(SIM_RELAY_FRAME, own_mac));
+}
+
+int sim_relay_neighbours(uint8_t count, uint32_t interval_ms, uint8_t loss_percent, uint8_t hops)
+{
+  if(count > SIM_RELAY_MAX_NEIGHBOURS || loss_percent > 100 || (count && interval_ms < 20)) { return -1; }
+  for(uint8_t ii = 0; ii < SIM_RELAY_MAX_NEIGHBOURS; ii++)
+  {
+    neighbour_t* p_neighbour = &m_neighbours[ii];
+    app_timer_stop(p_neighbour->timer);
+    if(ii >= count) { continue; }
+    p_neighbour->fresh_ticks = app_timer_sim_now();
+    // Neighbours start at random phases
+    APP_ERROR_CHECK(app_timer_start(p_neighbour->timer, 1 + random_next() % APP_TIMER_TICKS(interval_ms, RUUVITAG_APP_TIMER_PRESCALER),
+                                    p_neighbour));
+  }
+  m_neighbour_count       = count;
+  m_neighbour_interval_ms = interval_ms;
+  m_neighbour_loss        = loss_percent;
+  m_neighbour_hops        = hops;
+  m_used = true;
+  return 0;
+}
+
+void sim_relay_gateway(uint32_t interval_ms, uint8_t loss_percent)
+{
+  m_gateway_loss = loss_percent;
+  app_timer_stop(m_gateway_timer);
+  APP_ERROR_CHECK(app_timer_start(m_gateway_timer, APP_TIMER_TICKS(interval_ms, RUUVITAG_APP_TIMER_PRESCALER), NULL));
+  m_used = true;
+}
+
+void sim_relay_report(FILE* out)
+{
+  if(!m_used) { return; }
+  relay_counters_t now = { .frames = m_frames, .frames_lost = m_frames_lost };
+  uint64_t max_gap_ticks = 0;
+  for(uint8_t ii = 0; ii < m_neighbour_count; ii++)
+  {
+    neighbour_t* p_neighbour = &m_neighbours[ii];
+    now.sent      += p_neighbour->sent;
+    now.delivered += p_neighbour->delivered;
+    now.slots     += p_neighbour->slots;
+    // Gap still open counts too, neighbour may not have been delivered at all
+    uint64_t open_ticks = app_timer_sim_now() - p_neighbour->fresh_ticks;
+    max_gap_ticks = MAX(max_gap_ticks, MAX(open_ticks, p_neighbour->max_gap_ticks));
+    p_neighbour->max_gap_ticks = 0;
+  }
+  ble_relay_statistics_get(&now.relay);
+
+  uint64_t elapsed_ms = (app_timer_sim_now() - m_reported_ticks) * 1000 / app_timer_sim_tick_rate();
+  uint64_t sent       = now.sent - m_reported.sent;
+  uint64_t delivered  = now.delivered - m_reported.delivered;
+  uint64_t slots      = now.slots - m_reported.slots;
+  uint64_t slots_all  = elapsed_ms / (SIM_RELAY_SLOT_S * 1000) * m_neighbour_count;
+  uint32_t scan_ms    = now.relay.scan_ms - m_reported.relay.scan_ms;
+  double duty = elapsed_ms ? (double)scan_ms / elapsed_ms : 0;
+  ble_relay_config_t config;
+  ble_relay_config_get(&config);
+  fprintf(out, "Relay: window %u ms every %u s, budget %u permille, %u windows, %u skipped, scan duty %.2f %%, added current %.1f uA\n",
+          config.scan_window_ms, config.scan_period_s, config.budget_permille,
+          (unsigned)(now.relay.windows - m_reported.relay.windows), (unsigned)(now.relay.skipped - m_reported.relay.skipped),
+          100.0 * duty, duty * SIM_RELAY_SCAN_CURRENT_UA);
+  fprintf(out, "Relay: %u reports, %u accepted, %u duplicates, %u hop limited, %u forwarded, %llu frames to gateway, %llu lost\n",
+          (unsigned)(now.relay.reports - m_reported.relay.reports), (unsigned)(now.relay.accepted - m_reported.relay.accepted),
+          (unsigned)(now.relay.duplicates - m_reported.relay.duplicates),
+          (unsigned)(now.relay.hop_limited - m_reported.relay.hop_limited),
+          (unsigned)(now.relay.forwarded - m_reported.relay.forwarded),
+          (unsigned long long)(now.frames - m_reported.frames), (unsigned long long)(now.frames_lost - m_reported.frames_lost));
+  fprintf(out, "Gateway: %llu of %llu measurements of %u neighbours delivered, ratio %.2f %%, longest gap %.1f s\n",
+          (unsigned long long)delivered, (unsigned long long)sent, m_neighbour_count,
+          sent ? 100.0 * delivered / sent : 0.0, (double)max_gap_ticks / app_timer_sim_tick_rate());
+  fprintf(out, "Gateway: %llu of %llu %u s slots with a fresh measurement, ratio %.1f %%\n",
+          (unsigned long long)slots, (unsigned long long)slots_all, SIM_RELAY_SLOT_S,
+          slots_all ? 100.0 * slots / slots_all : 0.0);
+  m_reported       = now;
+  m_reported_ticks = app_timer_sim_now();
+}
@@ -0,0 +1,53 @@
+#ifndef SIM_RELAY_H
+#define SIM_RELAY_H
+
+/**
+ *  Virtual neighbours and gateway around ble_relay for host simulator.
+ *
+ *  Stands in for the SoftDevice scanner and for advertising_scheduler below ble_relay.
+ *  Neighbour tags are out of gateway range and advertise RAWv2 with a new measurement sequence in
+ *  every advertisement, interval plus 0 ... 10 ms random delay like advertisements on air.
+ *  An advertisement reaches the relay if the relay is scanning and the packet is not lost, and is
+ *  given to ble_relay_on_adv_report in BLE event context like on_ble_evt does on the tag.
+ *
+ *  Relay tag advertises at its own interval and relay frame takes the events a scheduler frame
+ *  with the period set by ble_relay would get. Gateway hears each of them unless the packet is lost,
+ *  and counts the distinct measurements of each neighbour, the SIM_RELAY_SLOT_S slots of gateway time
+ *  with a fresh measurement and the longest time without one.
+ *  Added current is scan time of ble_relay_statistics_get at SIM_RELAY_SCAN_CURRENT_UA, relay frames
+ *  take turns with own frames and add no radio events.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SIM_RELAY_MAX_NEIGHBOURS   8
+#define SIM_RELAY_FRAME            4     // Same frame as ruuvi_firmware
+#define SIM_RELAY_SCAN_CURRENT_UA  5400  // nRF52832 radio RX with DC/DC, 1 Mbps
+
+/** Create timers and initialize ble_relay with frame SIM_RELAY_FRAME **/
+void sim_relay_init(void);
+
+/**
+ *  Start neighbours advertising RAWv2, replaces previous neighbours.
+ *
+ *  @param count number of neighbours, 0 ... SIM_RELAY_MAX_NEIGHBOURS
+ *  @param interval_ms advertising interval of neighbours
+ *  @param loss_percent advertisements lost between neighbour and relay
+ *  @param hops 0 for RAWv2 of neighbours, N for relay frames with hop count N from relays further away
+ *  @return 0 on success, -1 on invalid parameters
+ */
+int sim_relay_neighbours(uint8_t count, uint32_t interval_ms, uint8_t loss_percent, uint8_t hops);
+
+/**
+ *  Start advertising of relay tag towards gateway.
+ *
+ *  @param interval_ms advertising interval of relay tag
+ *  @param loss_percent advertisements lost between relay and gateway
+ */
+void sim_relay_gateway(uint32_t interval_ms, uint8_t loss_percent);
+
+/** Print delivery and added current since previous report, nothing if relay is not in use **/
+void sim_relay_report(FILE* out);
+
+#endif
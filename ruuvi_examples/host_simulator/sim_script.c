@@ -0,0 +1,332 @@
+#include "sim_script.h"
+#include "sim_lis2dh12.h"
+#include "sim_link.h"
+#include "sim_bulk.h"
+#include "sim_relay.h"
+#include "sim_environmental.h"
+#include "sim_spi.h"
+#include "ble_relay.h"
+#include "ble_bulk_transfer.h"
+#include "ruuvi_endpoints.h"
+#include "lis2dh12.h"
+#include "lis2dh12_event_handler.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "init.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Parse standard message of 11 hex bytes **/
+static int parse_message(char* args, uint8_t* data)
+{
+  char* p_next = args;
+  for(size_t ii = 0; ii < sizeof(ruuvi_standard_message_t); ii++)
+  {
+    char* p_end;
+    unsigned long value = strtoul(p_next, &p_end, 16);
+    if(p_end == p_next || value > 0xFF) { return -1; }
+    data[ii] = (uint8_t)value;
+    p_next = p_end;
+  }
+  return 0;
+}
+
+/** Same path as NUS data handler on the tag: schedule message to router **/
+static int command_write(uint8_t central, char* args)
+{
+  uint8_t data[sizeof(ruuvi_standard_message_t)];
+  if(parse_message(args, data)) { return -1; }
+  if(sim_link_write(central, data, sizeof(data))) { return -1; }
+  app_sched_execute();
+  return 0;
+}
+
+static int command_send(char* args)
+{
+  return command_write(0, args);
+}
+
+/** Standard message written by given central **/
+static int command_central_write(char* args)
+{
+  unsigned int central;
+  int consumed = 0;
+  if(1 != sscanf(args, "%u %n", &central, &consumed) || central >= SIM_LINK_CENTRALS) { return -1; }
+  return command_write(central, args + consumed);
+}
+
+static int command_wave(char* args)
+{
+  long amplitude, period, noise;
+  if(3 != sscanf(args, "%ld %ld %ld", &amplitude, &period, &noise)) { return -1; }
+  if(period < 0 || noise < 0) { return -1; }
+  sim_lis2dh12_set_waveform(amplitude, period, noise);
+  return 0;
+}
+
+static int command_link(char* args)
+{
+  unsigned int mtu, interval, buffers, packets, central = 0;
+  if(4 > sscanf(args, "%u %u %u %u %u", &mtu, &interval, &buffers, &packets, &central)) { return -1; }
+  if(interval < 8 || !buffers || buffers > SIM_LINK_MAX_BUFFERS || !packets || packets > 255) { return -1; }
+  if(central >= SIM_LINK_CENTRALS) { return -1; }
+  sim_link_connect(central, mtu, interval, buffers, packets);
+  return 0;
+}
+
+static int command_disconnect(char* args)
+{
+  unsigned int central = 0;
+  if(sscanf(args, "%u", &central) > 0 && central >= SIM_LINK_CENTRALS) { return -1; }
+  sim_link_disconnect(central);
+  return 0;
+}
+
+static int command_packing(char* args)
+{
+  unsigned int packing;
+  if(1 != sscanf(args, "%u", &packing) || packing > 1) { return -1; }
+  ble_std_set_packing(packing);
+  return 0;
+}
+
+static int command_bulk(char* args)
+{
+  unsigned int endpoint;
+  unsigned long length;
+  if(2 != sscanf(args, "%x %lu", &endpoint, &length) || endpoint > 0xFF) { return -1; }
+  return sim_bulk_send(endpoint, length) ? -1 : 0;
+}
+
+static int command_upload(char* args)
+{
+  unsigned int endpoint;
+  unsigned long length;
+  if(2 != sscanf(args, "%x %lu", &endpoint, &length) || endpoint > 0xFF) { return -1; }
+  return sim_bulk_upload(endpoint, length) ? -1 : 0;
+}
+
+static int command_frame(char* args)
+{
+  ruuvi_standard_message_t message;
+  if(parse_message(args, (uint8_t*)&message)) { return -1; }
+  return sim_bulk_frame_append(&message);
+}
+
+static int command_upload_frame(char* args)
+{
+  return sim_bulk_upload_frame();
+}
+
+static int command_loss(char* args)
+{
+  unsigned int percent;
+  if(1 != sscanf(args, "%u", &percent) || percent > 100) { return -1; }
+  sim_bulk_set_loss(percent);
+  return 0;
+}
+
+static int command_ack(char* args)
+{
+  unsigned int ack;
+  if(1 != sscanf(args, "%u", &ack) || ack > 1) { return -1; }
+  ble_bulk_set_acknowledged(ack);
+  return 0;
+}
+
+/** Configure and enable relay directly, a central connected to configure it would stop the scanning **/
+static int command_relay(char* args)
+{
+  unsigned int window_ms, period_s, budget, hops = 0;
+  if(3 > sscanf(args, "%u %u %u %u", &window_ms, &period_s, &budget, &hops)) { return -1; }
+  if(window_ms > UINT16_MAX || period_s > UINT16_MAX || budget > UINT16_MAX || hops > UINT8_MAX) { return -1; }
+  ble_relay_config_t config;
+  ble_relay_config_get(&config);
+  config.scan_window_ms  = window_ms;
+  config.scan_period_s   = period_s;
+  config.budget_permille = budget;
+  if(hops) { config.max_hops = hops; }
+  if(ble_relay_configure(&config)) { return -1; }
+  return ble_relay_enable(0 != budget) ? -1 : 0;
+}
+
+static int command_neighbours(char* args)
+{
+  unsigned int count, interval_ms, loss, hops = 0;
+  if(3 > sscanf(args, "%u %u %u %u", &count, &interval_ms, &loss, &hops) || hops > UINT8_MAX) { return -1; }
+  return sim_relay_neighbours(count, interval_ms, loss, hops);
+}
+
+/**
+ *  Duty cycle of ruuvi_firmware asks for idle or active accelerometer. Same as accelerometer_state_allowed()
+ *  and accelerometer_configure() of ruuvi_firmware, at LIS2DH12_SAMPLERATE_IDLE and LIS2DH12_SAMPLERATE_ACTIVE.
+ */
+static int command_accelerometer(char* args)
+{
+  char state[8];
+  if(1 != sscanf(args, "%7s", state)) { return -1; }
+  if(strcmp(state, "idle") && strcmp(state, "active")) { return -1; }
+  bool idle = (0 == strcmp(state, "idle")) && !lis2dh12_event_active_rate_required();
+  lis2dh12_begin_configuration();
+  if(idle)
+  {
+    lis2dh12_set_interrupts(LIS2DH12_NO_INTERRUPTS, 1);
+    lis2dh12_set_fifo_mode(LIS2DH12_MODE_BYPASS);
+    lis2dh12_set_resolution(LIS2DH12_RES8BIT);
+    lis2dh12_set_sample_rate(LIS2DH12_RATE_1);
+  }
+  else
+  {
+    lis2dh12_set_resolution(LIS2DH12_RES10BIT);
+    lis2dh12_set_sample_rate(LIS2DH12_RATE_50);
+    lis2dh12_set_fifo_mode(LIS2DH12_MODE_STREAM);
+    lis2dh12_set_interrupts(LIS2DH12_I1_WTM, 1);
+  }
+  lis2dh12_commit_configuration();
+  lis2dh12_event_reconfigure();
+  app_sched_execute();
+  return 0;
+}
+
+static int command_tap(char* args)
+{
+  unsigned int duration_ms;
+  if(1 != sscanf(args, "%u", &duration_ms)) { return -1; }
+  sim_lis2dh12_tap(duration_ms);
+  app_sched_execute();
+  return 0;
+}
+
+static int command_activity(char* args)
+{
+  sim_lis2dh12_activity();
+  app_sched_execute();
+  return 0;
+}
+
+/** Fail the script if taps read or activity counted by the tag differ from expected **/
+static int command_expect_events(char* args)
+{
+  unsigned long long taps, activity;
+  if(2 != sscanf(args, "%llu %llu", &taps, &activity)) { return -1; }
+  if(taps == sim_lis2dh12_taps() && activity == sim_lis2dh12_activity_events()) { return 0; }
+  fprintf(stderr, "expected %llu taps and %llu activity, got %llu and %llu\n", taps, activity,
+          (unsigned long long)sim_lis2dh12_taps(), (unsigned long long)sim_lis2dh12_activity_events());
+  return -1;
+}
+
+/** Fail the script if central did not get given number of messages since its previous expect_messages **/
+static int command_expect_messages(char* args)
+{
+  static uint64_t checked[SIM_LINK_CENTRALS];
+  unsigned int central;
+  unsigned long long messages;
+  if(2 != sscanf(args, "%u %llu", &central, &messages) || central >= SIM_LINK_CENTRALS) { return -1; }
+  sim_link_stats_t stats;
+  sim_link_stats_get(central, &stats);
+  uint64_t received = stats.messages - checked[central];
+  checked[central] = stats.messages;
+  if(messages == received) { return 0; }
+  fprintf(stderr, "expected %llu messages to central %u, got %llu\n", messages, central, (unsigned long long)received);
+  return -1;
+}
+
+static int command_advertise(char* args)
+{
+  unsigned int interval_ms;
+  char mode[8];
+  if(2 != sscanf(args, "%u %7s", &interval_ms, mode)) { return -1; }
+  if(strcmp(mode, "forced") && strcmp(mode, "normal")) { return -1; }
+  sim_environmental_start(interval_ms, 0 == strcmp(mode, "forced"));
+  app_sched_execute();
+  return 0;
+}
+
+static int command_environment(char* args)
+{
+  unsigned long adc_p, adc_t, adc_h;
+  if(3 != sscanf(args, "%lu %lu %lu", &adc_p, &adc_t, &adc_h)) { return -1; }
+  if(adc_p > 0xFFFFF || adc_t > 0xFFFFF || adc_h > 0xFFFF) { return -1; }
+  sim_spi_bme280_set_input(adc_p, adc_t, adc_h);
+  return 0;
+}
+
+/** Fail the script unless advertisements since previous expect_advertised had given pressure and humidity **/
+static int command_expect_advertised(char* args)
+{
+  unsigned long samples, pressure, humidity;
+  if(3 != sscanf(args, "%lu %lu %lu", &samples, &pressure, &humidity)) { return -1; }
+  sim_environmental_stats_t stats;
+  sim_environmental_stats_get(&stats);
+  if(samples == stats.samples && pressure == stats.pressure_min && pressure == stats.pressure_max
+     && humidity == stats.humidity_min && humidity == stats.humidity_max) { return 0; }
+  fprintf(stderr, "expected %lu advertisements of %lu Pa and %lu %%RH, got %u of %u ... %u Pa and %u ... %u %%RH\n",
+          samples, pressure, humidity, (unsigned)stats.samples, (unsigned)stats.pressure_min,
+          (unsigned)stats.pressure_max, (unsigned)stats.humidity_min, (unsigned)stats.humidity_max);
+  return -1;
+}
+
+static int command_gateway(char* args)
+{
+  unsigned int interval_ms, loss;
+  if(2 != sscanf(args, "%u %u", &interval_ms, &loss) || interval_ms < 20 || loss > 100) { return -1; }
+  sim_relay_gateway(interval_ms, loss);
+  return 0;
+}
+
+int sim_script_run(FILE* script)
+{
+  char line[256];
+  int line_number = 0;
+  uint32_t tick_rate = app_timer_sim_tick_rate();
+  while(fgets(line, sizeof(line), script))
+  {
+    line_number++;
+    char* p_line = line + strspn(line, " \t");
+    if('#' == *p_line || '\n' == *p_line || '\0' == *p_line) { continue; }
+
+    unsigned long long time_ms;
+    char command[24];
+    int consumed = 0;
+    if(2 != sscanf(p_line, "%llu %23s %n", &time_ms, command, &consumed)) { return line_number; }
+
+    uint64_t target = time_ms * tick_rate / 1000;
+    if(target < app_timer_sim_now()) { return line_number; }
+    app_timer_sim_advance(target - app_timer_sim_now());
+
+    char* args = p_line + consumed;
+    int status = 0;
+    if(0 == strcmp(command, "send"))      { status = command_send(args); }
+    else if(0 == strcmp(command, "wave")) { status = command_wave(args); }
+    else if(0 == strcmp(command, "link")) { status = command_link(args); }
+    else if(0 == strcmp(command, "disconnect")) { status = command_disconnect(args); }
+    else if(0 == strcmp(command, "write"))      { status = command_central_write(args); }
+    else if(0 == strcmp(command, "packing"))    { status = command_packing(args); }
+    else if(0 == strcmp(command, "stats"))
+    {
+      sim_link_report(stdout);
+      sim_relay_report(stdout);
+    }
+    else if(0 == strcmp(command, "bulk"))       { status = command_bulk(args); }
+    else if(0 == strcmp(command, "upload"))     { status = command_upload(args); }
+    else if(0 == strcmp(command, "frame"))      { status = command_frame(args); }
+    else if(0 == strcmp(command, "upload_frame")) { status = command_upload_frame(args); }
+    else if(0 == strcmp(command, "loss"))       { status = command_loss(args); }
+    else if(0 == strcmp(command, "ack"))        { status = command_ack(args); }
+    else if(0 == strcmp(command, "relay"))      { status = command_relay(args); }
+    else if(0 == strcmp(command, "neighbours")) { status = command_neighbours(args); }
+    else if(0 == strcmp(command, "gateway"))    { status = command_gateway(args); }
+    else if(0 == strcmp(command, "accelerometer")) { status = command_accelerometer(args); }
+    else if(0 == strcmp(command, "tap"))        { status = command_tap(args); }
+    else if(0 == strcmp(command, "activity"))   { status = command_activity(args); }
+    else if(0 == strcmp(command, "expect_events")) { status = command_expect_events(args); }
+    else if(0 == strcmp(command, "expect_messages")) { status = command_expect_messages(args); }
+    else if(0 == strcmp(command, "advertise"))   { status = command_advertise(args); }
+    else if(0 == strcmp(command, "environment")) { status = command_environment(args); }
+    else if(0 == strcmp(command, "expect_advertised")) { status = command_expect_advertised(args); }
+    else if(0 == strcmp(command, "end"))  { return 0; }
+    else { status = -1; }
+    if(status) { return line_number; }
+  }
+  return 0;
+}
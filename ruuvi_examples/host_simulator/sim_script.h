@@ -0,0 +1,24 @@
+#ifndef SIM_SCRIPT_H
+#define SIM_SCRIPT_H
+
+/**
+ *  Scripted scenarios for host simulator.
+ *
+ *  One command per line, "<time_ms> <command> [arguments]". Lines starting with '#' are comments.
+ *  Virtual clock is advanced to given time before the command is run, times must not decrease.
+ *
+ *  Commands:
+ *    send <11 hex bytes>               Deliver a standard message as if written to NUS RX
+ *    wave <amplitude_mg> <period_ms> <noise_mg>  Set accelerometer waveform
+ *    end                               Advance clock to given time and stop
+ */
+
+#include <stdio.h>
+
+/**
+ *  Run script from file.
+ *  @return 0 on success, line number of first invalid line otherwise
+ */
+int sim_script_run(FILE* script);
+
+#endif
@@ -0,0 +1,307 @@
+#include "sim_spi.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "lis2dh12_registers.h"
+#include "bme280.h"
+
+#define LIS2DH12_REGISTERS   0x40
+#define LIS2DH12_READ        0x80
+#define LIS2DH12_ADR_INC     0x40
+#define LIS2DH12_FIFO_LENGTH 32
+#define BME280_READ          0x80
+
+static uint8_t m_lis2dh12[LIS2DH12_REGISTERS];
+static uint8_t m_fifo[LIS2DH12_FIFO_LENGTH][6];
+static size_t  m_fifo_head  = 0;
+static size_t  m_fifo_count = 0;
+static bool    m_overrun    = false;  // OVRN_FIFO, cleared by reading a sample
+
+// BME280 registers 0x80 ... 0xFF
+static uint8_t m_bme280[0x80];
+// BME280 ADC values which a conversion writes to data registers
+static uint32_t m_adc_p = 0;
+static uint32_t m_adc_t = 0;
+static uint16_t m_adc_h = 0;
+
+static bool m_initialized = false;
+static sim_spi_statistics_t m_statistics;
+
+static bool fifo_enabled(void)
+{
+  return m_lis2dh12[LIS2DH12_CTRL_REG5] & LIS2DH12_FIFO_EN_MASK;
+}
+
+static uint8_t fifo_mode(void)
+{
+  return m_lis2dh12[LIS2DH12_FIFO_CTRL_REG] & LIS2DH12_FM_MASK;
+}
+
+static uint8_t lis2dh12_read(uint8_t address)
+{
+  if(LIS2DH12_FIFO_SRC_REG == address)
+  {
+    size_t watermark = m_lis2dh12[LIS2DH12_FIFO_CTRL_REG] & LIS2DH12_FTH_MASK;
+    uint8_t value = (m_fifo_count >= LIS2DH12_FIFO_LENGTH) ? LIS2DH12_FSS_MASK : m_fifo_count;
+    if(m_overrun || LIS2DH12_FIFO_LENGTH == m_fifo_count) { value |= LIS2DH12_OVRN_FIFO_MASK; }
+    if(watermark && m_fifo_count >= watermark) { value |= 0x80; }
+    if(0 == m_fifo_count) { value |= 0x20; }
+    return value;
+  }
+  if(address >= LIS2DH12_OUT_X_L && address <= LIS2DH12_OUT_Z_H)
+  {
+    // Latest sample stays in output registers while FIFO is bypassed
+    if(!fifo_enabled() || 0 == m_fifo_count) { return m_fifo[m_fifo_head][address - LIS2DH12_OUT_X_L]; }
+    uint8_t value = m_fifo[m_fifo_head][address - LIS2DH12_OUT_X_L];
+    if(LIS2DH12_OUT_Z_H == address)
+    {
+      m_fifo_head = (m_fifo_head + 1) % LIS2DH12_FIFO_LENGTH;
+      m_fifo_count--;
+      m_overrun = false;
+    }
+    return value;
+  }
+  return m_lis2dh12[address % LIS2DH12_REGISTERS];
+}
+
+static void lis2dh12_write(uint8_t address, uint8_t value)
+{
+  if(LIS2DH12_WHO_AM_I == address || LIS2DH12_FIFO_SRC_REG == address) { return; }
+  m_lis2dh12[address % LIS2DH12_REGISTERS] = value;
+  // Bypass mode empties FIFO
+  if(LIS2DH12_FIFO_CTRL_REG == address && 0 == fifo_mode())
+  {
+    m_fifo_count = 0;
+    m_overrun    = false;
+  }
+}
+
+static uint8_t lis2dh12_next_address(uint8_t address)
+{
+  // Output registers wrap to OUT_X_L in FIFO mode, one burst reads several samples
+  if(LIS2DH12_OUT_Z_H == address && fifo_enabled()) { return LIS2DH12_OUT_X_L; }
+  return (address + 1) % LIS2DH12_REGISTERS;
+}
+
+/** Decode one chip select period of LIS2DH12, rx may be NULL **/
+static void lis2dh12_transfer(uint8_t command, const uint8_t* tx, uint8_t* rx, size_t count)
+{
+  uint8_t address = command & (LIS2DH12_REGISTERS - 1);
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    if(command & LIS2DH12_READ)
+    {
+      uint8_t value = lis2dh12_read(address);
+      if(rx) { rx[ii] = value; }
+    }
+    else
+    {
+      lis2dh12_write(address, tx ? tx[ii] : 0xFF);
+    }
+    if(command & LIS2DH12_ADR_INC) { address = lis2dh12_next_address(address); }
+  }
+  m_statistics.transfers++;
+  m_statistics.bytes += count + 1;
+}
+
+static void bme280_set_data(uint32_t adc_p, uint32_t adc_t, uint16_t adc_h)
+{
+  m_bme280[BME280REG_PRESS_MSB  & 0x7F] = adc_p >> 12;
+  m_bme280[BME280REG_PRESS_LSB  & 0x7F] = adc_p >> 4;
+  m_bme280[BME280REG_PRESS_XLSB & 0x7F] = (adc_p & 0x0F) << 4;
+  m_bme280[BME280REG_TEMP_MSB   & 0x7F] = adc_t >> 12;
+  m_bme280[BME280REG_TEMP_LSB   & 0x7F] = adc_t >> 4;
+  m_bme280[BME280REG_TEMP_XLSB  & 0x7F] = (adc_t & 0x0F) << 4;
+  m_bme280[BME280REG_HUM_MSB    & 0x7F] = adc_h >> 8;
+  m_bme280[BME280REG_HUM_LSB    & 0x7F] = adc_h & 0xFF;
+}
+
+/**
+ *  Forced or normal mode written to CTRL_MEAS converts at once, normal mode converts again before each read.
+ *  Skipped measurements read 0x80000, or 0x8000 for humidity, like on the sensor.
+ *  Humidity oversampling of CTRL_HUM applies from the write of CTRL_MEAS.
+ */
+static void bme280_convert(void)
+{
+  uint8_t ctrl_meas = m_bme280[BME280REG_CTRL_MEAS & 0x7F];
+  if(!(ctrl_meas & 0x03)) { return; }
+  bool temperature = ctrl_meas & 0xE0;
+  bool pressure    = ctrl_meas & 0x1C;
+  bool humidity    = m_bme280[BME280REG_CTRL_HUM & 0x7F] & 0x07;
+  bme280_set_data(pressure ? m_adc_p : 0x80000, temperature ? m_adc_t : 0x80000, humidity ? m_adc_h : 0x8000);
+}
+
+/** Decode one chip select period of BME280. Reads auto-increment, writes are register and data pairs. **/
+static void bme280_transfer(uint8_t command, const uint8_t* tx, uint8_t* rx, size_t count)
+{
+  uint8_t address = command | BME280_READ;
+  if((command & BME280_READ) && BME280_MODE_NORMAL == (m_bme280[BME280REG_CTRL_MEAS & 0x7F] & 0x03)) { bme280_convert(); }
+  for(size_t ii = 0; ii < count; ii++)
+  {
+    if(command & BME280_READ)
+    {
+      if(rx) { rx[ii] = m_bme280[address & 0x7F]; }
+      address = (address == 0xFF) ? 0xFF : address + 1;
+    }
+    else if(0 == ii % 2 && tx)
+    {
+      uint8_t value = tx[ii];
+      if(BME280REG_ID != address && BME280REG_STATUS != address && address >= BME280REG_CTRL_HUM)
+      {
+        m_bme280[address & 0x7F] = value;
+      }
+      if(BME280REG_CTRL_MEAS == address) { bme280_convert(); }
+      if(ii + 1 < count) { address = tx[ii + 1] | BME280_READ; }
+    }
+  }
+  m_statistics.transfers++;
+  m_statistics.bytes += count + 1;
+}
+
+static void bme280_set16(uint8_t address, uint16_t value)
+{
+  m_bme280[address & 0x7F]       = value & 0xFF;
+  m_bme280[(address + 1) & 0x7F] = value >> 8;
+}
+
+void sim_spi_init(void)
+{
+  memset(m_lis2dh12, 0, sizeof(m_lis2dh12));
+  memset(m_fifo, 0, sizeof(m_fifo));
+  m_lis2dh12[LIS2DH12_WHO_AM_I] = LIS2DH12_I_AM_MASK;
+  m_lis2dh12[LIS2DH12_CTRL_REG1] = 0x07;
+  m_fifo_head = m_fifo_count = 0;
+  m_overrun = false;
+
+  // Calibration of the compensation example in BME280 datasheet, humidity of a typical sensor
+  memset(m_bme280, 0, sizeof(m_bme280));
+  const uint16_t calibration[] = { 27504, 26435, (uint16_t)-1000, 36477, (uint16_t)-10685, 3024, 2855, 140,
+                                   (uint16_t)-7, 15500, (uint16_t)-14600, 6000 };
+  for(size_t ii = 0; ii < sizeof(calibration) / sizeof(calibration[0]); ii++)
+  {
+    bme280_set16(BME280REG_CALIB_00 + 2 * ii, calibration[ii]);
+  }
+  const int16_t h4 = 309, h5 = 50;
+  m_bme280[0xA1 & 0x7F] = 75;
+  bme280_set16(BME280REG_CALIB_26, 370);
+  m_bme280[0xE3 & 0x7F] = 0;
+  m_bme280[0xE4 & 0x7F] = h4 >> 4;
+  m_bme280[0xE5 & 0x7F] = (h4 & 0x0F) | ((h5 & 0x0F) << 4);
+  m_bme280[0xE6 & 0x7F] = h5 >> 4;
+  m_bme280[0xE7 & 0x7F] = 30;
+  m_bme280[BME280REG_ID & 0x7F] = BME280_ID_VALUE;
+  sim_spi_bme280_set_adc(415148, 519888, 30000);
+
+  memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+void sim_spi_lis2dh12_push(const int16_t raw[3])
+{
+  size_t tail = (m_fifo_head + m_fifo_count) % LIS2DH12_FIFO_LENGTH;
+  if(!fifo_enabled())
+  {
+    tail = m_fifo_head;
+  }
+  else if(LIS2DH12_FIFO_LENGTH == m_fifo_count)
+  {
+    // FIFO mode stops when full, stream mode drops the oldest sample
+    m_overrun = true;
+    if(LIS2DH12_FM_FIFO == fifo_mode()) { return; }
+    m_fifo_head = (m_fifo_head + 1) % LIS2DH12_FIFO_LENGTH;
+    m_fifo_count--;
+  }
+  for(size_t ii = 0; ii < 3; ii++)
+  {
+    m_fifo[tail][2 * ii]     = (uint16_t)raw[ii] & 0xFF;
+    m_fifo[tail][2 * ii + 1] = (uint16_t)raw[ii] >> 8;
+  }
+  if(fifo_enabled()) { m_fifo_count++; }
+}
+
+uint8_t sim_spi_lis2dh12_register(uint8_t address)
+{
+  return m_lis2dh12[address % LIS2DH12_REGISTERS];
+}
+
+void sim_spi_bme280_set_adc(uint32_t adc_p, uint32_t adc_t, uint16_t adc_h)
+{
+  m_adc_p = adc_p;
+  m_adc_t = adc_t;
+  m_adc_h = adc_h;
+  bme280_set_data(adc_p, adc_t, adc_h);
+}
+
+void sim_spi_bme280_set_input(uint32_t adc_p, uint32_t adc_t, uint16_t adc_h)
+{
+  m_adc_p = adc_p;
+  m_adc_t = adc_t;
+  m_adc_h = adc_h;
+}
+
+uint8_t sim_spi_bme280_register(uint8_t address)
+{
+  return m_bme280[address & 0x7F];
+}
+
+void sim_spi_statistics_get(sim_spi_statistics_t* statistics)
+{
+  *statistics = m_statistics;
+}
+
+/* spi.h *******************************************************************************************/
+
+void spi_init(void)
+{
+  m_initialized = true;
+}
+
+bool spi_isInitialized(void)
+{
+  return m_initialized;
+}
+
+// Full-duplex transfers, response to command byte is in p_toRead[0]
+SPI_Ret spi_transfer_bme280(uint8_t* const p_toWrite, uint8_t count, uint8_t* const p_toRead)
+{
+  if(NULL == p_toWrite || NULL == p_toRead || 0 == count) { return SPI_RET_ERROR; }
+  p_toRead[0] = 0xFF;
+  bme280_transfer(p_toWrite[0], &p_toWrite[1], &p_toRead[1], count - 1);
+  return SPI_RET_OK;
+}
+
+SPI_Ret spi_transfer_lis2dh12(uint8_t* const p_toWrite, uint8_t count, uint8_t* const p_toRead)
+{
+  if(NULL == p_toWrite || NULL == p_toRead || 0 == count) { return SPI_RET_ERROR; }
+  p_toRead[0] = 0xFF;
+  lis2dh12_transfer(p_toWrite[0], &p_toWrite[1], &p_toRead[1], count - 1);
+  return SPI_RET_OK;
+}
+
+SPI_Ret spi_read_bme280(uint8_t command, uint8_t* const p_toRead, uint8_t count)
+{
+  if(NULL == p_toRead) { return SPI_RET_ERROR; }
+  bme280_transfer(command, NULL, p_toRead, count);
+  return SPI_RET_OK;
+}
+
+SPI_Ret spi_write_bme280(uint8_t command, const uint8_t* const p_toWrite, uint8_t count)
+{
+  if((NULL == p_toWrite && count) || SPI_WRITE_MAX_LENGTH < count) { return SPI_RET_ERROR; }
+  bme280_transfer(command, p_toWrite, NULL, count);
+  return SPI_RET_OK;
+}
+
+SPI_Ret spi_read_lis2dh12(uint8_t command, uint8_t* const p_toRead, uint8_t count)
+{
+  if(NULL == p_toRead) { return SPI_RET_ERROR; }
+  lis2dh12_transfer(command, NULL, p_toRead, count);
+  return SPI_RET_OK;
+}
+
+SPI_Ret spi_write_lis2dh12(uint8_t command, const uint8_t* const p_toWrite, uint8_t count)
+{
+  if((NULL == p_toWrite && count) || SPI_WRITE_MAX_LENGTH < count) { return SPI_RET_ERROR; }
+  lis2dh12_transfer(command, p_toWrite, NULL, count);
+  return SPI_RET_OK;
+}
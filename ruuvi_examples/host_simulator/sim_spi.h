@@ -0,0 +1,56 @@
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+/**
+ *  Virtual SPI bus with LIS2DH12 and BME280 register files, for tests of the real sensor drivers on host.
+ *
+ *  Implements spi.h. Every transfer is decoded like the sensors do: first byte is the command,
+ *  i.e. register address with read bit, and LIS2DH12 auto-increment bit. Following bytes are written
+ *  to or read from consecutive registers.
+ *  LIS2DH12 output registers read from a 32-sample FIFO while FIFO is enabled in CTRL_REG5, and the
+ *  address wraps from OUT_Z_H back to OUT_X_L, so one burst drains several samples like on the sensor.
+ *  FIFO_SRC_REG reports sample count and overrun. BME280 has the calibration of the datasheet example,
+ *  and converts when forced or normal mode is written, and before every read in normal mode.
+ *  Measurements with oversampling skipped read 0x80000.
+ */
+
+#include <stdint.h>
+#include "spi.h"
+
+typedef struct{
+  uint32_t transfers;  //!< Chip select assertions
+  uint32_t bytes;      //!< Bytes clocked, command bytes included
+}sim_spi_statistics_t;
+
+/** Reset register files to power-on values, empty FIFO and clear statistics **/
+void sim_spi_init(void);
+
+/**
+ *  Put a sample to LIS2DH12 FIFO as the sensor would sample it.
+ *
+ *  @param raw left-justified X Y Z output register values
+ */
+void sim_spi_lis2dh12_push(const int16_t raw[3]);
+
+/** Current value of a LIS2DH12 register **/
+uint8_t sim_spi_lis2dh12_register(uint8_t address);
+
+/**
+ *  Set BME280 ADC values and data registers, as if converted with every measurement enabled.
+ *
+ *  @param adc_p 20-bit pressure ADC value
+ *  @param adc_t 20-bit temperature ADC value
+ *  @param adc_h 16-bit humidity ADC value
+ */
+void sim_spi_bme280_set_adc(uint32_t adc_p, uint32_t adc_t, uint16_t adc_h);
+
+/** Set BME280 ADC values of following conversions, data registers keep the previous conversion **/
+void sim_spi_bme280_set_input(uint32_t adc_p, uint32_t adc_t, uint16_t adc_h);
+
+/** Current value of a BME280 register **/
+uint8_t sim_spi_bme280_register(uint8_t address);
+
+/** Copy counters since sim_spi_init **/
+void sim_spi_statistics_get(sim_spi_statistics_t* statistics);
+
+#endif
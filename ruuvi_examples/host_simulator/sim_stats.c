@@ -0,0 +1,81 @@
+#include "sim_stats.h"
+#include <time.h>
+
+static sim_stat_t m_stats[SIM_STATS_MAX];
+static size_t     m_num_stats = 0;
+
+typedef struct {
+  app_sched_event_handler_t handler;
+  sim_stat_t*               stat;
+}scheduler_handler_name_t;
+
+static scheduler_handler_name_t m_handlers[SIM_STATS_MAX];
+static size_t                   m_num_handlers = 0;
+static sim_stat_t*              p_other        = NULL;
+
+uint64_t sim_stats_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+sim_stat_t* sim_stats_register(const char* name)
+{
+  if(SIM_STATS_MAX <= m_num_stats) { return NULL; }
+  sim_stat_t* stat = &m_stats[m_num_stats++];
+  stat->name = name;
+  return stat;
+}
+
+void sim_stats_record(sim_stat_t* stat, uint64_t elapsed_ns)
+{
+  if(NULL == stat) { return; }
+  stat->calls++;
+  stat->total_ns += elapsed_ns;
+  if(elapsed_ns > stat->max_ns) { stat->max_ns = elapsed_ns; }
+}
+
+static void scheduler_observer(app_sched_event_handler_t handler, uint64_t elapsed_ns)
+{
+  for(size_t ii = 0; ii < m_num_handlers; ii++)
+  {
+    if(m_handlers[ii].handler == handler)
+    {
+      sim_stats_record(m_handlers[ii].stat, elapsed_ns);
+      return;
+    }
+  }
+  if(NULL == p_other) { p_other = sim_stats_register("sched: other"); }
+  sim_stats_record(p_other, elapsed_ns);
+}
+
+void sim_stats_register_scheduler_handler(app_sched_event_handler_t handler, const char* name)
+{
+  if(SIM_STATS_MAX <= m_num_handlers) { return; }
+  m_handlers[m_num_handlers].handler = handler;
+  m_handlers[m_num_handlers].stat    = sim_stats_register(name);
+  m_num_handlers++;
+  app_sched_sim_observer_set(scheduler_observer);
+}
+
+void sim_stats_report(FILE* out, double virtual_seconds)
+{
+  app_sched_sim_stats_t sched;
+  app_sched_sim_stats_get(&sched);
+  fprintf(out, "\nScheduler: %llu puts, %llu executed, %llu drops, depth avg %.2f max %u / %u\n",
+          (unsigned long long)sched.puts, (unsigned long long)sched.executed,
+          (unsigned long long)sched.drops,
+          sched.puts ? (double)sched.depth_sum / sched.puts : 0.0,
+          sched.depth_max, sched.queue_size);
+  fprintf(out, "\n%-32s %10s %10s %10s %10s\n", "handler", "calls", "msgs/s", "avg ns", "max ns");
+  for(size_t ii = 0; ii < m_num_stats; ii++)
+  {
+    sim_stat_t* stat = &m_stats[ii];
+    fprintf(out, "%-32s %10llu %10.1f %10llu %10llu\n", stat->name,
+            (unsigned long long)stat->calls,
+            virtual_seconds > 0 ? stat->calls / virtual_seconds : 0.0,
+            (unsigned long long)(stat->calls ? stat->total_ns / stat->calls : 0),
+            (unsigned long long)stat->max_ns);
+  }
+}
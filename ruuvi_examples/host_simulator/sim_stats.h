@@ -0,0 +1,39 @@
+#ifndef SIM_STATS_H
+#define SIM_STATS_H
+
+/**
+ *  Per-handler counters for host simulator.
+ *  Latency is measured in host nanoseconds and is inclusive, i.e. time of a handler
+ *  includes the time of handlers it calls synchronously. Absolute numbers are host numbers,
+ *  use them to compare changes rather than to predict on-tag timing.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "app_scheduler.h"
+
+#define SIM_STATS_MAX 16
+
+typedef struct {
+  const char* name;
+  uint64_t    calls;
+  uint64_t    total_ns;
+  uint64_t    max_ns;
+}sim_stat_t;
+
+/** Register a named counter, returns NULL if all slots are used **/
+sim_stat_t* sim_stats_register(const char* name);
+
+/** Register name for scheduler event handler, executed events are recorded under this name **/
+void sim_stats_register_scheduler_handler(app_sched_event_handler_t handler, const char* name);
+
+/** Record one call **/
+void sim_stats_record(sim_stat_t* stat, uint64_t elapsed_ns);
+
+/** Host monotonic clock, ns **/
+uint64_t sim_stats_now_ns(void);
+
+/** Print report, rates are given per second of virtual time **/
+void sim_stats_report(FILE* out, double virtual_seconds);
+
+#endif
@@ -22,6 +22,15 @@
 #define BME280_IIR                      BME280_IIR_16
 #define BME280_DELAY                    BME280_STANDBY_1000_MS
 
+// 1 to run BME280 in forced mode, one conversion per sample completed just before it is read.
+// Settings above apply to normal mode (0), where BME280 converts continuously and samples read the latest result.
+// Forced mode configuration of each tag mode: humidity, temperature and pressure oversampling and IIR.
+// IIR runs once per conversion, slow mode filters less to keep step response time of fast mode.
+#define APPLICATION_ENVIRONMENTAL_FORCED_MODE 1
+#define BME280_FORCED_RAWv1      { BME280_OVERSAMPLING_1, BME280_OVERSAMPLING_1, BME280_OVERSAMPLING_1, BME280_IIR_16 }
+#define BME280_FORCED_RAWv2_FAST { BME280_OVERSAMPLING_1, BME280_OVERSAMPLING_1, BME280_OVERSAMPLING_1, BME280_IIR_16 }
+#define BME280_FORCED_RAWv2_SLOW { BME280_OVERSAMPLING_1, BME280_OVERSAMPLING_1, BME280_OVERSAMPLING_2, BME280_IIR_4 }
+
 #define LIS2DH12_SCALE              LIS2DH12_SCALE2G
 #define LIS2DH12_RESOLUTION         LIS2DH12_RES10BIT
 #define LIS2DH12_SAMPLERATE_RAWv2   LIS2DH12_RATE_10
@@ -30,4 +39,34 @@
 // mg, scaled to bits by driver
 #define LIS2DH12_ACTIVITY_THRESHOLD 64
 
+// Samples in FIFO which wake up the tag to drain it between main loop ticks, 1 ... 31.
+// Main loop drains FIFO too, watermark is reached only if the loop is slower than watermark / ODR.
+#define LIS2DH12_FIFO_WATERMARK     24
+// Accelerometer duty cycling in RAWv2 modes, see activity_duty_cycle.h. While idle the accelerometer runs at
+// LIS2DH12_SAMPLERATE_IDLE in low power mode with FIFO bypassed, activity interrupt wakes it up to
+// LIS2DH12_SAMPLERATE_ACTIVE with FIFO. Falls back after ACTIVITY_QUIET_PERIOD_MS without activity interrupts
+// and with motion below ACTIVITY_MOTION_THRESHOLD, which is below LIS2DH12_ACTIVITY_THRESHOLD for hysteresis.
+// 0 runs at LIS2DH12_SAMPLERATE_RAWv2 all the time.
+#define APPLICATION_ACCELERATION_DUTY_CYCLE 1
+#define LIS2DH12_SAMPLERATE_IDLE    LIS2DH12_RATE_1
+#define LIS2DH12_RESOLUTION_IDLE    LIS2DH12_RES8BIT
+#define LIS2DH12_SAMPLERATE_ACTIVE  LIS2DH12_RATE_50
+#define ACTIVITY_QUIET_PERIOD_MS    30000u
+#define ACTIVITY_MOTION_THRESHOLD   16 // mg, RMS change between samples
+
+// 1 to advertise the sample with largest magnitude since previous advertisement, 0 for latest sample
+#define ACCELERATION_ADVERTISE_PEAK 0
+
+// Windows of motion statistics frame, see ADVERTISING_MIXED_MOTION_PERIOD
+#define MOTION_STATISTICS_WINDOW_MS    10000u
+#define MOTION_STATISTICS_THRESHOLD_MG 1500 // time above is counted from this magnitude on, 1000 mg at rest
+#define MOTION_STATISTICS_BIN_WIDTH_MG 250
+
+// Change from previous advertised values which returns adaptive advertising to fast interval
+#define ADAPTIVE_TEMPERATURE_THRESHOLD  10                          // 1/100 C
+#define ADAPTIVE_HUMIDITY_THRESHOLD     1024                        // 1/1024 %
+#define ADAPTIVE_PRESSURE_THRESHOLD     (10*256)                    // Pa / 256
+#define ADAPTIVE_ACCELERATION_THRESHOLD LIS2DH12_ACTIVITY_THRESHOLD // mg
+#define ADAPTIVE_MOTION_THRESHOLD       32                          // mg, RMS change between samples
+
 #endif
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include "bluetooth_application_config.h"
 #include "bluetooth_board_config.h"
 
+#include "ble_bulk_receive.h"
 #include "ble_bulk_transfer.h"
 #include "ruuvi_endpoints.h"
 
@@ -25,6 +26,8 @@ static ble_dfu_t m_dfus;    /**< Structure for DFU service. */
 static void nus_data_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t length)
 {
   NRF_LOG_INFO("Received %s\r\n", (uint32_t)p_data);
+  // Bulk write header, chunk or poll is copied to reassembly buffer
+  if(ble_bulk_receive(p_data, length)) { return; }
   //Assume standard message - TODO: Switch by endpoint
   if(length == 11){
     ruuvi_standard_message_t message = { .destination_endpoint = p_data[0],
@@ -32,10 +35,9 @@ static void nus_data_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t lengt
                                          .type = p_data[2],
                                          .payload = {0}};
     memcpy(&(message.payload[0]), &(p_data[3]), sizeof(message.payload));
-    //Schedule handling of the message - do not process in interrupt context
-    app_sched_event_put	(	&message,
-                          sizeof(message),
-                          ble_gatt_scheduler_event_handler);
+    //Schedule handling of the message - do not process in interrupt context.
+    //Replies go back to the central which wrote the message.
+    ble_link_message_schedule(message);
   }
 }
 
@@ -18,9 +18,54 @@
 #define ADVERTISING_INTERVAL_STARTUP  100u  // Interval of startup advertising
 #define APPLICATION_ADV_INTERVAL      ADVERTISING_INTERVAL_RAW //!< Default value for driver
 
+// Adaptive advertising uses interval of the mode while data changes and backs off exponentially
+// up to ADVERTISING_INTERVAL_ADAPTIVE_MAX while data is steady. Set to 0 for fixed interval of the mode.
+// Thresholds for change are in application_config.h
+#define APPLICATION_ADAPTIVE_ADVERTISING    1
+#define ADVERTISING_INTERVAL_ADAPTIVE_MAX   ADVERTISING_INTERVAL_RAW_SLOW
+#define ADVERTISING_ADAPTIVE_STEADY_SAMPLES 4u  // Main loop samples without change before interval doubles
+
+// Sample sensors on radio notification just before an advertisement instead of on main loop timer,
+// so advertisement carries fresh data and sensor reads share the wakeup of radio.
+// Main loop timer runs at RADIO_SYNC_FALLBACK_INTERVAL and samples only if radio has been quiet.
+#define APPLICATION_RADIO_SYNC_SAMPLING 0
+#define RADIO_SYNC_NOTIFICATION_DISTANCE NRF_RADIO_NOTIFICATION_DISTANCE_2680US // Time to read sensors and update data before radio
+#define RADIO_SYNC_MIN_INTERVAL         1000u  // ms, radio events closer than this to previous sample are skipped, i.e. startup and GATT
+#define RADIO_SYNC_FALLBACK_INTERVAL    10000u // ms
+
+// RAWv2 modes interleave other frames for older receivers, see advertising_scheduler.h.
+// A frame with period N takes one advertisement in N, RAWv2 goes on the rest. 0 disables the frame.
+#define ADVERTISING_MIXED_RAWv1_PERIOD  0
+#define ADVERTISING_MIXED_URL_PERIOD    0
+#define ADVERTISING_MIXED_URL_BASE      "\x03" "ruu.vi/#" // Eddystone scheme byte 0x03 "https://", at most URL_BASE_MAX_LENGTH chars after it
+// Eddystone TLM with battery, temperature, advertisement count and uptime, in every mode.
+// Encrypted eTLM uses EIK shared with the resolver and seconds since boot as time counter.
+#define ADVERTISING_MIXED_TLM_PERIOD      0
+#define ADVERTISING_TLM_ENCRYPTED         0
+#define ADVERTISING_TLM_EIK               { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+#define ADVERTISING_TLM_ROTATION_EXPONENT 10 // EID rotation period 2^K s
+// Motion statistics of acceleration magnitude in RAWv2 modes: peak, RMS, time above threshold and histogram
+// over MOTION_STATISTICS_WINDOW_MS, see motion_statistics.h for encoding. Frame is updated once per window.
+#define ADVERTISING_MIXED_MOTION_PERIOD   0
+
+// Relay RAWv2 of neighbours out of gateway range, see ble_relay.h. Enable on the tags selected as relays.
+// Scan window is scanned every period while budget allows, relayed payload takes every RELAY_FRAME_PERIODth advertisement.
+// Scanning draws about 5.4 mA, average added current is window / period * 5.4 mA, i.e. 1 % budget adds ~54 uA.
+// See scripts/relay.txt of host_simulator for delivery ratio at different budgets: 1 % delivers a fresh
+// measurement of every neighbour in every 5 minutes at 10 % packet loss.
+#define APPLICATION_BLE_RELAY  0
+#define RELAY_SCAN_WINDOW_MS   1400  // Longer than advertising interval of neighbours
+#define RELAY_SCAN_PERIOD_S    60
+#define RELAY_BUDGET_PERMILLE  10
+#define RELAY_FRAME_PERIOD     2
+#define RELAY_MAX_HOPS         2
+#define RELAY_REPEATS          3
+
 //Raw v2
 #define RAWv1_DATA_LENGTH 14
 #define RAWv2_DATA_LENGTH 24
+#define MOTION_DATA_LENGTH 19 // MOTION_STATISTICS_ENCODED_LENGTH and MAC
 
 /**
  *  BLE_GAP_ADV_TYPE_ADV_IND          0x00   Connectable, scannable
@@ -43,11 +43,16 @@
 #include "bsp.h"
 
 // Drivers
+#include "advertising_scheduler.h"
 #include "flash.h"
 #include "lis2dh12.h"
 #include "lis2dh12_acceleration_handler.h"
+#include "lis2dh12_event_handler.h"
+#include "activity_duty_cycle.h"
 #include "bme280.h"
+#include "bme280_scheduler.h"
 #include "battery.h"
+#include "ble_relay.h"
 #include "bluetooth_core.h"
 #include "eddystone.h"
 #include "pin_interrupt.h"
@@ -57,6 +62,10 @@
 #include "application_config.h"
 
 // Libraries
+#include "adaptive_advertising.h"
+#include "motion_aggregate.h"
+#include "motion_statistics.h"
+#include "magnitude.h"
 #include "base64.h"
 #include "sensortag.h"
 
@@ -108,8 +117,18 @@ static bool fast_advertising = true;           // Connectable mode
 static uint64_t fast_advertising_start = 0;    // Timestamp of when tag became connectable
 static uint64_t debounce = 0;                  // Flag for avoiding double presses
 static uint16_t acceleration_events = 0;       // Number of times accelerometer has triggered
+static motion_aggregate_t motion;              // Accelerometer samples since previous advertisement
+static motion_statistics_t statistics;         // Accelerometer samples of current motion statistics window
+static uint64_t statistics_window_start = 0;   // Timestamp of current motion statistics window
+static uint64_t fifo_drain_time = 0;           // Timestamp of latest FIFO drain which had samples
+static uint32_t fifo_overruns = 0;             // Times accelerometer FIFO was full before it was drained
+static activity_state_t accelerometer_state = ACTIVITY_STATE_ACTIVE; // Configuration of accelerometer
+static bme280_request_t environmental_request = { .interval_ms = BME280_SCHEDULER_SINGLE }; // Oversampling of advertised conversions
+static bme280_data_t environmental;            // Latest advertised BME280 sample
+static bool environmental_valid = false;       // Flag for environmental holding a sample
 static volatile uint16_t vbat = 0;             // Update in interrupt after radio activity.
 static uint64_t last_battery_measurement = 0;  // Timestamp of VBat update.
+static volatile uint64_t last_sample = 0;      // Timestamp of latest sensor sample, updated also in radio interrupt.
 static volatile bool pressed = false;          // Debounce flag
 
 // Possible modes of the app
@@ -127,15 +146,169 @@ static const uint16_t advertising_rates[] = {
   ADVERTISING_INTERVAL_RAW,
   ADVERTISING_INTERVAL_RAW_SLOW
 };
-// Rates of advertising. These must match the tag mode enum.
-static const uint16_t advertising_sizes[] = {
-  RAWv1_DATA_LENGTH,
-  RAWv2_DATA_LENGTH,
-  RAWv2_DATA_LENGTH
-};
+
+// BME280 configuration of forced mode, see APPLICATION_ENVIRONMENTAL_FORCED_MODE
+typedef struct {
+  uint8_t humidity_oversampling;
+  uint8_t temperature_oversampling;
+  uint8_t pressure_oversampling;
+  uint8_t iir;
+}environmental_config_t;
+
+// Frames of advertising scheduler
+#define ADV_FRAME_RAWv2 0
+#define ADV_FRAME_RAWv1 1
+#define ADV_FRAME_URL   2
+#define ADV_FRAME_TLM   3
+#define ADV_FRAME_RELAY 4
+#define ADV_FRAME_MOTION 5
 
 // Prototype declaration
 static void main_timer_handler(void * p_context);
+static void main_sensor_task(void* p_data, uint16_t length);
+static void sample_start(void* p_data, uint16_t length);
+
+/**
+ * Restart adaptive advertising from the interval of current mode.
+ * Adaptation is disabled if mode is already slower than the adaptive maximum.
+ */
+static void adaptive_advertising_configure(void)
+{
+  adaptive_advertising_config_t config = { .min_interval = advertising_rates[tag_mode],
+                                           .max_interval = APPLICATION_ADAPTIVE_ADVERTISING ? ADVERTISING_INTERVAL_ADAPTIVE_MAX : 0,
+                                           .steady_samples = ADVERTISING_ADAPTIVE_STEADY_SAMPLES,
+                                           .temperature_threshold  = ADAPTIVE_TEMPERATURE_THRESHOLD,
+                                           .humidity_threshold     = ADAPTIVE_HUMIDITY_THRESHOLD,
+                                           .pressure_threshold     = ADAPTIVE_PRESSURE_THRESHOLD,
+                                           .acceleration_threshold = ADAPTIVE_ACCELERATION_THRESHOLD,
+                                           .motion_threshold       = ADAPTIVE_MOTION_THRESHOLD };
+  adaptive_advertising_init(&config);
+}
+
+/**
+ * Select advertised frames of current mode. RAWv2 modes interleave RAWv1 and URL frames
+ * if configured, RAWv1 mode advertises RAWv1 only.
+ */
+static void advertising_frames_configure(void)
+{
+  bool raw2 = (RAWv1 != tag_mode);
+  adv_scheduler_frame_period_set(ADV_FRAME_RAWv2, raw2 ? 1 : 0);
+  adv_scheduler_frame_period_set(ADV_FRAME_RAWv1, raw2 ? ADVERTISING_MIXED_RAWv1_PERIOD : 1);
+  adv_scheduler_frame_period_set(ADV_FRAME_URL,   raw2 ? ADVERTISING_MIXED_URL_PERIOD : 0);
+  adv_scheduler_frame_period_set(ADV_FRAME_TLM,   ADVERTISING_MIXED_TLM_PERIOD);
+  adv_scheduler_frame_period_set(ADV_FRAME_MOTION, raw2 ? ADVERTISING_MIXED_MOTION_PERIOD : 0);
+}
+
+/**
+ * Configure BME280 for current mode. Forced mode converts once per sample with oversampling and IIR
+ * of the mode, normal mode converts continuously and samples read the latest result.
+ * Conversions of samples run on BME280_CHANNEL_APPLICATION of the scheduler, next to endpoint channels,
+ * which write the oversampling of each conversion.
+ */
+static void environmental_configure(void)
+{
+  if(!bme280_available) { return; }
+#if APPLICATION_ENVIRONMENTAL_FORCED_MODE
+  // Configurations of tag modes, these must match the tag mode enum.
+  static const environmental_config_t configs[] = {
+    BME280_FORCED_RAWv1,
+    BME280_FORCED_RAWv2_FAST,
+    BME280_FORCED_RAWv2_SLOW
+  };
+  // Mode is validated by change_mode, stored mode may be anything at boot
+  const environmental_config_t* config = &configs[(tag_mode <= RAWv2_SLOW) ? tag_mode : RAWv1];
+  environmental_request.oversampling_hum   = config->humidity_oversampling;
+  environmental_request.oversampling_temp  = config->temperature_oversampling;
+  environmental_request.oversampling_press = config->pressure_oversampling;
+  bme280_set_iir(config->iir);
+#else
+  environmental_request.oversampling_hum   = BME280_HUMIDITY_OVERSAMPLING;
+  environmental_request.oversampling_temp  = BME280_TEMPERATURE_OVERSAMPLING;
+  environmental_request.oversampling_press = BME280_PRESSURE_OVERSAMPLING;
+  // Endpoints run the sensor in forced mode, main_sensor_task resumes normal mode once they stop
+  if(!bme280_scheduler_is_idle()) { return; }
+  bme280_set_mode(BME280_MODE_SLEEP);
+  // oversampling must be set for each used sensor.
+  bme280_set_oversampling_hum  (BME280_HUMIDITY_OVERSAMPLING);
+  bme280_set_oversampling_temp (BME280_TEMPERATURE_OVERSAMPLING);
+  bme280_set_oversampling_press(BME280_PRESSURE_OVERSAMPLING);
+  bme280_set_iir(BME280_IIR);
+  bme280_set_interval(BME280_DELAY);
+  bme280_set_mode(BME280_MODE_NORMAL);
+  // Scheduled conversions write their oversampling again
+  bme280_scheduler_invalidate();
+#endif
+}
+
+/**
+ * Samples take a conversion of the scheduler in forced mode, and in normal mode while endpoints
+ * run the BME280 in forced mode. Otherwise they read the latest result of normal mode.
+ */
+static bool environmental_scheduled(void)
+{
+  return APPLICATION_ENVIRONMENTAL_FORCED_MODE || !bme280_scheduler_is_idle();
+}
+
+/** Request a conversion for a sample, environmental_handler gets the result **/
+static bool environmental_start(void)
+{
+  return BME280_RET_OK == bme280_scheduler_request(BME280_CHANNEL_APPLICATION, &environmental_request);
+}
+
+/** Read latest conversion from BME280 registers, i.e. the result of normal mode or the conversion of boot **/
+static void environmental_read(void)
+{
+  if(BME280_RET_OK != bme280_read_measurements()) { return; }
+  environmental.temperature = bme280_get_temperature();
+  environmental.pressure    = bme280_get_pressure();
+  environmental.humidity    = bme280_get_humidity();
+  environmental_valid = true;
+}
+
+/** Accelerometer follows activity in RAWv2 modes, RAWv1 runs at 1 Hz anyway **/
+static bool duty_cycling(void)
+{
+  return APPLICATION_ACCELERATION_DUTY_CYCLE && RAWv1 != tag_mode;
+}
+
+/**
+ * Configure accelerometer for activity state. Idle runs in low power mode with FIFO bypassed and
+ * watermark interrupt off, activity interrupt on pin 2 stays armed. Active runs at the rate of
+ * current mode with FIFO and watermark interrupt.
+ */
+static void accelerometer_configure(activity_state_t state)
+{
+  if(!lis2dh12_available) { return; }
+  // Changed registers are written in two bursts
+  lis2dh12_begin_configuration();
+  if(ACTIVITY_STATE_IDLE == state)
+  {
+    lis2dh12_set_interrupts(LIS2DH12_NO_INTERRUPTS, 1);
+    lis2dh12_set_fifo_mode(LIS2DH12_MODE_BYPASS);
+    lis2dh12_set_resolution(LIS2DH12_RESOLUTION_IDLE);
+    lis2dh12_set_sample_rate(LIS2DH12_SAMPLERATE_IDLE);
+  }
+  else
+  {
+    lis2dh12_sample_rate_t rate = LIS2DH12_SAMPLERATE_RAWv1;
+    if(RAWv1 != tag_mode) { rate = duty_cycling() ? LIS2DH12_SAMPLERATE_ACTIVE : LIS2DH12_SAMPLERATE_RAWv2; }
+    lis2dh12_set_resolution(LIS2DH12_RESOLUTION);
+    lis2dh12_set_sample_rate(rate);
+    lis2dh12_set_fifo_mode(LIS2DH12_MODE_STREAM);
+    lis2dh12_set_interrupts(LIS2DH12_I1_WTM, 1);
+  }
+  lis2dh12_commit_configuration();
+  // Tap, free-fall and orientation durations are in samples of the sample rate
+  lis2dh12_event_reconfigure();
+  accelerometer_state = state;
+}
+
+/** Tap and free-fall are not detected at idle sample rate, stay active while they are enabled **/
+static activity_state_t accelerometer_state_allowed(activity_state_t state)
+{
+  if(ACTIVITY_STATE_IDLE == state && lis2dh12_event_active_rate_required()) { return ACTIVITY_STATE_ACTIVE; }
+  return state;
+}
 
 /**@brief Handler for button press.
  * Called in scheduler, out of interrupt context.
@@ -146,33 +319,43 @@ void change_mode(void* data, uint16_t length)
     switch(tag_mode)
     {  
       case RAWv2_SLOW:
-        lis2dh12_set_sample_rate(LIS2DH12_SAMPLERATE_RAWv2);
         app_timer_start(main_timer_id, APP_TIMER_TICKS(MAIN_LOOP_INTERVAL_RAW_SLOW, RUUVITAG_APP_TIMER_PRESCALER), NULL);
         break;
 
       case RAWv2_FAST:
-        lis2dh12_set_sample_rate(LIS2DH12_SAMPLERATE_RAWv2);
         app_timer_start(main_timer_id, APP_TIMER_TICKS(MAIN_LOOP_INTERVAL_RAW, RUUVITAG_APP_TIMER_PRESCALER), NULL);
         break;
 
       case RAWv1:
       default:
-        lis2dh12_set_sample_rate(LIS2DH12_SAMPLERATE_RAWv1);
         app_timer_start(main_timer_id, APP_TIMER_TICKS(MAIN_LOOP_INTERVAL_RAW, RUUVITAG_APP_TIMER_PRESCALER), NULL);
         tag_mode = RAWv1;
         break;
     }
+  // Every mode starts active, duty cycling falls back to idle after quiet period
+  activity_duty_cycle_config_t duty_cycle_config = { .quiet_period_ms  = ACTIVITY_QUIET_PERIOD_MS,
+                                                     .motion_threshold = ACTIVITY_MOTION_THRESHOLD };
+  activity_duty_cycle_init(&duty_cycle_config, millis());
+  accelerometer_configure(ACTIVITY_STATE_ACTIVE);
+  environmental_configure();
+#if APPLICATION_RADIO_SYNC_SAMPLING
+  // Radio notifications trigger sampling, main loop timer only covers for a quiet radio.
+  app_timer_stop(main_timer_id);
+  app_timer_start(main_timer_id, APP_TIMER_TICKS(RADIO_SYNC_FALLBACK_INTERVAL, RUUVITAG_APP_TIMER_PRESCALER), NULL);
+#endif
+  adaptive_advertising_configure();
+  advertising_frames_configure();
   if(fast_advertising)
   {
     bluetooth_configure_advertising_interval(ADVERTISING_INTERVAL_STARTUP);
   }
   else
   {
-    bluetooth_configure_advertising_interval(advertising_rates[tag_mode]);
+    bluetooth_configure_advertising_interval(adaptive_advertising_interval_get());
   }
   bluetooth_apply_configuration();
   NRF_LOG_INFO("Updating to %d mode\r\n", (uint32_t) tag_mode);
-  main_timer_handler(NULL);
+  app_sched_event_put (NULL, 0, sample_start);
 }
 
 /**
@@ -341,14 +524,96 @@ static void power_manage(void)
 }
 
 
-static void updateAdvertisement(void)
+/**
+ * Encode sample to every advertised frame, advertising scheduler rotates them.
+ */
+static void updateAdvertisement(ruuvi_sensor_t* data)
 {
-  bluetooth_set_manufacturer_data(data_buffer, advertising_sizes[tag_mode]);
+  if(RAWv1 != tag_mode)
+  {
+    encodeToRawFormat5(data_buffer, data, acceleration_events, BLE_TX_POWER);
+    adv_scheduler_set_manufacturer_data(ADV_FRAME_RAWv2, data_buffer, RAWv2_DATA_LENGTH);
+  }
+  if(RAWv1 == tag_mode || ADVERTISING_MIXED_RAWv1_PERIOD)
+  {
+    encodeToRawFormat3(data_buffer, data);
+    adv_scheduler_set_manufacturer_data(ADV_FRAME_RAWv1, data_buffer, RAWv1_DATA_LENGTH);
+  }
+  if(RAWv1 != tag_mode && ADVERTISING_MIXED_URL_PERIOD)
+  {
+    // Scheme byte, base and payload
+    char url[1 + URL_BASE_MAX_LENGTH + URL_PAYLOAD_LENGTH] = ADVERTISING_MIXED_URL_BASE;
+    size_t base_length = sizeof(ADVERTISING_MIXED_URL_BASE) - 1;
+    encodeToUrlDataFromat(url, base_length, data);
+    adv_scheduler_set_eddystone_url(ADV_FRAME_URL, url, base_length + URL_PAYLOAD_LENGTH);
+  }
+  if(ADVERTISING_MIXED_TLM_PERIOD)
+  {
+    // Tag health for standard beacon infrastructure
+    eddystone_tlm_t tlm = { .battery     = vbat,
+                            .temperature = (TEMPERATURE_INVALID == data->temperature) ?
+                                           EDDYSTONE_TLM_TEMPERATURE_INVALID : data->temperature * 256 / 100,
+                            .adv_count   = adv_scheduler_events(),
+                            .uptime      = millis() / 100 };
+    ble_advdata_t advdata;
+#if ADVERTISING_TLM_ENCRYPTED
+    static const uint8_t eik[] = ADVERTISING_TLM_EIK;
+    ret_code_t tlm_status = eddystone_prepare_etlm_advertisement(&advdata, &tlm, eik, millis() / 1000,
+                                                                 ADVERTISING_TLM_ROTATION_EXPONENT);
+#else
+    ret_code_t tlm_status = eddystone_prepare_tlm_advertisement(&advdata, &tlm);
+#endif
+    // Busy ECB or random pool keeps the previous TLM frame until the next sample
+    if(NRF_SUCCESS == tlm_status) { adv_scheduler_frame_encode(ADV_FRAME_TLM, &advdata); }
+    else { NRF_LOG_WARNING("TLM frame not updated: %d\r\n", tlm_status); }
+  }
+  if(RAWv1 != tag_mode && ADVERTISING_MIXED_MOTION_PERIOD
+     && millis() - statistics_window_start >= MOTION_STATISTICS_WINDOW_MS)
+  {
+    // Frame keeps the previous window until the current one is complete
+    uint64_t now = millis();
+    motion_statistics_result_t result;
+    motion_statistics_close(&statistics);
+    motion_statistics_get(&statistics, &result);
+    motion_statistics_encode(data_buffer, &result, motion_statistics_time_above_ms(&result, now - statistics_window_start));
+    getRawFormat5Mac(&data_buffer[MOTION_STATISTICS_ENCODED_LENGTH]);
+    adv_scheduler_set_manufacturer_data(ADV_FRAME_MOTION, data_buffer, MOTION_DATA_LENGTH);
+    statistics_window_start = now;
+  }
 }
 
+/**
+ * Drain accelerometer FIFO in one SPI burst and aggregate the samples.
+ * Called in scheduler, from main loop and from FIFO watermark interrupt.
+ */
+static void lis2dh12_fifo_drain(void* p_data, uint16_t length)
+{
+  size_t count = 0;
+  bool overrun = false;
+  lis2dh12_sensor_buffer_t buffer[LIS2DH12_FIFO_MAX_LENGTH];
+  lis2dh12_get_fifo_status(&count, &overrun);
+  if(overrun) { fifo_overruns++; }
+  // FIFO is bypassed while idle, output registers hold the latest sample
+  if(ACTIVITY_STATE_IDLE == accelerometer_state) { count = 1; }
+  if(0 == count) { return; }
+  lis2dh12_read_samples(buffer, count);
+  // Samples stand for the time since previous drain, at 50 Hz active or 1 Hz idle alike
+  uint64_t now = millis();
+  uint32_t duration_ms = now - fifo_drain_time;
+  fifo_drain_time = now;
+  // Advertisement window and statistics window aggregate the same magnitudes
+  uint32_t squares[LIS2DH12_FIFO_MAX_LENGTH];
+  magnitude_square_block((int16_t*)buffer, squares, count);
+  motion_aggregate_add_squares(&motion, (int16_t*)buffer, squares, count);
+  if(ADVERTISING_MIXED_MOTION_PERIOD)
+  {
+    motion_statistics_add_squares(&statistics, (int16_t*)buffer, squares, count, duration_ms);
+  }
+}
 
 static void main_sensor_task(void* p_data, uint16_t length)
 {
+  last_sample = millis();
   // Signal mode by led color.
   if (RAWv1 == tag_mode) { RED_LED_ON; }
   else { GREEN_LED_ON; }
@@ -361,24 +626,33 @@ static void main_sensor_task(void* p_data, uint16_t length)
                           .temperature = TEMPERATURE_INVALID,
                           .vbat = vbat
                         };
-  lis2dh12_sensor_buffer_t buffer;
+  motion_aggregate_result_t motion_result = { 0 };
 
   if (fast_advertising && ((millis() - fast_advertising_start) > ADVERTISING_STARTUP_PERIOD))
   {
     fast_advertising = false;
     bluetooth_configure_advertisement_type(APPLICATION_ADVERTISEMENT_TYPE);
 
-    bluetooth_configure_advertising_interval(advertising_rates[tag_mode]);
+    bluetooth_configure_advertising_interval(adaptive_advertising_interval_get());
     bluetooth_apply_configuration();
   }
 
   if (bme280_available)
   {
-    // Get raw environmental data.
-    bme280_read_measurements();
-    data.temperature = bme280_get_temperature();
-    data.pressure    = bme280_get_pressure();
-    data.humidity    = bme280_get_humidity();
+    if(!environmental_scheduled())
+    {
+      // Endpoints have stopped and left BME280 asleep, resume normal mode. Next sample reads its result.
+      if(BME280_MODE_NORMAL != bme280_get_mode()) { environmental_configure(); }
+      else { environmental_read(); }
+    }
+    if(environmental_valid)
+    {
+      data.temperature = environmental.temperature;
+      data.pressure    = environmental.pressure;
+      data.humidity    = environmental.humidity;
+    }
+    // Radio notification is too close to advertisement for a conversion, next sample gets one started now
+    if(APPLICATION_RADIO_SYNC_SAMPLING && environmental_scheduled()) { environmental_start(); }
   }
   // If only temperature sensor is present.
   else
@@ -391,27 +665,39 @@ static void main_sensor_task(void* p_data, uint16_t length)
 
   if(lis2dh12_available)
   {
-    // Get accelerometer data.
-    lis2dh12_read_samples(&buffer, 1);
-    data.accX = buffer.sensor.x;
-    data.accY = buffer.sensor.y;
-    data.accZ = buffer.sensor.z;
+    // Get accelerometer samples taken since previous advertisement.
+    lis2dh12_fifo_drain(NULL, 0);
+    motion_aggregate_get(&motion, &motion_result);
+    const int16_t* acceleration = (ACCELERATION_ADVERTISE_PEAK && motion_result.count) ? motion_result.peak_sample : motion.latest;
+    if(motion.has_latest)
+    {
+      data.accX = acceleration[0];
+      data.accY = acceleration[1];
+      data.accZ = acceleration[2];
+    }
+    NRF_LOG_DEBUG("%d samples, peak %d mg, RMS %d mg, motion %d mg\r\n", motion_result.count, motion_result.peak,
+                                                                    motion_result.rms, motion_result.motion);
+    NRF_LOG_DEBUG("%d FIFO overruns\r\n", fifo_overruns);
+    motion_aggregate_reset(&motion);
+
+    if(duty_cycling())
+    {
+      activity_state_t state = activity_duty_cycle_update(acceleration_events, motion_result.motion, millis());
+      state = accelerometer_state_allowed(state);
+      if(state != accelerometer_state) { accelerometer_configure(state); }
+    }
   }
 
-  switch(tag_mode)
+  // Slow down advertising while data is steady, speed up on change or movement.
+  // Startup advertising is left as is, next sample after it applies the adaptive interval.
+  uint16_t interval = adaptive_advertising_interval_get();
+  if(interval != adaptive_advertising_update(&data, acceleration_events, motion_result.motion) && !fast_advertising)
   {
-    case RAWv2_FAST:
-    case RAWv2_SLOW:
-      encodeToRawFormat5(data_buffer, &data, acceleration_events, BLE_TX_POWER);
-      break;
-    
-    case RAWv1:
-    default:
-      encodeToRawFormat3(data_buffer, &data);
-      break;
+    bluetooth_configure_advertising_interval(adaptive_advertising_interval_get());
+    bluetooth_apply_configuration();
   }
 
-  updateAdvertisement();
+  updateAdvertisement(&data);
   watchdog_feed();
 }
 
@@ -419,10 +705,64 @@ static void main_sensor_task(void* p_data, uint16_t length)
  */
 static void main_timer_handler(void * p_context)
 {
-  app_sched_event_put (NULL, 0, main_sensor_task);
+  // Radio sampled recently
+  if(APPLICATION_RADIO_SYNC_SAMPLING && millis() - last_sample < RADIO_SYNC_FALLBACK_INTERVAL) { return; }
+  app_sched_event_put (NULL, 0, sample_start);
+}
+
+/**
+ * Start a sample. Scheduled BME280 converts first and the sample is taken once the conversion is complete,
+ * so that the data is fresh in the advertisement which follows. Otherwise the sample is taken at once.
+ * Called in scheduler.
+ */
+static void sample_start(void* p_data, uint16_t length)
+{
+  if(!APPLICATION_RADIO_SYNC_SAMPLING && bme280_available && environmental_scheduled() && environmental_start())
+  {
+    return;
+  }
+  main_sensor_task(NULL, 0);
+}
+
+/**
+ * Conversion of a sample is complete, take the sample. NULL data of a failed conversion keeps the previous
+ * result. Radio synchronised sampling takes the result at next radio notification instead.
+ * Called in scheduler.
+ */
+static void environmental_handler(const bme280_channel_t channel, const bme280_data_t* const data)
+{
+  if(NULL != data)
+  {
+    environmental = *data;
+    environmental_valid = true;
+  }
+  if(!APPLICATION_RADIO_SYNC_SAMPLING) { main_sensor_task(NULL, 0); }
 }
 
 
+/**
+ * Activity while accelerometer is idle, return to full rate.
+ * Called in scheduler, from activity interrupt on pin 2.
+ */
+static void accelerometer_wake(void* p_data, uint16_t length)
+{
+  activity_state_t state = accelerometer_state_allowed(activity_duty_cycle_on_wake(millis()));
+  if(duty_cycling() && state != accelerometer_state) { accelerometer_configure(state); }
+}
+
+/**
+ * Activity interrupt, counted in RAWv2 movement counter and wakes idle accelerometer.
+ * Called in interrupt context, or in scheduler while tap, free-fall or orientation is enabled.
+ */
+static void accelerometer_activity(void)
+{
+  acceleration_events++;
+  if(duty_cycling() && ACTIVITY_STATE_IDLE == accelerometer_state)
+  {
+    app_sched_event_put(NULL, 0, accelerometer_wake);
+  }
+}
+
 /**
  * @brief Handle interrupt from lis2dh12.
  * Never do long actions, such as sensor reads in interrupt context.
@@ -434,12 +774,20 @@ static void main_timer_handler(void * p_context)
 ret_code_t lis2dh12_int2_handler(const ruuvi_standard_message_t message)
 {
   NRF_LOG_DEBUG("Accelerometer interrupt to pin 2\r\n");
-  acceleration_events++;
-  /*
-  app_sched_event_put ((void*)(&message),
-                       sizeof(message),
-                       lis2dh12_scheduler_event_handler);
-  */
+  // Tap, free-fall and orientation share pin 2 with activity, event handler tells activity apart
+  return lis2dh12_event_int2_handler(message);
+}
+
+/**
+ * @brief Handle FIFO watermark interrupt from lis2dh12 on pin 1.
+ * FIFO is drained in scheduler, out of interrupt context.
+ *
+ *  @param message Ruuvi message, ignored.
+ **/
+static ret_code_t lis2dh12_watermark_handler(const ruuvi_standard_message_t message)
+{
+  NRF_LOG_DEBUG("Accelerometer FIFO watermark\r\n");
+  app_sched_event_put (NULL, 0, lis2dh12_fifo_drain);
   return NRF_SUCCESS;
 }
 
@@ -451,6 +799,17 @@ ret_code_t lis2dh12_int2_handler(const ruuvi_standard_message_t message)
  */
 static void on_radio_evt(bool active)
 {
+  // Next advertising frame goes to SoftDevice after radio event
+  adv_scheduler_on_radio_evt(active);
+
+  // Radio is about to advertise, schedule sampling and data update to run before it.
+  // Scheduler runs as soon as this interrupt returns, RADIO_SYNC_NOTIFICATION_DISTANCE leaves time for it.
+  if(APPLICATION_RADIO_SYNC_SAMPLING && active && millis() - last_sample >= RADIO_SYNC_MIN_INTERVAL)
+  {
+    last_sample = millis();
+    app_sched_event_put (NULL, 0, main_sensor_task);
+  }
+
   // If radio is turned off (was active) and enough time has passed since last measurement
   if(false == active && millis() - last_battery_measurement > APPLICATION_BATTERY_INTERVAL)
   {
@@ -531,7 +890,7 @@ int main(void)
   // 6, 7 after SD non-critical events.
   // Triggers ADC, so use 3. 
   ble_radio_notification_init(3,
-                              NRF_RADIO_NOTIFICATION_DISTANCE_800US,
+                              APPLICATION_RADIO_SYNC_SAMPLING ? RADIO_SYNC_NOTIFICATION_DISTANCE : NRF_RADIO_NOTIFICATION_DISTANCE_800US,
                               on_radio_evt);
 
   // If GATT is enabled BLE init inits peer manager which uses flash.
@@ -569,6 +928,7 @@ int main(void)
     lis2dh12_reset(); // Clear memory.
     
     // Enable Low-To-Hi rising edge trigger interrupt on nRF52 to detect acceleration events.
+    lis2dh12_event_set_activity_handler(accelerometer_activity);
     if (pin_interrupt_enable(INT_ACC2_PIN, NRF_GPIOTE_POLARITY_LOTOHI, NRF_GPIO_PIN_NOPULL, lis2dh12_int2_handler) )
     {
       init_status |= ACC_INT_FAILED_INIT;
@@ -582,17 +942,37 @@ int main(void)
     lis2dh12_set_resolution(LIS2DH12_RESOLUTION);
 
     lis2dh12_set_activity_interrupt_pin_2(LIS2DH12_ACTIVITY_THRESHOLD);
+
+    // Keep every sample in FIFO between reads, drain when watermark is reached.
+    motion_aggregate_init(&motion);
+    motion_statistics_config_t statistics_config = { .threshold = MOTION_STATISTICS_THRESHOLD_MG,
+                                                     .bin_width = MOTION_STATISTICS_BIN_WIDTH_MG,
+                                                     .window    = 0 };
+    motion_statistics_init(&statistics, &statistics_config);
+    statistics_window_start = millis();
+    fifo_drain_time = statistics_window_start;
+    lis2dh12_set_fifo_watermark(LIS2DH12_FIFO_WATERMARK);
+    lis2dh12_set_fifo_mode(LIS2DH12_MODE_STREAM);
+    lis2dh12_set_interrupts(LIS2DH12_I1_WTM, 1);
+    if (pin_interrupt_enable(INT_ACC1_PIN, NRF_GPIOTE_POLARITY_LOTOHI, NRF_GPIO_PIN_NOPULL, lis2dh12_watermark_handler) )
+    {
+      init_status |= ACC_INT_FAILED_INIT;
+    }
     NRF_LOG_INFO("Accelerometer configuration done \r\n");
   }
   if(bme280_available)
   {
-    // oversampling must be set for each used sensor.
-    bme280_set_oversampling_hum  (BME280_HUMIDITY_OVERSAMPLING);
-    bme280_set_oversampling_temp (BME280_TEMPERATURE_OVERSAMPLING);
-    bme280_set_oversampling_press(BME280_PRESSURE_OVERSAMPLING);
-    bme280_set_iir(BME280_IIR);
-    bme280_set_interval(BME280_DELAY);
-    bme280_set_mode(BME280_MODE_NORMAL);
+    environmental_configure();
+    bme280_scheduler_set_application_handler(environmental_handler);
+    // First sample is read after boot delay below, before the scheduler runs
+    if(APPLICATION_ENVIRONMENTAL_FORCED_MODE)
+    {
+      bme280_set_oversampling_hum  (environmental_request.oversampling_hum);
+      bme280_set_oversampling_temp (environmental_request.oversampling_temp);
+      bme280_set_oversampling_press(environmental_request.oversampling_press);
+      bme280_scheduler_invalidate();
+      bme280_set_mode(BME280_MODE_FORCED);
+    }
     NRF_LOG_INFO("BME280 configuration done \r\n");
   }
 
@@ -640,6 +1020,7 @@ int main(void)
   nrf_delay_ms(1000);
   // Get first sample from sensors, set fast advertising start counter
   fast_advertising_start = millis();
+  if(bme280_available) { environmental_read(); }
   app_sched_event_put (NULL, 0, main_sensor_task);
   app_sched_execute();
 
@@ -647,6 +1028,24 @@ int main(void)
   bluetooth_advertising_start(); 
   NRF_LOG_INFO("Advertising started\r\n");
 
+#if APPLICATION_BLE_RELAY
+  // Relay neighbours' RAWv2 in idle time, own payloads relayed back are ignored
+  uint8_t mac[BLE_RELAY_MAC_LENGTH];
+  getRawFormat5Mac(mac);
+  ble_relay_config_t relay_config = { .scan_window_ms      = RELAY_SCAN_WINDOW_MS,
+                                      .scan_period_s       = RELAY_SCAN_PERIOD_S,
+                                      .budget_permille     = RELAY_BUDGET_PERMILLE,
+                                      .forward_interval_ms = RELAY_FRAME_PERIOD * ADVERTISING_INTERVAL_RAW,
+                                      .frame_period        = RELAY_FRAME_PERIOD,
+                                      .max_hops            = RELAY_MAX_HOPS,
+                                      .repeats             = RELAY_REPEATS };
+  if(ble_relay_init(ADV_FRAME_RELAY, mac) || ble_relay_configure(&relay_config) || ble_relay_enable(true))
+  {
+    NRF_LOG_ERROR("Failed to start relay\r\n");
+  }
+  set_relay_handler(ble_relay_handler);
+#endif
+
   // Enter main loop. Executes tasks scheduled by timers and interrupts.
   for (;;)
   {
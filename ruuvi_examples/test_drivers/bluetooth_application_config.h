@@ -7,6 +7,9 @@
 #define APP_DEVICE_NAME_LENGTH APPLICATION_DEVICE_NAME_LENGTH
 #define APPLICATION_ADV_INTERVAL        1000                            /**< ms **/
 #define APP_TX_POWER                    4                               /**< dBm **/
+#define APPLICATION_BLE_MAX_MTU_SIZE    247                             /**< bytes, 247 fills one LL packet with data length extension **/
+#define APPLICATION_BLE_STD_PACKING     1                               /**< Pack standard messages into frames, see ruuvi_message_frame.h **/
+#define APPLICATION_BLE_BULK_ACK        1                               /**< Receiver acknowledges bulk transfers, see ble_bulk_transfer.h **/
 #define INIT_FWREV                      "Test 1.3.0"                    /**< Github tag **/
 #define INIT_SWREV                      INIT_FWREV                      /**< Essentially same s FWrev since there is no separate SW (i.e. Espruino) **/
 
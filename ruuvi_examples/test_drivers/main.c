@@ -196,6 +196,7 @@ int main(void)
   bluetooth_advertising_start();  
   
   set_mam_handler(mam_handler); //XXX POC
+  set_bulk_transfer_handler(ble_bulk_ack_handler);
   
   while(1)
   {
@@ -119,4 +119,26 @@ void test_environmental(void)
     nrf_delay_ms(1100);
   }
   bme280_set_mode(BME280_MODE_SLEEP);
+
+  // CPU cycles of compensation, 64-bit pressure calls runtime library for 64-bit division
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  bme280_read_measurements();
+  uint32_t start = DWT->CYCCNT;
+  raw_t = bme280_get_temperature();
+  uint32_t cycles_t = DWT->CYCCNT - start;
+  start = DWT->CYCCNT;
+  raw_h = bme280_get_humidity();
+  uint32_t cycles_h = DWT->CYCCNT - start;
+  start = DWT->CYCCNT;
+  raw_p = bme280_compensate_pressure_int64(bme280.adc_p);
+  uint32_t cycles_p64 = DWT->CYCCNT - start;
+  start = DWT->CYCCNT;
+  uint32_t raw_p32 = bme280_compensate_pressure_int32(bme280.adc_p);
+  uint32_t cycles_p32 = DWT->CYCCNT - start;
+  NRF_LOG_INFO("Compensation cycles: temperature %d, humidity %d, pressure 64-bit %d, 32-bit %d\r\n",
+               cycles_t, cycles_h, cycles_p64, cycles_p32);
+  NRF_LOG_INFO("Pressure 64-bit: %d.%d, 32-bit: %d\r\n", raw_p>>8, ((raw_p*1000)>>8)%1000, raw_p32>>8);
+  NRF_LOG_FLUSH();
 }